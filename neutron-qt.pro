@@ -172,6 +172,8 @@ HEADERS += src/activemasternode.h \
     src/base58.h \
     src/bignum.h \
     src/bitcoinrpc.h \
+    src/blockserver.h \
+    src/blockstats.h \
     src/chainparams.h \
     src/checkpoints.h \
     src/clientversion.h \
@@ -180,13 +182,18 @@ HEADERS += src/activemasternode.h \
     src/coincontrol.h \
     src/darksend.h \
     src/db.h \
+    src/feeestimator.h \
     src/init.h \
     src/ismine.h \
     src/kernel.h \
     src/key.h \
     src/keystore.h \
+    src/lockedpool.h \
+    src/txsigner.h \
     src/main.h \
     src/masternode.h \
+    src/masternodecollateral.h \
+    src/masternodelistsync.h \
     src/miner.h \
     src/mruset.h \
     src/net.h \
@@ -197,11 +204,13 @@ HEADERS += src/activemasternode.h \
     src/protocol.h \
     src/random.h \
     src/robinhood.h \
+    src/runtimeconfig.h \
     src/scheduler.h \
     src/script.h \
     src/scrypt.h \
     src/serialize.h \
     src/spork.h \
+    src/stakeportfolio.h \
     src/streams.h \
     src/strlcpy.h \
     src/sync.h \
@@ -219,6 +228,7 @@ HEADERS += src/activemasternode.h \
     src/validation.h \
     src/version.h \
     src/wallet.h \
+    src/walletcheck.h \
     src/walletdb.h \
     src/json/json_spirit.h \
     src/json/json_spirit_error_position.h \
@@ -279,19 +289,26 @@ SOURCES += src/activemasternode.cpp \
     src/alert.cpp \
     src/backtrace.cpp \
     src/bitcoinrpc.cpp \
+    src/blockserver.cpp \
+    src/blockstats.cpp \
     src/chainparams.cpp \
     src/checkpoints.cpp \
     src/clientversion.cpp \
     src/crypter.cpp \
     src/darksend.cpp \
     src/db.cpp \
+    src/feeestimator.cpp \
     src/init.cpp \
     src/ismine.cpp \
     src/kernel.cpp \
     src/key.cpp \
     src/keystore.cpp \
+    src/lockedpool.cpp \
+    src/txsigner.cpp \
     src/main.cpp \
     src/masternode.cpp \
+    src/masternodecollateral.cpp \
+    src/masternodelistsync.cpp \
     src/masternodeconfig.cpp \
     src/miner.cpp \
     src/net.cpp \
@@ -308,6 +325,7 @@ SOURCES += src/activemasternode.cpp \
     src/rpcnet.cpp \
     src/rpcrawtransaction.cpp \
     src/rpcwallet.cpp \
+    src/runtimeconfig.cpp \
     src/scheduler.cpp \
     src/script.cpp \
     src/scrypt.cpp \
@@ -315,6 +333,7 @@ SOURCES += src/activemasternode.cpp \
     src/scrypt-x86.S \
     src/scrypt-x86_64.S \
     src/spork.cpp \
+    src/stakeportfolio.cpp \
     src/sync.cpp \
     src/threadinterrupt.cpp \
     src/timedata.cpp \
@@ -326,6 +345,7 @@ SOURCES += src/activemasternode.cpp \
     src/utiltime.cpp \
     src/validation.cpp \
     src/wallet.cpp \
+    src/walletcheck.cpp \
     src/walletdb.cpp \
     src/primitives/block.cpp \
     src/primitives/transaction.cpp \
@@ -561,7 +581,7 @@ macx:QMAKE_TARGET_BUNDLE_PREFIX = "com.neutroncoin"
 # Set libraries and includes at end, to use platform-defined defaults if not overridden
 INCLUDEPATH += $$BOOST_INCLUDE_PATH $$BDB_INCLUDE_PATH $$OPENSSL_INCLUDE_PATH
 LIBS += $$join(BOOST_LIB_PATH,,-L,) $$join(BDB_LIB_PATH,,-L,) $$join(OPENSSL_LIB_PATH,,-L,)
-LIBS += -lssl -lcrypto -ldb_cxx$$BDB_LIB_SUFFIX
+LIBS += -lssl -lcrypto -ldb_cxx$$BDB_LIB_SUFFIX -lz
 # -lgdi32 has to happen after -lcrypto (see  #681)
 windows:LIBS += -lws2_32 -lshlwapi -lmswsock -lole32 -loleaut32 -luuid -lgdi32
 LIBS += -lboost_system$$BOOST_LIB_SUFFIX -lboost_filesystem$$BOOST_LIB_SUFFIX -lboost_program_options$$BOOST_LIB_SUFFIX -lboost_thread$$BOOST_THREAD_LIB_SUFFIX -lboost_chrono$$BOOST_LIB_SUFFIX
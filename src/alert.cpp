@@ -170,6 +170,40 @@ CAlert CAlert::getAlertByHash(const uint256 &hash)
     return retval;
 }
 
+std::vector<CAlert> CAlert::getActiveAlerts()
+{
+    std::vector<CAlert> vAlerts;
+    {
+        LOCK(cs_mapAlerts);
+        BOOST_FOREACH(PAIRTYPE(const uint256, CAlert)& item, mapAlerts)
+        {
+            if (item.second.IsInEffect())
+                vAlerts.push_back(item.second);
+        }
+    }
+    return vAlerts;
+}
+
+bool CAlert::ProcessStoredAlert()
+{
+    if (!CheckSignature())
+        return false;
+    if (!IsInEffect())
+        return false;
+
+    {
+        LOCK(cs_mapAlerts);
+        BOOST_FOREACH(PAIRTYPE(const uint256, CAlert)& item, mapAlerts)
+        {
+            if (item.second.Cancels(*this))
+                return false;
+        }
+
+        mapAlerts.insert(make_pair(GetHash(), *this));
+    }
+    return true;
+}
+
 bool CAlert::ProcessAlert(bool fThread)
 {
     if (!CheckSignature())
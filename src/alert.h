@@ -99,6 +99,17 @@ public:
      * Get copy of (active) alert object by hash. Returns a null alert if it is not found.
      */
     static CAlert getAlertByHash(const uint256 &hash);
+
+    /*
+     * Get copies of all alerts currently in effect, to persist them across restarts.
+     */
+    static std::vector<CAlert> getActiveAlerts();
+
+    /*
+     * Re-add an alert read back from disk. The signature is checked, but the UI
+     * and -alertnotify are not notified again.
+     */
+    bool ProcessStoredAlert();
 };
 
 #endif
@@ -10,6 +10,8 @@
 #include <boost/thread/mutex.hpp>
 #include <map>
 
+#include "lockedpool.h"
+
 #ifdef WIN32
 #ifdef _WIN32_WINNT
 #undef _WIN32_WINNT
@@ -175,9 +177,22 @@ private:
     {}
 };
 
+/**
+ * Singleton pool of locked arenas that secure_allocator serves from first.
+ */
+class LockedPoolManager: public LockedPoolBase<MemoryPageLocker>
+{
+public:
+    static LockedPoolManager& Instance(); // instantiated in util.cpp
+private:
+    LockedPoolManager() {}
+};
+
 //
 // Allocator that locks its contents from being paged
 // out of memory and clears its contents before deletion.
+// Small allocations come from the locked pool, anything it
+// can't take locks its own pages.
 //
 template<typename T>
 struct secure_allocator : public std::allocator<T>
@@ -201,7 +216,9 @@ struct secure_allocator : public std::allocator<T>
 
     T* allocate(std::size_t n, const void *hint = 0)
     {
-        T *p;
+        T *p = static_cast<T*>(LockedPoolManager::Instance().alloc(sizeof(T) * n));
+        if (p != NULL)
+            return p;
         p = std::allocator<T>::allocate(n, hint);
         if (p != NULL)
             LockedPageManager::instance.LockRange(p, sizeof(T) * n);
@@ -212,7 +229,10 @@ struct secure_allocator : public std::allocator<T>
     {
         if (p != NULL)
         {
-            memset(p, 0, sizeof(T) * n);
+            // The pool wipes what it takes back
+            if (LockedPoolManager::Instance().free(p))
+                return;
+            memory_cleanse(p, sizeof(T) * n);
             LockedPageManager::instance.UnlockRange(p, sizeof(T) * n);
         }
         std::allocator<T>::deallocate(p, n);
@@ -9,6 +9,7 @@
 #include "base58.h"
 #include "db.h"
 #include "init.h"
+#include "runtimeconfig.h"
 #include "sync.h"
 #include "ui_interface.h"
 #include "util.h"
@@ -335,6 +336,85 @@ UniValue debug(const UniValue& params, bool fHelp)
     return true;
 }
 
+static UniValue ConfigOptionToJSON(const CConfigOption& option)
+{
+    static const char* pszSources[] = { "default", "args", "reload", "setconfig" };
+
+    UniValue obj(UniValue::VOBJ);
+
+    switch (option.GetType())
+    {
+    case CONFIG_BOOL:
+        obj.push_back(Pair("value", option.GetBool()));
+        obj.push_back(Pair("default", option.GetDefault() != 0));
+        break;
+
+    case CONFIG_INT:
+        obj.push_back(Pair("value", option.GetInt()));
+        obj.push_back(Pair("default", option.GetDefault()));
+        obj.push_back(Pair("min", option.GetMin()));
+        obj.push_back(Pair("max", option.GetMax()));
+        break;
+
+    case CONFIG_LIST:
+        obj.push_back(Pair("value", option.GetString()));
+        obj.push_back(Pair("default", ""));
+        break;
+    }
+
+    obj.push_back(Pair("hot", option.IsHotReload()));
+    obj.push_back(Pair("source", pszSources[option.GetSource()]));
+
+    return obj;
+}
+
+UniValue getconfig(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+    {
+        throw runtime_error("getconfig [name]\n"
+                            "Returns the runtime options, or the one named, with their value, default, range,\n"
+                            "whether setconfig can change them (hot) and where the value came from.");
+    }
+
+    if (params.size() > 0)
+    {
+        CConfigOption* poption = FindConfigOption(params[0].get_str());
+
+        if (!poption)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown option " + params[0].get_str());
+
+        return ConfigOptionToJSON(*poption);
+    }
+
+    UniValue result(UniValue::VOBJ);
+
+    BOOST_FOREACH(const CConfigOption* poption, GetConfigOptions())
+        result.push_back(Pair(poption->GetName(), ConfigOptionToJSON(*poption)));
+
+    return result;
+}
+
+UniValue setconfig(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 2)
+    {
+        throw runtime_error("setconfig <name> <value>\n"
+                            "Changes a runtime option until the next restart, a SIGHUP reloading the\n"
+                            "config file leaves it alone. See getconfig for the options that can be\n"
+                            "changed. debug takes a list of log categories, e.g. \"net,masternode\",\n"
+                            "\"1\" for all of them or \"\" to stop debug output.");
+    }
+
+    string strValue = params[1].isStr() ? params[1].get_str() : params[1].write();
+    string strError;
+
+    if (!SetConfigOption(params[0].get_str(), strValue, strError))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strError);
+
+    return ConfigOptionToJSON(*FindConfigOption(params[0].get_str()));
+}
+
 UniValue help(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() > 1)
@@ -372,6 +452,8 @@ static const CRPCCommand vRPCCommands[] =
     { "getinfo",                &getinfo,                true,       false },
     { "getdebuginfo",           &getdebuginfo,           true,       false },
     { "debug",                  &debug,                  true,       true },
+    { "getconfig",              &getconfig,              true,       true },
+    { "setconfig",              &setconfig,              true,       true },
     { "help",                   &help,                   true,       true },
     { "stop",                   &stop,                   true,       true },
 
@@ -380,6 +462,9 @@ static const CRPCCommand vRPCCommands[] =
     { "disconnectnode",         &disconnectnode,         true,       false },
     { "getconnectioncount",     &getconnectioncount,     true,       false },
     { "getpeerinfo",            &getpeerinfo,            true,       false },
+    { "getnettotals",           &getnettotals,           true,       false },
+    { "getschedulerinfo",       &getschedulerinfo,       true,       false },
+    { "getmemoryinfo",          &getmemoryinfo,          true,       false },
     { "setban",                 &setban,                 true,       false },
     { "listbanned",             &listbanned,             true,       false },
     { "clearbanned",            &clearbanned,            true,       false },
@@ -390,7 +475,10 @@ static const CRPCCommand vRPCCommands[] =
     { "getblock",               &getblock,               true,       false },
     { "getblockhash",           &getblockhash,           true,       false },
     { "getdifficulty",          &getdifficulty,          true,       false },
+    { "getblockstats",          &getblockstats,          true,       false },
+    { "getblockstorageinfo",    &getblockstorageinfo,    true,       false },
     { "getrawmempool",          &getrawmempool,          true,       false },
+    { "savemempool",            &savemempool,            true,       false },
 
     /* Mining */
     { "getblocktemplate",       &getblocktemplate,       true,       false },
@@ -398,6 +486,7 @@ static const CRPCCommand vRPCCommands[] =
     { "getstakinginfo",         &getstakinginfo,         true,       false },
     { "submitblock",            &submitblock,            false,      false },
     { "reservebalance",         &reservebalance,         false,      true },
+    { "setstakepolicy",         &setstakepolicy,         false,      true },
 
     /* Coin generation */
     { "setgenerate",            &setgenerate,            true,       false },
@@ -411,6 +500,7 @@ static const CRPCCommand vRPCCommands[] =
     { "signrawtransaction",     &signrawtransaction,     false,      false },
 
     /* Utility functions */
+    { "estimatefee",            &estimatefee,            true,       false },
     { "validateaddress",        &validateaddress,        true,       false },
     { "verifymessage",          &verifymessage,          true,       false },
 
@@ -446,6 +536,7 @@ static const CRPCCommand vRPCCommands[] =
     { "listunspent",            &listunspent,            false,      false },
     { "lockunspent",            &lockunspent,            false,      false },
     { "move",                   &movecmd,                false,      false },
+    { "restorewalletbackup",    &restorewalletbackup,    true,       false },
     { "sendfrom",               &sendfrom,               false,      false },
     { "sendmany",               &sendmany,               false,      false },
     { "sendtoaddress",          &sendtoaddress,          false,      false },
@@ -470,6 +561,7 @@ static const CRPCCommand vRPCCommands[] =
     { "getworkex",              &getworkex,              true,       false },
     { "makekeypair",            &makekeypair,            false,      true },
     { "repairwallet",           &repairwallet,           false,      true },
+    { "getwalletcheckinfo",     &getwalletcheckinfo,     true,       true },
     { "resendtx",               &resendtx,               false,      true },
     { "sendalert",              &sendalert,              false,      false },
     { "validatepubkey",         &validatepubkey,         true,       false },
@@ -1431,6 +1523,9 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "getblockbyrange", 2, "txinfo" },
     { "getblockversionstats", 0, "version" },
     { "getblockversionstats", 1, "blocks_to_count" },
+    { "getblockstats", 0, "from" },
+    { "getblockstats", 1, "to" },
+    { "getblockstats", 2, "interval" },
     { "invalidateblock", 0, "height" },
     { "getsuperblockbudget", 0, "index" },
     { "waitforblockheight", 0, "height" },
@@ -1467,6 +1562,9 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "createrawtransaction", 1, "outputs" },
     { "signrawtransaction", 1, "prevtxs" },
     { "signrawtransaction", 2, "privkeys" },
+    { "signrawtransaction", 4, "verify" },
+    { "checkwallet", 0, "full" },
+    { "repairwallet", 0, "full" },
     { "sendrawtransaction", 1, "allowhighfees" },
     { "sendrawtransaction", 2, "instantsend" },
     { "sendrawtransaction", 3, "bypasslimits" },
@@ -175,6 +175,9 @@ extern std::string HelpExampleRpc(std::string methodname, std::string args);
 // in rpcnet.cpp
 extern UniValue getconnectioncount(const UniValue& params, bool fHelp);
 extern UniValue getpeerinfo(const UniValue& params, bool fHelp);
+extern UniValue getnettotals(const UniValue& params, bool fHelp);
+extern UniValue getschedulerinfo(const UniValue& params, bool fHelp);
+extern UniValue getmemoryinfo(const UniValue& params, bool fHelp);
 extern UniValue addnode(const UniValue& params, bool fHelp);
 extern UniValue disconnectnode(const UniValue& params, bool fHelp);
 extern UniValue setban(const UniValue& params, bool fHelp);
@@ -199,6 +202,8 @@ extern UniValue dumpwallet(const UniValue& params, bool fHelp);
 extern UniValue getsubsidy(const UniValue& params, bool fHelp);
 extern UniValue getmininginfo(const UniValue& params, bool fHelp);
 extern UniValue getstakinginfo(const UniValue& params, bool fHelp);
+extern UniValue setstakepolicy(const UniValue& params, bool fHelp);
+extern UniValue estimatefee(const UniValue& params, bool fHelp);
 extern UniValue getworkex(const UniValue& params, bool fHelp);
 extern UniValue getwork(const UniValue& params, bool fHelp);
 extern UniValue getblocktemplate(const UniValue& params, bool fHelp);
@@ -234,6 +239,7 @@ extern UniValue listaccounts(const UniValue& params, bool fHelp);
 extern UniValue listsinceblock(const UniValue& params, bool fHelp);
 extern UniValue gettransaction(const UniValue& params, bool fHelp);
 extern UniValue backupwallet(const UniValue& params, bool fHelp);
+extern UniValue restorewalletbackup(const UniValue& params, bool fHelp);
 extern UniValue keypoolrefill(const UniValue& params, bool fHelp);
 extern UniValue walletpassphrase(const UniValue& params, bool fHelp);
 extern UniValue walletpassphrasechange(const UniValue& params, bool fHelp);
@@ -244,6 +250,7 @@ extern UniValue validatepubkey(const UniValue& params, bool fHelp);
 extern UniValue reservebalance(const UniValue& params, bool fHelp);
 extern UniValue checkwallet(const UniValue& params, bool fHelp);
 extern UniValue repairwallet(const UniValue& params, bool fHelp);
+extern UniValue getwalletcheckinfo(const UniValue& params, bool fHelp);
 extern UniValue resendtx(const UniValue& params, bool fHelp);
 extern UniValue makekeypair(const UniValue& params, bool fHelp);
 extern UniValue getminingreport(const UniValue& params, bool fHelp);
@@ -265,6 +272,7 @@ extern UniValue getblockcount(const UniValue& params, bool fHelp);
 extern UniValue getdifficulty(const UniValue& params, bool fHelp);
 extern UniValue settxfee(const UniValue& params, bool fHelp);
 extern UniValue getrawmempool(const UniValue& params, bool fHelp);
+extern UniValue savemempool(const UniValue& params, bool fHelp);
 extern UniValue getblockhash(const UniValue& params, bool fHelp);
 extern UniValue getblock(const UniValue& params, bool fHelp);
 extern UniValue getblockbynumber(const UniValue& params, bool fHelp);
@@ -272,5 +280,7 @@ extern UniValue getblockbyrange(const UniValue& params, bool fHelp);
 extern UniValue getcheckpoint(const UniValue& params, bool fHelp);
 extern UniValue getblockversionstats(const UniValue& params, bool fHelp);
 extern UniValue invalidateblock(const UniValue& params, bool fHelp);
+extern UniValue getblockstats(const UniValue& params, bool fHelp);
+extern UniValue getblockstorageinfo(const UniValue& params, bool fHelp);
 
 #endif
@@ -0,0 +1,215 @@
+// Copyright (c) 2016-2020 The Neutron Developers
+//
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockserver.h"
+#include "main.h"
+#include "net.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <boost/thread/condition_variable.hpp>
+
+using namespace std;
+
+extern boost::condition_variable messageHandlerCondition;
+
+CBlockServer blockServer;
+
+CBlockServer::CBlockServer()
+{
+    fRunning = false;
+    fStopRequested = false;
+    nThreads = 0;
+    nBlocksServed = 0;
+    nBlocksNotFound = 0;
+    nBytesServed = 0;
+    nReadMicros = 0;
+    nWaitMicros = 0;
+    nMaxWaitMicros = 0;
+}
+
+CBlockServer::~CBlockServer()
+{
+    Stop();
+}
+
+void CBlockServer::Start(int nThreads)
+{
+    if (fRunning || nThreads <= 0)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutexJobs);
+        fStopRequested = false;
+    }
+
+    for (int i = 0; i < nThreads; i++)
+        vThreads.push_back(std::thread(&TraceThread<std::function<void()> >, "blockserver",
+                                       std::function<void()>(std::bind(&CBlockServer::ThreadBlockServer, this))));
+
+    this->nThreads = nThreads;
+    fRunning = true;
+    LogPrintf("%s : serving historical blocks from %d threads\n", __func__, nThreads);
+}
+
+void CBlockServer::Stop()
+{
+    if (!fRunning)
+        return;
+
+    fRunning = false;
+    std::deque<Job> vDropped;
+
+    {
+        std::lock_guard<std::mutex> lock(mutexJobs);
+        fStopRequested = true;
+        vDropped.swap(vJobs);
+    }
+
+    condJobs.notify_all();
+
+    BOOST_FOREACH(std::thread& t, vThreads)
+    {
+        if (t.joinable())
+            t.join();
+    }
+
+    vThreads.clear();
+
+    // Hand the references on queued nodes back, nothing will be served anymore
+    LOCK(cs_vNodes);
+
+    BOOST_FOREACH(Job& job, vDropped)
+    {
+        job.pnode->fServingBlock = false;
+        job.pnode->Release();
+    }
+}
+
+bool CBlockServer::Enqueue(CNode* pnode, const CInv& inv, unsigned int nFile, unsigned int nBlockPos,
+                           const std::vector<CInv>& vInvAfter)
+{
+    Job job;
+    job.pnode = pnode;
+    job.inv = inv;
+    job.nFile = nFile;
+    job.nBlockPos = nBlockPos;
+    job.vInvAfter = vInvAfter;
+    job.nQueuedTime = GetTimeMicros();
+
+    {
+        std::lock_guard<std::mutex> lock(mutexJobs);
+
+        if (fStopRequested)
+            return false;
+
+        {
+            LOCK(cs_vNodes);
+            pnode->AddRef();
+        }
+
+        pnode->fServingBlock = true;
+        vJobs.push_back(job);
+    }
+
+    condJobs.notify_one();
+
+    return true;
+}
+
+void CBlockServer::ThreadBlockServer()
+{
+    while (true)
+    {
+        Job job;
+
+        {
+            std::unique_lock<std::mutex> lock(mutexJobs);
+
+            while (vJobs.empty() && !fStopRequested)
+                condJobs.wait(lock);
+
+            if (fStopRequested)
+                return;
+
+            job = vJobs.front();
+            vJobs.pop_front();
+        }
+
+        ServeBlock(job);
+    }
+}
+
+void CBlockServer::ServeBlock(const Job& job)
+{
+    CNode* pnode = job.pnode;
+    int64_t nStart = GetTimeMicros();
+    uint64_t nWait = nStart - job.nQueuedTime;
+
+    nWaitMicros += nWait;
+
+    uint64_t nMaxWait = nMaxWaitMicros.load();
+    while (nWait > nMaxWait && !nMaxWaitMicros.compare_exchange_weak(nMaxWait, nWait))
+        ;
+
+    if (!pnode->fDisconnect)
+    {
+        CBlock block;
+
+        if (block.ReadFromDisk(job.nFile, job.nBlockPos))
+        {
+            nReadMicros += GetTimeMicros() - nStart;
+
+            pnode->PushMessage(NetMsgType::BLOCK, block);
+
+            if (!job.vInvAfter.empty())
+                pnode->PushMessage(NetMsgType::INV, job.vInvAfter);
+
+            nBlocksServed++;
+            nBytesServed += ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION);
+        }
+        else
+        {
+            LogPrintf("%s : failed to read block %s for peer=%d\n", __func__,
+                      job.inv.hash.ToString(), pnode->GetId());
+
+            // Let the peer know that we didn't find what it asked for, so it doesn't
+            // have to wait around forever.
+            vector<CInv> vNotFound;
+            vNotFound.push_back(job.inv);
+            pnode->PushMessage(NetMsgType::NOTFOUND, vNotFound);
+            nBlocksNotFound++;
+        }
+    }
+
+    pnode->fServingBlock = false;
+
+    {
+        LOCK(cs_vNodes);
+        pnode->Release();
+    }
+
+    // Let the message handler pick up the rest of this peer's requests
+    messageHandlerCondition.notify_one();
+}
+
+CBlockServerStats CBlockServer::GetStats()
+{
+    CBlockServerStats stats;
+    stats.nBlocksServed = nBlocksServed;
+    stats.nBlocksNotFound = nBlocksNotFound;
+    stats.nBytesServed = nBytesServed;
+    stats.nReadMicros = nReadMicros;
+    stats.nWaitMicros = nWaitMicros;
+    stats.nMaxWaitMicros = nMaxWaitMicros;
+    stats.nThreads = fRunning ? nThreads.load() : 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mutexJobs);
+        stats.nQueued = vJobs.size();
+    }
+
+    return stats;
+}
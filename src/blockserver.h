@@ -0,0 +1,99 @@
+// Copyright (c) 2016-2020 The Neutron Developers
+//
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NEUTRON_BLOCKSERVER_H
+#define NEUTRON_BLOCKSERVER_H
+
+#include "protocol.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class CNode;
+
+/** Default for -blockservethreads, 0 serves blocks from the message handler thread */
+static const int DEFAULT_BLOCK_SERVE_THREADS = 2;
+/** Maximum for -blockservethreads */
+static const int MAX_BLOCK_SERVE_THREADS = 8;
+/** Blocks at least this deep are read by the block server, shallower ones are served inline */
+static const int BLOCK_SERVE_MIN_DEPTH = 6;
+
+struct CBlockServerStats
+{
+    uint64_t nBlocksServed;
+    uint64_t nBlocksNotFound;
+    uint64_t nBytesServed;
+    uint64_t nReadMicros;       // total time spent reading and deserializing blocks
+    uint64_t nWaitMicros;       // total time jobs spent queued before a thread picked them up
+    uint64_t nMaxWaitMicros;
+    unsigned int nQueued;
+    int nThreads;
+};
+
+/**
+ * Serves historical blocks requested through getdata from a small pool of
+ * I/O threads. Block data is immutable once written, so reads happen without
+ * cs_main and the message handler thread keeps relaying while IBD peers are
+ * being served.
+ *
+ * A node has at most one block in flight through the server (CNode::fServingBlock);
+ * ProcessGetData and ProcessMessages hold back that node's later requests until the
+ * block has been pushed, which keeps responses in request order.
+ */
+class CBlockServer
+{
+public:
+    CBlockServer();
+    ~CBlockServer();
+
+    void Start(int nThreads);
+    void Stop();
+    bool IsRunning() const { return fRunning; }
+
+    /** Queue a block read for pnode. vInvAfter is pushed as an inv right after the block.
+     *  Takes a reference on pnode that is released once the response has been pushed.
+     *  Returns false if the server is shutting down and the caller has to serve the block. */
+    bool Enqueue(CNode* pnode, const CInv& inv, unsigned int nFile, unsigned int nBlockPos,
+                 const std::vector<CInv>& vInvAfter);
+
+    CBlockServerStats GetStats();
+
+private:
+    struct Job
+    {
+        CNode* pnode;
+        CInv inv;
+        unsigned int nFile;
+        unsigned int nBlockPos;
+        std::vector<CInv> vInvAfter;
+        int64_t nQueuedTime;
+    };
+
+    void ThreadBlockServer();
+    void ServeBlock(const Job& job);
+
+    std::mutex mutexJobs;
+    std::condition_variable condJobs;
+    std::deque<Job> vJobs;
+    std::vector<std::thread> vThreads;
+    std::atomic<bool> fRunning;
+    std::atomic<int> nThreads;
+    bool fStopRequested;
+
+    std::atomic<uint64_t> nBlocksServed;
+    std::atomic<uint64_t> nBlocksNotFound;
+    std::atomic<uint64_t> nBytesServed;
+    std::atomic<uint64_t> nReadMicros;
+    std::atomic<uint64_t> nWaitMicros;
+    std::atomic<uint64_t> nMaxWaitMicros;
+};
+
+extern CBlockServer blockServer;
+
+#endif // NEUTRON_BLOCKSERVER_H
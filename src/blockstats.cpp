@@ -0,0 +1,385 @@
+// Copyright (c) 2016-2020 The Neutron Developers
+//
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockstats.h"
+#include "main.h"
+#include "txdb.h"
+#include "util.h"
+
+#include <boost/foreach.hpp>
+
+using namespace std;
+
+bool fBlockStatsIndex = DEFAULT_BLOCKSTATSINDEX;
+
+// Set while ThreadBuildBlockStats runs, guarded by cs_main
+static bool fBuildingBlockStats = false;
+
+void CBlockStats::SetNull()
+{
+    nVersion = CBlockStats::CURRENT_VERSION;
+    hashBlock = 0;
+    nTime = 0;
+    nBlockVersion = 0;
+    fProofOfStake = false;
+    nTx = 0;
+    nSize = 0;
+    nFees = 0;
+    nStakeReward = 0;
+    nMasternodePaid = 0;
+    nDevPaid = 0;
+    nMint = 0;
+    nChainStakeBlocks = 0;
+    nChainTx = 0;
+    nChainSize = 0;
+    nChainFees = 0;
+    nChainStakeReward = 0;
+    nChainMasternodePaid = 0;
+    nChainDevPaid = 0;
+    nChainMint = 0;
+    mapChainVersions.clear();
+}
+
+void CBlockStats::SetBlock(const CBlock& block, const CBlockIndex* pindex, int64_t nFeesIn, int64_t nStakeRewardIn)
+{
+    hashBlock = pindex->GetBlockHash();
+    nTime = block.GetBlockTime();
+    nBlockVersion = block.nVersion;
+    fProofOfStake = block.IsProofOfStake();
+    nTx = block.vtx.size();
+    nSize = ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION);
+    nFees = nFeesIn;
+    nStakeReward = nStakeRewardIn;
+    nMasternodePaid = 0;
+    nDevPaid = 0;
+    nMint = pindex->nMint;
+
+    if (!fProofOfStake)
+        return;
+
+    // vout[0] marks the coinstake, the staker is paid from vout[1] on, in one or two outputs
+    const CTransaction& txStake = block.vtx[1];
+    CScript scriptDev = GetDeveloperScript();
+
+    for (unsigned int i = 2; i < txStake.vout.size(); i++)
+    {
+        const CTxOut& out = txStake.vout[i];
+
+        if (out.scriptPubKey == txStake.vout[1].scriptPubKey)
+            continue;
+
+        if (out.scriptPubKey == scriptDev)
+            nDevPaid += out.nValue;
+        else
+            nMasternodePaid += out.nValue;
+    }
+}
+
+void CBlockStats::SetChainTotals(const CBlockStats* pprev)
+{
+    CBlockStats prev;
+
+    if (pprev)
+        prev = *pprev;
+
+    nChainStakeBlocks = prev.nChainStakeBlocks + (fProofOfStake ? 1 : 0);
+    nChainTx = prev.nChainTx + nTx;
+    nChainSize = prev.nChainSize + nSize;
+    nChainFees = prev.nChainFees + nFees;
+    nChainStakeReward = prev.nChainStakeReward + nStakeReward;
+    nChainMasternodePaid = prev.nChainMasternodePaid + nMasternodePaid;
+    nChainDevPaid = prev.nChainDevPaid + nDevPaid;
+    nChainMint = prev.nChainMint + nMint;
+    mapChainVersions.swap(prev.mapChainVersions);
+    mapChainVersions[nBlockVersion]++;
+}
+
+void CBlockStatsRange::SetNull()
+{
+    nFirst = 0;
+    nLast = -1;
+    nTimeSpan = 0;
+    nStakeBlocks = 0;
+    nTx = 0;
+    nSize = 0;
+    nFees = 0;
+    nStakeReward = 0;
+    nMasternodePaid = 0;
+    nDevPaid = 0;
+    nMint = 0;
+    mapVersions.clear();
+}
+
+void CBlockStatsRange::Set(int nFirstIn, const CBlockStats* pbefore, const CBlockStats& first, int nLastIn, const CBlockStats& last)
+{
+    // Everything up to nLast minus everything before nFirst
+    CBlockStats before;
+
+    if (pbefore)
+        before = *pbefore;
+
+    nFirst = nFirstIn;
+    nLast = nLastIn;
+    nTimeSpan = last.nTime - (pbefore ? pbefore->nTime : first.nTime);
+    nStakeBlocks = last.nChainStakeBlocks - before.nChainStakeBlocks;
+    nTx = last.nChainTx - before.nChainTx;
+    nSize = last.nChainSize - before.nChainSize;
+    nFees = last.nChainFees - before.nChainFees;
+    nStakeReward = last.nChainStakeReward - before.nChainStakeReward;
+    nMasternodePaid = last.nChainMasternodePaid - before.nChainMasternodePaid;
+    nDevPaid = last.nChainDevPaid - before.nChainDevPaid;
+    nMint = last.nChainMint - before.nChainMint;
+    mapVersions.clear();
+
+    for (std::map<int32_t, uint32_t>::const_iterator it = last.mapChainVersions.begin(); it != last.mapChainVersions.end(); ++it)
+    {
+        std::map<int32_t, uint32_t>::const_iterator itBefore = before.mapChainVersions.find(it->first);
+        uint32_t nBlocks = it->second - (itBefore != before.mapChainVersions.end() ? itBefore->second : 0);
+
+        if (nBlocks > 0)
+            mapVersions[it->first] = nBlocks;
+    }
+}
+
+int GetBlockStatsHeight(CTxDB& txdb)
+{
+    int nHeight;
+
+    if (!txdb.ReadBlockStatsHeight(nHeight))
+        return -1;
+
+    return nHeight;
+}
+
+bool ConnectBlockStats(CTxDB& txdb, const CBlock& block, const CBlockIndex* pindex, int64_t nFees, int64_t nStakeReward)
+{
+    int nStatsHeight = GetBlockStatsHeight(txdb);
+
+    // Behind, the builder thread fills the gap
+    if (nStatsHeight != pindex->nHeight - 1)
+    {
+        if (nStatsHeight < pindex->nHeight - 1)
+            StartBlockStatsBuilder();
+
+        return true;
+    }
+
+    CBlockStats prev;
+
+    // The index is only a convenience, the block connects anyway. The tip is dropped so
+    // the index is behind, and the builder goes back to where it joins the best chain.
+    if (pindex->pprev && (!txdb.ReadBlockStats(pindex->nHeight - 1, prev) || prev.hashBlock != pindex->pprev->GetBlockHash() ||
+                          prev.nVersion < CBlockStats::CURRENT_VERSION))
+    {
+        LogPrintf("%s : no statistics for block %d, rebuilding the index from there\n", __func__, pindex->nHeight - 1);
+
+        if (!txdb.WriteBlockStatsHeight(pindex->nHeight - 2))
+            return false;
+
+        StartBlockStatsBuilder();
+        return true;
+    }
+
+    CBlockStats stats;
+    stats.SetBlock(block, pindex, nFees, nStakeReward);
+    stats.SetChainTotals(pindex->pprev ? &prev : NULL);
+
+    return txdb.WriteBlockStats(pindex->nHeight, stats) && txdb.WriteBlockStatsHeight(pindex->nHeight);
+}
+
+bool DisconnectBlockStats(CTxDB& txdb, const CBlockIndex* pindex)
+{
+    if (GetBlockStatsHeight(txdb) != pindex->nHeight)
+        return true;
+
+    return txdb.EraseBlockStats(pindex->nHeight) && txdb.WriteBlockStatsHeight(pindex->nHeight - 1);
+}
+
+bool GetBlockStatsRange(int nFirst, int nLast, CBlockStatsRange& range)
+{
+    CTxDB txdb("r");
+
+    if (nFirst < 0 || nLast < nFirst || nLast > GetBlockStatsHeight(txdb))
+        return false;
+
+    CBlockStats before, first, last;
+
+    if ((nFirst > 0 && !txdb.ReadBlockStats(nFirst - 1, before)) ||
+        !txdb.ReadBlockStats(nFirst, first) || !txdb.ReadBlockStats(nLast, last))
+        return error("%s : missing statistics between blocks %d and %d", __func__, nFirst, nLast);
+
+    range.Set(nFirst, nFirst > 0 ? &before : NULL, first, nLast, last);
+
+    return true;
+}
+
+bool ResetBlockStats()
+{
+    CTxDB txdb;
+
+    return txdb.WriteBlockStatsHeight(-1);
+}
+
+// Fees and stake reward of a block already in the best chain, from the transaction index
+static bool GetBlockAmounts(CTxDB& txdb, const CBlock& block, int64_t& nFees, int64_t& nStakeReward)
+{
+    nFees = nStakeReward = 0;
+
+    BOOST_FOREACH(const CTransaction& tx, block.vtx)
+    {
+        if (tx.IsCoinBase())
+            continue;
+
+        int64_t nValueIn = 0;
+
+        BOOST_FOREACH(const CTxIn& txin, tx.vin)
+        {
+            CTransaction txPrev;
+
+            if (!txdb.ReadDiskTx(txin.prevout, txPrev) || txin.prevout.n >= txPrev.vout.size())
+                return error("%s : input %s of %s not found", __func__, txin.prevout.ToString(), tx.GetHash().ToString());
+
+            nValueIn += txPrev.vout[txin.prevout.n].nValue;
+        }
+
+        if (tx.IsCoinStake())
+            nStakeReward = tx.GetValueOut() - nValueIn;
+        else
+            nFees += nValueIn - tx.GetValueOut();
+    }
+
+    return true;
+}
+
+// Drops the tip of the index while it isn't in the best chain, records left behind by
+// a run without -blockstatsindex may belong to blocks since reorganized away. Records
+// of an older format are all rebuilt.
+static int FindBlockStatsFork(CTxDB& txdb)
+{
+    int nHeight = GetBlockStatsHeight(txdb);
+
+    while (nHeight >= 0)
+    {
+        CBlockStats stats;
+
+        if (nHeight <= nBestHeight && txdb.ReadBlockStats(nHeight, stats))
+        {
+            if (stats.nVersion < CBlockStats::CURRENT_VERSION)
+            {
+                LogPrintf("%s : block statistics index is of an older version, rebuilding it\n", __func__);
+                return -1;
+            }
+
+            if (stats.hashBlock == FindBlockByHeight(nHeight)->GetBlockHash())
+                break;
+        }
+
+        nHeight--;
+    }
+
+    return nHeight;
+}
+
+void StartBlockStatsBuilder()
+{
+    LOCK(cs_main);
+
+    if (!fBlockStatsIndex || fBuildingBlockStats)
+        return;
+
+    fBuildingBlockStats = true;
+
+    if (!NewThread(ThreadBuildBlockStats, NULL))
+    {
+        LogPrintf("%s : couldn't start the block statistics builder\n", __func__);
+        fBuildingBlockStats = false;
+    }
+}
+
+static void BuildBlockStats()
+{
+    int64_t nStart = GetTimeMillis();
+    int nFirst = -1;
+    bool fBuilt = false;
+
+    while (!fShutdown)
+    {
+        LOCK(cs_main);
+
+        if (pindexBest == NULL)
+            break;
+
+        CTxDB txdb;
+        int nHeight = FindBlockStatsFork(txdb);
+
+        if (nFirst < 0)
+            nFirst = nHeight + 1;
+
+        if (nHeight >= nBestHeight)
+        {
+            if (GetBlockStatsHeight(txdb) != nHeight)
+                txdb.WriteBlockStatsHeight(nHeight);
+
+            break;
+        }
+
+        CBlockStats prev;
+
+        if (nHeight >= 0 && !txdb.ReadBlockStats(nHeight, prev))
+        {
+            LogPrintf("%s : no statistics for block %d\n", __func__, nHeight);
+            return;
+        }
+
+        CBlockIndex* pindex = nHeight >= 0 ? FindBlockByHeight(nHeight)->pnext : pindexGenesisBlock;
+
+        if (!txdb.TxnBegin())
+            return;
+
+        for (int n = 0; n < BLOCKSTATS_BUILD_BATCH && pindex; n++, pindex = pindex->pnext)
+        {
+            CBlock block;
+            int64_t nFees, nStakeReward;
+
+            if (!block.ReadFromDisk(pindex) || !GetBlockAmounts(txdb, block, nFees, nStakeReward))
+            {
+                LogPrintf("%s : can't read block %d, giving up\n", __func__, pindex->nHeight);
+                txdb.TxnAbort();
+                return;
+            }
+
+            CBlockStats stats;
+            stats.SetBlock(block, pindex, nFees, nStakeReward);
+            stats.SetChainTotals(pindex->pprev ? &prev : NULL);
+            txdb.WriteBlockStats(pindex->nHeight, stats);
+
+            prev = stats;
+            nHeight = pindex->nHeight;
+        }
+
+        txdb.WriteBlockStatsHeight(nHeight);
+
+        if (!txdb.TxnCommit())
+            return;
+
+        fBuilt = true;
+
+        if (nHeight % (BLOCKSTATS_BUILD_BATCH * 20) < BLOCKSTATS_BUILD_BATCH)
+            LogPrintf("%s : indexed up to block %d of %d\n", __func__, nHeight, nBestHeight);
+    }
+
+    if (fBuilt && !fShutdown)
+        LogPrintf("%s : block statistics index complete from block %d, %dms\n", __func__, nFirst, GetTimeMillis() - nStart);
+}
+
+void ThreadBuildBlockStats(void* parg)
+{
+    RenameThread("neutron-blockstats");
+
+    BuildBlockStats();
+
+    LOCK(cs_main);
+    fBuildingBlockStats = false;
+}
@@ -0,0 +1,153 @@
+// Copyright (c) 2016-2020 The Neutron Developers
+//
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NEUTRON_BLOCKSTATS_H
+#define NEUTRON_BLOCKSTATS_H
+
+#include "serialize.h"
+#include "uint256.h"
+
+#include <map>
+#include <stdint.h>
+
+class CBlock;
+class CBlockIndex;
+class CTxDB;
+
+/** Default for -blockstatsindex */
+static const bool DEFAULT_BLOCKSTATSINDEX = false;
+/** Blocks the index builder handles per cs_main lock */
+static const int BLOCKSTATS_BUILD_BATCH = 500;
+/** Most intervals getblockstats returns at once */
+static const int MAX_BLOCKSTATS_INTERVALS = 1000;
+
+/**
+ * Statistics of one block of the best chain, kept in the block database under
+ * its height. The nChain* fields add up every block from the genesis block to
+ * this one, so the totals of any range of blocks are the difference of two
+ * records. mapChainVersions grows by one entry per block version ever used.
+ */
+class CBlockStats
+{
+public:
+    static const int CURRENT_VERSION = 2;
+    int nVersion;
+
+    uint256 hashBlock;
+    int64_t nTime;
+    int32_t nBlockVersion;
+    bool fProofOfStake;
+    uint32_t nTx;
+    uint32_t nSize;
+    int64_t nFees;              // paid by regular transactions
+    int64_t nStakeReward;       // coinstake outputs minus inputs
+    int64_t nMasternodePaid;    // coinstake outputs to neither the staker nor the developer script
+    int64_t nDevPaid;
+    int64_t nMint;
+
+    uint32_t nChainStakeBlocks;
+    uint64_t nChainTx;
+    uint64_t nChainSize;
+    int64_t nChainFees;
+    int64_t nChainStakeReward;
+    int64_t nChainMasternodePaid;
+    int64_t nChainDevPaid;
+    int64_t nChainMint;
+    std::map<int32_t, uint32_t> mapChainVersions;  // blocks per block version
+
+    CBlockStats()
+    {
+        SetNull();
+    }
+
+    IMPLEMENT_SERIALIZE
+    (
+        READWRITE(this->nVersion);
+        READWRITE(hashBlock);
+        READWRITE(nTime);
+        READWRITE(nBlockVersion);
+        READWRITE(fProofOfStake);
+        READWRITE(nTx);
+        READWRITE(nSize);
+        READWRITE(nFees);
+        READWRITE(nStakeReward);
+        READWRITE(nMasternodePaid);
+        READWRITE(nDevPaid);
+        READWRITE(nMint);
+        READWRITE(nChainStakeBlocks);
+        READWRITE(nChainTx);
+        READWRITE(nChainSize);
+        READWRITE(nChainFees);
+        READWRITE(nChainStakeReward);
+        READWRITE(nChainMasternodePaid);
+        READWRITE(nChainDevPaid);
+        READWRITE(nChainMint);
+
+        if (this->nVersion >= 2)
+            READWRITE(mapChainVersions);
+    )
+
+    void SetNull();
+
+    /** Fills in the per-block fields from a block, its index entry and the amounts
+     *  ConnectBlock worked out */
+    void SetBlock(const CBlock& block, const CBlockIndex* pindex, int64_t nFeesIn, int64_t nStakeRewardIn);
+
+    /** Fills in the nChain* fields, pprev is the record of the previous block or NULL for genesis */
+    void SetChainTotals(const CBlockStats* pprev);
+};
+
+/** Totals over a range of blocks, worked out from two records */
+class CBlockStatsRange
+{
+public:
+    int nFirst;
+    int nLast;
+    int64_t nTimeSpan;          // from the block before nFirst (or nFirst itself) to nLast
+    uint32_t nStakeBlocks;
+    uint64_t nTx;
+    uint64_t nSize;
+    int64_t nFees;
+    int64_t nStakeReward;
+    int64_t nMasternodePaid;
+    int64_t nDevPaid;
+    int64_t nMint;
+    std::map<int32_t, uint32_t> mapVersions;
+
+    CBlockStatsRange()
+    {
+        SetNull();
+    }
+
+    void SetNull();
+
+    /** pbefore is the record of block nFirst - 1, NULL when nFirst is the genesis block */
+    void Set(int nFirstIn, const CBlockStats* pbefore, const CBlockStats& first, int nLastIn, const CBlockStats& last);
+
+    int GetBlocks() const { return nLast - nFirst + 1; }
+};
+
+extern bool fBlockStatsIndex;
+
+/** Height up to which the index is complete, -1 when empty */
+int GetBlockStatsHeight(CTxDB& txdb);
+
+/** ConnectBlock/DisconnectBlock hooks, they write into txdb's open batch */
+bool ConnectBlockStats(CTxDB& txdb, const CBlock& block, const CBlockIndex* pindex, int64_t nFees, int64_t nStakeReward);
+bool DisconnectBlockStats(CTxDB& txdb, const CBlockIndex* pindex);
+
+/** Totals of blocks nFirst..nLast of the best chain, false if the index doesn't cover them */
+bool GetBlockStatsRange(int nFirst, int nLast, CBlockStatsRange& range);
+
+/** Forgets the index so the builder starts over from the genesis block (-reindexblockstats) */
+bool ResetBlockStats();
+
+/** Catches the index up with the best chain from the block files, then returns */
+void ThreadBuildBlockStats(void* parg);
+
+/** Starts ThreadBuildBlockStats unless it is running already or the index is off */
+void StartBlockStatsBuilder();
+
+#endif // NEUTRON_BLOCKSTATS_H
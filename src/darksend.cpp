@@ -5,11 +5,13 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "darksend.h"
+#include "scheduler.h"
 #include "main.h"
 #include "init.h"
 #include "util.h"
 #include "utiltime.h"
 #include "masternode.h"
+#include "masternodelistsync.h"
 #include "ui_interface.h"
 #include "txdb.h"
 
@@ -614,15 +616,67 @@ bool CDarkSendSigner::SignMessage(std::string strMessage, std::string& errorMess
     return true;
 }
 
+// Verified (pubkey, message hash, signature) entries, keyed by their combined hash
+static std::set<uint256> setVerifiedMessageSigs;
+static CCriticalSection cs_setVerifiedMessageSigs;
+static uint64_t nVerifyCacheHits = 0;
+static uint64_t nVerifyCacheMisses = 0;
+
 bool CDarkSendSigner::VerifyMessage(CPubKey pubkey, vector<unsigned char>& vchSig, std::string strMessage, std::string& errorMessage)
 {
     CHashWriter ss(SER_GETHASH, 0);
     ss << strMessageMagic;
     ss << strMessage;
 
+    uint256 hashMessage = ss.GetHash();
+    uint256 hashEntry = Hash(hashMessage.begin(), hashMessage.end(), pubkey.vchPubKey.begin(), pubkey.vchPubKey.end(),
+                             vchSig.begin(), vchSig.end());
+
+    {
+        LOCK(cs_setVerifiedMessageSigs);
+
+        if (setVerifiedMessageSigs.count(hashEntry))
+        {
+            nVerifyCacheHits++;
+            return true;
+        }
+
+        nVerifyCacheMisses++;
+    }
+
     CKey key;
     key.SetPubKey(pubkey);
-    return key.Verify(ss.GetHash(), vchSig);
+
+    if (!key.Verify(hashMessage, vchSig))
+    {
+        errorMessage = _("Signature verification failed.");
+        return false;
+    }
+
+    LOCK(cs_setVerifiedMessageSigs);
+
+    while (setVerifiedMessageSigs.size() >= MESSAGE_SIGCACHE_SIZE)
+    {
+        // Evict a random entry, so an attacker can't predict which ones survive
+        std::set<uint256>::iterator it = setVerifiedMessageSigs.lower_bound(GetRandHash());
+
+        if (it == setVerifiedMessageSigs.end())
+            it = setVerifiedMessageSigs.begin();
+
+        setVerifiedMessageSigs.erase(it);
+    }
+
+    setVerifiedMessageSigs.insert(hashEntry);
+    return true;
+}
+
+void CDarkSendSigner::GetVerifyCacheStats(uint64_t& nHits, uint64_t& nMisses, uint64_t& nSize)
+{
+    LOCK(cs_setVerifiedMessageSigs);
+
+    nHits = nVerifyCacheHits;
+    nMisses = nVerifyCacheMisses;
+    nSize = setVerifiedMessageSigs.size();
 }
 
 bool CDarksendQueue::Sign()
@@ -690,197 +744,199 @@ bool CDarksendQueue::CheckSignature()
     return false;
 }
 
-// TODO: Rename and move to core
-void ThreadCheckDarkSend(CConnman& connman)
+// The masternode maintenance used to run as one thread ticking twice a second, the
+// intervals below keep that timing but run each job as its own scheduler task.
+static const int64_t DARKSEND_TICK_MILLIS = 500;
+
+static bool waitMnSyncStarted = false;
+static int64_t nMnSyncWaitTime = 0;
+
+static void MasternodeCheckTask()
 {
+    if (IsInitialBlockDownload())
+        return;
+
+    // cs_main is required for doing CMasternode.Check because something
+    // is modifying the coins view without a mempool lock. It causes
+    // segfaults from this code without the cs_main lock.
+    LOCK(cs_main);
+
     if (fDebug)
-        LogPrintf("%s : Started\n", __func__);
+        LogPrintf("%s : Check timeout\n", __func__);
 
-    static bool fOneThread;
+    mnodeman.CheckAndRemove();
+    if (pindexBest != NULL)
+        masternodePayments.CleanPaymentList(pindexBest->nHeight);
+}
 
-    if (fOneThread)
-        return;
+static int64_t MasternodeSyncInterval()
+{
+    // every X ticks we try to send some requests (as controlled by the spork)
+    return DARKSEND_TICK_MILLIS * std::max((int64_t) 1, sporkManager.GetSporkValue(SPORK_14_MASTERNODE_DISTRIBUTION_TICK));
+}
 
-    fOneThread = true;
+static void MasternodeSyncTask()
+{
+    if (IsInitialBlockDownload())
+        return;
 
-    // Make this thread recognisable as the wallet flushing thread
-    RenameThread("neutron-darksend");
+    if (fDebug)
+        LogPrintf("%s : %d\n", __func__, requestedMasterNodeList);
 
-    unsigned int nTick = 0;
+    // Before cs_vNodes, it takes cs_masternodes
+    CMasternodeListSummary summary = GetMasternodeListSummary();
 
-    bool waitMnSyncStarted = false;
-    int64_t nMnSyncWaitTime = GetTime();
+    LOCK(cs_vNodes);
 
-    while (true)
+    if (!vNodes.empty())
     {
-        if (!IsInitialBlockDownload())
-        {
-            nTick++;
+        // randomly clear a node in order to get constant syncing of the lists
+        int index = GetRandInt(vNodes.size());
 
-            {
-                if (nTick % 60 == 0)
-                {
-                    LOCK(cs_main);
-
-                    // cs_main is required for doing CMasternode.Check because something
-                    // is modifying the coins view without a mempool lock. It causes
-                    // segfaults from this code without the cs_main lock.
+        vNodes[index]->ClearFulfilledRequest("getspork");
+        vNodes[index]->ClearFulfilledRequest("mnsync");
+        vNodes[index]->ClearFulfilledRequest("mnwsync");
+    }
 
-                    if (fDebug)
-                        LogPrintf("%s : Check timeout\n", __func__);
+    if (fDebug)
+        LogPrintf("%s : Asking peers for sporks and masternode list\n", __func__);
 
-                    mnodeman.CheckAndRemove();
-                    masternodePayments.CleanPaymentList();
-                }
-            }
+    int sentRequests = 0;
 
-            if (fDebug)
-                LogPrintf("%s : %d, %d\n", nTick % 5, __func__, requestedMasterNodeList);
+    BOOST_FOREACH(CNode* pnode, vNodes)
+    {
+        if (!pnode->HasFulfilledRequest("getspork"))
+        {
+            pnode->FulfilledRequest("getspork");
+            pnode->PushMessage(NetMsgType::GETSPORKS); // get current network sporks
+            sentRequests++;
+        }
 
-            // every X ticks we try to send some requests (as controlled by the spork)
-            if (nTick % sporkManager.GetSporkValue(SPORK_14_MASTERNODE_DISTRIBUTION_TICK) == 0)
-            {
-                LOCK(cs_vNodes);
+        if (!pnode->HasFulfilledRequest("mnsync"))
+        {
+            pnode->FulfilledRequest("mnsync");
+            RequestMasternodeList(pnode, summary);
+            sentRequests++;
+        }
 
-                if (!vNodes.empty())
-                {
-                    // randomly clear a node in order to get constant syncing of the lists
-                    int index = GetRandInt(vNodes.size());
+        if (pnode->HasFulfilledRequest("mnwsync"))
+        {
+            pnode->FulfilledRequest("mnwsync");
+            pnode->PushMessage(NetMsgType::MASTERNODEPAYMENTSYNC); // sync payees (winners list)
+            sentRequests++;
+        }
 
-                    vNodes[index]->ClearFulfilledRequest("getspork");
-                    vNodes[index]->ClearFulfilledRequest("mnsync");
-                    vNodes[index]->ClearFulfilledRequest("mnwsync");
-                }
+        if (fDebug)
+            LogPrintf("%s : Synced with peer=%s\n", __func__, pnode->id);
 
-                if (fDebug)
-                    LogPrintf("%s : Asking peers for sporks and masternode list\n", __func__);
+        requestedMasterNodeList++;
 
-                int sentRequests = 0;
+        if (sentRequests >= MAX_REQUESTS_PER_TICK_CYCLE)
+            break;
+    }
 
-                BOOST_FOREACH(CNode* pnode, vNodes)
-                {
-                    if (!pnode->HasFulfilledRequest("getspork"))
-                    {
-                        pnode->FulfilledRequest("getspork");
-                        pnode->PushMessage(NetMsgType::GETSPORKS); // get current network sporks
-                        sentRequests++;
-                    }
+    if (!isMasternodeListSynced)
+    {
+        if (!waitMnSyncStarted && (requestedMasterNodeList > 5 && mnodeman.CountEnabled() > 3))
+        {
+            waitMnSyncStarted = true;
+            nMnSyncWaitTime = GetTime() + 20;
+            LogPrintf("%s : Started waiting for mnsync", __func__);
+        }
 
-                    if (!pnode->HasFulfilledRequest("mnsync"))
-                    {
-                        pnode->FulfilledRequest("mnsync");
-                        pnode->PushMessage(NetMsgType::DSEG, CTxIn()); // request full mn list
-                        sentRequests++;
-                    }
+        LogPrintf("%s : waiting... requested=%d, enabled=%d, time_remaining=%d\n", __func__,
+                  requestedMasterNodeList, mnodeman.CountEnabled(), nMnSyncWaitTime-GetTime());
 
-                    if (pnode->HasFulfilledRequest("mnwsync"))
-                    {
-                        pnode->FulfilledRequest("mnwsync");
-                        pnode->PushMessage(NetMsgType::MASTERNODEPAYMENTSYNC); // sync payees (winners list)
-                        sentRequests++;
-                    }
+        if (waitMnSyncStarted && (GetTime() >= nMnSyncWaitTime))
+        {
+            LogPrintf("%s : complete... setting isMasternodeListSynced - requested=%d, enabled=%d\n",
+                      __func__, requestedMasterNodeList, mnodeman.CountEnabled());
 
-                    if (fDebug)
-                        LogPrintf("%s : Synced with peer=%s\n", __func__, pnode->id);
+            // Calculate a few masternode winners first
+            masternodePayments.ProcessBlocks(pindexBest->nHeight, 3);
 
-                    requestedMasterNodeList++;
+            // ... then also fill in previous winners on this chain
+            CBlockIndex *pindex = pindexBest;
+            CTxDB txdb("r");
 
-                    if (sentRequests >= MAX_REQUESTS_PER_TICK_CYCLE)
-                        break;
-                }
+            for (int i = 0; i < 30; i++)
+            {
+                CBlock block;
+                pindex = pindex->pprev;
 
-                if (!isMasternodeListSynced)
+                if (block.ReadFromDisk(pindex->nFile, pindex->nBlockPos, true))
                 {
-                    if (!waitMnSyncStarted && (requestedMasterNodeList > 5 && mnodeman.CountEnabled() > 3))
-                    {
-                        waitMnSyncStarted = true;
-                        nMnSyncWaitTime = GetTime() + 20;
-                        LogPrintf("%s : Started waiting for mnsync", __func__);
-                    }
+                    uint64_t nCoinAge;
 
-                    LogPrintf("%s : waiting... requested=%d, enabled=%d, time_remaining=%d\n", __func__,
-                              requestedMasterNodeList, mnodeman.CountEnabled(), nMnSyncWaitTime-GetTime());
-
-                    if (waitMnSyncStarted && (GetTime() >= nMnSyncWaitTime))
+                    if (block.vtx[1].GetCoinAge(txdb, nCoinAge))
                     {
-                        LogPrintf("%s : complete... setting isMasternodeListSynced - requested=%d, enabled=%d\n",
-                                  __func__, requestedMasterNodeList, mnodeman.CountEnabled());
 
-                        // Calculate a few masternode winners first
-                        masternodePayments.ProcessBlock(pindexBest->nHeight);
-                        masternodePayments.ProcessBlock(pindexBest->nHeight + 1);
-                        masternodePayments.ProcessBlock(pindexBest->nHeight + 2);
+                        map<uint256, CTxIndex> mapQueuedChanges;
+                        int64_t nFees = 0;
+                        int64_t nValueIn = 0;
+                        int64_t nValueOut = 0;
+                        int64_t nStakeReward = 0;
 
-                        // ... then also fill in previous winners on this chain
-                        CBlockIndex *pindex = pindexBest;
-                        CTxDB txdb("r");
+                        if (block.CalculateBlockAmounts(txdb, pindex, mapQueuedChanges, nFees, nValueIn,
+                                                        nValueOut, nStakeReward, true, true, false))
 
-                        for (int i = 0; i < 30; i++)
                         {
-                            CBlock block;
-                            pindex = pindex->pprev;
-
-                            if (block.ReadFromDisk(pindex->nFile, pindex->nBlockPos, true))
-                            {
-                                uint64_t nCoinAge;
-
-                                if (block.vtx[1].GetCoinAge(txdb, nCoinAge))
-                                {
-
-                                    map<uint256, CTxIndex> mapQueuedChanges;
-                                    int64_t nFees = 0;
-                                    int64_t nValueIn = 0;
-                                    int64_t nValueOut = 0;
-                                    int64_t nStakeReward = 0;
-
-                                    if (block.CalculateBlockAmounts(txdb, pindex, mapQueuedChanges, nFees, nValueIn,
-                                                                    nValueOut, nStakeReward, true, true, false))
-
-                                    {
-                                        int64_t nCalculatedStakeReward = GetProofOfStakeReward(
-                                              nCoinAge, nFees, pindex->nHeight
-                                        );
-
-                                        masternodePayments.AddPastWinningMasternode(block.vtx,
-                                            GetMasternodePayment(pindex->nHeight, nCalculatedStakeReward),
-                                            pindex->nHeight
-                                        );
-                                    }
-                                }
-                            }
+                            int64_t nCalculatedStakeReward = GetProofOfStakeReward(
+                                  nCoinAge, nFees, pindex->nHeight
+                            );
+
+                            masternodePayments.AddPastWinningMasternode(block.vtx,
+                                GetMasternodePayment(pindex->nHeight, nCalculatedStakeReward),
+                                pindex->nHeight
+                            );
                         }
-
-                        isMasternodeListSynced = true;
                     }
                 }
             }
 
-            if(nTick % MASTERNODE_PING_SECONDS == 0)
-                activeMasternode.ManageStatus(*g_connman);
-
-            // TODO: NTRN - disabled for now
-            // darkSendPool.CheckTimeout();
-            // darkSendPool.CheckForCompleteQueue();
-
-            // TODO: NTRN - disabled for now
-            // if(nTick % (60*5) == 0){
-            //     int nMnCountEnabled = mnodeman.CountEnabled(ActiveProtocol());
-
-            //     // If we've used 90% of the Masternode list then drop the oldest first ~30%
-            //     int nThreshold_high = nMnCountEnabled * 0.9;
-            //     int nThreshold_low = nThreshold_high * 0.7;
-            //     LogPrintf("ThreadCheckDarkSend::Checking vecMasternodesUsed: size: %d, threshold: %d\n",
-            //               (int) vecMasternodesUsed.size(), nThreshold_high);
-
-            //     if((int)vecMasternodesUsed.size() > nThreshold_high) {
-            //         vecMasternodesUsed.erase(vecMasternodesUsed.begin(), vecMasternodesUsed.begin() +
-            //                                  vecMasternodesUsed.size() - nThreshold_low);
-            //         LogPrintf("ThreadCheckDarkSend::Cleaning vecMasternodesUsed: new size: %d, threshold: %d\n",
-            //                   (int) vecMasternodesUsed.size(), nThreshold_high);
-            //     }
-            // }
+            isMasternodeListSynced = true;
         }
-
-	MilliSleep(500); // Sleep for half a second before the next tick
     }
 }
+
+static void MasternodeStatusTask(CConnman& connman)
+{
+    if (IsInitialBlockDownload())
+        return;
+
+    activeMasternode.ManageStatus(connman);
+
+    // TODO: NTRN - disabled for now
+    // darkSendPool.CheckTimeout();
+    // darkSendPool.CheckForCompleteQueue();
+
+    // TODO: NTRN - disabled for now
+    // if(nTick % (60*5) == 0){
+    //     int nMnCountEnabled = mnodeman.CountEnabled(ActiveProtocol());
+
+    //     // If we've used 90% of the Masternode list then drop the oldest first ~30%
+    //     int nThreshold_high = nMnCountEnabled * 0.9;
+    //     int nThreshold_low = nThreshold_high * 0.7;
+    //     LogPrintf("ThreadCheckDarkSend::Checking vecMasternodesUsed: size: %d, threshold: %d\n",
+    //               (int) vecMasternodesUsed.size(), nThreshold_high);
+
+    //     if((int)vecMasternodesUsed.size() > nThreshold_high) {
+    //         vecMasternodesUsed.erase(vecMasternodesUsed.begin(), vecMasternodesUsed.begin() +
+    //                                  vecMasternodesUsed.size() - nThreshold_low);
+    //         LogPrintf("ThreadCheckDarkSend::Cleaning vecMasternodesUsed: new size: %d, threshold: %d\n",
+    //                   (int) vecMasternodesUsed.size(), nThreshold_high);
+    //     }
+    // }
+}
+
+void StartDarkSendTasks(CScheduler& scheduler, CConnman& connman)
+{
+    nMnSyncWaitTime = GetTime();
+
+    scheduler.scheduleTask("masternodecheck", &MasternodeCheckTask, 60 * DARKSEND_TICK_MILLIS,
+                           SCHEDULER_CLASS_MAIN, DARKSEND_TICK_MILLIS);
+    scheduler.scheduleTask("masternodesync", &MasternodeSyncTask, &MasternodeSyncInterval,
+                           SCHEDULER_CLASS_NET, DARKSEND_TICK_MILLIS);
+    scheduler.scheduleTask("masternodestatus", boost::bind(&MasternodeStatusTask, boost::ref(connman)),
+                           MASTERNODE_PING_SECONDS * DARKSEND_TICK_MILLIS, SCHEDULER_CLASS_WALLET, DARKSEND_TICK_MILLIS);
+}
@@ -18,6 +18,7 @@ class CMasterNodeVote;
 class CBitcoinAddress;
 class CDarksendQueue;
 class CDarksendBroadcastTx;
+class CScheduler;
 class CActiveMasternode;
 
 #define POOL_MAX_TRANSACTIONS                  3 // wait for X transactions to merge and publish
@@ -208,6 +209,9 @@ public:
     int64_t sigTime;
 };
 
+// Maximum number of verified message signatures remembered by CDarkSendSigner
+#define MESSAGE_SIGCACHE_SIZE                  20000
+
 // Helper object for signing and checking signatures
 class CDarkSendSigner
 {
@@ -215,7 +219,9 @@ public:
     bool IsVinAssociatedWithPubkey(CTxIn& vin, CPubKey& pubkey);
     bool SetKey(std::string strSecret, std::string& errorMessage, CKey& key, CPubKey& pubkey);
     bool SignMessage(std::string strMessage, std::string& errorMessage, std::vector<unsigned char>& vchSig, CKey key);
+    // Valid signatures are cached by (pubkey, message hash, signature), a repeated check is a set lookup
     bool VerifyMessage(CPubKey pubkey, std::vector<unsigned char>& vchSig, std::string strMessage, std::string& errorMessage);
+    void GetVerifyCacheStats(uint64_t& nHits, uint64_t& nMisses, uint64_t& nSize);
 };
 
 class CDarksendSession
@@ -376,5 +382,7 @@ public:
 };
 
 void ConnectToDarkSendMasterNodeWinner();
-void ThreadCheckDarkSend(CConnman& connman);
+
+// Schedule the periodic masternode list, payment and status maintenance
+void StartDarkSendTasks(CScheduler& scheduler, CConnman& connman);
 #endif
@@ -245,6 +245,10 @@ CDB::CDB(const char *pszFile, const char* pszMode) :
     fReadOnly = (!strchr(pszMode, '+') && !strchr(pszMode, 'w'));
     bool fCreate = strchr(pszMode, 'c');
     unsigned int nFlags = DB_THREAD;
+#ifdef DB_MULTIVERSION
+    // Lets ReadSnapshot copy a database while it is being written
+    nFlags |= DB_MULTIVERSION;
+#endif
     if (fCreate)
         nFlags |= DB_CREATE;
 
@@ -450,6 +454,56 @@ bool CDB::Rewrite(const string& strFile, const char* pszSkip)
 }
 
 
+bool CDB::ReadSnapshot(const string& strFile, boost::function<bool (CDataStream&, CDataStream&)> visitor)
+{
+    CDB db(strFile.c_str(), "r");
+
+    if (!db.pdb)
+        return false;
+
+#ifdef DB_TXN_SNAPSHOT
+    DbTxn* ptxn = bitdb.TxnBegin(DB_TXN_SNAPSHOT);
+#else
+    DbTxn* ptxn = bitdb.TxnBegin(0);
+#endif
+
+    if (!ptxn)
+        return error("%s : cannot begin snapshot transaction on %s", __func__, strFile);
+
+    Dbc* pcursor = NULL;
+    int ret = db.pdb->cursor(ptxn, &pcursor, 0);
+
+    if (ret != 0 || !pcursor)
+    {
+        ptxn->abort();
+        return error("%s : cannot open cursor on %s, error %d", __func__, strFile, ret);
+    }
+
+    bool fSuccess = true;
+
+    while (fSuccess)
+    {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        ret = db.ReadAtCursor(pcursor, ssKey, ssValue, DB_NEXT);
+
+        if (ret == DB_NOTFOUND)
+            break;
+
+        if (ret != 0)
+            fSuccess = error("%s : error %d reading %s", __func__, ret, strFile);
+        else
+            fSuccess = visitor(ssKey, ssValue);
+    }
+
+    pcursor->close();
+
+    // Nothing was written, committing just releases the snapshot
+    ptxn->commit(0);
+
+    return fSuccess;
+}
+
 void CDBEnv::Flush(bool fShutdown)
 {
     int64_t nStart = GetTimeMillis();
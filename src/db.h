@@ -16,6 +16,8 @@
 
 #include <db_cxx.h>
 
+#include <boost/function.hpp>
+
 class CAddress;
 class CAddrMan;
 class CDiskBlockIndex;
@@ -29,7 +31,26 @@ class CWalletTx;
 extern unsigned int nWalletDBUpdated;
 
 void ThreadFlushWalletDB(void* parg);
+
+/** Size and content hash of a wallet backup, the hash covers all records in key order */
+struct CWalletBackupInfo
+{
+    unsigned int nRecords;
+    uint256 hash;
+
+    CWalletBackupInfo() : nRecords(0) {}
+};
+
 bool BackupWallet(const CWallet& wallet, const std::string& strDest);
+bool BackupWallet(const CWallet& wallet, const std::string& strDest, CWalletBackupInfo& info);
+/** Write only what changed since the full backup strBase (a differential backup) */
+bool BackupWalletDifferential(const CWallet& wallet, const std::string& strBase, const std::string& strDest,
+                              CWalletBackupInfo& info);
+/** Rebuild a wallet file from a full backup and, if strDifferential isn't empty, a differential one */
+bool RestoreWalletBackup(const std::string& strBase, const std::string& strDifferential, const std::string& strDest,
+                         CWalletBackupInfo& info);
+/** Read back a full backup and compute its info */
+bool VerifyWalletBackup(const std::string& strPath, CWalletBackupInfo& info);
 
 class CDBEnv
 {
@@ -310,6 +331,13 @@ public:
     }
 
     bool static Rewrite(const std::string& strFile, const char* pszSkip = NULL);
+
+    /**
+     * Pass every record of strFile to visitor, as it was when the call started. The read
+     * runs in a snapshot transaction on a DB_MULTIVERSION handle: writers carry on
+     * copy-on-write instead of waiting for it, and nothing has to be closed or flushed.
+     */
+    bool static ReadSnapshot(const std::string& strFile, boost::function<bool (CDataStream&, CDataStream&)> visitor);
 };
 
 #endif // BITCOIN_DB_H
@@ -0,0 +1,339 @@
+// Copyright (c) 2016-2020 The Neutron Developers
+//
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "feeestimator.h"
+#include "clientversion.h"
+#include "main.h"
+#include "random.h"
+#include "streams.h"
+#include "util.h"
+
+#include <algorithm>
+
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+
+using namespace std;
+
+CFeeEstimator feeEstimator;
+
+/** Bucket bounds grow by this factor, from MIN_TX_FEE / 10 up to MIN_TX_FEE * 1000 */
+static const double FEE_BUCKET_SPACING = 1.2;
+
+CFeeEstimator::CFeeEstimator()
+{
+    // Free and below-minimum transactions all land in the first bucket
+    vBucketBounds.push_back(0);
+
+    for (double dBound = MIN_TX_FEE / 10; dBound <= MIN_TX_FEE * 1000.0; dBound *= FEE_BUCKET_SPACING)
+        vBucketBounds.push_back(dBound);
+
+    Clear();
+}
+
+void CFeeEstimator::Clear()
+{
+    LOCK(cs);
+    vTxCount.assign(vBucketBounds.size(), 0);
+    vFeeSum.assign(vBucketBounds.size(), 0);
+    vConfirmed.assign(FEE_ESTIMATOR_MAX_CONFIRMS, vector<double>(vBucketBounds.size(), 0));
+    mapTracked.clear();
+    nBestHeight = 0;
+}
+
+unsigned int CFeeEstimator::GetBucket(double dFeeRate) const
+{
+    return std::upper_bound(vBucketBounds.begin(), vBucketBounds.end(), dFeeRate) - vBucketBounds.begin() - 1;
+}
+
+// requires cs
+void CFeeEstimator::Record(const CTrackedTx& tracked, int nBlocksToConfirm)
+{
+    vTxCount[tracked.nBucket] += 1;
+    vFeeSum[tracked.nBucket] += tracked.dFeeRate;
+
+    // 0 = never confirmed in time, a transaction in the next block took 1
+    if (nBlocksToConfirm <= 0)
+        return;
+
+    for (int n = nBlocksToConfirm; n <= FEE_ESTIMATOR_MAX_CONFIRMS; n++)
+        vConfirmed[n - 1][tracked.nBucket] += 1;
+}
+
+void CFeeEstimator::TransactionAdded(const uint256& hash, int64_t nFee, unsigned int nSize, int nHeight)
+{
+    if (nSize == 0)
+        return;
+
+    CTrackedTx tracked;
+    tracked.nHeight = nHeight;
+    tracked.dFeeRate = (double) nFee * 1000 / nSize;
+
+    LOCK(cs);
+    tracked.nBucket = GetBucket(tracked.dFeeRate);
+    mapTracked[hash] = tracked;
+}
+
+void CFeeEstimator::TransactionRemoved(const uint256& hash)
+{
+    LOCK(cs);
+    mapTracked.erase(hash);
+}
+
+void CFeeEstimator::BlockConnected(int nHeight, const vector<CTransaction>& vtx)
+{
+    LOCK(cs);
+
+    if (nHeight <= nBestHeight)
+        return;
+
+    nBestHeight = nHeight;
+
+    // Blocks we had nothing waiting for say nothing about fees, and don't age what we know
+    if (mapTracked.empty())
+        return;
+
+    for (unsigned int i = 0; i < vTxCount.size(); i++)
+    {
+        vTxCount[i] *= FEE_ESTIMATOR_DECAY;
+        vFeeSum[i] *= FEE_ESTIMATOR_DECAY;
+
+        for (int n = 0; n < FEE_ESTIMATOR_MAX_CONFIRMS; n++)
+            vConfirmed[n][i] *= FEE_ESTIMATOR_DECAY;
+    }
+
+    BOOST_FOREACH(const CTransaction& tx, vtx)
+    {
+        map<uint256, CTrackedTx>::iterator it = mapTracked.find(tx.GetHash());
+
+        if (it == mapTracked.end())
+            continue;
+
+        Record(it->second, nHeight - it->second.nHeight);
+        mapTracked.erase(it);
+    }
+
+    // Waited too long, counts against its fee rate at every target
+    for (map<uint256, CTrackedTx>::iterator it = mapTracked.begin(); it != mapTracked.end();)
+    {
+        if (nHeight - it->second.nHeight >= FEE_ESTIMATOR_MAX_CONFIRMS)
+        {
+            Record(it->second, 0);
+            mapTracked.erase(it++);
+        }
+        else
+            ++it;
+    }
+}
+
+int64_t CFeeEstimator::EstimateFee(int nBlocks) const
+{
+    if (nBlocks < 1 || nBlocks > FEE_ESTIMATOR_MAX_CONFIRMS)
+        return -1;
+
+    LOCK(cs);
+
+    // Transactions already waiting longer than nBlocks count as failures too, so a
+    // backlog shows up before they are given up on
+    vector<double> vWaiting(vBucketBounds.size(), 0);
+
+    for (map<uint256, CTrackedTx>::const_iterator it = mapTracked.begin(); it != mapTracked.end(); ++it)
+    {
+        if (nBestHeight - it->second.nHeight >= nBlocks)
+            vWaiting[it->second.nBucket] += 1;
+    }
+
+    // From the highest fee rate down, group buckets until they hold enough transactions;
+    // the lowest group that still confirmed often enough gives the estimate
+    double dConfirmed = 0, dTotal = 0, dFeeSum = 0, dCount = 0;
+    double dFeeRate = -1;
+
+    for (int i = vBucketBounds.size() - 1; i >= 0; i--)
+    {
+        dConfirmed += vConfirmed[nBlocks - 1][i];
+        dTotal += vTxCount[i] + vWaiting[i];
+        dFeeSum += vFeeSum[i];
+        dCount += vTxCount[i];
+
+        if (dTotal < FEE_ESTIMATOR_SUFFICIENT_TXS)
+            continue;
+
+        if (dConfirmed / dTotal < FEE_ESTIMATOR_SUCCESS_PCT)
+            break;
+
+        if (dCount > 0)
+            dFeeRate = dFeeSum / dCount;
+
+        dConfirmed = dTotal = dFeeSum = dCount = 0;
+    }
+
+    if (dFeeRate < 0)
+        return -1;
+
+    return (int64_t) (dFeeRate + 0.5);
+}
+
+unsigned int CFeeEstimator::GetTrackedCount() const
+{
+    LOCK(cs);
+    return mapTracked.size();
+}
+
+bool CFeeEstimator::Write(CDataStream& ss) const
+{
+    LOCK(cs);
+    ss << nBestHeight << vBucketBounds << vTxCount << vFeeSum << vConfirmed;
+
+    return true;
+}
+
+bool CFeeEstimator::Read(CDataStream& ss)
+{
+    int nHeightIn;
+    vector<double> vBoundsIn, vTxCountIn, vFeeSumIn;
+    vector<vector<double> > vConfirmedIn;
+
+    ss >> nHeightIn >> vBoundsIn >> vTxCountIn >> vFeeSumIn >> vConfirmedIn;
+
+    LOCK(cs);
+
+    // Data for other buckets or targets can't be used
+    if (vBoundsIn != vBucketBounds || vTxCountIn.size() != vBucketBounds.size() ||
+        vFeeSumIn.size() != vBucketBounds.size() || vConfirmedIn.size() != (unsigned int) FEE_ESTIMATOR_MAX_CONFIRMS)
+        return error("%s : fee estimates have a different layout", __func__);
+
+    BOOST_FOREACH(const vector<double>& vRow, vConfirmedIn)
+    {
+        if (vRow.size() != vBucketBounds.size())
+            return error("%s : fee estimates have a different layout", __func__);
+    }
+
+    nBestHeight = nHeightIn;
+    vTxCount = vTxCountIn;
+    vFeeSum = vFeeSumIn;
+    vConfirmed = vConfirmedIn;
+
+    return true;
+}
+
+CFeeEstimatesDB::CFeeEstimatesDB()
+{
+    pathEstimates = GetDataDir() / "fee_estimates.dat";
+}
+
+bool CFeeEstimatesDB::Write(const CFeeEstimator& estimator)
+{
+    // Generate random temporary filename
+    unsigned short randv = 0;
+    GetRandBytes((unsigned char*)&randv, sizeof(randv));
+    std::string tmpfn = strprintf("fee_estimates.dat.%04x", randv);
+
+    // Serialize the estimator state, checksum data up to that point, then append csum
+    CDataStream ssEstimates(SER_DISK, CLIENT_VERSION);
+    ssEstimates << FLATDATA(pchMessageStart);
+    ssEstimates << FEE_ESTIMATES_FILE_VERSION;
+    estimator.Write(ssEstimates);
+    uint256 hash = Hash(ssEstimates.begin(), ssEstimates.end());
+    ssEstimates << hash;
+
+    // Open temp output file, and associate with CAutoFile
+    boost::filesystem::path pathTmp = GetDataDir() / tmpfn;
+    FILE *file = fopen(pathTmp.string().c_str(), "wb");
+    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+
+    if (fileout.IsNull())
+        return error("%s : failed to open file %s", __func__, pathTmp.string());
+
+    try
+    {
+        fileout << ssEstimates;
+    }
+    catch (const std::exception& e)
+    {
+        return error("%s : serialize or I/O error - %s", __func__, e.what());
+    }
+
+    FileCommit(fileout.Get());
+    fileout.fclose();
+
+    // Replace existing fee_estimates.dat, if any, with new fee_estimates.dat.XXXX
+    if (!RenameOver(pathTmp, pathEstimates))
+        return error("%s : rename-into-place failed", __func__);
+
+    return true;
+}
+
+bool CFeeEstimatesDB::Read(CFeeEstimator& estimator)
+{
+    if (!boost::filesystem::exists(pathEstimates))
+        return false;
+
+    // Open input file, and associate with CAutoFile
+    FILE *file = fopen(pathEstimates.string().c_str(), "rb");
+    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+
+    if (filein.IsNull())
+        return error("%s : failed to open file %s", __func__, pathEstimates.string());
+
+    // Use file size to size memory buffer
+    uint64_t fileSize = boost::filesystem::file_size(pathEstimates);
+    uint64_t dataSize = 0;
+
+    // Don't try to resize to a negative number if file is small
+    if (fileSize >= sizeof(uint256))
+        dataSize = fileSize - sizeof(uint256);
+
+    std::vector<unsigned char> vchData;
+    vchData.resize(dataSize);
+    uint256 hashIn;
+
+    try
+    {
+        if (dataSize > 0)
+            filein.read((char *)&vchData[0], dataSize);
+
+        filein >> hashIn;
+    }
+    catch (const std::exception& e)
+    {
+        return error("%s : deserialize or I/O error - %s", __func__, e.what());
+    }
+
+    filein.fclose();
+    CDataStream ssEstimates(vchData, SER_DISK, CLIENT_VERSION);
+
+    // Verify stored checksum matches input data
+    uint256 hashTmp = Hash(ssEstimates.begin(), ssEstimates.end());
+
+    if (hashIn != hashTmp)
+        return error("%s : checksum mismatch, data corrupted", __func__);
+
+    unsigned char pchMsgTmp[4];
+    int nVersion;
+
+    try
+    {
+        ssEstimates >> FLATDATA(pchMsgTmp);
+
+        if (memcmp(pchMsgTmp, pchMessageStart, sizeof(pchMsgTmp)))
+            return error("%s : invalid network magic number", __func__);
+
+        ssEstimates >> nVersion;
+
+        if (nVersion > FEE_ESTIMATES_FILE_VERSION)
+            return error("%s : unsupported file version %d", __func__, nVersion);
+
+        return estimator.Read(ssEstimates);
+    }
+    catch (const std::exception& e)
+    {
+        return error("%s : deserialize or I/O error - %s", __func__, e.what());
+    }
+}
+
+bool DumpFeeEstimates()
+{
+    return CFeeEstimatesDB().Write(feeEstimator);
+}
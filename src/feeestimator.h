@@ -0,0 +1,107 @@
+// Copyright (c) 2016-2020 The Neutron Developers
+//
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NEUTRON_FEEESTIMATOR_H
+#define NEUTRON_FEEESTIMATOR_H
+
+#include "serialize.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <map>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+class CDataStream;
+class CTransaction;
+
+/** Version of fee_estimates.dat, bump when its layout changes */
+static const int FEE_ESTIMATES_FILE_VERSION = 1;
+/** How often (seconds) fee_estimates.dat is rewritten */
+static const int FEE_ESTIMATES_DUMP_INTERVAL = 60 * 60;
+/** Longest confirmation target estimatefee answers for */
+static const int FEE_ESTIMATOR_MAX_CONFIRMS = 25;
+/** Per block, the weight of everything seen so far is multiplied by this (half-life ~350 blocks) */
+static const double FEE_ESTIMATOR_DECAY = 0.998;
+/** A fee rate must have got this share of its transactions confirmed in time */
+static const double FEE_ESTIMATOR_SUCCESS_PCT = 0.85;
+/** Buckets are combined until they hold at least this many (decayed) transactions */
+static const double FEE_ESTIMATOR_SUFFICIENT_TXS = 10;
+/** Default for -txconfirmtarget, 0 keeps the fixed -paytxfee */
+static const int DEFAULT_TX_CONFIRM_TARGET = 0;
+
+/**
+ * Estimates the fee rate (per 1000 bytes) that gets a transaction into a
+ * block within a number of blocks.
+ *
+ * Transactions are tracked from the height they entered the pool at until a
+ * block confirms them, or until FEE_ESTIMATOR_MAX_CONFIRMS blocks have passed
+ * without one. Fee rates are grouped in exponentially spaced buckets, each
+ * counting its transactions and how many confirmed within 1..MAX blocks;
+ * older data decays with every block that had something to tell.
+ *
+ * cs is a leaf lock, it is taken under mempool.cs.
+ */
+class CFeeEstimator
+{
+private:
+    struct CTrackedTx
+    {
+        int nHeight;
+        unsigned int nBucket;
+        double dFeeRate;
+    };
+
+    mutable CCriticalSection cs;
+    std::vector<double> vBucketBounds;              // lowest fee rate of each bucket
+    std::vector<double> vTxCount;                   // transactions confirmed or given up on
+    std::vector<double> vFeeSum;                    // their fee rates added up
+    std::vector<std::vector<double> > vConfirmed;   // [nBlocks - 1][bucket] confirmed within nBlocks
+    std::map<uint256, CTrackedTx> mapTracked;
+    int nBestHeight;
+
+    unsigned int GetBucket(double dFeeRate) const;
+    void Record(const CTrackedTx& tracked, int nBlocksToConfirm);
+
+public:
+    CFeeEstimator();
+
+    /** A transaction paying nFee for nSize bytes entered the pool while the best height was nHeight */
+    void TransactionAdded(const uint256& hash, int64_t nFee, unsigned int nSize, int nHeight);
+
+    /** A transaction left the pool without being confirmed (conflict, reorg) */
+    void TransactionRemoved(const uint256& hash);
+
+    /** Called with the transactions of each block that becomes the new tip, before the pool drops them */
+    void BlockConnected(int nHeight, const std::vector<CTransaction>& vtx);
+
+    /** Fee per 1000 bytes to confirm within nBlocks, -1 without enough data */
+    int64_t EstimateFee(int nBlocks) const;
+
+    unsigned int GetTrackedCount() const;
+    void Clear();
+
+    bool Write(CDataStream& ss) const;
+    bool Read(CDataStream& ss);
+};
+
+/** Access to the fee estimator state file (fee_estimates.dat) */
+class CFeeEstimatesDB
+{
+private:
+    boost::filesystem::path pathEstimates;
+public:
+    CFeeEstimatesDB();
+    bool Write(const CFeeEstimator& estimator);
+    bool Read(CFeeEstimator& estimator);
+};
+
+extern CFeeEstimator feeEstimator;
+
+/** Write feeEstimator to fee_estimates.dat */
+bool DumpFeeEstimates();
+
+#endif // NEUTRON_FEEESTIMATOR_H
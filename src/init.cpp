@@ -6,13 +6,17 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "txdb.h"
+#include "txmempool.h"
 #include "walletdb.h"
 #include "bitcoinrpc.h"
+#include "blockserver.h"
+#include "blockstats.h"
 #include "net.h"
 #include "netbase.h"
 #include "noui.h"
 #include "init.h"
 #include "rpc/register.h"
+#include "runtimeconfig.h"
 #include "script/standard.h"
 #include "scheduler.h"
 #include "util.h"
@@ -31,7 +35,9 @@
 #include "version.h"
 #include "activemasternode.h"
 #include "spork.h"
+#include "stakeportfolio.h"
 #include "darksend.h"
+#include "feeestimator.h"
 #include "masternodeconfig.h"
 #include "txdb-leveldb.h"
 
@@ -56,6 +62,7 @@ enum Checkpoints::CPMode CheckpointsMode;
 
 std::unique_ptr<CConnman> g_connman;
 CConnman* shared_connman;
+CScheduler* shared_scheduler;
 
 CCriticalSection cs_Shutdown;
 
@@ -135,6 +142,26 @@ void Interrupt(boost::thread_group& threadGroup)
     threadGroup.interrupt_all();
 }
 
+// Resend wallet transactions that haven't gotten in a block yet, the wallet
+// decides itself how often that actually happens
+static void ResendWalletTransactionsTask()
+{
+    LOCK(cs_main);
+    ResendWalletTransactions();
+}
+
+// Only once mempool.dat has been loaded, an earlier dump would drop what is still in it
+static void DumpMempoolTask()
+{
+    if (IsMempoolLoaded())
+        DumpMempool();
+}
+
+static void StakeConsolidateTask()
+{
+    stakePortfolio.Consolidate(pwalletMain);
+}
+
 /** Preparing steps before shutting down or restarting the wallet */
 bool PrepareShutdown()
 {
@@ -148,11 +175,20 @@ bool PrepareShutdown()
     RenameThread("neutron-shutoff");
 
     nTransactionsUpdated++;
+    sporkManager.Dump();
+    DumpFeeEstimates();
+
+    if (GetBoolArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL))
+        DumpMempoolTask();
+
+    StopBlockFileFlusher();
     CTxDB().Close();
     bitdb.Flush(false);
+    blockServer.Stop();
     LogPrintf("%s: call ConnMan::reset\n", __func__);
     g_connman.reset();
     LogPrintf("%s: call ConnMan::reset finished\n", __func__);
+    asyncResolver.Stop();
     bitdb.Flush(true);
     boost::filesystem::remove(GetPidFile());
     UnregisterWallet(pwalletMain);
@@ -197,6 +233,7 @@ void HandleSIGTERM(int)
 void HandleSIGHUP(int)
 {
     fReopenDebugLog = true;
+    fReloadConfig = true;
 }
 
 static bool LockDataDirectory(bool probeOnly)
@@ -344,8 +381,11 @@ std::string HelpMessage()
         "  -timeout=<n>           " + _("Specify connection timeout in milliseconds (default: 5000)") + "\n" +
         "  -proxy=<ip:port>       " + _("Connect through socks proxy") + "\n" +
         "  -dns                   " + _("Allow DNS lookups for -addnode, -seednode and -connect") + "\n" +
+        "  -dnsthreads=<n>        " + _("Number of threads resolving DNS seeds and -addnode names, 0 = resolve one at a time (default: 4)") + "\n" +
+        "  -dnscachettl=<n>       " + _("Reuse resolved names for <n> seconds, 0 = no cache (default: 300)") + "\n" +
         "  -port=<port>           " + _("Listen for connections on <port> (default: 32001 or testnet: 25714)") + "\n" +
         "  -maxconnections=<n>    " + _("Maintain at most <n> connections to peers (default: 125)") + "\n" +
+        "  -maxconnectattempts=<n> " + _("Open up to <n> outbound connections at the same time (default: 4)") + "\n" +
         "  -addnode=<ip>          " + _("Add a node to connect to and attempt to keep the connection open") + "\n" +
         "  -connect=<ip>          " + _("Connect only to the specified node(s)") + "\n" +
         "  -seednode=<ip>         " + _("Connect to a node to retrieve peer addresses, and disconnect") + "\n" +
@@ -362,6 +402,12 @@ std::string HelpMessage()
         "  -bantime=<n>           " + strprintf(_("Number of seconds to keep misbehaving peers from reconnecting (default: %u)"), DEFAULT_MISBEHAVING_BANTIME) + "\n" +
         "  -maxreceivebuffer=<n>  " + _("Maximum per-connection receive buffer, <n>*1000 bytes (default: 5000)") + "\n" +
         "  -maxsendbuffer=<n>     " + _("Maximum per-connection send buffer, <n>*1000 bytes (default: 1000)") + "\n" +
+        "  -maxuploadtarget=<n>   " + _("Tries to keep outbound traffic to all peers under the given target (in MiB per 24h), 0 = no limit (default: 0)") + "\n" +
+        "  -asyncblockflush       " + _("Sync block files to disk on a background thread (default: 1)") + "\n" +
+        "  -schedulerthreads=<n>  " + _("Number of threads running periodic maintenance tasks (default: 2)") + "\n" +
+        "  -blockservethreads=<n> " + _("Number of threads serving historical blocks to peers, 0 = serve from the message handler (default: 2)") + "\n" +
+        "  -persistmempool        " + _("Save the memory pool on shutdown and load it on startup (default: 1)") + "\n" +
+        "  -blockstallingtimeout=<n> " + _("Disconnect peers that make no progress on requested blocks for <n> seconds, 0 = never (default: 120)") + "\n" +
 #ifdef USE_UPNP
 #if USE_UPNP
         "  -upnp                  " + _("Use UPnP to map the listening port (default: 1 when listening)") + "\n" +
@@ -371,6 +417,7 @@ std::string HelpMessage()
 #endif
         "  -detachdb              " + _("Detach block and address databases. Increases shutdown time (default: 0)") + "\n" +
         "  -paytxfee=<amt>        " + _("Fee per KB to add to transactions you send") + "\n" +
+        "  -txconfirmtarget=<n>   " + _("Pay the fee that recently got transactions confirmed within <n> blocks instead of -paytxfee, 0 = off (default: 0)") + "\n" +
         "  -mininput=<amt>        " + _("When creating transactions, ignore inputs with value less than this (default: 0.01)") + "\n" +
         "  -maxtipage=<n>         " + strprintf(_("Maximum tip age in seconds to consider node in initial block download (default: %u)"), DEFAULT_MAX_TIP_AGE) + "\n" +
 #ifdef QT_GUI
@@ -400,11 +447,16 @@ std::string HelpMessage()
         "  -alertnotify=<cmd>     " + _("Execute command when a relevant alert is received (%s in cmd is replaced by message)") + "\n" +
         "  -upgradewallet         " + _("Upgrade wallet to latest format") + "\n" +
         "  -keypool=<n>           " + _("Set key pool size to <n> (default: 100)") + "\n" +
+        "  -walletkdf=<method>    " + _("Passphrase key derivation for newly encrypted wallets, sha512 or scrypt (default: sha512)") + "\n" +
+        "  -walletkdftime=<ms>    " + _("Calibrate the passphrase key derivation to take <ms> milliseconds (default: 100)") + "\n" +
         "  -rescan                " + _("Rescan the block chain for missing wallet transactions") + "\n" +
         "  -salvagewallet         " + _("Attempt to recover private keys from a corrupt wallet.dat") + "\n" +
         "  -checkblocks=<n>       " + _("How many blocks to check at startup (default: 500, 0 = all)") + "\n" +
         "  -checklevel=<n>        " + _("How thorough the block verification is (0-6, default: 1)") + "\n" +
-        "  -loadblock=<file>      " + _("Imports blocks from external blk000?.dat file") + "\n" +
+        "  -loadblock=<file>      " + _("Imports blocks from external blk000?.dat file (raw or compressed)") + "\n" +
+        "  -compressblocks        " + _("Store new blocks in compressed block files (default: 0)") + "\n" +
+        "  -blockstatsindex       " + _("Maintain per-block statistics for the getblockstats RPC (default: 0)") + "\n" +
+        "  -reindexblockstats     " + _("Rebuild the block statistics index from the block files on startup") + "\n" +
 
         "\n" + _("Block creation options:") + "\n" +
         "  -blockminsize=<n>      "   + _("Set minimum block size in bytes (default: 0)") + "\n" +
@@ -426,6 +478,13 @@ std::string HelpMessage()
     strUsage += "\n" + _("Wallet options:") + "\n";
     strUsage += "  -zapwallettxes=<mode>      " + _("Delete all wallet transactions and only recover those parts of the blockchain through -rescan on startup") +
         " " + _("(1 = keep tx meta data e.g. account owner and payment request information, 2 = drop tx meta data)") + "\n";
+    strUsage += "  -staketargetvalue=<amt>    " + _("Keep stake outputs around this value (default: 1000)") + "\n";
+    strUsage += "  -staketargetoutputs=<n>    " + _("Consolidate small stake outputs when there are more than <n> (default: 100)") + "\n";
+    strUsage += "  -stakesplitage=<n>         " + _("Split stakes whose kernel is younger than <n> seconds in two, 0 = never (default: 86400)") + "\n";
+    strUsage += "  -stakesplitthreshold=<amt> " + _("Also split stakes paying back at least this value in two, 0 = never (default: 0)") + "\n";
+    strUsage += "  -stakecombinethreshold=<amt> " + _("Combine stake outputs below this value (default: 1000)") + "\n";
+    strUsage += "  -stakecombineinputs=<n>    " + _("Most outputs a stake combines, 0 = only consolidate in the background (default: 100)") + "\n";
+    strUsage += "  -stakeconsolidate          " + _("Consolidate small stake outputs with self-transfers in the background (default: 0)") + "\n";
 
     return strUsage;
 }
@@ -479,7 +538,7 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     sigaction(SIGTERM, &sa, NULL);
     sigaction(SIGINT, &sa, NULL);
 
-    // Reopen debug.log on SIGHUP
+    // Reopen debug.log and read the config file again on SIGHUP
     struct sigaction sa_hup;
     sa_hup.sa_handler = HandleSIGHUP;
     sigemptyset(&sa_hup.sa_mask);
@@ -489,6 +548,11 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     // ********************************************************* Step 2: parameter interactions
 
+    std::string strConfigError;
+
+    if (!LoadConfigOptions(strConfigError))
+        return InitError(strConfigError);
+
     nNodeLifespan = GetArg("-addrlifespan", 7);
     fUseFastIndex = GetBoolArg("-fastindex", true);
     nMinerSleep = GetArg("-minersleep", 500);
@@ -505,7 +569,8 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     if(strCpMode == "permissive")
         CheckpointsMode = Checkpoints::PERMISSIVE;
 
-    nDerivationMethodIndex = 0;
+    nDerivationMethodIndex = GetArg("-walletkdf", "sha512") == "scrypt" ? 1 : 0;
+    nWalletKdfTargetMillis = std::max((int64_t) 1, GetArg("-walletkdftime", DEFAULT_WALLET_KDF_MILLIS));
 
     fTestNet = GetBoolArg("-testnet");
 
@@ -558,7 +623,7 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     int nBind = std::max((mapMultiArgs.count("-bind") ? mapMultiArgs.at("-bind").size() : 0) +
                          (mapMultiArgs.count("-whitebind") ? mapMultiArgs.at("-whitebind").size() : 0), size_t(1));
 
-    nUserMaxConnections = GetArg("-maxconnections", DEFAULT_MAX_PEER_CONNECTIONS);
+    nUserMaxConnections = configMaxConnections.GetInt();
     nMaxConnections = std::max(nUserMaxConnections, 0);
 
     // Trim requested connection counts, to fit into system limitations
@@ -578,7 +643,7 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     // ********************************************************* Step 3: parameter-to-internal-flags
 
-    fDebug = GetBoolArg("-debug");
+    // fDebug and the log categories were set from -debug by LoadConfigOptions()
 
     // -debug implies fDebug*
     if (fDebug)
@@ -625,6 +690,8 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             nConnectTimeout = nNewTimeout;
     }
 
+    nDNSCacheTTL = GetArg("-dnscachettl", DEFAULT_DNS_CACHE_TTL);
+
     if (mapArgs.count("-paytxfee"))
     {
         if (!ParseMoney(mapArgs["-paytxfee"], nTransactionFee))
@@ -634,6 +701,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             InitWarning(_("Warning: -paytxfee is set very high! This is the transaction fee you will pay if you send a transaction."));
     }
 
+    nTxConfirmTarget = std::max(0, std::min((int) GetArg("-txconfirmtarget", DEFAULT_TX_CONFIRM_TARGET),
+                                            FEE_ESTIMATOR_MAX_CONFIRMS));
+
     fConfChange = GetBoolArg("-confchange", false);
     fEnforceCanonical = GetBoolArg("-enforcecanonical", true);
 
@@ -644,6 +714,8 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     }
 
     nMaxTipAge = GetArg("-maxtipage", DEFAULT_MAX_TIP_AGE);
+    fCompressBlocks = GetBoolArg("-compressblocks", false);
+    fBlockStatsIndex = GetBoolArg("-blockstatsindex", DEFAULT_BLOCKSTATSINDEX);
 
 
     // ********************************************************* Step 4: application initialization: dir lock, daemonize, pidfile, debug log
@@ -890,6 +962,14 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         }
     }
 
+    CStakePolicy stakePolicy;
+    std::string strStakePolicyError;
+
+    if (!ReadStakePolicyOptions(stakePolicy, strStakePolicyError))
+        return InitError(strStakePolicyError);
+
+    stakePortfolio.SetPolicy(stakePolicy);
+
     if (mapArgs.count("-checkpointkey")) // ppcoin: checkpoint master priv key
     {
         if (!Checkpoints::SetCheckpointPrivKey(GetArg("-checkpointkey", "")))
@@ -917,6 +997,12 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         return false;
     }
 
+    if (GetBoolArg("-asyncblockflush", DEFAULT_ASYNC_BLOCK_FLUSH))
+        StartBlockFileFlusher();
+
+    // Sporks and alerts have to be in place before any block is checked against them
+    sporkManager.Load();
+
     uiInterface.InitMessage(_("Loading block index..."));
     nStart = GetTimeMillis();
 
@@ -934,6 +1020,10 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     LogPrintf("[AppInit2]  block index %15dms\n", GetTimeMillis() - nStart);
 
+    // Starts from scratch if it is missing or unusable
+    if (!CFeeEstimatesDB().Read(feeEstimator))
+        feeEstimator.Clear();
+
     if (GetBoolArg("-printblockindex") || GetBoolArg("-printblocktree"))
     {
         PrintBlockTree();
@@ -1218,7 +1308,46 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     */
 
     darkSendPool.InitCollateralAddress();
-    threadGroup.create_thread(boost::bind(&ThreadCheckDarkSend, boost::ref(*g_connman)));
+
+    // Periodic maintenance runs as scheduler tasks on a small pool of threads
+    shared_scheduler = &scheduler;
+    int nSchedulerThreads = configSchedulerThreads.GetInt();
+
+    for (int i = 0; i < nSchedulerThreads; i++)
+    {
+        threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler",
+                                              CScheduler::Function(boost::bind(&CScheduler::serviceQueue, &scheduler))));
+    }
+
+    StartDarkSendTasks(scheduler, *g_connman);
+    scheduler.scheduleTask("resendwallettxs", &ResendWalletTransactionsTask, 60 * 1000, SCHEDULER_CLASS_MAIN, 5 * 1000);
+    scheduler.scheduleTask("dumpsporks", boost::bind(&CSporkManager::Dump, &sporkManager), SPORK_DUMP_INTERVAL * 1000);
+    scheduler.scheduleTask("dumpfeeestimates", &DumpFeeEstimates, FEE_ESTIMATES_DUMP_INTERVAL * 1000);
+    scheduler.scheduleTask("reloadconfig", &ReloadConfigTask, 1000);
+
+    // Blocks connected while the index was off (or all of them for a new index) are
+    // read back from the block files, new blocks are added as they connect
+    if (fBlockStatsIndex)
+    {
+        if (GetBoolArg("-reindexblockstats", false) && !ResetBlockStats())
+            return InitError(_("Failed to reset the block statistics index"));
+
+        StartBlockStatsBuilder();
+    }
+
+    // Transactions of mempool.dat are accepted again in the background, wallets have to be
+    // registered by now
+    if (GetBoolArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL))
+    {
+        NewThread(ThreadLoadMempool, NULL);
+        scheduler.scheduleTask("dumpmempool", &DumpMempoolTask, MEMPOOL_DUMP_INTERVAL * 1000);
+    }
+
+    // Small stake outputs are mostly combined here, off the staking thread
+    if (GetBoolArg("-staking", true))
+        scheduler.scheduleTask("stakeconsolidate", &StakeConsolidateTask, STAKE_CONSOLIDATE_INTERVAL * 1000,
+                               SCHEDULER_CLASS_WALLET, 60 * 1000);
+
     RandAddSeedPerfmon();
 
     //// debug print
@@ -1233,6 +1362,13 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     connOptions.nMaxOutbound = std::min(MAX_OUTBOUND_CONNECTIONS, connOptions.nMaxConnections);
     connOptions.nMaxAddnode = MAX_ADDNODE_CONNECTIONS;
     connOptions.nMaxFeeler = 1;
+    connOptions.nMaxOutboundTimeframe = MAX_UPLOAD_TIMEFRAME;
+    connOptions.nMaxOutboundLimit = GetArg("-maxuploadtarget", DEFAULT_MAX_UPLOAD_TARGET) * 1024 * 1024;
+    connOptions.nBlockStallingTimeout = GetArg("-blockstallingtimeout", DEFAULT_BLOCK_STALLING_TIMEOUT);
+    connOptions.nMaxConnectAttempts = GetArg("-maxconnectattempts", DEFAULT_MAX_CONNECT_ATTEMPTS);
+
+    blockServer.Start(std::min((int) GetArg("-blockservethreads", DEFAULT_BLOCK_SERVE_THREADS), MAX_BLOCK_SERVE_THREADS));
+    asyncResolver.Start(std::min((int) GetArg("-dnsthreads", DEFAULT_DNS_THREADS), MAX_DNS_THREADS));
 
     if (!connman.Start(scheduler, connOptions))
     {
@@ -17,6 +17,7 @@ namespace boost {
 
 extern CWallet* pwalletMain;
 extern CConnman* shared_connman;
+extern CScheduler* shared_scheduler;
 extern CCriticalSection cs_Shutdown;
 
 void StartShutdown();
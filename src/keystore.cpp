@@ -5,6 +5,10 @@
 
 #include "keystore.h"
 #include "script.h"
+#include "util.h"
+
+#include <atomic>
+#include <thread>
 
 bool CKeyStore::GetPubKey(const CKeyID &address, CPubKey &vchPubKeyOut) const
 {
@@ -84,12 +88,39 @@ bool CCryptoKeyStore::Lock()
     {
         LOCK(cs_KeyStore);
         vMasterKey.clear();
+
+        // EC_KEY_free clears the private key when the cached keys are destroyed
+        mapSigningKeys.clear();
     }
 
     NotifyStatusChanged(this);
     return true;
 }
 
+bool CCryptoKeyStore::CheckMasterKey(const CKeyingMaterial& vMasterKeyIn) const
+{
+    LOCK(cs_KeyStore);
+
+    CryptedKeyMap::const_iterator mi = mapCryptedKeys.begin();
+    for (; mi != mapCryptedKeys.end(); ++mi)
+    {
+        const CPubKey &vchPubKey = (*mi).second.first;
+        const std::vector<unsigned char> &vchCryptedSecret = (*mi).second.second;
+        CSecret vchSecret;
+        if(!DecryptSecret(vMasterKeyIn, vchCryptedSecret, vchPubKey.GetHash(), vchSecret))
+            return false;
+        if (vchSecret.size() != 32)
+            return false;
+        CKey key;
+        key.SetPubKey(vchPubKey);
+        key.SetSecret(vchSecret);
+        if (key.GetPubKey() == vchPubKey)
+            break;
+        return false;
+    }
+    return true;
+}
+
 bool CCryptoKeyStore::Unlock(const CKeyingMaterial& vMasterKeyIn)
 {
     {
@@ -97,23 +128,9 @@ bool CCryptoKeyStore::Unlock(const CKeyingMaterial& vMasterKeyIn)
         if (!SetCrypted())
             return false;
 
-        CryptedKeyMap::const_iterator mi = mapCryptedKeys.begin();
-        for (; mi != mapCryptedKeys.end(); ++mi)
-        {
-            const CPubKey &vchPubKey = (*mi).second.first;
-            const std::vector<unsigned char> &vchCryptedSecret = (*mi).second.second;
-            CSecret vchSecret;
-            if(!DecryptSecret(vMasterKeyIn, vchCryptedSecret, vchPubKey.GetHash(), vchSecret))
-                return false;
-            if (vchSecret.size() != 32)
-                return false;
-            CKey key;
-            key.SetPubKey(vchPubKey);
-            key.SetSecret(vchSecret);
-            if (key.GetPubKey() == vchPubKey)
-                break;
+        if (!CheckMasterKey(vMasterKeyIn))
             return false;
-        }
+
         vMasterKey = vMasterKeyIn;
     }
     NotifyStatusChanged(this);
@@ -162,6 +179,14 @@ bool CCryptoKeyStore::GetKey(const CKeyID &address, CKey& keyOut) const
         if (!IsCrypted())
             return CBasicKeyStore::GetKey(address, keyOut);
 
+        std::map<CKeyID, CKey>::const_iterator it = mapSigningKeys.find(address);
+        if (it != mapSigningKeys.end())
+        {
+            nSigningKeyHits++;
+            keyOut = (*it).second;
+            return true;
+        }
+
         CryptedKeyMap::const_iterator mi = mapCryptedKeys.find(address);
         if (mi != mapCryptedKeys.end())
         {
@@ -180,6 +205,35 @@ bool CCryptoKeyStore::GetKey(const CKeyID &address, CKey& keyOut) const
     return false;
 }
 
+bool CCryptoKeyStore::GetSigningKey(const CKeyID &address, CKey& keyOut) const
+{
+    {
+        LOCK(cs_KeyStore);
+        if (!IsCrypted())
+            return CBasicKeyStore::GetKey(address, keyOut);
+
+        if (mapSigningKeys.count(address))
+            return GetKey(address, keyOut);
+
+        nSigningKeyMisses++;
+
+        if (!GetKey(address, keyOut))
+            return false;
+
+        if (mapSigningKeys.size() < SIGNING_KEY_CACHE_SIZE)
+            mapSigningKeys[address] = keyOut;
+    }
+    return true;
+}
+
+void CCryptoKeyStore::GetSigningKeyCacheStats(uint64_t& nHits, uint64_t& nMisses, unsigned int& nSize) const
+{
+    LOCK(cs_KeyStore);
+    nHits = nSigningKeyHits;
+    nMisses = nSigningKeyMisses;
+    nSize = mapSigningKeys.size();
+}
+
 bool CCryptoKeyStore::GetPubKey(const CKeyID &address, CPubKey& vchPubKeyOut) const
 {
     {
@@ -204,21 +258,62 @@ bool CCryptoKeyStore::EncryptKeys(CKeyingMaterial& vMasterKeyIn)
         if (!mapCryptedKeys.empty() || IsCrypted())
             return false;
 
+        int64_t nStart = GetTimeMillis();
         fUseCrypto = true;
-        BOOST_FOREACH(KeyMap::value_type& mKey, mapKeys)
+
+        // Rebuilding the public key and encrypting the secret are independent for
+        // every key, do them on all cores and only store the results in order here
+        std::vector<const KeyMap::value_type*> vKeys;
+        BOOST_FOREACH(const KeyMap::value_type& mKey, mapKeys)
+            vKeys.push_back(&mKey);
+
+        std::vector<CPubKey> vPubKeys(vKeys.size());
+        std::vector<std::vector<unsigned char> > vCryptedSecrets(vKeys.size());
+        std::atomic<bool> fFailed(false);
+
+        unsigned int nThreads = std::max(1U, std::min(std::thread::hardware_concurrency(),
+                                                      (unsigned int) (vKeys.size() / ENCRYPT_KEYS_PER_THREAD)));
+
+        auto encryptRange = [&](size_t nBegin, size_t nEnd)
         {
-            CKey key;
-            if (!key.SetSecret(mKey.second.first, mKey.second.second))
-                return false;
-            const CPubKey vchPubKey = key.GetPubKey();
-            std::vector<unsigned char> vchCryptedSecret;
-            bool fCompressed;
-            if (!EncryptSecret(vMasterKeyIn, key.GetSecret(fCompressed), vchPubKey.GetHash(), vchCryptedSecret))
-                return false;
-            if (!AddCryptedKey(vchPubKey, vchCryptedSecret))
+            for (size_t i = nBegin; i < nEnd && !fFailed; i++)
+            {
+                CKey key;
+                if (!key.SetSecret(vKeys[i]->second.first, vKeys[i]->second.second))
+                {
+                    fFailed = true;
+                    return;
+                }
+                vPubKeys[i] = key.GetPubKey();
+                bool fCompressed;
+                if (!EncryptSecret(vMasterKeyIn, key.GetSecret(fCompressed), vPubKeys[i].GetHash(), vCryptedSecrets[i]))
+                    fFailed = true;
+            }
+        };
+
+        std::vector<std::thread> vThreads;
+        size_t nPerThread = (vKeys.size() + nThreads - 1) / nThreads;
+
+        for (unsigned int t = 1; t < nThreads; t++)
+            vThreads.push_back(std::thread(encryptRange, t * nPerThread, std::min(vKeys.size(), (t + 1) * nPerThread)));
+
+        encryptRange(0, std::min(vKeys.size(), nPerThread));
+
+        BOOST_FOREACH(std::thread& t, vThreads)
+            t.join();
+
+        if (fFailed)
+            return false;
+
+        for (size_t i = 0; i < vKeys.size(); i++)
+        {
+            if (!AddCryptedKey(vPubKeys[i], vCryptedSecrets[i]))
                 return false;
         }
         mapKeys.clear();
+
+        LogPrintf("%s : encrypted %u keys in %dms using %u threads\n", __func__, vKeys.size(),
+                  GetTimeMillis() - nStart, nThreads);
     }
     return true;
 }
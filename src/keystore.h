@@ -29,6 +29,12 @@ public:
     virtual void GetKeys(std::set<CKeyID> &setAddress) const =0;
     virtual bool GetPubKey(const CKeyID &address, CPubKey& vchPubKeyOut) const;
 
+    // Get a key that is used for signing over and over, stores may keep it ready for the next call
+    virtual bool GetSigningKey(const CKeyID &address, CKey& keyOut) const
+    {
+        return GetKey(address, keyOut);
+    }
+
     // Support for BIP 0013 : see https://en.bitcoin.it/wiki/BIP_0013
     virtual bool AddCScript(const CScript& redeemScript) =0;
     virtual bool HaveCScript(const CScriptID &hash) const =0;
@@ -112,6 +118,11 @@ public:
 
 typedef std::map<CKeyID, std::pair<CPubKey, std::vector<unsigned char> > > CryptedKeyMap;
 
+/** EncryptKeys only starts another thread for every this many keys */
+static const unsigned int ENCRYPT_KEYS_PER_THREAD = 1000;
+/** Maximum number of decrypted keys kept ready for signing while the wallet is unlocked */
+static const unsigned int SIGNING_KEY_CACHE_SIZE = 128;
+
 /** Keystore which keeps the private keys encrypted.
  * It derives from the basic key store, which is used if no encryption is active.
  */
@@ -126,6 +137,13 @@ private:
     // if fUseCrypto is false, vMasterKey must be empty
     bool fUseCrypto;
 
+    // Decrypted keys used for staking and masternode signing, ready to copy without
+    // running the AES decryption and public key derivation again. Only filled while
+    // unlocked, cleared by Lock().
+    mutable std::map<CKeyID, CKey> mapSigningKeys;
+    mutable uint64_t nSigningKeyHits;
+    mutable uint64_t nSigningKeyMisses;
+
 protected:
     bool SetCrypted();
 
@@ -134,8 +152,11 @@ protected:
 
     bool Unlock(const CKeyingMaterial& vMasterKeyIn);
 
+    // whether vMasterKeyIn decrypts the keys, without unlocking with it
+    bool CheckMasterKey(const CKeyingMaterial& vMasterKeyIn) const;
+
 public:
-    CCryptoKeyStore() : fUseCrypto(false)
+    CCryptoKeyStore() : fUseCrypto(false), nSigningKeyHits(0), nSigningKeyMisses(0)
     {
     }
 
@@ -172,6 +193,11 @@ public:
     }
     bool GetKey(const CKeyID &address, CKey& keyOut) const;
     bool GetPubKey(const CKeyID &address, CPubKey& vchPubKeyOut) const;
+
+    // Like GetKey, but keeps the decrypted key in the signing key cache for the next
+    // call. Meant for keys that sign repeatedly (coinstakes, blocks, masternode messages).
+    bool GetSigningKey(const CKeyID &address, CKey& keyOut) const;
+    void GetSigningKeyCacheStats(uint64_t& nHits, uint64_t& nMisses, unsigned int& nSize) const;
     void GetKeys(std::set<CKeyID> &setAddress) const
     {
         if (!IsCrypted())
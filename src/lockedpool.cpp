@@ -0,0 +1,180 @@
+// Copyright (c) 2016-2020 The Neutron Developers
+//
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "lockedpool.h"
+
+#include <assert.h>
+
+#ifdef WIN32
+#ifdef _WIN32_WINNT
+#undef _WIN32_WINNT
+#endif
+#define _WIN32_WINNT 0x0501
+#define WIN32_LEAN_AND_MEAN 1
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include <openssl/crypto.h>
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+using namespace std;
+
+static size_t AlignUp(size_t x, size_t align)
+{
+    return (x + align - 1) & ~(align - 1);
+}
+
+Arena::Arena(void* base_in, size_t size_in, size_t alignment_in):
+    base(static_cast<char*>(base_in)), end(static_cast<char*>(base_in) + size_in), alignment(alignment_in)
+{
+    // alignment must be a power of two
+    assert(!(alignment & (alignment - 1)));
+    addFree(base, size_in);
+}
+
+void Arena::addFree(char* begin, size_t size)
+{
+    size_to_free_chunk.insert(make_pair(size, begin));
+    chunks_free[begin] = size;
+    chunks_free_end[begin + size] = begin;
+}
+
+void Arena::removeFree(char* begin, size_t size)
+{
+    pair<SizeToChunkMap::iterator, SizeToChunkMap::iterator> range = size_to_free_chunk.equal_range(size);
+
+    for (SizeToChunkMap::iterator it = range.first; it != range.second; ++it)
+    {
+        if (it->second == begin)
+        {
+            size_to_free_chunk.erase(it);
+            break;
+        }
+    }
+
+    chunks_free.erase(begin);
+    chunks_free_end.erase(begin + size);
+}
+
+void* Arena::alloc(size_t size)
+{
+    size = AlignUp(size, alignment);
+
+    if (size == 0)
+        return NULL;
+
+    // Smallest free chunk that fits, keeps large chunks whole for large requests
+    SizeToChunkMap::iterator it = size_to_free_chunk.lower_bound(size);
+
+    if (it == size_to_free_chunk.end())
+        return NULL;
+
+    size_t size_free = it->first;
+    char* begin = it->second;
+    removeFree(begin, size_free);
+
+    // Hand out the front, the rest stays free
+    if (size_free > size)
+        addFree(begin + size, size_free - size);
+
+    chunks_used[begin] = size;
+    return begin;
+}
+
+void Arena::free(void* ptr)
+{
+    map<char*, size_t>::iterator it = chunks_used.find(static_cast<char*>(ptr));
+    assert(it != chunks_used.end());     // Cannot free what this arena didn't allocate
+
+    char* begin = it->first;
+    size_t size = it->second;
+    chunks_used.erase(it);
+
+    memory_cleanse(begin, size);
+
+    // Merge with the free chunk right after...
+    map<char*, size_t>::iterator next = chunks_free.find(begin + size);
+
+    if (next != chunks_free.end())
+    {
+        size_t size_next = next->second;
+        removeFree(begin + size, size_next);
+        size += size_next;
+    }
+
+    // ...and the one right before
+    map<char*, char*>::iterator prev = chunks_free_end.find(begin);
+
+    if (prev != chunks_free_end.end())
+    {
+        char* begin_prev = prev->second;
+        size_t size_prev = begin - begin_prev;
+        removeFree(begin_prev, size_prev);
+        begin = begin_prev;
+        size += size_prev;
+    }
+
+    addFree(begin, size);
+}
+
+Arena::Stats Arena::stats() const
+{
+    Stats r;
+    r.used = r.free = 0;
+    r.total = end - base;
+    r.chunks_used = chunks_used.size();
+    r.chunks_free = chunks_free.size();
+
+    for (map<char*, size_t>::const_iterator it = chunks_used.begin(); it != chunks_used.end(); ++it)
+        r.used += it->second;
+
+    for (map<char*, size_t>::const_iterator it = chunks_free.begin(); it != chunks_free.end(); ++it)
+        r.free += it->second;
+
+    return r;
+}
+
+void* AllocateArenaPages(size_t len)
+{
+#ifdef WIN32
+    return VirtualAlloc(NULL, len, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+    void* addr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (addr == MAP_FAILED)
+        return NULL;
+
+#ifdef MADV_DONTDUMP
+    // Keys don't belong in core dumps either
+    madvise(addr, len, MADV_DONTDUMP);
+#endif
+
+    return addr;
+#endif
+}
+
+void FreeArenaPages(void* addr, size_t len)
+{
+    memory_cleanse(addr, len);
+
+#ifdef WIN32
+    VirtualFree(addr, 0, MEM_RELEASE);
+#else
+    munmap(addr, len);
+#endif
+}
+
+void memory_cleanse(void* ptr, size_t len)
+{
+    OPENSSL_cleanse(ptr, len);
+}
@@ -0,0 +1,233 @@
+// Copyright (c) 2016-2020 The Neutron Developers
+//
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NEUTRON_LOCKEDPOOL_H
+#define NEUTRON_LOCKEDPOOL_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <list>
+#include <map>
+
+#include <boost/thread/mutex.hpp>
+
+/** Size of one locked arena, a few hundred keys and passphrases fit in one */
+static const size_t LOCKEDPOOL_ARENA_SIZE = 256 * 1024;
+/** Most arenas the pool locks, further allocations lock their own pages */
+static const size_t LOCKEDPOOL_MAX_ARENAS = 4;
+/** Arenas reserved and locked when the pool is created */
+static const size_t LOCKEDPOOL_INITIAL_ARENAS = 1;
+/** Allocations are rounded up to this, enough for any type kept in secure memory */
+static const size_t LOCKEDPOOL_ALIGNMENT = 16;
+
+/**
+ * Best-fit allocator over one fixed block of memory. Free chunks are kept
+ * by address and by size; freeing merges a chunk with its free neighbours.
+ * Not thread-safe, the pool locks around it.
+ */
+class Arena
+{
+public:
+    struct Stats
+    {
+        size_t used;
+        size_t free;
+        size_t total;
+        size_t chunks_used;
+        size_t chunks_free;
+    };
+
+    Arena(void* base, size_t size, size_t alignment);
+
+    /** Returns NULL for 0 bytes or when no free chunk is large enough */
+    void* alloc(size_t size);
+
+    /** ptr must have come from alloc() of this arena */
+    void free(void* ptr);
+
+    bool addressInArena(void* ptr) const { return ptr >= base && ptr < end; }
+
+    Stats stats() const;
+
+private:
+    typedef std::multimap<size_t, char*> SizeToChunkMap;
+
+    SizeToChunkMap size_to_free_chunk;
+    std::map<char*, size_t> chunks_free;        // begin -> size
+    std::map<char*, char*> chunks_free_end;     // end -> begin
+    std::map<char*, size_t> chunks_used;        // begin -> size
+    char* base;
+    char* end;
+    size_t alignment;
+
+    void addFree(char* begin, size_t size);
+    void removeFree(char* begin, size_t size);
+};
+
+/** Page-aligned memory for an arena, NULL on failure */
+void* AllocateArenaPages(size_t len);
+void FreeArenaPages(void* addr, size_t len);
+
+/** Wipes memory in a way the compiler can't optimize away */
+void memory_cleanse(void* ptr, size_t len);
+
+/**
+ * Secure memory served from a few arenas that are locked once, instead of
+ * locking and unlocking pages on every allocation.
+ *
+ * initial_arenas are reserved up front, more are added as needed up to
+ * max_arenas. If the OS refuses to lock one (RLIMIT_MEMLOCK) it is used
+ * anyway and counted as unlocked in the stats.
+ * alloc() returns NULL when nothing fits, callers then fall back to locking
+ * their own pages. free() wipes the memory it takes back.
+ *
+ * Locker is a policy class as for LockedPageManagerBase, so tests can stub it.
+ */
+template <class Locker> class LockedPoolBase
+{
+public:
+    struct Stats
+    {
+        size_t used;
+        size_t free;
+        size_t total;
+        size_t locked;
+        size_t chunks_used;
+        size_t chunks_free;
+        size_t arenas;
+        uint64_t fallback_allocs;   // requests alloc() couldn't serve
+    };
+
+    LockedPoolBase(size_t arena_size = LOCKEDPOOL_ARENA_SIZE, size_t max_arenas = LOCKEDPOOL_MAX_ARENAS,
+                   size_t initial_arenas = LOCKEDPOOL_INITIAL_ARENAS):
+        arena_size(arena_size), max_arenas(max_arenas), locked_bytes(0), fallback_allocs(0)
+    {
+        boost::mutex::scoped_lock lock(mutex);
+
+        while (arenas.size() < std::min(initial_arenas, max_arenas) && NewArena()) {}
+    }
+
+    ~LockedPoolBase()
+    {
+        for (typename std::list<LockedArena>::iterator it = arenas.begin(); it != arenas.end(); ++it)
+        {
+            if (it->fLocked)
+                locker.Unlock(it->base, arena_size);
+
+            FreeArenaPages(it->base, arena_size);
+        }
+    }
+
+    void* alloc(size_t size)
+    {
+        boost::mutex::scoped_lock lock(mutex);
+
+        if (size == 0 || size > arena_size)
+        {
+            fallback_allocs++;
+            return NULL;
+        }
+
+        for (typename std::list<LockedArena>::iterator it = arenas.begin(); it != arenas.end(); ++it)
+        {
+            void* p = it->arena.alloc(size);
+
+            if (p)
+                return p;
+        }
+
+        if (arenas.size() < max_arenas && NewArena())
+        {
+            void* p = arenas.back().arena.alloc(size);
+
+            if (p)
+                return p;
+        }
+
+        fallback_allocs++;
+        return NULL;
+    }
+
+    /** Returns false if ptr isn't pool memory */
+    bool free(void* ptr)
+    {
+        boost::mutex::scoped_lock lock(mutex);
+
+        for (typename std::list<LockedArena>::iterator it = arenas.begin(); it != arenas.end(); ++it)
+        {
+            if (it->arena.addressInArena(ptr))
+            {
+                it->arena.free(ptr);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    Stats stats()
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        Stats r;
+        memset(&r, 0, sizeof(r));
+
+        for (typename std::list<LockedArena>::iterator it = arenas.begin(); it != arenas.end(); ++it)
+        {
+            Arena::Stats s = it->arena.stats();
+            r.used += s.used;
+            r.free += s.free;
+            r.total += s.total;
+            r.chunks_used += s.chunks_used;
+            r.chunks_free += s.chunks_free;
+        }
+
+        r.locked = locked_bytes;
+        r.arenas = arenas.size();
+        r.fallback_allocs = fallback_allocs;
+
+        return r;
+    }
+
+private:
+    struct LockedArena
+    {
+        Arena arena;
+        void* base;
+        bool fLocked;
+
+        LockedArena(void* base, size_t size, bool fLocked) :
+            arena(base, size, LOCKEDPOOL_ALIGNMENT), base(base), fLocked(fLocked) {}
+    };
+
+    // requires mutex
+    bool NewArena()
+    {
+        void* base = AllocateArenaPages(arena_size);
+
+        if (base == NULL)
+            return false;
+
+        // Unlocked secure memory is still wiped on free, better than not having it
+        bool fLocked = locker.Lock(base, arena_size);
+
+        if (fLocked)
+            locked_bytes += arena_size;
+
+        arenas.push_back(LockedArena(base, arena_size, fLocked));
+        return true;
+    }
+
+    Locker locker;
+    boost::mutex mutex;
+    std::list<LockedArena> arenas;
+    size_t arena_size;
+    size_t max_arenas;
+    size_t locked_bytes;
+    uint64_t fallback_allocs;
+};
+
+#endif // NEUTRON_LOCKEDPOOL_H
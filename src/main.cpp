@@ -7,20 +7,26 @@
 
 #include "alert.h"
 #include "backtrace.h"
+#include "blockstats.h"
+#include "blockserver.h"
 #include "checkpoints.h"
 #include "db.h"
+#include "feeestimator.h"
 #include "txdb.h"
 #include "net.h"
 #include "init.h"
 #include "ui_interface.h"
 #include "kernel.h"
 #include "robinhood.h"
+#include "runtimeconfig.h"
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <boost/format.hpp>
 #include "darksend.h"
 #include "masternode.h"
+#include "masternodecollateral.h"
+#include "masternodelistsync.h"
 #include "spork.h"
 #include "wallet.h"
 
@@ -608,7 +614,7 @@ bool AcceptableInputs(CTxMemPool& pool, const CTransaction &txo, bool fLimitFree
 
             // -limitfreerelay unit is thousand-bytes-per-minute
             // At default rate it would take over a month to fill 1GB
-            if (dFreeCount > GetArg("-limitfreerelay", 15) * 10 * 1000)
+            if (dFreeCount > configLimitFreeRelay.GetInt() * 10 * 1000)
                 return error("%s : free transaction rejected by rate limiter", __func__);
 
             LogPrintf("%s : rate limit dFreeCount: %g => %g\n", __func__, dFreeCount, dFreeCount+nSize);
@@ -1470,6 +1476,9 @@ bool CBlock::DisconnectBlock(CTxDB& txdb, CBlockIndex* pindex)
             return error("%s : WriteBlockIndex failed", __func__);
     }
 
+    if (fBlockStatsIndex && !DisconnectBlockStats(txdb, pindex))
+        return error("%s : DisconnectBlockStats failed", __func__);
+
     // ppcoin: clean up wallet after disconnecting coinstake
     BOOST_FOREACH(CTransaction& tx, vtx)
         SyncWithWallets(tx, this, false, false);
@@ -1674,9 +1683,7 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex *pindex, bool fJustCheck, boo
         {
             if (isMasternodeListSynced)
             {
-                masternodePayments.ProcessBlock(pindex->nHeight + 1);
-                masternodePayments.ProcessBlock(pindex->nHeight + 2);
-                masternodePayments.ProcessBlock(pindex->nHeight + 3);
+                masternodePayments.ProcessBlocks(pindex->nHeight + 1, 3);
             }
 
             CAmount nRequiredMnPmt = GetMasternodePayment(pindex->nHeight, nCalculatedStakeReward);
@@ -1840,6 +1847,9 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex *pindex, bool fJustCheck, boo
             return error("%s : UpdateTxIndex failed", __func__);
     }
 
+    if (fBlockStatsIndex && !ConnectBlockStats(txdb, *this, pindex, nFees, nStakeReward))
+        return error("%s : ConnectBlockStats failed", __func__);
+
     // Update block index on disk without changing it in memory.
     // The memory index structure will be changed after the db commits.
     if (pindex->pprev)
@@ -1904,6 +1914,7 @@ bool static Reorganize(CTxDB& txdb, CBlockIndex* pindexNew, int postponedBlocks)
 
     // Disconnect shorter branch
     vector<CTransaction> vResurrect;
+    vector<CTransaction> vDisconnected;
 
     BOOST_FOREACH(CBlockIndex* pindex, vDisconnect)
     {
@@ -1918,6 +1929,9 @@ bool static Reorganize(CTxDB& txdb, CBlockIndex* pindexNew, int postponedBlocks)
                          pindex->GetBlockHash().ToString().substr(0,20).c_str());
         }
 
+        // Oldest block first, for the collateral watcher to undo in reverse
+        vDisconnected.insert(vDisconnected.begin(), block.vtx.begin(), block.vtx.end());
+
         // Queue memory transactions to resurrect
         BOOST_FOREACH(const CTransaction& tx, block.vtx)
         {
@@ -1951,6 +1965,9 @@ bool static Reorganize(CTxDB& txdb, CBlockIndex* pindexNew, int postponedBlocks)
     if (!txdb.WriteHashBestChain(pindexNew->GetBlockHash()))
         return error("%s : WriteHashBestChain failed", __func__);
 
+    // The new best chain must never point at block data that is not durable yet
+    WaitForBlockFileFlush(pindexNew->nFile, pindexNew->nBlockPos);
+
     // Make sure it's successfully written to disk before changing memory structure
     if (!txdb.TxnCommit())
         return error("%s : TxnCommit failed", __func__);
@@ -1969,6 +1986,9 @@ bool static Reorganize(CTxDB& txdb, CBlockIndex* pindexNew, int postponedBlocks)
             pindex->pprev->pnext = pindex;
     }
 
+    collateralWatcher.TransactionsDisconnected(vDisconnected);
+    collateralWatcher.TransactionsConnected(vDelete);
+
     // Resurrect memory transactions that were in the disconnected branch
     BOOST_FOREACH(CTransaction& tx, vResurrect)
         tx.AcceptToMemoryPool(txdb, false);
@@ -1999,6 +2019,10 @@ bool CBlock::SetBestChainInner(CTxDB& txdb, CBlockIndex *pindexNew, bool reorgan
         return false;
     }
 
+    // The new best chain must never point at block data that is not durable yet,
+    // the sync has been running on the flush thread while the block was connected
+    WaitForBlockFileFlush(pindexNew->nFile, pindexNew->nBlockPos);
+
     if (!txdb.TxnCommit())
         return error("%s : TxnCommit failed", __func__);
 
@@ -2006,6 +2030,11 @@ bool CBlock::SetBestChainInner(CTxDB& txdb, CBlockIndex *pindexNew, bool reorgan
     if (pindexNew->pprev != NULL)
         pindexNew->pprev->pnext = pindexNew;
 
+    collateralWatcher.TransactionsConnected(vtx);
+
+    // Before the pool forgets them, the estimator needs to see what confirmed
+    feeEstimator.BlockConnected(pindexNew->nHeight, vtx);
+
     // Delete redundant memory transactions
     BOOST_FOREACH(CTransaction& tx, vtx)
         mempool.remove(tx);
@@ -2023,6 +2052,7 @@ bool CBlock::SetBestChain(CTxDB& txdb, CBlockIndex* pindexNew)
     if (pindexGenesisBlock == NULL && hash == (!fTestNet ? hashGenesisBlock : hashGenesisBlockTestNet))
     {
         txdb.WriteHashBestChain(hash);
+        WaitForBlockFileFlush(pindexNew->nFile, pindexNew->nBlockPos);
 
         if (!txdb.TxnCommit())
             return error("%s : TxnCommit failed", __func__);
@@ -2778,7 +2808,7 @@ bool CBlock::SignBlock_POW(const CKeyStore& keystore)
             // Convert to pay to public key type
             if (!keystore.GetKey(uint160(vSolutions[0]), key))
             {
-                if (fDebug && GetBoolArg("-printcoinstake"))
+                if (fDebug && configPrintCoinStake.GetBool())
                     LogPrintf("%s : failed to get key for kernel type=%d\n", __func__, whichType);
 
                 continue;  // unable to find corresponding public key
@@ -3127,6 +3157,39 @@ bool LoadExternalBlockFile(FILE* fileIn)
             CAutoFile blkdat(fileIn, SER_DISK, CLIENT_VERSION);
             unsigned int nPos = 0;
 
+            // Compressed block files are framed, so walk them record by record
+            if (IsCompressedBlockFile(blkdat))
+            {
+                while (blkdat.good() && !fRequestShutdown)
+                {
+                    unsigned char pchMagic[sizeof(pchMessageStart)];
+                    unsigned int nSize;
+
+                    if (fread(pchMagic, 1, sizeof(pchMagic), blkdat) != sizeof(pchMagic))
+                        break;
+
+                    if (memcmp(pchMagic, pchMessageStart, sizeof(pchMagic)) != 0)
+                    {
+                        LogPrintf("%s : unexpected record magic in compressed block file\n", __func__);
+                        break;
+                    }
+
+                    blkdat >> nSize;
+                    CDataStream ssBlock(SER_DISK, CLIENT_VERSION);
+
+                    if (!ReadCompressedBlock(blkdat, false, ssBlock))
+                        break;
+
+                    CBlock block;
+                    ssBlock >> block;
+
+                    if (ProcessNewBlock(NULL, &block))
+                        nLoaded++;
+                }
+
+                nPos = (unsigned int)-1;
+            }
+
             while (nPos != (unsigned int)-1 && blkdat.good() && !fRequestShutdown)
             {
                 unsigned char pchData[65536];
@@ -3268,7 +3331,7 @@ bool static AlreadyHave(CTxDB& txdb, const CInv& inv)
         return mapSporks.count(inv.hash);
 
     case MSG_MASTERNODE_WINNER:
-        return mapSeenMasternodeVotes.count(inv.hash);
+        return masternodePayments.HaveSeenVote(inv.hash);
 
     }
     // Don't know what it is, just say we already got one
@@ -3287,6 +3350,10 @@ void static ProcessGetData(CNode* pfrom)
         if (pfrom->nSendSize >= SendBufferSize())
             break;
 
+        // Wait for the block server to push the previous block, responses go out in request order
+        if (pfrom->fServingBlock)
+            break;
+
         const CInv &inv = *it;
         if (fDebug) LogPrintf("ProcessGetData -- inv = %s\n", inv.ToString());
         {
@@ -3300,21 +3367,49 @@ void static ProcessGetData(CNode* pfrom)
 
                 if (mi != mapBlockIndex.end())
                 {
-                    CBlock block;
-                    block.ReadFromDisk((*mi).second);
-                    pfrom->PushMessage(NetMsgType::BLOCK, block);
+                    // Once the -maxuploadtarget budget is used up, stop serving
+                    // historical blocks. Recent blocks are still served so that
+                    // relay keeps working.
+                    if (g_connman && g_connman->OutboundTargetReached(true) &&
+                        pindexBest->GetBlockTime() - (*mi).second->GetBlockTime() > HISTORICAL_BLOCK_AGE)
+                    {
+                        LogPrint("net", "%s : historical block serving limit reached, disconnect peer=%d\n",
+                                 __func__, pfrom->GetId());
+
+                        pfrom->fDisconnect = true;
+                        break;
+                    }
+
+                    CBlockIndex* pindex = (*mi).second;
 
                     // Trigger them to send a getblocks request for the next batch of inventory
+                    vector<CInv> vInv;
+
                     if (inv.hash == pfrom->hashContinue)
                     {
                         // ppcoin: send latest proof-of-work block to allow the
                         // download node to accept as orphan (proof-of-stake
                         // block might be rejected by stake connection check)
-                        vector<CInv> vInv;
                         vInv.push_back(CInv(MSG_BLOCK, GetLastBlockIndex(pindexBest, false)->GetBlockHash()));
-                        pfrom->PushMessage(NetMsgType::INV, vInv);
                         pfrom->hashContinue = 0;
                     }
+
+                    // Historical blocks are read off cs_main by the block server
+                    if (!blockServer.IsRunning() || pindexBest->nHeight - pindex->nHeight < BLOCK_SERVE_MIN_DEPTH ||
+                        !blockServer.Enqueue(pfrom, inv, pindex->nFile, pindex->nBlockPos, vInv))
+                    {
+                        CBlock block;
+
+                        if (block.ReadFromDisk(pindex))
+                        {
+                            pfrom->PushMessage(NetMsgType::BLOCK, block);
+
+                            if (!vInv.empty())
+                                pfrom->PushMessage(NetMsgType::INV, vInv);
+                        }
+                        else
+                            vNotFound.push_back(inv);
+                    }
                 }
             }
             else if (inv.IsKnownType())
@@ -3362,11 +3457,9 @@ void static ProcessGetData(CNode* pfrom)
                     }
                 }
                 if (!pushed && inv.type == MSG_MASTERNODE_WINNER) {
-                    if(mapSeenMasternodeVotes.count(inv.hash)){
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        int a = 0;
-                        ss.reserve(1000);
-                        ss << mapSeenMasternodeVotes[inv.hash] << a;
+                    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                    ss.reserve(1000);
+                    if(masternodePayments.GetVoteMessage(inv.hash, ss)){
                         pfrom->PushMessage(NetMsgType::MASTERNODEPAYMENTVOTE, ss);
                         pushed = true;
                     }
@@ -3507,6 +3600,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 
         // Change version
         pfrom->PushMessage(NetMsgType::VERACK);
+        PushMasternodeListSyncVersion(pfrom);
         pfrom->ssSend.SetVersion(min(pfrom->nVersion, PROTOCOL_VERSION));
 
         if (!pfrom->fInbound)
@@ -3954,6 +4048,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             SyncWithWallets(tx, NULL, true);
             RelayTransaction(tx, inv.hash);
             mapAlreadyAskedFor.erase(inv);
+            pfrom->nLastTXTime = GetTime();
             vWorkQueue.push_back(inv.hash);
             vEraseQueue.push_back(inv.hash);
 
@@ -4009,9 +4104,12 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
     }
     else if (strCommand == NetMsgType::BLOCK)
     {
+        size_t nBlockBytes = vRecv.size();
         CBlock block;
         vRecv >> block;
 
+        pfrom->MarkBlockReceived(nBlockBytes);
+
         if (fDebug)
             LogPrintf("%s : received block %s\n", __func__, block.GetHash().ToString().c_str());
 
@@ -4019,7 +4117,10 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         pfrom->AddInventoryKnown(inv);
 
         if (ProcessNewBlock(pfrom, &block))
+        {
             mapAlreadyAskedFor.erase(inv);
+            pfrom->nLastBlockTime = GetTime();
+        }
         else
         {
             // Be more aggressive with blockchain download. Send getblocks() message after
@@ -4082,6 +4183,31 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             pfrom->PushMessage(NetMsgType::PONG, nonce);
         }
     }
+    else if (strCommand == NetMsgType::PONG)
+    {
+        uint64_t nonce = 0;
+
+        if (vRecv.size() >= sizeof(nonce))
+        {
+            vRecv >> nonce;
+
+            // Only process pong message if there is an outstanding ping (old ping without nonce should never pong)
+            if (pfrom->nPingNonceSent != 0 && nonce == pfrom->nPingNonceSent)
+            {
+                int64_t pingUsecTime = nTimeReceived - pfrom->nPingUsecStart;
+
+                if (pingUsecTime > 0)
+                {
+                    pfrom->nPingUsecTime = pingUsecTime;
+                    pfrom->nMinPingUsecTime = std::min(pfrom->nMinPingUsecTime, pingUsecTime);
+                }
+
+                pfrom->nPingNonceSent = 0;
+            }
+            else if (nonce != 0)
+                LogPrint("net", "%s : unsolicited pong from peer=%d\n", __func__, pfrom->id);
+        }
+    }
     else if (strCommand == NetMsgType::ALERT)
     {
         CAlert alert;
@@ -4112,6 +4238,20 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             }
         }
     }
+    else if (strCommand == NetMsgType::NOTFOUND)
+    {
+        vector<CInv> vInv;
+        vRecv >> vInv;
+
+        if (vInv.size() <= MAX_INV_SZ)
+        {
+            BOOST_FOREACH(const CInv& inv, vInv)
+            {
+                if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK)
+                    pfrom->MarkBlockNotFound();
+            }
+        }
+    }
     else if (strCommand == NetMsgType::REJECT)
     {
         if (fDebug) {
@@ -4154,7 +4294,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             /* DSF, DSC, DSA, DSQ, DSI, DSSUB, DSSU, DSS */
             //ProcessMessageDarksend(pfrom, strCommand, vRecv);
 
-            /* DSEE, DSEEP, DSEG, MNGET, MNW */
+            /* DSEE, DSEEP, DSEG, MNGET, MNW, list sync */
             ProcessMessageMasternode(pfrom, strCommand, vRecv);
 
             // TODO: Test/Enable InstantX
@@ -4211,7 +4351,7 @@ bool ProcessMessages(CNode* pfrom)
         ProcessGetData(pfrom);
 
     // this maintains the order of responses
-    if (!pfrom->vRecvGetData.empty()) return fOk;
+    if (!pfrom->vRecvGetData.empty() || pfrom->fServingBlock) return fOk;
 
     std::deque<CNetMessage>::iterator it = pfrom->vRecvMsg.begin();
     while (!pfrom->fDisconnect && it != pfrom->vRecvMsg.end())
@@ -4349,20 +4489,32 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
         return true;
     }
 
-    // Keep-alive ping. We send a nonce of zero because we don't use it anywhere right now
-    if (pto->nLastSend && GetTime() - pto->nLastSend > 30 * 60 && pto->vSendMsg.empty())
+    // Ping every PING_INTERVAL to measure latency (used for inbound eviction),
+    // which also serves as keep-alive. Pings without a nonce can't be matched
+    // to a pong, so older peers only get the keep-alive. A peer that leaves a
+    // ping unanswered for TIMEOUT_INTERVAL is disconnected by the socket handler.
+    if (pto->nPingNonceSent == 0 && pto->nPingUsecStart + PING_INTERVAL * 1000000 < GetTimeMicros())
     {
         uint64_t nonce = 0;
 
+        while (nonce == 0)
+            GetRandBytes((unsigned char*)&nonce, sizeof(nonce));
+
+        pto->nPingUsecStart = GetTimeMicros();
+
         if (pto->nVersion > BIP0031_VERSION)
+        {
+            pto->nPingNonceSent = nonce;
             pto->PushMessage(NetMsgType::PING, nonce);
+        }
         else
+        {
+            // Peer is too old to support ping command with nonce, pong will never arrive.
+            pto->nPingNonceSent = 0;
             pto->PushMessage(NetMsgType::PING);
+        }
     }
 
-    // Resend wallet transactions that haven't gotten in a block yet
-    ResendWalletTransactions();
-
     // Address refresh broadcast
     static int64_t nLastRebroadcast;
 
@@ -4501,6 +4653,9 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
 
             vGetData.push_back(inv);
 
+            if (inv.type == MSG_BLOCK)
+                pto->MarkBlockRequested();
+
             if (vGetData.size() >= 1000)
             {
                 pto->PushMessage(NetMsgType::GETDATA, vGetData);
@@ -627,6 +627,31 @@ public:
 
     bool ReadFromDisk(CDiskTxPos pos, FILE** pfileRet=NULL)
     {
+        // Transaction positions in compressed files are offsets into the inflated block
+        if (GetBlockFileFormat(pos.nFile) == BLOCKFILE_COMPRESSED)
+        {
+            if (pfileRet)
+                return error("CTransaction::ReadFromDisk() : file handle requested for compressed block file");
+
+            CDataStream ssBlock(SER_DISK, CLIENT_VERSION);
+
+            if (!ReadCompressedBlock(pos.nFile, pos.nBlockPos, false, ssBlock))
+                return error("CTransaction::ReadFromDisk() : ReadCompressedBlock failed");
+
+            if (pos.nTxPos < pos.nBlockPos || pos.nTxPos - pos.nBlockPos >= ssBlock.size())
+                return error("CTransaction::ReadFromDisk() : transaction offset outside of block");
+
+            try {
+                ssBlock.ignore(pos.nTxPos - pos.nBlockPos);
+                ssBlock >> *this;
+            }
+            catch (std::exception &e) {
+                return error("%s() : deserialize or I/O error", __PRETTY_FUNCTION__);
+            }
+
+            return true;
+        }
+
         CAutoFile filein = CAutoFile(OpenBlockFile(pos.nFile, 0, pfileRet ? "rb+" : "rb"), SER_DISK, CLIENT_VERSION);
         if (!filein)
             return error("CTransaction::ReadFromDisk() : OpenBlockFile failed");
@@ -999,20 +1024,41 @@ public:
         if (!fileout)
             return error("CBlock::WriteToDisk() : AppendBlockFile failed");
 
-        unsigned int nSize = fileout.GetSerializeSize(*this);
-        fileout << FLATDATA(pchMessageStart) << nSize;
+        if (GetBlockFileFormat(nFileRet) == BLOCKFILE_COMPRESSED)
+        {
+            CDataStream ssBlock(SER_DISK, CLIENT_VERSION);
+            ssBlock << *this;
+
+            if (!WriteCompressedBlock(fileout, ssBlock, ::GetSerializeSize(*this, SER_DISK | SER_BLOCKHEADERONLY, CLIENT_VERSION), nBlockPosRet))
+                return error("CBlock::WriteToDisk() : WriteCompressedBlock failed");
+        }
+        else
+        {
+            unsigned int nSize = fileout.GetSerializeSize(*this);
+            fileout << FLATDATA(pchMessageStart) << nSize;
+
+            long fileOutPos = ftell(fileout);
 
-        long fileOutPos = ftell(fileout);
+            if (fileOutPos < 0)
+                return error("CBlock::WriteToDisk() : ftell failed");
 
-        if (fileOutPos < 0)
-            return error("CBlock::WriteToDisk() : ftell failed");
+            nBlockPosRet = fileOutPos;
+            fileout << *this;
+            RecordRawBlockWrite(nSize);
+        }
 
-        nBlockPosRet = fileOutPos;
-        fileout << *this;
         fflush(fileout);
 
+        // The fsync runs on the block flush thread, SetBestChain waits for it
         if (!IsInitialBlockDownload() || (nBestHeight+1) % 500 == 0)
-            FileCommit(fileout);
+        {
+            long nEndPos = ftell(fileout);
+
+            if (nEndPos < 0)
+                return error("CBlock::WriteToDisk() : ftell failed");
+
+            ScheduleBlockFileFlush(nFileRet, nEndPos);
+        }
 
         return true;
     }
@@ -1020,21 +1066,44 @@ public:
     bool ReadFromDisk(unsigned int nFile, unsigned int nBlockPos, bool fReadTransactions=true)
     {
         SetNull();
-        CAutoFile filein = CAutoFile(OpenBlockFile(nFile, nBlockPos, "rb"), SER_DISK, CLIENT_VERSION);
 
-        if (!filein)
-            return error("CBlock::ReadFromDisk() : OpenBlockFile failed");
+        if (GetBlockFileFormat(nFile) == BLOCKFILE_COMPRESSED)
+        {
+            CDataStream ssBlock(SER_DISK, CLIENT_VERSION);
 
-        if (!fReadTransactions)
-            filein.nType |= SER_BLOCKHEADERONLY;
+            if (!ReadCompressedBlock(nFile, nBlockPos, !fReadTransactions, ssBlock))
+                return error("CBlock::ReadFromDisk() : ReadCompressedBlock failed");
 
-        try
-        {
-            filein >> *this;
+            if (!fReadTransactions)
+                ssBlock.nType |= SER_BLOCKHEADERONLY;
+
+            try
+            {
+                ssBlock >> *this;
+            }
+            catch (std::exception &e)
+            {
+                return error("%s() : deserialize or I/O error", __PRETTY_FUNCTION__);
+            }
         }
-        catch (std::exception &e)
+        else
         {
-            return error("%s() : deserialize or I/O error", __PRETTY_FUNCTION__);
+            CAutoFile filein = CAutoFile(OpenBlockFile(nFile, nBlockPos, "rb"), SER_DISK, CLIENT_VERSION);
+
+            if (!filein)
+                return error("CBlock::ReadFromDisk() : OpenBlockFile failed");
+
+            if (!fReadTransactions)
+                filein.nType |= SER_BLOCKHEADERONLY;
+
+            try
+            {
+                filein >> *this;
+            }
+            catch (std::exception &e)
+            {
+                return error("%s() : deserialize or I/O error", __PRETTY_FUNCTION__);
+            }
         }
 
         if (fReadTransactions && IsProofOfWork() && !CheckProofOfWork(GetPoWHash(), nBits))
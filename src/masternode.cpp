@@ -5,6 +5,8 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "masternode.h"
+#include "masternodecollateral.h"
+#include "masternodelistsync.h"
 #include "activemasternode.h"
 #include "darksend.h"
 #include "main.h"
@@ -21,7 +23,6 @@ CCriticalSection cs_masternodes;
 CMasternodeMan mnodeman;
 std::vector<CMasternode> vecMasternodes;
 CMasternodePayments masternodePayments;
-map<uint256, CMasternodePaymentWinner> mapSeenMasternodeVotes;
 map<uint256, int> mapSeenMasternodeScanningErrors;
 std::map<CNetAddr, int64_t> mAskedUsForMasternodeList;
 std::map<COutPoint, int64_t> mWeAskedForMasternodeListEntry;
@@ -48,6 +49,9 @@ void ProcessMasternodeConnections()
 
 void ProcessMessageMasternode(CNode* pfrom, std::string& strCommand, CDataStream& vRecv)
 {
+    if (ProcessMessageMasternodeList(pfrom, strCommand, vRecv))
+        return;
+
     if (IsInitialBlockDownload())
         return;
 
@@ -69,6 +73,8 @@ void ProcessMessageMasternode(CNode* pfrom, std::string& strCommand, CDataStream
         vRecv >> vin >> addr >> vchSig >> sigTime >> pubkey >> pubkey2 >> count >> current >>
                  lastUpdated >> protocolVersion;
 
+        mnodeman.CountMessage(&CMasternodeMessageStats::nDseeReceived);
+
         if (fDebug)
         {
             LogPrintf("%s : dsee - received: node: %s, vin: %s, addr: %s, sigTime: %lld, pubkey: %s, pubkey2: %s, "
@@ -136,18 +142,45 @@ void ProcessMessageMasternode(CNode* pfrom, std::string& strCommand, CDataStream
             return;
         }
 
-        std::string errorMessage = "";
+        // the same broadcast reaches us from most of our peers, only check its signature once
+        CHashWriter ss(SER_GETHASH, 0);
+        ss << vin << strMessage << vchSig;
+        uint256 hashBroadcast = ss.GetHash();
 
-        if (!darkSendSigner.VerifyMessage(pubkey, vchSig, strMessage, errorMessage))
+        if (mnodeman.HaveRejectedBroadcast(hashBroadcast))
         {
+            mnodeman.CountMessage(&CMasternodeMessageStats::nDseeRejectedCached);
+
             std::stringstream msg;
-            msg << boost::format("%s : dsee - got bad masternode address signature") % __func__;
+            msg << boost::format("%s : dsee - got previously rejected masternode broadcast") % __func__;
 
             LogPrintf("%s\n", msg.str().c_str());
             pfrom->Misbehaving(msg.str(), 100);
             return;
         }
 
+        if (mnodeman.HaveSeenBroadcast(hashBroadcast))
+            mnodeman.CountMessage(&CMasternodeMessageStats::nDseeDuplicate);
+        else
+        {
+            std::string errorMessage = "";
+            mnodeman.CountMessage(&CMasternodeMessageStats::nDseeVerified);
+
+            if (!darkSendSigner.VerifyMessage(pubkey, vchSig, strMessage, errorMessage))
+            {
+                mnodeman.AddRejectedBroadcast(hashBroadcast);
+
+                std::stringstream msg;
+                msg << boost::format("%s : dsee - got bad masternode address signature") % __func__;
+
+                LogPrintf("%s\n", msg.str().c_str());
+                pfrom->Misbehaving(msg.str(), 100);
+                return;
+            }
+
+            mnodeman.AddSeenBroadcast(hashBroadcast);
+        }
+
         // search existing masternode list, this is where we update existing masternodes with new dsee broadcasts
         CMasternode* pmn = mnodeman.Find(vin);
         if (pmn != NULL)
@@ -188,6 +221,8 @@ void ProcessMessageMasternode(CNode* pfrom, std::string& strCommand, CDataStream
 
         // make sure the vout that was signed is related to the transaction that spawned the masternode
         //  - this is expensive, so it's only done once per masternode
+        //  - not remembered as rejected: it also fails while the collateral isn't indexed yet,
+        //    and peers relaying the broadcast later must not be banned for that
         if (!darkSendSigner.IsVinAssociatedWithPubkey(vin, pubkey))
         {
             std::stringstream msg;
@@ -202,7 +237,7 @@ void ProcessMessageMasternode(CNode* pfrom, std::string& strCommand, CDataStream
             LogPrintf("%s : dsee - got new masternode entry %s\n", __func__, addr.ToString().c_str());
 
         // make sure it's still unspent
-        //  - this is checked later by .check() in many places and by ThreadCheckDarkSend()
+        //  - this is checked later by .check() in many places and by the masternodecheck task
 
         CTransaction tx = CTransaction();
         CTxOut vout = CTxOut(24999*COIN, darkSendPool.collateralPubKey);
@@ -233,6 +268,7 @@ void ProcessMessageMasternode(CNode* pfrom, std::string& strCommand, CDataStream
             CMasternode mn(addr, vin, pubkey, vchSig, sigTime, pubkey2, protocolVersion);
             mn.UpdateLastSeen(lastUpdated);
             vecMasternodes.push_back(mn);
+            mnodeman.CountMessage(&CMasternodeMessageStats::nDseeNew);
 
             // if it matches our masternodeprivkey, then we've been remotely activated
             if (pubkey2 == activeMasternode.pubKeyMasternode && protocolVersion == PROTOCOL_VERSION)
@@ -268,6 +304,8 @@ void ProcessMessageMasternode(CNode* pfrom, std::string& strCommand, CDataStream
 
         vRecv >> vin >> vchSig >> sigTime >> stop;
 
+        mnodeman.CountMessage(&CMasternodeMessageStats::nDseepReceived);
+
         if (fDebug)
         {
             LogPrintf("%s : dseep - received: node: %s, vin: %s, sigTime: %lld, stop: %s\n", __func__,
@@ -316,6 +354,7 @@ void ProcessMessageMasternode(CNode* pfrom, std::string& strCommand, CDataStream
                 }
 
                 std::string errorMessage = "";
+                mnodeman.CountMessage(&CMasternodeMessageStats::nDseepVerified);
 
                 if (!darkSendSigner.VerifyMessage(pmn->pubkey2, vchSig, strMessage, errorMessage))
                 {
@@ -360,6 +399,8 @@ void ProcessMessageMasternode(CNode* pfrom, std::string& strCommand, CDataStream
                     RelayDarkSendElectionEntryPing(vin, vchSig, sigTime, stop);
                 }
             }
+            else
+                mnodeman.CountMessage(&CMasternodeMessageStats::nDseepDuplicate);
 
             return;
         }
@@ -497,7 +538,7 @@ void ProcessMessageMasternode(CNode* pfrom, std::string& strCommand, CDataStream
 
         uint256 nHash = winner.GetHash();
 
-        if (mapSeenMasternodeVotes.count(nHash))
+        if (masternodePayments.HaveSeenVote(nHash))
         {
             if (fDebug)
             {
@@ -510,6 +551,9 @@ void ProcessMessageMasternode(CNode* pfrom, std::string& strCommand, CDataStream
 
         int nFirstBlock = pindexBest->nHeight - (mnodeman.CountEnabled() * 1.25);
 
+        // older votes wouldn't fit in the payment list
+        nFirstBlock = std::max(nFirstBlock, pindexBest->nHeight - MASTERNODE_PAYMENTS_CACHE_BLOCKS + 21);
+
         if (winner.nBlockHeight < nFirstBlock || winner.nBlockHeight > pindexBest->nHeight + 20)
         {
             if (fDebug)
@@ -571,7 +615,7 @@ void ProcessMessageMasternode(CNode* pfrom, std::string& strCommand, CDataStream
                   __func__, address2.ToString(), winner.nBlockHeight, pindexBest->nHeight,
                   winner.vin.prevout.ToStringShort(), nHash.ToString());
 
-        mapSeenMasternodeVotes.insert(make_pair(nHash, winner));
+        masternodePayments.AddSeenVote(nHash, winner.nBlockHeight);
 
         if (masternodePayments.AddWinningMasternode(winner))
             masternodePayments.Relay(winner);
@@ -770,13 +814,20 @@ uint256 CMasternode::CalculateScore(unsigned int nBlockHeight)
     }
 
     uint256 hash = 0;
-    uint256 aux = vin.prevout.hash + vin.prevout.n;
 
     if(!GetBlockHash(hash, nBlockHeight - MASTERNODE_BLOCK_OFFSET))
     {
         LogPrintf("%s : failed to get blockhash\n", __func__);
         return 0;
     }
+
+    return CalculateScore(hash);
+}
+
+uint256 CMasternode::CalculateScore(const uint256& hash) const
+{
+    uint256 aux = vin.prevout.hash + vin.prevout.n;
+
     CDataStream ss(SER_GETHASH, 0);
     ss << hash;
     uint256 hash2 = Hash(ss.begin(), ss.end());
@@ -790,6 +841,25 @@ uint256 CMasternode::CalculateScore(unsigned int nBlockHeight)
 
 void CMasternode::Check()
 {
+    // The collateral state is kept current by the watcher, so a spend (or a reorg
+    // undoing one) shows up on the next call rather than the next timed pass
+    bool fSpent;
+
+    if (!unitTest && collateralWatcher.GetSpent(vin.prevout, fSpent))
+    {
+        if (fSpent)
+        {
+            nActiveState = MASTERNODE_VIN_SPENT;
+            return;
+        }
+
+        if (nActiveState == MASTERNODE_VIN_SPENT)
+        {
+            nActiveState = MASTERNODE_ENABLED;
+            lastTimeChecked = 0;
+        }
+    }
+
     if (GetTime() - lastTimeChecked < MASTERNODE_CHECK_SECONDS)
         return;
 
@@ -818,21 +888,11 @@ void CMasternode::Check()
         return;
     }
 
-    if (!unitTest)
+    // First check of this collateral, later ones are answered above
+    if (!unitTest && collateralWatcher.Watch(vin.prevout))
     {
-        CTransaction tx = CTransaction();
-        CTxOut vout = CTxOut(24999 * COIN, darkSendPool.collateralPubKey);
-        tx.vin.push_back(vin);
-        tx.vout.push_back(vout);
-
-        // if(!AcceptableInputs(mempool, state, tx)){
-        bool pfMissingInputs = false;
-
-        if (!AcceptableInputs(mempool, tx, false, &pfMissingInputs))
-        {
-            nActiveState = MASTERNODE_VIN_SPENT;
-            return;
-        }
+        nActiveState = MASTERNODE_VIN_SPENT;
+        return;
     }
 
     nActiveState = MASTERNODE_ENABLED; // OK
@@ -922,14 +982,65 @@ bool CMasternodePayments::Sign(CMasternodePaymentWinner& winner)
     return true;
 }
 
+void CMasternodePaymentRecord::SetNull()
+{
+    nBlockHeight = 0;
+    vin = CTxIn();
+    payee = CNoDestination();
+    score = 0;
+    nVotes = 0;
+    vchSig.clear();
+}
+
+bool CMasternodePaymentRecord::SetWinner(const CMasternodePaymentWinner& winner)
+{
+    CTxDestination dest;
+
+    if (!ExtractDestination(winner.payee, dest) || GetScriptForDestination(dest) != winner.payee)
+        return false;
+
+    nBlockHeight = winner.nBlockHeight;
+    vin = winner.vin;
+    payee = dest;
+    score = winner.score;
+    vchSig = winner.vchSig;
+
+    return true;
+}
+
+CScript CMasternodePaymentRecord::GetPayee() const
+{
+    return GetScriptForDestination(payee);
+}
+
+CMasternodePaymentWinner CMasternodePaymentRecord::GetWinner() const
+{
+    CMasternodePaymentWinner winner(vin);
+    winner.nBlockHeight = nBlockHeight;
+    winner.payee = GetPayee();
+    winner.score = score;
+    winner.vchSig = vchSig;
+
+    return winner;
+}
+
+static int GetPaymentSlot(int nBlockHeight)
+{
+    return nBlockHeight % MASTERNODE_PAYMENTS_CACHE_BLOCKS;
+}
+
 bool CMasternodePayments::GetBlockPayee(int nBlockHeight, CScript& payee)
 {
     LOCK(cs_masternodes);
-    std::map<int, CMasternodePaymentWinner>::iterator winner = vWinning.find(nBlockHeight);
 
-    if (winner != vWinning.end() && winner->second.nBlockHeight == nBlockHeight)
+    if (nBlockHeight <= 0)
+        return false;
+
+    const CMasternodePaymentRecord& record = vWinning[GetPaymentSlot(nBlockHeight)];
+
+    if (record.nBlockHeight == nBlockHeight)
     {
-        payee = winner->second.payee;
+        payee = record.GetPayee();
         return true;
     }
 
@@ -939,11 +1050,15 @@ bool CMasternodePayments::GetBlockPayee(int nBlockHeight, CScript& payee)
 bool CMasternodePayments::GetWinningMasternode(int nBlockHeight, CTxIn& vinOut)
 {
     LOCK(cs_masternodes);
-    std::map<int, CMasternodePaymentWinner>::iterator winner = vWinning.find(nBlockHeight);
 
-    if (winner != vWinning.end() && winner->second.nBlockHeight == nBlockHeight)
+    if (nBlockHeight <= 0)
+        return false;
+
+    const CMasternodePaymentRecord& record = vWinning[GetPaymentSlot(nBlockHeight)];
+
+    if (record.nBlockHeight == nBlockHeight)
     {
-        vinOut = winner->second.vin;
+        vinOut = record.vin;
         return true;
     }
 
@@ -954,20 +1069,35 @@ bool CMasternodePayments::AddPastWinningMasternode(std::vector<CTransaction>& vt
 {
    LOCK(cs_masternodes);
 
-   if (vtx.size() > 1)
+   if (vtx.size() > 1 && height > 0)
    {
       for (const CTxOut out : vtx[1].vout)
       {
          if (amount == out.nValue)
          {
+            CMasternodePaymentRecord& record = vWinning[GetPaymentSlot(height)];
+
+            // the slot was taken by a newer block, this one is out of the ring
+            if (record.nBlockHeight > height)
+                return false;
+
             CMasternodePaymentWinner winner;
 
             winner.score = -1; /* We can't know this as we dont know the previous state */
             winner.nBlockHeight = height;
             winner.payee = out.scriptPubKey;
 
-            vWinning.erase(height);
-            vWinning.insert(make_pair(height, winner));
+            record.SetNull();
+
+            if (!record.SetWinner(winner))
+            {
+                LogPrint("masternode", "%s : non-standard payee %s in block %d\n", __func__,
+                         out.scriptPubKey.ToString(), height);
+                return false;
+            }
+
+            record.nVotes = 1;
+            nSyncMessagesHeight = -1;
             return true;
          }
       }
@@ -979,138 +1109,269 @@ bool CMasternodePayments::AddPastWinningMasternode(std::vector<CTransaction>& vt
 bool CMasternodePayments::AddWinningMasternode(CMasternodePaymentWinner& winnerIn, bool reorganize)
 {
     LOCK(cs_masternodes);
-    std::map<int, CMasternodePaymentWinner>::iterator winner = vWinning.find(winnerIn.nBlockHeight);
 
-    if (winner != vWinning.end() && winner->second.nBlockHeight == winnerIn.nBlockHeight)
+    if (winnerIn.nBlockHeight <= 0)
+        return false;
+
+    CMasternodePaymentRecord& record = vWinning[GetPaymentSlot(winnerIn.nBlockHeight)];
+
+    if (record.nBlockHeight == winnerIn.nBlockHeight)
     {
-        if (reorganize || winner->second.score <= winnerIn.score)
+        if (reorganize || record.score <= winnerIn.score)
         {
-            LogPrintf("%s : new masternode winner %s - replacing\n", __func__,
-                      reorganize ? "during reorganize" : "has an equal or higher score");
+            CMasternodePaymentRecord recordNew;
+
+            if (!recordNew.SetWinner(winnerIn))
+                return false;
+
+            // the same winner again counts as a vote for it
+            if (recordNew.vin == record.vin && recordNew.payee == record.payee)
+                recordNew.nVotes = record.nVotes + 1;
+            else
+            {
+                LogPrintf("%s : new masternode winner %s - replacing\n", __func__,
+                          reorganize ? "during reorganize" : "has an equal or higher score");
+                recordNew.nVotes = 1;
+            }
 
-            winner->second.score = winnerIn.score;
-            winner->second.vin = winnerIn.vin;
-            winner->second.payee = winnerIn.payee;
-            winner->second.vchSig = winnerIn.vchSig;
+            record = recordNew;
+            nSyncMessagesHeight = -1;
 
             return true;
         }
         else
             LogPrintf("%s : new masternode winner has a lower score - ignoring\n", __func__);
     }
-    else
+    else if (record.nBlockHeight < winnerIn.nBlockHeight)
     {
+        CMasternodePaymentRecord recordNew;
+
+        if (!recordNew.SetWinner(winnerIn))
+        {
+            LogPrintf("%s : non-standard payee for block %d - ignoring\n", __func__, winnerIn.nBlockHeight);
+            return false;
+        }
+
         LogPrintf("%s : adding block %d\n", __func__, winnerIn.nBlockHeight);
-        vWinning.insert(make_pair(winnerIn.nBlockHeight, winnerIn));
-        mapSeenMasternodeVotes.insert(make_pair(winnerIn.GetHash(), winnerIn));
+        recordNew.nVotes = 1;
+        record = recordNew;
+        nSyncMessagesHeight = -1;
+        AddSeenVote(winnerIn.GetHash(), winnerIn.nBlockHeight);
 
         return true;
     }
+    else
+        LogPrint("masternode", "%s : block %d is older than the payment list - ignoring\n", __func__,
+                 winnerIn.nBlockHeight);
 
     return false;
 }
 
-void CMasternodePayments::CleanPaymentList()
+void CMasternodePayments::CleanPaymentList(int nHeight)
 {
     LOCK(cs_masternodes);
 
-    if (pindexBest == nullptr)
-        return;
-
-    int nLimit = std::max(((int) vecMasternodes.size()) * 2, 1000);
+    // the records make room for newer ones by themselves, only the seen votes need forgetting
+    int nFirstHeight = nHeight - MASTERNODE_PAYMENTS_CACHE_BLOCKS;
+    std::map<uint256, int>::iterator it = mapSeenVotes.begin();
 
-    for (int i = 0; i < (int) vWinning.size() - nLimit; i++)
+    while (it != mapSeenVotes.end())
     {
-       int height = pindexBest->nHeight - vWinning.size() + i;
+        if (it->second < nFirstHeight)
+            mapSeenVotes.erase(it++);
+        else
+            ++it;
+    }
+}
+
+bool CMasternodePayments::HaveSeenVote(const uint256& hash) const
+{
+    LOCK(cs_masternodes);
+    return mapSeenVotes.count(hash);
+}
+
+void CMasternodePayments::AddSeenVote(const uint256& hash, int nBlockHeight)
+{
+    LOCK(cs_masternodes);
+    mapSeenVotes[hash] = nBlockHeight;
+}
 
-       if (vWinning.erase(height) > 0 && fDebug)
-           LogPrintf("%s : Removing old masternode payment block %d\n", __func__, height);
+bool CMasternodePayments::GetVoteMessage(const uint256& hash, CDataStream& ss) const
+{
+    LOCK(cs_masternodes);
+    std::map<uint256, int>::const_iterator it = mapSeenVotes.find(hash);
+
+    if (it == mapSeenVotes.end() || it->second <= 0)
+        return false;
+
+    const CMasternodePaymentRecord& record = vWinning[GetPaymentSlot(it->second)];
+
+    // only the vote that won is kept
+    if (record.nBlockHeight != it->second)
+        return false;
+
+    CMasternodePaymentWinner winner = record.GetWinner();
+
+    if (winner.GetHash() != hash)
+        return false;
+
+    int a = 0;
+    ss << winner << a;
+
+    return true;
+}
+
+unsigned int CMasternodePayments::GetRecordCount() const
+{
+    LOCK(cs_masternodes);
+    unsigned int nCount = 0;
+
+    for (const CMasternodePaymentRecord& record : vWinning)
+    {
+        if (!record.IsNull())
+            nCount++;
     }
+
+    return nCount;
+}
+
+unsigned int CMasternodePayments::GetSeenVoteCount() const
+{
+    LOCK(cs_masternodes);
+    return mapSeenVotes.size();
 }
 
 bool CMasternodePayments::ProcessBlock(int nBlockHeight, bool reorganize)
 {
-    CMasternodePaymentWinner winner;
+    return ProcessBlocks(nBlockHeight, 1, reorganize);
+}
+
+bool CMasternodePayments::ProcessBlocks(int nFirstHeight, int nCount, bool reorganize)
+{
+    if (pindexBest == NULL || nCount <= 0)
+        return false;
+
+    std::vector<CMasternodePaymentWinner> vWinners(nCount);
 
     {
         LOCK(cs_masternodes);
 
-        // scan for winner
-        unsigned int score = 0;
+        // the hash each block is scored against, looked up once rather than once per masternode
+        std::vector<uint256> vBlockHashes(nCount);
+        std::vector<bool> vHaveHash(nCount);
+
+        for (int i = 0; i < nCount; i++)
+        {
+            vHaveHash[i] = GetBlockHash(vBlockHashes[i], nFirstHeight + i - MASTERNODE_BLOCK_OFFSET);
+
+            if (!vHaveHash[i])
+                LogPrintf("%s : failed to get blockhash for block %d\n", __func__, nFirstHeight + i);
+        }
+
+        // scan for winners
+        std::vector<unsigned int> vScores(nCount, 0);
 
-        for (CMasternode mn : vecMasternodes)
+        for (CMasternode& mn : vecMasternodes)
         {
             mn.Check();
 
             if (!mn.IsEnabled())
                 continue;
 
-            // calculate the score for each masternode
-            uint256 nScore_256 = mn.CalculateScore(nBlockHeight);
-            unsigned int n2 = static_cast<unsigned int>(nScore_256.Get64());
-
-            // determine the winner
-            if (n2 > score)
+            for (int i = 0; i < nCount; i++)
             {
-                score = n2;
-                winner.score = n2;
-                winner.nBlockHeight = nBlockHeight;
-                winner.vin = mn.vin;
-                winner.payee = GetScriptForDestination(mn.pubkey.GetID());
+                if (!vHaveHash[i])
+                    continue;
+
+                // calculate the score for each masternode
+                uint256 nScore_256 = mn.CalculateScore(vBlockHashes[i]);
+                unsigned int n2 = static_cast<unsigned int>(nScore_256.Get64());
+
+                // determine the winner
+                if (n2 > vScores[i])
+                {
+                    vScores[i] = n2;
+                    vWinners[i].score = n2;
+                    vWinners[i].nBlockHeight = nFirstHeight + i;
+                    vWinners[i].vin = mn.vin;
+                    vWinners[i].payee = GetScriptForDestination(mn.pubkey.GetID());
+                }
             }
         }
-    }
 
-    // if we can't find someone to get paid, pick randomly
-    if (winner.nBlockHeight == 0 && vecMasternodes.size() > 0)
-    {
-        LogPrintf("%s : using random mn as winner\n", __func__);
-        winner.score = 0;
-        winner.nBlockHeight = nBlockHeight;
-        unsigned int nHeightOffset = nBlockHeight;
+        // if we can't find someone to get paid, pick randomly
+        for (int i = 0; i < nCount; i++)
+        {
+            if (vWinners[i].nBlockHeight != 0 || vecMasternodes.empty())
+                continue;
 
-        if (nHeightOffset > vecMasternodes.size() - 1)
-            nHeightOffset = (vecMasternodes.size() - 1) % nHeightOffset;
+            LogPrintf("%s : using random mn as winner\n", __func__);
+            vWinners[i].score = 0;
+            vWinners[i].nBlockHeight = nFirstHeight + i;
+            unsigned int nHeightOffset = nFirstHeight + i;
 
-        winner.vin = vecMasternodes[nHeightOffset].vin;
-        winner.payee = GetScriptForDestination(vecMasternodes[nHeightOffset].pubkey.GetID());
-    }
+            if (nHeightOffset > vecMasternodes.size() - 1)
+                nHeightOffset = (vecMasternodes.size() - 1) % nHeightOffset;
 
-    CTxDestination address1;
-    ExtractDestination(winner.payee, address1);
-    CBitcoinAddress address2(address1);
+            vWinners[i].vin = vecMasternodes[nHeightOffset].vin;
+            vWinners[i].payee = GetScriptForDestination(vecMasternodes[nHeightOffset].pubkey.GetID());
+        }
+    }
 
-    LogPrintf("%s : winner, payee=%s, nBlockHeight=%d\n", __func__,
-              address2.ToString(), nBlockHeight);
+    bool fAdded = false;
 
-    if (AddWinningMasternode(winner, reorganize))
+    for (CMasternodePaymentWinner& winner : vWinners)
     {
-        if (enabled)
-        {
-            LogPrintf("%s : signing winner\n", __func__);
+        if (winner.nBlockHeight == 0)
+            continue;
+
+        CTxDestination address1;
+        ExtractDestination(winner.payee, address1);
+        CBitcoinAddress address2(address1);
+
+        LogPrintf("%s : winner, payee=%s, nBlockHeight=%d\n", __func__,
+                  address2.ToString(), winner.nBlockHeight);
 
-            if (Sign(winner))
+        if (AddWinningMasternode(winner, reorganize))
+        {
+            if (enabled)
             {
-                LogPrintf("%s : relay winner\n", __func__);
-                Relay(winner);
+                LogPrintf("%s : signing winner\n", __func__);
+
+                if (Sign(winner))
+                {
+                    LogPrintf("%s : relay winner\n", __func__);
+                    Relay(winner);
+                }
             }
-        }
 
-        return true;
+            fAdded = true;
+        }
     }
 
-    return false;
+    return fAdded;
 }
 
 bool CMasternodePayments::ProcessManyBlocks(int nBlockHeight)
 {
-    if (vecMasternodes.empty())
+    if (vecMasternodes.empty() || pindexBest == NULL)
         return false;
 
-    for (int i = nBlockHeight + 1; i < nBlockHeight + 10; i++)
-        ProcessBlock(i);
+    {
+        LOCK(cs_masternodes);
+        uint256 hashTip = pindexBest->GetBlockHash();
+
+        // Already done for this tip, a block or a new masternode computes them again
+        if (hashTip == hashScoredTip && vecMasternodes.size() == nScoredMasternodes)
+            return true;
+
+        hashScoredTip = hashTip;
+        nScoredMasternodes = vecMasternodes.size();
+    }
+
+    ProcessBlocks(nBlockHeight + 1, 9);
 
-   return true;
+    return true;
 }
 
 void CMasternodePayments::Relay(CMasternodePaymentWinner& winner)
@@ -1127,16 +1388,34 @@ void CMasternodePayments::Relay(CMasternodePaymentWinner& winner)
 
 void CMasternodePayments::Sync(CNode* node)
 {
-    int a = 0;
+    if (pindexBest == NULL)
+        return;
+
+    LOCK(cs_masternodes);
+    int nHeight = pindexBest->nHeight;
 
-    for (auto winner : vWinning)
+    // The same answer for every peer until the tip or a winner changes
+    if (nSyncMessagesHeight != nHeight)
     {
-        if (winner.second.nBlockHeight >= pindexBest->nHeight - 10 &&
-            winner.second.nBlockHeight <= pindexBest->nHeight + 20)
+        vSyncMessages.clear();
+
+        for (int nBlockHeight = std::max(nHeight - 10, 1); nBlockHeight <= nHeight + 20; nBlockHeight++)
         {
-            node->PushMessage(NetMsgType::MASTERNODEPAYMENTVOTE, winner.second, a);
+            const CMasternodePaymentRecord& record = vWinning[GetPaymentSlot(nBlockHeight)];
+
+            if (record.nBlockHeight != nBlockHeight)
+                continue;
+
+            int a = 0;
+            vSyncMessages.push_back(CDataStream(SER_NETWORK, PROTOCOL_VERSION));
+            vSyncMessages.back() << record.GetWinner() << a;
         }
+
+        nSyncMessagesHeight = nHeight;
     }
+
+    for (const CDataStream& ss : vSyncMessages)
+        node->PushMessage(NetMsgType::MASTERNODEPAYMENTVOTE, ss);
 }
 
 bool CMasternodePayments::SetPrivKey(std::string strPrivKey)
@@ -1210,6 +1489,7 @@ void CMasternodeMan::CheckAndRemove()
                 LogPrintf("%s : removing inactive masternode %s - %s, reason: %d\n", __func__,
                           (*it).addr.ToString().c_str(), (*it).vin.prevout.hash.ToString(), (*it).nActiveState);
 
+                collateralWatcher.Unwatch((*it).vin.prevout);
                 it = vecMasternodes.erase(it);
             }
             else
@@ -1235,15 +1515,74 @@ void CMasternodeMan::CheckAndRemove()
             else
                 ++it1;
         }
+
+        // forget seen broadcasts after a while, a late copy is simply verified again
+        int64_t nCutOff = GetTime() - MASTERNODE_REMOVAL_SECONDS;
+        std::map<uint256, int64_t>* maps[] = { &mapSeenMasternodeBroadcast, &mapRejectedMasternodeBroadcast };
+
+        for (std::map<uint256, int64_t>* pmap : maps)
+        {
+            auto it2 = pmap->begin();
+
+            while (it2 != pmap->end())
+            {
+                if ((*it2).second < nCutOff)
+                    pmap->erase(it2++);
+                else
+                    ++it2;
+            }
+        }
     }
 
     LogPrintf("%s : finished\n", __func__);
 }
 
+CMasternodeMan::CMasternodeMan()
+{
+    memset(&messageStats, 0, sizeof(messageStats));
+}
+
+bool CMasternodeMan::HaveSeenBroadcast(const uint256& hash) const
+{
+    LOCK(cs);
+    return mapSeenMasternodeBroadcast.count(hash);
+}
+
+void CMasternodeMan::AddSeenBroadcast(const uint256& hash)
+{
+    LOCK(cs);
+    mapSeenMasternodeBroadcast[hash] = GetTime();
+}
+
+bool CMasternodeMan::HaveRejectedBroadcast(const uint256& hash) const
+{
+    LOCK(cs);
+    return mapRejectedMasternodeBroadcast.count(hash);
+}
+
+void CMasternodeMan::AddRejectedBroadcast(const uint256& hash)
+{
+    LOCK(cs);
+    mapRejectedMasternodeBroadcast[hash] = GetTime();
+}
+
+void CMasternodeMan::CountMessage(uint64_t CMasternodeMessageStats::*pCounter, uint64_t nCount)
+{
+    LOCK(cs);
+    messageStats.*pCounter += nCount;
+}
+
+CMasternodeMessageStats CMasternodeMan::GetMessageStats() const
+{
+    LOCK(cs);
+    return messageStats;
+}
+
 void CMasternodeMan::Clear()
 {
     LOCK(cs_masternodes);
     vecMasternodes.clear();
+    collateralWatcher.Clear();
 }
 
 int CMasternodeMan::CountEnabled(int protocolVersion)
@@ -51,6 +51,7 @@ class uint256;
 #define MASTERNODE_DSEG_SECONDS                (5*60) // 5 minutes
 
 #define MASTERNODE_BLOCK_OFFSET                50
+#define MASTERNODE_PAYMENTS_CACHE_BLOCKS       1000 // winners kept, by block height
 
 using namespace std;
 
@@ -61,7 +62,6 @@ extern std::vector<CMasternode> vecMasternodes;
 extern CMasternodePayments masternodePayments;
 extern CMasternodeMan mnodeman;
 extern std::vector<CTxIn> vecMasternodeAskedFor;
-extern map<uint256, CMasternodePaymentWinner> mapSeenMasternodeVotes;
 extern map<int64_t, uint256> mapCacheBlockHashes;
 
 // manage the masternode connections
@@ -127,6 +127,7 @@ public:
     }
 
     uint256 CalculateScore(unsigned int nBlockHeight);
+    uint256 CalculateScore(const uint256& hashBlock) const;
 
     void UpdateLastSeen(int64_t override=0)
     {
@@ -211,7 +212,7 @@ public:
         payee = CScript();
     }
 
-    uint256 GetHash(){
+    uint256 GetHash() const {
         uint256 n2 = Hash(BEGIN(nBlockHeight), END(nBlockHeight));
         uint256 n3 = vin.prevout.hash > n2 ? (vin.prevout.hash - n2) : (n2 - vin.prevout.hash);
 
@@ -242,10 +243,45 @@ public:
 
 };
 
+// the winner of one block, as kept by CMasternodePayments
+class CMasternodePaymentRecord
+{
+public:
+    int nBlockHeight; // 0 for an empty slot
+    CTxIn vin;
+    CTxDestination payee;
+    uint64_t score;
+    unsigned int nVotes; // times this winner was computed or voted for
+    std::vector<unsigned char> vchSig;
+
+    CMasternodePaymentRecord()
+    {
+        SetNull();
+    }
+
+    void SetNull();
+    bool IsNull() const { return nBlockHeight == 0; }
+
+    // false if the payee isn't a script GetScriptForDestination() gives back
+    bool SetWinner(const CMasternodePaymentWinner& winner);
+    CMasternodePaymentWinner GetWinner() const;
+    CScript GetPayee() const;
+};
+
 class CMasternodePayments
 {
 private:
-    std::map<int, CMasternodePaymentWinner> vWinning;
+    // ring of MASTERNODE_PAYMENTS_CACHE_BLOCKS records indexed by block height, a newer height
+    // takes the slot of an older one; guarded by cs_masternodes like everything below
+    std::vector<CMasternodePaymentRecord> vWinning;
+    // hashes of the mnw votes seen, with their block height, forgotten once out of the ring
+    std::map<uint256, int> mapSeenVotes;
+    // what ProcessManyBlocks last computed winners for
+    uint256 hashScoredTip;
+    unsigned int nScoredMasternodes;
+    // mnget answer, serialized once per tip and after winners change
+    std::vector<CDataStream> vSyncMessages;
+    int nSyncMessagesHeight;
     int nSyncedFromPeer;
     std::string strMasterPrivKey;
     std::string strTestPubKey;
@@ -263,6 +299,10 @@ public:
       }
 
         enabled = false;
+        vWinning.resize(MASTERNODE_PAYMENTS_CACHE_BLOCKS);
+        hashScoredTip = 0;
+        nScoredMasternodes = 0;
+        nSyncMessagesHeight = -1;
     }
 
     bool SetPrivKey(std::string strPrivKey);
@@ -279,24 +319,69 @@ public:
     bool AddPastWinningMasternode(std::vector<CTransaction>& vtx, int64_t amount, int height);
     bool AddWinningMasternode(CMasternodePaymentWinner& winner, bool reorganize=false);
     bool ProcessBlock(int nBlockHeight, bool reorganize=false);
+
+    // Winners of nCount blocks from nFirstHeight, scored in one pass over the masternodes
+    bool ProcessBlocks(int nFirstHeight, int nCount, bool reorganize=false);
+
+    // The next blocks after nBlockHeight, once per tip while the list doesn't change
     bool ProcessManyBlocks(int nBlockHeight);
     void Relay(CMasternodePaymentWinner& winner);
     void Sync(CNode* node);
-    void CleanPaymentList();
+    void CleanPaymentList(int nHeight);
     int LastPayment(CMasternode& mn);
 
+    bool HaveSeenVote(const uint256& hash) const;
+    void AddSeenVote(const uint256& hash, int nBlockHeight);
+
+    // the mnw message for a vote we have, to answer getdata
+    bool GetVoteMessage(const uint256& hash, CDataStream& ss) const;
+
+    // for tests and stats
+    unsigned int GetRecordCount() const;
+    unsigned int GetSeenVoteCount() const;
+
     //slow
     bool GetBlockPayee(int nBlockHeight, CScript& payee);
 };
 
 
+/** Counters for dsee/dseep handling, reported by "masternode stats" */
+struct CMasternodeMessageStats
+{
+    uint64_t nDseeReceived;
+    uint64_t nDseeDuplicate;      // already verified broadcasts, signature check skipped
+    uint64_t nDseeRejectedCached; // broadcasts dropped because they were rejected before
+    uint64_t nDseeVerified;       // signatures actually checked
+    uint64_t nDseeNew;            // new masternodes added to the list
+    uint64_t nDseepReceived;
+    uint64_t nDseepDuplicate;     // pings not newer than the last one, dropped before verifying
+    uint64_t nDseepVerified;
+    uint64_t nListSummariesSent;  // getmnlsum answered
+    uint64_t nListEntriesSent;    // dsee sent for getmnents
+};
+
 class CMasternodeMan
 {
 private:
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
 
+    // hashes of (vin, signed message, signature) for dsee broadcasts that were
+    // verified, or rejected for a bad signature, mapped to the time they were added
+    std::map<uint256, int64_t> mapSeenMasternodeBroadcast;
+    std::map<uint256, int64_t> mapRejectedMasternodeBroadcast;
+    CMasternodeMessageStats messageStats;
+
 public:
+    CMasternodeMan();
+
+    bool HaveSeenBroadcast(const uint256& hash) const;
+    void AddSeenBroadcast(const uint256& hash);
+    bool HaveRejectedBroadcast(const uint256& hash) const;
+    void AddRejectedBroadcast(const uint256& hash);
+    void CountMessage(uint64_t CMasternodeMessageStats::*pCounter, uint64_t nCount = 1);
+    CMasternodeMessageStats GetMessageStats() const;
+
     /// Ask (source) node for mnb
     void AskForMN(CNode* pnode, CTxIn& vin);
 
@@ -0,0 +1,227 @@
+// Copyright (c) 2016-2020 The Neutron Developers
+//
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternodecollateral.h"
+#include "txdb.h"
+#include "txmempool.h"
+#include "util.h"
+
+#include <boost/foreach.hpp>
+
+using namespace std;
+
+CMasternodeCollateralWatcher collateralWatcher;
+
+// An output the tx index doesn't know counts as spent, like a missing input would
+static bool IsSpentInChain(const COutPoint& outpoint)
+{
+    CTxDB txdb("r");
+    CTxIndex txindex;
+
+    if (!txdb.ReadTxIndex(outpoint.hash, txindex))
+        return true;
+
+    if (outpoint.n >= txindex.vSpent.size())
+        return true;
+
+    return !txindex.vSpent[outpoint.n].IsNull();
+}
+
+static bool IsSpentInMempool(const COutPoint& outpoint)
+{
+    LOCK(mempool.cs);
+    return mempool.mapNextTx.count(outpoint) != 0;
+}
+
+CMasternodeCollateralWatcher::CMasternodeCollateralWatcher()
+{
+    nEvents = 0;
+}
+
+bool CMasternodeCollateralWatcher::Watch(const COutPoint& outpoint)
+{
+    {
+        LOCK(cs);
+        map<COutPoint, CCollateralState>::iterator it = mapWatched.find(outpoint);
+
+        if (it != mapWatched.end() && it->second.fInitialized)
+            return it->second.fSpentInChain || it->second.fSpentInMempool;
+
+        CCollateralState& state = mapWatched[outpoint];
+        state.fInitialized = false;
+        state.fChainTouched = false;
+        state.fMempoolTouched = false;
+        state.fSpentInChain = false;
+        state.fSpentInMempool = false;
+    }
+
+    // The lookups run without cs, events arriving meanwhile take precedence
+    bool fSpentInChain = IsSpentInChain(outpoint);
+    bool fSpentInMempool = IsSpentInMempool(outpoint);
+
+    LOCK(cs);
+    map<COutPoint, CCollateralState>::iterator it = mapWatched.find(outpoint);
+
+    // Unwatched while we were looking
+    if (it == mapWatched.end())
+        return fSpentInChain || fSpentInMempool;
+
+    CCollateralState& state = it->second;
+
+    if (!state.fChainTouched)
+        state.fSpentInChain = fSpentInChain;
+
+    if (!state.fMempoolTouched)
+        state.fSpentInMempool = fSpentInMempool;
+
+    state.fInitialized = true;
+
+    return state.fSpentInChain || state.fSpentInMempool;
+}
+
+void CMasternodeCollateralWatcher::Unwatch(const COutPoint& outpoint)
+{
+    LOCK(cs);
+    mapWatched.erase(outpoint);
+}
+
+void CMasternodeCollateralWatcher::Clear()
+{
+    LOCK(cs);
+    mapWatched.clear();
+}
+
+bool CMasternodeCollateralWatcher::GetSpent(const COutPoint& outpoint, bool& fSpent) const
+{
+    LOCK(cs);
+    map<COutPoint, CCollateralState>::const_iterator it = mapWatched.find(outpoint);
+
+    if (it == mapWatched.end() || !it->second.fInitialized)
+        return false;
+
+    fSpent = it->second.fSpentInChain || it->second.fSpentInMempool;
+
+    return true;
+}
+
+// requires cs
+void CMasternodeCollateralWatcher::UpdateChain(const CTransaction& tx, bool fConnect)
+{
+    map<COutPoint, CCollateralState>::iterator it;
+
+    // Inputs are spent by a connect and become available again on a disconnect
+    BOOST_FOREACH(const CTxIn& txin, tx.vin)
+    {
+        it = mapWatched.find(txin.prevout);
+
+        if (it != mapWatched.end())
+        {
+            it->second.fSpentInChain = fConnect;
+            it->second.fChainTouched = true;
+            nEvents++;
+        }
+    }
+
+    // Outputs of a disconnected transaction are gone until it confirms again
+    uint256 hash = tx.GetHash();
+
+    for (unsigned int i = 0; i < tx.vout.size(); i++)
+    {
+        it = mapWatched.find(COutPoint(hash, i));
+
+        if (it != mapWatched.end())
+        {
+            it->second.fSpentInChain = !fConnect;
+            it->second.fChainTouched = true;
+            nEvents++;
+        }
+    }
+}
+
+void CMasternodeCollateralWatcher::TransactionsConnected(const vector<CTransaction>& vtx)
+{
+    LOCK(cs);
+
+    if (mapWatched.empty())
+        return;
+
+    for (unsigned int i = 0; i < vtx.size(); i++)
+        UpdateChain(vtx[i], true);
+}
+
+void CMasternodeCollateralWatcher::TransactionsDisconnected(const vector<CTransaction>& vtx)
+{
+    LOCK(cs);
+
+    if (mapWatched.empty())
+        return;
+
+    // Undo in reverse, a transaction spending an output of an earlier one comes off first
+    for (int i = vtx.size() - 1; i >= 0; i--)
+        UpdateChain(vtx[i], false);
+}
+
+void CMasternodeCollateralWatcher::TransactionAddedToMempool(const CTransaction& tx)
+{
+    LOCK(cs);
+
+    if (mapWatched.empty())
+        return;
+
+    BOOST_FOREACH(const CTxIn& txin, tx.vin)
+    {
+        map<COutPoint, CCollateralState>::iterator it = mapWatched.find(txin.prevout);
+
+        if (it != mapWatched.end())
+        {
+            it->second.fSpentInMempool = true;
+            it->second.fMempoolTouched = true;
+            nEvents++;
+        }
+    }
+}
+
+void CMasternodeCollateralWatcher::TransactionRemovedFromMempool(const CTransaction& tx)
+{
+    LOCK(cs);
+
+    if (mapWatched.empty())
+        return;
+
+    BOOST_FOREACH(const CTxIn& txin, tx.vin)
+    {
+        map<COutPoint, CCollateralState>::iterator it = mapWatched.find(txin.prevout);
+
+        if (it != mapWatched.end())
+        {
+            it->second.fSpentInMempool = false;
+            it->second.fMempoolTouched = true;
+            nEvents++;
+        }
+    }
+}
+
+void CMasternodeCollateralWatcher::MempoolCleared()
+{
+    LOCK(cs);
+
+    for (map<COutPoint, CCollateralState>::iterator it = mapWatched.begin(); it != mapWatched.end(); it++)
+    {
+        it->second.fSpentInMempool = false;
+        it->second.fMempoolTouched = true;
+    }
+}
+
+unsigned int CMasternodeCollateralWatcher::size() const
+{
+    LOCK(cs);
+    return mapWatched.size();
+}
+
+uint64_t CMasternodeCollateralWatcher::GetEventCount() const
+{
+    LOCK(cs);
+    return nEvents;
+}
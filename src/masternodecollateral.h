@@ -0,0 +1,70 @@
+// Copyright (c) 2016-2020 The Neutron Developers
+//
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NEUTRON_MASTERNODECOLLATERAL_H
+#define NEUTRON_MASTERNODECOLLATERAL_H
+
+#include "main.h"
+#include "sync.h"
+
+#include <map>
+#include <vector>
+
+/**
+ * Tracks whether masternode collateral outputs are spent.
+ *
+ * An outpoint is looked up once in the tx index and the mempool when it is
+ * first watched; after that its state follows block connects/disconnects
+ * (after they have been committed) and mempool adds/removals, so
+ * CMasternode::Check doesn't have to re-validate the collateral input on
+ * every pass.
+ *
+ * cs is a leaf lock: it is taken under cs_main and mempool.cs and nothing is
+ * called while holding it.
+ */
+class CMasternodeCollateralWatcher
+{
+private:
+    struct CCollateralState
+    {
+        bool fInitialized;      // initial lookup done, GetSpent may answer
+        bool fChainTouched;     // a block event arrived while the initial lookup was running
+        bool fMempoolTouched;   // a mempool event arrived while the initial lookup was running
+        bool fSpentInChain;     // spent by, or (after a disconnect) missing from, the best chain
+        bool fSpentInMempool;
+    };
+
+    mutable CCriticalSection cs;
+    std::map<COutPoint, CCollateralState> mapWatched;
+    uint64_t nEvents;
+
+    void UpdateChain(const CTransaction& tx, bool fConnect);
+
+public:
+    CMasternodeCollateralWatcher();
+
+    /** Start tracking outpoint, does the initial lookup. Returns whether it is spent */
+    bool Watch(const COutPoint& outpoint);
+    void Unwatch(const COutPoint& outpoint);
+    void Clear();
+
+    /** Returns false if outpoint isn't watched (yet) */
+    bool GetSpent(const COutPoint& outpoint, bool& fSpent) const;
+
+    /** Transactions of blocks that became part of / left the best chain, in that order */
+    void TransactionsConnected(const std::vector<CTransaction>& vtx);
+    void TransactionsDisconnected(const std::vector<CTransaction>& vtx);
+
+    void TransactionAddedToMempool(const CTransaction& tx);
+    void TransactionRemovedFromMempool(const CTransaction& tx);
+    void MempoolCleared();
+
+    unsigned int size() const;
+    uint64_t GetEventCount() const;
+};
+
+extern CMasternodeCollateralWatcher collateralWatcher;
+
+#endif // NEUTRON_MASTERNODECOLLATERAL_H
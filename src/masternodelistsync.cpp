@@ -0,0 +1,288 @@
+// Copyright (c) 2016-2020 The Neutron Developers
+//
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternodelistsync.h"
+#include "hash.h"
+#include "masternode.h"
+#include "net.h"
+#include "protocol.h"
+#include "util.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <sstream>
+
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+
+using namespace std;
+
+void CMasternodeListSummary::SetNull()
+{
+    hashRoot = 0;
+    nCount = 0;
+    vBucketHashes.clear();
+    vBuckets.clear();
+}
+
+uint256 CMasternodeListSummary::GetEntryHash(const CMasternode& mn)
+{
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << mn.vin << mn.addr << mn.pubkey << mn.pubkey2 << mn.sig << mn.now << mn.protocolVersion;
+
+    return ss.GetHash();
+}
+
+int CMasternodeListSummary::GetBucket(const COutPoint& outpoint)
+{
+    return (outpoint.hash.GetLow64() + outpoint.n) % MNLIST_SYNC_BUCKETS;
+}
+
+void CMasternodeListSummary::Build(const vector<CMasternode>& vMasternodes)
+{
+    SetNull();
+    vBuckets.resize(MNLIST_SYNC_BUCKETS);
+    vBucketHashes.resize(MNLIST_SYNC_BUCKETS);
+
+    BOOST_FOREACH(const CMasternode& mn, vMasternodes)
+    {
+        // What dseg would send
+        if (mn.nActiveState != CMasternode::MASTERNODE_ENABLED || mn.addr.IsRFC1918())
+            continue;
+
+        vBuckets[GetBucket(mn.vin.prevout)].push_back(CMasternodeListEntryRef(mn.vin.prevout, mn.now,
+                                                                              GetEntryHash(mn)));
+        nCount++;
+    }
+
+    CHashWriter ssRoot(SER_GETHASH, 0);
+
+    for (int i = 0; i < MNLIST_SYNC_BUCKETS; i++)
+    {
+        sort(vBuckets[i].begin(), vBuckets[i].end());
+
+        // Empty buckets stay 0, most of them are on a small network
+        if (!vBuckets[i].empty())
+        {
+            CHashWriter ss(SER_GETHASH, 0);
+            ss << vBuckets[i];
+            vBucketHashes[i] = ss.GetHash();
+        }
+
+        ssRoot << vBucketHashes[i];
+    }
+
+    hashRoot = ssRoot.GetHash();
+}
+
+vector<int> CMasternodeListSummary::GetDifferentBuckets(const vector<uint256>& vOtherBucketHashes) const
+{
+    vector<int> vDifferent;
+
+    for (int i = 0; i < (int) vBucketHashes.size(); i++)
+    {
+        if (vOtherBucketHashes.size() != vBucketHashes.size() || vOtherBucketHashes[i] != vBucketHashes[i])
+            vDifferent.push_back(i);
+    }
+
+    return vDifferent;
+}
+
+vector<CMasternodeListEntryRef> CMasternodeListSummary::GetEntries(const vector<int>& vBucketIndexes) const
+{
+    vector<CMasternodeListEntryRef> vEntries;
+
+    BOOST_FOREACH(int i, vBucketIndexes)
+    {
+        if (i >= 0 && i < (int) vBuckets.size())
+            vEntries.insert(vEntries.end(), vBuckets[i].begin(), vBuckets[i].end());
+    }
+
+    return vEntries;
+}
+
+vector<COutPoint> CMasternodeListSummary::GetNeeded(const vector<CMasternodeListEntryRef>& vRemote) const
+{
+    vector<COutPoint> vNeeded;
+
+    BOOST_FOREACH(const CMasternodeListEntryRef& ref, vRemote)
+    {
+        if (vBuckets.empty())
+        {
+            vNeeded.push_back(ref.outpoint);
+            continue;
+        }
+
+        const vector<CMasternodeListEntryRef>& vBucket = vBuckets[GetBucket(ref.outpoint)];
+        vector<CMasternodeListEntryRef>::const_iterator it = lower_bound(vBucket.begin(), vBucket.end(), ref);
+
+        // Missing, or the peer has a newer broadcast. Ours being newer, it will get it from us.
+        if (it == vBucket.end() || it->outpoint != ref.outpoint || (it->hash != ref.hash && it->sigTime < ref.sigTime))
+            vNeeded.push_back(ref.outpoint);
+    }
+
+    return vNeeded;
+}
+
+CMasternodeListSummary GetMasternodeListSummary()
+{
+    CMasternodeListSummary summary;
+
+    LOCK(cs_masternodes);
+    summary.Build(vecMasternodes);
+
+    return summary;
+}
+
+void RequestMasternodeList(CNode* pnode, const CMasternodeListSummary& summary)
+{
+    if (pnode->nMasternodeListSyncVersion >= 1 && summary.nCount > 0)
+        pnode->PushMessage(NetMsgType::GETMNLISTSUM, summary.hashRoot);
+    else
+        pnode->PushMessage(NetMsgType::DSEG, CTxIn()); // request full mn list
+}
+
+void PushMasternodeListSyncVersion(CNode* pnode)
+{
+    pnode->PushMessage(NetMsgType::MNLISTVERSION, MNLIST_SYNC_VERSION);
+}
+
+bool ProcessMessageMasternodeList(CNode* pfrom, const string& strCommand, CDataStream& vRecv)
+{
+    if (strCommand == NetMsgType::MNLISTVERSION)
+    {
+        int nVersion;
+        vRecv >> nVersion;
+
+        pfrom->nMasternodeListSyncVersion = min(nVersion, MNLIST_SYNC_VERSION);
+    }
+    else if (strCommand == NetMsgType::GETMNLISTSUM) // Compare lists, the peer sent its root
+    {
+        uint256 hashRootPeer;
+        vRecv >> hashRootPeer;
+
+        CMasternodeListSummary summary = GetMasternodeListSummary();
+        mnodeman.CountMessage(&CMasternodeMessageStats::nListSummariesSent);
+
+        // The bucket hashes only if they are needed
+        if (hashRootPeer == summary.hashRoot)
+            pfrom->PushMessage(NetMsgType::MNLISTSUM, summary.hashRoot, summary.nCount, vector<uint256>());
+        else
+            pfrom->PushMessage(NetMsgType::MNLISTSUM, summary.hashRoot, summary.nCount, summary.vBucketHashes);
+    }
+    else if (strCommand == NetMsgType::MNLISTSUM)
+    {
+        uint256 hashRootPeer;
+        unsigned int nCountPeer;
+        vector<uint256> vBucketHashesPeer;
+        vRecv >> hashRootPeer >> nCountPeer >> vBucketHashesPeer;
+
+        // Only answers to our own requests
+        if (!pfrom->HasFulfilledRequest("mnsync"))
+            return true;
+
+        CMasternodeListSummary summary = GetMasternodeListSummary();
+
+        if (hashRootPeer == summary.hashRoot || vBucketHashesPeer.empty())
+        {
+            LogPrint("masternode", "%s : mnlsum - list of %d entries matches peer=%d\n", __func__, summary.nCount,
+                     pfrom->id);
+            return true;
+        }
+
+        vector<int> vBuckets = summary.GetDifferentBuckets(vBucketHashesPeer);
+
+        LogPrint("masternode", "%s : mnlsum - %d of %d buckets differ, %d entries here, %d at peer=%d\n", __func__,
+                 vBuckets.size(), MNLIST_SYNC_BUCKETS, summary.nCount, nCountPeer, pfrom->id);
+
+        // Too far apart, the whole list is cheaper
+        if ((int) vBuckets.size() > MNLIST_SYNC_FULL_BUCKETS)
+            pfrom->PushMessage(NetMsgType::DSEG, CTxIn());
+        else
+            pfrom->PushMessage(NetMsgType::GETMNLISTBUCKETS, vBuckets);
+    }
+    else if (strCommand == NetMsgType::GETMNLISTBUCKETS) // Entries of some buckets
+    {
+        vector<int> vBuckets;
+        vRecv >> vBuckets;
+
+        if (vBuckets.size() > (unsigned int) MNLIST_SYNC_BUCKETS)
+        {
+            std::stringstream msg;
+            msg << boost::format("%s : getmnlbkts - asked for %u buckets") % __func__ % vBuckets.size();
+
+            LogPrintf("%s\n", msg.str().c_str());
+            pfrom->Misbehaving(msg.str(), 20);
+            return true;
+        }
+
+        CMasternodeListSummary summary = GetMasternodeListSummary();
+        pfrom->PushMessage(NetMsgType::MNLISTBUCKETS, summary.GetEntries(vBuckets));
+    }
+    else if (strCommand == NetMsgType::MNLISTBUCKETS)
+    {
+        vector<CMasternodeListEntryRef> vEntries;
+        vRecv >> vEntries;
+
+        if (!pfrom->HasFulfilledRequest("mnsync"))
+            return true;
+
+        vector<COutPoint> vNeeded = GetMasternodeListSummary().GetNeeded(vEntries);
+
+        if (vNeeded.size() > MNLIST_SYNC_MAX_ENTRIES)
+            vNeeded.resize(MNLIST_SYNC_MAX_ENTRIES);
+
+        LogPrint("masternode", "%s : mnlbkts - asking for %d of %d entries from peer=%d\n", __func__,
+                 vNeeded.size(), vEntries.size(), pfrom->id);
+
+        if (!vNeeded.empty())
+            pfrom->PushMessage(NetMsgType::GETMNENTRIES, vNeeded);
+    }
+    else if (strCommand == NetMsgType::GETMNENTRIES) // Entries by collateral, answered with dsee
+    {
+        vector<COutPoint> vOutpoints;
+        vRecv >> vOutpoints;
+
+        if (vOutpoints.size() > MNLIST_SYNC_MAX_ENTRIES)
+        {
+            std::stringstream msg;
+            msg << boost::format("%s : getmnents - asked for %u entries") % __func__ % vOutpoints.size();
+
+            LogPrintf("%s\n", msg.str().c_str());
+            pfrom->Misbehaving(msg.str(), 20);
+            return true;
+        }
+
+        // One pass over the list, not one per entry as for single dseg requests
+        set<COutPoint> setOutpoints(vOutpoints.begin(), vOutpoints.end());
+        int nSent = 0;
+
+        LOCK(cs_masternodes);
+        int count = vecMasternodes.size();
+        int i = 0;
+
+        BOOST_FOREACH(const CMasternode& mn, vecMasternodes)
+        {
+            if (setOutpoints.count(mn.vin.prevout) && !mn.addr.IsRFC1918())
+            {
+                pfrom->PushMessage(NetMsgType::DSEE, mn.vin, mn.addr, mn.sig, mn.now, mn.pubkey, mn.pubkey2,
+                                   count, i, mn.lastTimeSeen, mn.protocolVersion);
+                nSent++;
+            }
+
+            i++;
+        }
+
+        mnodeman.CountMessage(&CMasternodeMessageStats::nListEntriesSent, nSent);
+
+        LogPrint("masternode", "%s : getmnents - sent %d of %d asked entries to peer=%d\n", __func__, nSent,
+                 vOutpoints.size(), pfrom->id);
+    }
+    else
+        return false;
+
+    return true;
+}
@@ -0,0 +1,114 @@
+// Copyright (c) 2016-2020 The Neutron Developers
+//
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NEUTRON_MASTERNODELISTSYNC_H
+#define NEUTRON_MASTERNODELISTSYNC_H
+
+#include "main.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <string>
+#include <vector>
+
+class CDataStream;
+class CMasternode;
+class CNode;
+
+/** Version of the list sync messages we speak, announced with mnlistver */
+static const int MNLIST_SYNC_VERSION = 1;
+/** The list is split into this many buckets by collateral outpoint */
+static const int MNLIST_SYNC_BUCKETS = 256;
+/** With more buckets than this differing, the whole list is asked for with dseg instead */
+static const int MNLIST_SYNC_FULL_BUCKETS = MNLIST_SYNC_BUCKETS / 2;
+/** Most entries one getmnents may ask for */
+static const unsigned int MNLIST_SYNC_MAX_ENTRIES = 10000;
+
+/** What a peer needs to know about an entry to tell whether it has the same one */
+class CMasternodeListEntryRef
+{
+public:
+    COutPoint outpoint;
+    int64_t sigTime;
+    uint256 hash;
+
+    CMasternodeListEntryRef() : sigTime(0) {}
+    CMasternodeListEntryRef(const COutPoint& outpointIn, int64_t sigTimeIn, const uint256& hashIn) :
+        outpoint(outpointIn), sigTime(sigTimeIn), hash(hashIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        unsigned int nSerSize = 0;
+        READWRITE(outpoint);
+        READWRITE(sigTime);
+        READWRITE(hash);
+    }
+
+    bool operator<(const CMasternodeListEntryRef& other) const { return outpoint < other.outpoint; }
+};
+
+/**
+ * Hashes over the enabled, publicly reachable masternodes, the ones dseg
+ * sends.
+ *
+ * Entries are hashed over their signed broadcast (not the last seen times,
+ * dseep keeps those current), put in buckets by collateral outpoint and
+ * sorted within each bucket. A bucket hashes its sorted entries, the root
+ * hashes the buckets. Two peers with the same root have the same list; if
+ * not, the bucket hashes tell which parts to compare entry by entry.
+ */
+class CMasternodeListSummary
+{
+public:
+    uint256 hashRoot;
+    unsigned int nCount;
+    std::vector<uint256> vBucketHashes;
+    std::vector<std::vector<CMasternodeListEntryRef> > vBuckets;
+
+    CMasternodeListSummary()
+    {
+        SetNull();
+    }
+
+    void SetNull();
+
+    /** Requires cs_masternodes if vMasternodes is vecMasternodes */
+    void Build(const std::vector<CMasternode>& vMasternodes);
+
+    /** Buckets whose hash isn't the one in vOtherBucketHashes, all of them if the sizes differ */
+    std::vector<int> GetDifferentBuckets(const std::vector<uint256>& vOtherBucketHashes) const;
+
+    std::vector<CMasternodeListEntryRef> GetEntries(const std::vector<int>& vBucketIndexes) const;
+
+    /** Outpoints of the remote entries we don't have, or have an older broadcast of */
+    std::vector<COutPoint> GetNeeded(const std::vector<CMasternodeListEntryRef>& vRemote) const;
+
+    static uint256 GetEntryHash(const CMasternode& mn);
+    static int GetBucket(const COutPoint& outpoint);
+};
+
+/** Summary of vecMasternodes */
+CMasternodeListSummary GetMasternodeListSummary();
+
+/**
+ * Asks pnode for the masternode list: by comparing summaries if it announced
+ * the list sync protocol and we have a list, with a full dseg otherwise.
+ */
+void RequestMasternodeList(CNode* pnode, const CMasternodeListSummary& summary);
+
+/** Announces the list sync protocol, sent with verack */
+void PushMasternodeListSyncVersion(CNode* pnode);
+
+/**
+ * Handles mnlistver, getmnlsum, mnlsum, getmnlbkts, mnlbkts and getmnents,
+ * returns false for any other command. These only read the list, they are
+ * answered during initial block download too.
+ */
+bool ProcessMessageMasternodeList(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv);
+
+#endif // NEUTRON_MASTERNODELISTSYNC_H
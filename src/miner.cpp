@@ -9,6 +9,7 @@
 #include "txdb.h"
 #include "miner.h"
 #include "kernel.h"
+#include "runtimeconfig.h"
 #include "utiltime.h"
 #include "script/standard.h"
 
@@ -153,20 +154,17 @@ CBlock* CreateNewBlock(CWallet* pwallet, bool fProofOfStake, int64_t* pFees)
     pblock->vtx.push_back(txNew);
 
     // Largest block you're willing to create:
-    unsigned int nBlockMaxSize = GetArg("-blockmaxsize", MAX_BLOCK_SIZE_GEN / 2);
-
-    // Limit to betweeen 1K and MAX_BLOCK_SIZE-1K for sanity
-    nBlockMaxSize = std::max((unsigned int) 1000, std::min((unsigned int)(MAX_BLOCK_SIZE - 1000),
-                             nBlockMaxSize));
+    // Between 1K and MAX_BLOCK_SIZE-1K for sanity, the option's range
+    unsigned int nBlockMaxSize = configBlockMaxSize.GetInt();
 
     // How much of the block should be dedicated to high-priority transactions,
     // included regardless of the fees they pay
-    unsigned int nBlockPrioritySize = GetArg("-blockprioritysize", 27000);
+    unsigned int nBlockPrioritySize = configBlockPrioritySize.GetInt();
     nBlockPrioritySize = std::min(nBlockMaxSize, nBlockPrioritySize);
 
     // Minimum block size you want to create; block will be filled with free transactions
     // until there are no more or the block reaches this size:
-    unsigned int nBlockMinSize = GetArg("-blockminsize", 0);
+    unsigned int nBlockMinSize = configBlockMinSize.GetInt();
     nBlockMinSize = std::min(nBlockMaxSize, nBlockMinSize);
 
     // Fee-per-kilobyte amount considered the same as "free"
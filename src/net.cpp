@@ -12,6 +12,7 @@
 #include "init.h"
 #include "miner.h"
 #include "netbase.h"
+#include "runtimeconfig.h"
 #include "strlcpy.h"
 #include "wallet.h"
 #include "ui_interface.h"
@@ -763,7 +764,7 @@ bool CNode::Misbehaving(std::string cause, int howmuch)
         misbehaviors.push_back(Misbehavior(GetTime(), howmuch, cause));
     }
 
-    if (nMisbehavior >= GetArg("-banscore", 100))
+    if (nMisbehavior >= configBanScore.GetInt())
     {
         LogPrintf("%s : [WARNING] %s (%d -> %d, cause: %s) DISCONNECTING\n", __func__, addr.ToString().c_str(),
                   nMisbehavior - howmuch, nMisbehavior, cause.c_str());
@@ -824,6 +825,7 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes)
 
         if (msg.complete())
         {
+            RecordRecvBytesPerMsgCmd(msg.hdr.GetCommand(), msg.hdr.nMessageSize + CMessageHeader::HEADER_SIZE);
             msg.nTime = GetTimeMicros();
             messageHandlerCondition.notify_one();
         }
@@ -880,9 +882,27 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes)
 // TODO: implement void CConnman::AcceptConnection
 
 // requires LOCK(cs_vSend)
-void SocketSendData(CNode *pnode)
+size_t SocketSendData(CNode *pnode)
 {
     std::deque<CSerializeData>::iterator it = pnode->vSendMsg.begin();
+    size_t nSentSize = 0;
+
+    if (pnode->pTransport)
+    {
+        for (; it != pnode->vSendMsg.end(); it++)
+        {
+            pnode->pTransport->Send(pnode, *it);
+            pnode->nSendBytes += it->size();
+            nSentSize += it->size();
+        }
+
+        pnode->nLastSend = GetTime();
+        pnode->nSendOffset = 0;
+        pnode->nSendSize = 0;
+        pnode->vSendMsg.clear();
+
+        return nSentSize;
+    }
 
     while (it != pnode->vSendMsg.end())
     {
@@ -893,7 +913,9 @@ void SocketSendData(CNode *pnode)
         if (nBytes > 0)
         {
             pnode->nLastSend = GetTime();
+            pnode->nSendBytes += nBytes;
             pnode->nSendOffset += nBytes;
+            nSentSize += nBytes;
 
             if (pnode->nSendOffset == data.size())
             {
@@ -933,6 +955,195 @@ void SocketSendData(CNode *pnode)
     }
 
     pnode->vSendMsg.erase(pnode->vSendMsg.begin(), it);
+
+    return nSentSize;
+}
+
+struct NodeEvictionCandidate
+{
+    NodeId id;
+    int64_t nTimeConnected;
+    int64_t nMinPingUsecTime;
+    int64_t nLastBlockTime;
+    int64_t nLastTXTime;
+    uint64_t nKeyedNetGroup;
+    CNetAddr addr;
+};
+
+static bool ReverseCompareNodeMinPingTime(const NodeEvictionCandidate &a, const NodeEvictionCandidate &b)
+{
+    return a.nMinPingUsecTime > b.nMinPingUsecTime;
+}
+
+static bool ReverseCompareNodeTimeConnected(const NodeEvictionCandidate &a, const NodeEvictionCandidate &b)
+{
+    return a.nTimeConnected > b.nTimeConnected;
+}
+
+static bool CompareNetGroupKeyed(const NodeEvictionCandidate &a, const NodeEvictionCandidate &b)
+{
+    return a.nKeyedNetGroup < b.nKeyedNetGroup;
+}
+
+static bool CompareNodeBlockTime(const NodeEvictionCandidate &a, const NodeEvictionCandidate &b)
+{
+    // There is a fall-through here because it is common for a node to have many peers which have not yet relayed a block.
+    if (a.nLastBlockTime != b.nLastBlockTime)
+        return a.nLastBlockTime < b.nLastBlockTime;
+
+    return a.nTimeConnected > b.nTimeConnected;
+}
+
+static bool CompareNodeTXTime(const NodeEvictionCandidate &a, const NodeEvictionCandidate &b)
+{
+    // There is a fall-through here because it is common for a node to have more than a few peers that have not yet relayed txn.
+    if (a.nLastTXTime != b.nLastTXTime)
+        return a.nLastTXTime < b.nLastTXTime;
+
+    return a.nTimeConnected > b.nTimeConnected;
+}
+
+static void EraseLastKElements(std::vector<NodeEvictionCandidate> &vEvictionCandidates,
+                               bool (*comparator)(const NodeEvictionCandidate&, const NodeEvictionCandidate&),
+                               size_t k, const char* pszReason)
+{
+    std::sort(vEvictionCandidates.begin(), vEvictionCandidates.end(), comparator);
+    size_t nErase = std::min(k, vEvictionCandidates.size());
+    vEvictionCandidates.erase(vEvictionCandidates.end() - nErase, vEvictionCandidates.end());
+
+    LogPrint("net", "%s : protected %u peers by %s, %u candidates left\n", __func__,
+             nErase, pszReason, vEvictionCandidates.size());
+}
+
+/** Try to find an inbound connection to evict when a new inbound peer arrives
+ *  at the connection limit. Returns false if no connection could be evicted.
+ *
+ *  Peers are protected from eviction, in order, for network group diversity,
+ *  lowest ping, recently relaying transactions and blocks, being a known
+ *  masternode and for connection uptime. The youngest connection out of the
+ *  most represented network group among the rest is disconnected. */
+bool CConnman::AttemptToEvictConnection()
+{
+    std::vector<NodeEvictionCandidate> vEvictionCandidates;
+
+    {
+        LOCK(cs_vNodes);
+
+        BOOST_FOREACH(CNode *node, vNodes)
+        {
+            if (!node->fInbound || node->fDisconnect)
+                continue;
+
+            if (node->fMasternode || node->fDarkSendMaster)
+                continue;
+
+            std::vector<unsigned char> vchNetGroup(node->addr.GetGroup());
+            uint64_t nKeyedNetGroup = Hash(BEGIN(nSeed0), END(nSeed0), vchNetGroup.begin(), vchNetGroup.end()).GetLow64();
+
+            NodeEvictionCandidate candidate = {node->id, node->nTimeConnected, node->nMinPingUsecTime,
+                                               node->nLastBlockTime, node->nLastTXTime, nKeyedNetGroup, node->addr};
+            vEvictionCandidates.push_back(candidate);
+        }
+    }
+
+    if (vEvictionCandidates.empty())
+    {
+        LogPrint("net", "%s : no inbound candidates\n", __func__);
+        return false;
+    }
+
+    // Protect connections from active masternodes, they keep the payment and
+    // sync network healthy. Checked without holding cs_vNodes.
+    {
+        LOCK(cs_masternodes);
+        std::set<CNetAddr> setMasternodeAddrs;
+
+        BOOST_FOREACH(const CMasternode& mn, vecMasternodes)
+            setMasternodeAddrs.insert((CNetAddr) mn.addr);
+
+        size_t nBefore = vEvictionCandidates.size();
+        std::vector<NodeEvictionCandidate>::iterator it = vEvictionCandidates.begin();
+
+        while (it != vEvictionCandidates.end())
+        {
+            if (setMasternodeAddrs.count(it->addr))
+                it = vEvictionCandidates.erase(it);
+            else
+                ++it;
+        }
+
+        LogPrint("net", "%s : protected %u masternode peers, %u candidates left\n", __func__,
+                 nBefore - vEvictionCandidates.size(), vEvictionCandidates.size());
+    }
+
+    // Protect connections with certain characteristics
+
+    // Deterministically select 4 peers to protect by netgroup.
+    // An attacker cannot predict which netgroups will be protected
+    EraseLastKElements(vEvictionCandidates, CompareNetGroupKeyed, 4, "netgroup");
+
+    // Protect the 8 nodes with the lowest minimum ping time.
+    // An attacker cannot manipulate this metric without physically moving nodes closer to the target.
+    EraseLastKElements(vEvictionCandidates, ReverseCompareNodeMinPingTime, 8, "ping time");
+
+    // Protect 4 nodes that most recently sent us transactions.
+    // An attacker cannot manipulate this metric without performing useful work.
+    EraseLastKElements(vEvictionCandidates, CompareNodeTXTime, 4, "tx relay");
+
+    // Protect 4 nodes that most recently sent us blocks.
+    // An attacker cannot manipulate this metric without performing useful work.
+    EraseLastKElements(vEvictionCandidates, CompareNodeBlockTime, 4, "block relay");
+
+    // Protect the half of the remaining nodes which have been connected the longest.
+    // This replicates the non-eviction implicit behavior, and precludes attacks that start later.
+    EraseLastKElements(vEvictionCandidates, ReverseCompareNodeTimeConnected, vEvictionCandidates.size() / 2, "uptime");
+
+    if (vEvictionCandidates.empty())
+        return false;
+
+    // Identify the network group with the most connections and youngest member.
+    // (vEvictionCandidates is already sorted by reverse connect time)
+    uint64_t naMostConnections = 0;
+    unsigned int nMostConnections = 0;
+    int64_t nMostConnectionsTime = 0;
+    std::map<uint64_t, std::vector<NodeEvictionCandidate> > mapNetGroupNodes;
+
+    BOOST_FOREACH(const NodeEvictionCandidate &node, vEvictionCandidates)
+    {
+        std::vector<NodeEvictionCandidate>& group = mapNetGroupNodes[node.nKeyedNetGroup];
+        group.push_back(node);
+        int64_t grouptime = group[0].nTimeConnected;
+
+        if (group.size() > nMostConnections || (group.size() == nMostConnections && grouptime > nMostConnectionsTime))
+        {
+            nMostConnections = group.size();
+            nMostConnectionsTime = grouptime;
+            naMostConnections = node.nKeyedNetGroup;
+        }
+    }
+
+    // Reduce to the network group with the most connections
+    vEvictionCandidates = mapNetGroupNodes[naMostConnections];
+
+    // Disconnect from the network group with the most connections
+    NodeId evicted = vEvictionCandidates.front().id;
+
+    LOCK(cs_vNodes);
+
+    BOOST_FOREACH(CNode* pnode, vNodes)
+    {
+        if (pnode->id == evicted)
+        {
+            LogPrint("net", "%s : evicting peer=%d (group of %u peers, connected %ds)\n", __func__,
+                     evicted, nMostConnections, GetTime() - pnode->nTimeConnected);
+
+            pnode->fDisconnect = true;
+            nInboundEvicted++;
+            return true;
+        }
+    }
+
+    return false;
 }
 
 void CConnman::ThreadSocketHandler()
@@ -1134,6 +1345,10 @@ void CConnman::ThreadSocketHandler2()
             CAddress addr;
             int nInbound = 0;
 
+            // -maxconnections can be lowered at runtime, the file descriptors reserved at
+            // startup cap it
+            int nMaxInbound = std::min(nMaxConnections, (int) configMaxConnections.GetInt()) - MAX_OUTBOUND_CONNECTIONS;
+
             if (hSocket != INVALID_SOCKET)
                 if (!addr.SetSockAddr((const struct sockaddr*)&sockaddr))
                     LogPrintf("%s : [WARNING] unknown socket family\n", __func__);
@@ -1155,16 +1370,19 @@ void CConnman::ThreadSocketHandler2()
                 if (nErr != WSAEWOULDBLOCK)
                     LogPrintf("%s : socket error accept failed: %d\n", __func__, nErr);
             }
-            else if (nInbound >= GetArg("-maxconnections", 125) - MAX_OUTBOUND_CONNECTIONS)
-            {
-                CloseSocket(hSocket);
-            }
             else if (IsBanned(addr))
             {
                 LogPrintf("%s : connection from %s dropped (banned)\n", __func__,
                           addr.ToString().c_str());
                 CloseSocket(hSocket);
             }
+            else if (nInbound >= nMaxInbound && !AttemptToEvictConnection())
+            {
+                // No connection to evict, disconnect the new connection
+                LogPrint("net", "%s : failed to find an eviction candidate - connection dropped (full)\n", __func__);
+                nInboundRefused++;
+                CloseSocket(hSocket);
+            }
             else
             {
                 LogPrintf("%s : accepted connection %s\n", __func__, addr.ToString().c_str());
@@ -1223,6 +1441,8 @@ void CConnman::ThreadSocketHandler2()
                                 pnode->CloseSocketDisconnect();
 
                             pnode->nLastRecv = GetTime();
+                            pnode->nRecvBytes += nBytes;
+                            RecordBytesRecv(nBytes);
                         }
                         else if (nBytes == 0)
                         {
@@ -1258,7 +1478,7 @@ void CConnman::ThreadSocketHandler2()
                 TRY_LOCK(pnode->cs_vSend, lockSend);
 
                 if (lockSend)
-                    SocketSendData(pnode);
+                    RecordBytesSent(SocketSendData(pnode));
             }
 
             // Inactivity checking
@@ -1284,6 +1504,19 @@ void CConnman::ThreadSocketHandler2()
                     LogPrintf("%s : socket inactivity timeout\n", __func__);
                     pnode->fDisconnect = true;
                 }
+                else if (pnode->IsPingTimedOut(GetTimeMicros()))
+                {
+                    // No more pings go out while one is unanswered, so a lost pong ends the connection
+                    LogPrintf("%s : ping timeout: %fs, peer=%d\n", __func__,
+                              0.000001 * (GetTimeMicros() - pnode->nPingUsecStart), pnode->id);
+                    pnode->fDisconnect = true;
+                }
+                else if (pnode->IsStallingBlockDownload(GetTime(), nBlockStallingTimeout))
+                {
+                    LogPrintf("%s : peer=%d is stalling block download (%d blocks in flight), disconnecting\n",
+                              __func__, pnode->id, pnode->nBlocksInFlight.load());
+                    pnode->fDisconnect = true;
+                }
             }
         }
 
@@ -1499,6 +1732,17 @@ void CConnman::ThreadDNSAddressSeed()
         {
             LogPrintf("%s : loading addresses from DNS seeds (could take a while)\n", __func__);
 
+            // All seeds are queried at once, a slow one doesn't hold up the others
+            vector<CAsyncResolver::Result> vLookups;
+
+            BOOST_FOREACH (const CDNSSeedData& seed, vSeeds)
+            {
+                if (!HaveNameProxy())
+                    vLookups.push_back(asyncResolver.LookupHost(seed.host, true));
+            }
+
+            unsigned int nLookup = 0;
+
             BOOST_FOREACH (const CDNSSeedData& seed, vSeeds)
             {
                 if (HaveNameProxy())
@@ -1510,10 +1754,10 @@ void CConnman::ThreadDNSAddressSeed()
                 {
                     LogPrintf("%s : trying %s (%s)\n", __func__, seed.host, seed.name);
 
-                    vector<CNetAddr> vaddr;
+                    vector<CNetAddr> vaddr = vLookups[nLookup++].get();
                     vector<CAddress> vAdd;
 
-                    if (LookupHost(seed.host.c_str(), vaddr, 0, true))
+                    if (!vaddr.empty())
                     {
                         LogPrintf("%s : found %d addresses from %s\n", __func__, vaddr.size(), seed.host);
 
@@ -1668,14 +1912,19 @@ void CConnman::ThreadOpenConnections2()
 
     // Minimum time before next feeler connection (in microseconds).
     int64_t nNextFeeler = PoissonNextSend(nStart*1000 * 1000, FEELER_INTERVAL);
+    bool fQueued = false;
     while (!interruptNet)
     {
         ProcessOneShot();
 
-        if (!interruptNet.sleep_for(std::chrono::milliseconds(500)))
+        // While connections are being handed out, keep filling the free slots
+        if (!interruptNet.sleep_for(std::chrono::milliseconds(fQueued ? 0 : 500)))
             return;
 
+        fQueued = false;
+
         CSemaphoreGrant grant(*semOutbound);
+        CSemaphoreGrant grantAttempt(*semConnectAttempts);
         if (interruptNet)
             return;
 
@@ -1723,6 +1972,12 @@ void CConnman::ThreadOpenConnections2()
             }
         }
 
+        // Nor to a group that a connect worker is still trying
+        {
+            std::lock_guard<std::mutex> lock(mutexConnect);
+            setConnected.insert(setConnectingGroups.begin(), setConnectingGroups.end());
+        }
+
         // Feeler Connections
         //
         // Design goals:
@@ -1781,7 +2036,10 @@ void CConnman::ThreadOpenConnections2()
         }
 
         if (addrConnect.IsValid())
-            OpenNetworkConnection(addrConnect, &grant);
+        {
+            QueueConnection(addrConnect, grant, grantAttempt);
+            fQueued = true;
+        }
     }
 }
 
@@ -1825,9 +2083,12 @@ void CConnman::ThreadOpenAddedConnections2()
             {
                 CAddress addr;
                 CSemaphoreGrant grant(*semOutbound);
+                CSemaphoreGrant grantAttempt(*semConnectAttempts);
 
-                OpenNetworkConnection(addr, &grant, strAddNode.c_str());
-                MilliSleep(500);
+                if (interruptNet)
+                    return;
+
+                QueueConnection(addr, grant, grantAttempt, strAddNode.c_str());
             }
 
             vnThreadsRunning[THREAD_ADDEDCONNECTIONS]--;
@@ -1839,12 +2100,27 @@ void CConnman::ThreadOpenAddedConnections2()
     }
 
     vector<vector<CService> > vservAddressesToAdd(0);
+    vector<pair<int, CAsyncResolver::Result> > vLookups;
 
+    // Resolve all entries at once rather than waiting for each name in turn
     BOOST_FOREACH(string& strAddNode, mapMultiArgs["-addnode"])
     {
+        int port = GetDefaultPort();
+        string strHost;
+
+        SplitHostPort(strAddNode, port, strHost);
+        vLookups.push_back(make_pair(port, asyncResolver.LookupHost(strHost, fNameLookup)));
+    }
+
+    for (unsigned int i = 0; i < vLookups.size(); i++)
+    {
+        vector<CNetAddr> vIP = vLookups[i].second.get();
         vector<CService> vservNode(0);
 
-        if(Lookup(strAddNode.c_str(), vservNode, GetDefaultPort(), fNameLookup, 0))
+        BOOST_FOREACH(const CNetAddr& ip, vIP)
+            vservNode.push_back(CService(ip, vLookups[i].first));
+
+        if (!vservNode.empty())
         {
             vservAddressesToAdd.push_back(vservNode);
             {
@@ -1886,11 +2162,12 @@ void CConnman::ThreadOpenAddedConnections2()
         BOOST_FOREACH(vector<CService>& vserv, vservConnectAddresses)
         {
             CSemaphoreGrant grant(*semOutbound);
-            OpenNetworkConnection(CAddress(*(vserv.begin())), &grant);
-            MilliSleep(500);
+            CSemaphoreGrant grantAttempt(*semConnectAttempts);
 
-            if (fShutdown)
+            if (fShutdown || interruptNet)
                 return;
+
+            QueueConnection(CAddress(*(vserv.begin())), grant, grantAttempt);
         }
 
         if (fShutdown)
@@ -1946,6 +2223,86 @@ bool CConnman::OpenNetworkConnection(const CAddress& addrConnect, CSemaphoreGran
     return true;
 }
 
+void CConnman::QueueConnection(const CAddress& addrConnect, CSemaphoreGrant& grantOutbound,
+                               CSemaphoreGrant& grantAttempt, const char *strDest)
+{
+    ConnectJob* job = new ConnectJob();
+    job->addr = addrConnect;
+    job->strDest = strDest ? strDest : "";
+    grantOutbound.MoveTo(job->grantOutbound);
+    grantAttempt.MoveTo(job->grantAttempt);
+
+    {
+        std::lock_guard<std::mutex> lock(mutexConnect);
+
+        if (addrConnect.IsValid())
+            setConnectingGroups.insert(addrConnect.GetGroup());
+
+        nConnectingCount++;
+        vConnectJobs.push_back(job);
+    }
+
+    condConnect.notify_one();
+}
+
+void CConnman::ThreadConnectWorker()
+{
+    while (true)
+    {
+        ConnectJob* job;
+
+        {
+            std::unique_lock<std::mutex> lock(mutexConnect);
+
+            while (vConnectJobs.empty() && !interruptNet)
+                condConnect.wait(lock);
+
+            if (interruptNet)
+                return;
+
+            job = vConnectJobs.front();
+            vConnectJobs.pop_front();
+        }
+
+        int64_t nStart = GetTimeMillis();
+        nConnectAttempts++;
+
+        if (OpenNetworkConnection(job->addr, &job->grantOutbound, job->strDest.empty() ? NULL : job->strDest.c_str()))
+        {
+            nConnectSucceeded++;
+            nConnectSucceededMillis += GetTimeMillis() - nStart;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutexConnect);
+
+            if (job->addr.IsValid())
+                setConnectingGroups.erase(setConnectingGroups.find(job->addr.GetGroup()));
+
+            nConnectingCount--;
+        }
+
+        // Frees the attempt slot, and the outbound slot unless the node took it
+        delete job;
+    }
+}
+
+CConnman::ConnectStats CConnman::GetConnectStats()
+{
+    ConnectStats stats;
+    stats.nAttempts = nConnectAttempts;
+    stats.nSucceeded = nConnectSucceeded;
+    stats.nSucceededMillis = nConnectSucceededMillis;
+    stats.nWorkers = vConnectThreads.size();
+
+    {
+        std::lock_guard<std::mutex> lock(mutexConnect);
+        stats.nInFlight = nConnectingCount;
+    }
+
+    return stats;
+}
+
 void ThreadMessageHandler(void* parg)
 {
     // Make this thread recognisable as the message handling thread
@@ -2236,13 +2593,28 @@ CConnman::CConnman(uint64_t nSeed0In, uint64_t nSeed1In) :
     // nReceiveFloodSize = 0;
     semOutbound = NULL;
     semAddnode = NULL;
+    semConnectAttempts = NULL;
     // semMasternodeOutbound = NULL;
     nMaxConnections = 0;
     nMaxOutbound = 0;
     nMaxAddnode = 0;
+    nMaxConnectAttempts = DEFAULT_MAX_CONNECT_ATTEMPTS;
+    nConnectingCount = 0;
+    nConnectAttempts = 0;
+    nConnectSucceeded = 0;
+    nConnectSucceededMillis = 0;
     // nBestHeight = 0;
     // clientInterface = NULL;
     flagInterruptMsgProc = false;
+    nTotalBytesRecv = 0;
+    nTotalBytesSent = 0;
+    nMaxOutboundTotalBytesSentInCycle = 0;
+    nMaxOutboundCycleStartTime = 0;
+    nMaxOutboundLimit = 0;
+    nMaxOutboundTimeframe = MAX_UPLOAD_TIMEFRAME;
+    nBlockStallingTimeout = DEFAULT_BLOCK_STALLING_TIMEOUT;
+    nInboundEvicted = 0;
+    nInboundRefused = 0;
 }
 
 CConnman::~CConnman()
@@ -2251,6 +2623,125 @@ CConnman::~CConnman()
     Stop();
 }
 
+void CConnman::RecordBytesRecv(uint64_t bytes)
+{
+    LOCK(cs_totalBytesRecv);
+    nTotalBytesRecv += bytes;
+}
+
+void CConnman::RecordBytesSent(uint64_t bytes)
+{
+    LOCK(cs_totalBytesSent);
+    nTotalBytesSent += bytes;
+
+    uint64_t now = GetTime();
+
+    if (nMaxOutboundCycleStartTime + nMaxOutboundTimeframe < now)
+    {
+        // timeframe expired, reset cycle
+        nMaxOutboundCycleStartTime = now;
+        nMaxOutboundTotalBytesSentInCycle = 0;
+    }
+
+    // Every peer counts against the target, there are no whitelisted peers to leave out
+    nMaxOutboundTotalBytesSentInCycle += bytes;
+}
+
+void CConnman::SetMaxOutboundTarget(uint64_t limit)
+{
+    LOCK(cs_totalBytesSent);
+    nMaxOutboundLimit = limit;
+}
+
+uint64_t CConnman::GetMaxOutboundTarget()
+{
+    LOCK(cs_totalBytesSent);
+    return nMaxOutboundLimit;
+}
+
+uint64_t CConnman::GetMaxOutboundTimeframe()
+{
+    LOCK(cs_totalBytesSent);
+    return nMaxOutboundTimeframe;
+}
+
+uint64_t CConnman::GetMaxOutboundTimeLeftInCycle()
+{
+    LOCK(cs_totalBytesSent);
+
+    if (nMaxOutboundLimit == 0)
+        return 0;
+
+    if (nMaxOutboundCycleStartTime == 0)
+        return nMaxOutboundTimeframe;
+
+    uint64_t cycleEndTime = nMaxOutboundCycleStartTime + nMaxOutboundTimeframe;
+    uint64_t now = GetTime();
+
+    return (cycleEndTime < now) ? 0 : cycleEndTime - GetTime();
+}
+
+void CConnman::SetMaxOutboundTimeframe(uint64_t timeframe)
+{
+    LOCK(cs_totalBytesSent);
+
+    if (nMaxOutboundTimeframe != timeframe)
+    {
+        // reset measure-cycle in case of changing
+        // the timeframe
+        nMaxOutboundCycleStartTime = GetTime();
+    }
+
+    nMaxOutboundTimeframe = timeframe;
+}
+
+bool CConnman::OutboundTargetReached(bool historicalBlockServingLimit)
+{
+    LOCK(cs_totalBytesSent);
+
+    if (nMaxOutboundLimit == 0)
+        return false;
+
+    if (historicalBlockServingLimit)
+    {
+        // keep a buffer to relay each block of the cycle once, budgeting with a
+        // large block. A day of those is over a GB, so with a smaller target the
+        // buffer is capped, or historical blocks would never be served at all.
+        uint64_t timeLeftInCycle = GetMaxOutboundTimeLeftInCycle();
+        uint64_t buffer = std::min(timeLeftInCycle / nTargetSpacing * UPLOAD_TARGET_BLOCK_BUFFER,
+                                   nMaxOutboundLimit / UPLOAD_TARGET_BUFFER_DIVISOR);
+
+        if (nMaxOutboundTotalBytesSentInCycle >= nMaxOutboundLimit - buffer)
+            return true;
+    }
+    else if (nMaxOutboundTotalBytesSentInCycle >= nMaxOutboundLimit)
+        return true;
+
+    return false;
+}
+
+uint64_t CConnman::GetOutboundTargetBytesLeft()
+{
+    LOCK(cs_totalBytesSent);
+
+    if (nMaxOutboundLimit == 0)
+        return 0;
+
+    return (nMaxOutboundTotalBytesSentInCycle >= nMaxOutboundLimit) ? 0 : nMaxOutboundLimit - nMaxOutboundTotalBytesSentInCycle;
+}
+
+uint64_t CConnman::GetTotalBytesRecv()
+{
+    LOCK(cs_totalBytesRecv);
+    return nTotalBytesRecv;
+}
+
+uint64_t CConnman::GetTotalBytesSent()
+{
+    LOCK(cs_totalBytesSent);
+    return nTotalBytesSent;
+}
+
 bool CConnman::Start(CScheduler& scheduler, Options connOptions)
 {
     // Make this thread recognisable as the startup thread
@@ -2260,6 +2751,14 @@ bool CConnman::Start(CScheduler& scheduler, Options connOptions)
     nMaxOutbound = std::min((connOptions.nMaxOutbound), nMaxConnections);
     nMaxAddnode = connOptions.nMaxAddnode;
     nMaxFeeler = connOptions.nMaxFeeler;
+    nBlockStallingTimeout = connOptions.nBlockStallingTimeout;
+    nMaxConnectAttempts = std::max(1, std::min(connOptions.nMaxConnectAttempts, MAX_CONNECT_ATTEMPTS));
+
+    {
+        LOCK(cs_totalBytesSent);
+        nMaxOutboundTimeframe = connOptions.nMaxOutboundTimeframe;
+        nMaxOutboundLimit = connOptions.nMaxOutboundLimit;
+    }
 
     clientInterface = &uiInterface;
 
@@ -2313,6 +2812,9 @@ bool CConnman::Start(CScheduler& scheduler, Options connOptions)
     if (semAddnode == NULL)
         semAddnode = new CSemaphore(nMaxAddnode);
 
+    if (semConnectAttempts == NULL)
+        semConnectAttempts = new CSemaphore(nMaxConnectAttempts);
+
     if (pnodeLocalHost == NULL)
         pnodeLocalHost = new CNode(INVALID_SOCKET, CAddress(CService("127.0.0.1", 0), nLocalServices));
 
@@ -2339,6 +2841,11 @@ bool CConnman::Start(CScheduler& scheduler, Options connOptions)
     if (fUseUPnP)
         MapPort();
 
+    // Open outbound connections in parallel
+    for (int i = 0; i < nMaxConnectAttempts; i++)
+        vConnectThreads.push_back(std::thread(&TraceThread<std::function<void()> >, "connect",
+                                  std::function<void()>(std::bind(&CConnman::ThreadConnectWorker, this))));
+
     // Send and receive from sockets, accept connections
     threadSocketHandler = std::thread(&TraceThread<std::function<void()> >, "net",
                           std::function<void()>(std::bind(&CConnman::ThreadSocketHandler, this)));
@@ -2370,7 +2877,8 @@ bool CConnman::Start(CScheduler& scheduler, Options connOptions)
     }
 
     // Dump network addresses
-    scheduler.scheduleEvery(boost::bind(&CConnman::DumpData, this), DUMP_ADDRESSES_INTERVAL);
+    scheduler.scheduleTask("dumpaddresses", boost::bind(&CConnman::DumpData, this), DUMP_ADDRESSES_INTERVAL * 1000,
+                           SCHEDULER_CLASS_NONE, 1000);
     return true;
 }
 
@@ -2403,6 +2911,19 @@ void CConnman::Interrupt()
         }
     }
 
+    if (semConnectAttempts)
+    {
+        for (int i=0; i<nMaxConnectAttempts; i++)
+        {
+            semConnectAttempts->post();
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutexConnect);
+        condConnect.notify_all();
+    }
+
     LogPrintf("%s : finished\n", __func__);
 }
 
@@ -2424,6 +2945,27 @@ void CConnman::Stop()
     if (threadOpenAddedConnections.joinable())
         threadOpenAddedConnections.join();
 
+    LogPrintf("%s : joining connect workers\n", __func__);
+
+    for (std::thread& t : vConnectThreads)
+    {
+        if (t.joinable())
+            t.join();
+    }
+
+    vConnectThreads.clear();
+
+    {
+        std::lock_guard<std::mutex> lock(mutexConnect);
+
+        for (ConnectJob* job : vConnectJobs)
+            delete job;
+
+        vConnectJobs.clear();
+        setConnectingGroups.clear();
+        nConnectingCount = 0;
+    }
+
     LogPrintf("%s : joining threadDNSAddressSeed\n", __func__);
 
     if (threadDNSAddressSeed.joinable())
@@ -2486,6 +3028,8 @@ void CConnman::Stop()
     semOutbound = NULL;
     delete semAddnode;
     semAddnode = NULL;
+    delete semConnectAttempts;
+    semConnectAttempts = NULL;
 
     // int64_t nStart = GetTime();
     // do
@@ -2693,11 +3237,14 @@ CNode::CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn, bool fIn
 {
     nServices = 0;
     hSocket = hSocketIn;
+    pTransport = NULL;
     nRecvVersion = INIT_PROTO_VERSION;
     nLastSend = 0;
     nLastRecv = 0;
     nLastSendEmpty = GetTime();
     nTimeConnected = GetTime();
+    nSendBytes = 0;
+    nRecvBytes = 0;
     addr = addrIn;
     addrName = addrNameIn == "" ? addr.ToStringIPPort() : addrNameIn;
     nVersion = 0;
@@ -2719,8 +3266,30 @@ CNode::CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn, bool fIn
     fRelayTxes = false;
     nMisbehavior = 0;
     hashCheckpointKnown = 0;
+    nBlocksInFlight = 0;
+    nBlockDownloadProgress = 0;
+    nBlocksRecv = 0;
+    nBlockBytesRecv = 0;
+    fServingBlock = false;
+    nMasternodeListSyncVersion = 0;
+    nPingNonceSent = 0;
+    nPingUsecStart = 0;
+    nPingUsecTime = 0;
+    nMinPingUsecTime = std::numeric_limits<int64_t>::max();
+    nLastBlockTime = 0;
+    nLastTXTime = 0;
     setInventoryKnown.max_size(SendBufferSize() / 1000);
 
+    // The commands are fixed here, a peer making up new ones can't grow the maps
+    BOOST_FOREACH(const std::string& strCommand, getAllNetMessageTypes())
+    {
+        mapSendBytesPerMsgCmd[strCommand] = 0;
+        mapRecvBytesPerMsgCmd[strCommand] = 0;
+    }
+
+    mapSendBytesPerMsgCmd[MSG_CMD_OTHER] = 0;
+    mapRecvBytesPerMsgCmd[MSG_CMD_OTHER] = 0;
+
     {
         LOCK(cs_nLastNodeId);
         id = nLastNodeId++;
@@ -2772,6 +3341,79 @@ void CNode::AskFor(const CInv& inv)
     mapAskFor.insert(std::make_pair(nRequestTime, inv));
 }
 
+const std::string CNode::MSG_CMD_OTHER = "*other*";
+
+// Adds to the count of a known command or to MSG_CMD_OTHER, never a new key
+static void AddBytesPerMsgCmd(CNode::mapMsgCmdSize& mapBytes, const std::string& strCommand, uint64_t nBytes)
+{
+    CNode::mapMsgCmdSize::iterator it = mapBytes.find(strCommand);
+
+    if (it == mapBytes.end())
+        it = mapBytes.find(CNode::MSG_CMD_OTHER);
+
+    assert(it != mapBytes.end());
+    it->second += nBytes;
+}
+
+void CNode::RecordSendBytesPerMsgCmd(const std::string& strCommand, uint64_t nBytes)
+{
+    LOCK(cs_msgStats);
+    AddBytesPerMsgCmd(mapSendBytesPerMsgCmd, strCommand, nBytes);
+}
+
+void CNode::RecordRecvBytesPerMsgCmd(const std::string& strCommand, uint64_t nBytes)
+{
+    LOCK(cs_msgStats);
+    AddBytesPerMsgCmd(mapRecvBytesPerMsgCmd, strCommand, nBytes);
+}
+
+void CNode::GetBytesPerMsgCmd(mapMsgCmdSize& mapSendRet, mapMsgCmdSize& mapRecvRet)
+{
+    LOCK(cs_msgStats);
+    mapSendRet = mapSendBytesPerMsgCmd;
+    mapRecvRet = mapRecvBytesPerMsgCmd;
+}
+
+void CNode::MarkBlockRequested()
+{
+    // The stall clock starts when the first block is requested; further
+    // requests while blocks are outstanding do not reset it
+    if (nBlocksInFlight++ == 0)
+        nBlockDownloadProgress = GetTime();
+}
+
+void CNode::MarkBlockReceived(uint64_t nBytes)
+{
+    nBlocksRecv++;
+    nBlockBytesRecv += nBytes;
+    nBlockDownloadProgress = GetTime();
+
+    // Blocks can also arrive unrequested (relay), never go below zero
+    int nInFlight = nBlocksInFlight.load();
+    while (nInFlight > 0 && !nBlocksInFlight.compare_exchange_weak(nInFlight, nInFlight - 1))
+        ;
+}
+
+void CNode::MarkBlockNotFound()
+{
+    int nInFlight = nBlocksInFlight.load();
+    while (nInFlight > 0 && !nBlocksInFlight.compare_exchange_weak(nInFlight, nInFlight - 1))
+        ;
+}
+
+bool CNode::IsPingTimedOut(int64_t nNowMicros) const
+{
+    return nPingNonceSent != 0 && nNowMicros - nPingUsecStart > TIMEOUT_INTERVAL * 1000000LL;
+}
+
+bool CNode::IsStallingBlockDownload(int64_t nNow, int64_t nTimeout) const
+{
+    if (nTimeout <= 0 || nBlocksInFlight.load() <= 0)
+        return false;
+
+    return nNow - nBlockDownloadProgress.load() > nTimeout;
+}
+
 void CNode::BeginMessage(const char* pszCommand) EXCLUSIVE_LOCK_FUNCTION(cs_vSend)
 {
     ENTER_CRITICAL_SECTION(cs_vSend);
@@ -2819,13 +3461,22 @@ void CNode::EndMessage() UNLOCK_FUNCTION(cs_vSend)
         LogPrintf("(%d bytes)\n", nSize);
     }
 
+    RecordSendBytesPerMsgCmd(std::string(&ssSend[CMessageHeader::MESSAGE_START_SIZE],
+                                         strnlen(&ssSend[CMessageHeader::MESSAGE_START_SIZE], CMessageHeader::COMMAND_SIZE)),
+                             ssSend.size());
+
     std::deque<CSerializeData>::iterator it = vSendMsg.insert(vSendMsg.end(), CSerializeData());
     ssSend.GetAndClear(*it);
     nSendSize += (*it).size();
 
     // If write queue empty, attempt "optimistic write"
     if (it == vSendMsg.begin())
-        SocketSendData(this);
+    {
+        size_t nBytes = SocketSendData(this);
+
+        if (nBytes && g_connman)
+            g_connman->RecordBytesSent(nBytes);
+    }
 
     LEAVE_CRITICAL_SECTION(cs_vSend);
 }
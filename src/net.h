@@ -25,7 +25,11 @@
 #include "ui_interface.h"
 #include "utiltime.h"
 
+#include <atomic>
+#include <condition_variable>
 #include <deque>
+#include <mutex>
+#include <set>
 #include <thread>
 
 #ifndef WIN32
@@ -47,6 +51,10 @@ extern int nBestHeight;
 /** Bootstap */
 //#define NTRNCORE_RELEASES_ATOM_LOCATION "https://github.com/neutroncoin/neutron/releases.atom"
 
+/** Time between pings automatically sent out for latency probing and keepalive (in seconds). */
+static const int PING_INTERVAL = 2 * 60;
+/** Time after which to disconnect a peer that hasn't answered a ping (in seconds). */
+static const int TIMEOUT_INTERVAL = 20 * 60;
 /** Run the feeler connection loop once every 2 minutes or 120 seconds. **/
 static const int FEELER_INTERVAL = 120;
 /** The maximum number of new addresses to accumulate before announcing. */
@@ -57,6 +65,10 @@ static const unsigned int MAX_PROTOCOL_MESSAGE_LENGTH = 2 * 1024 * 1024;
 static const int MAX_OUTBOUND_CONNECTIONS = 64;
 /** Maximum number of addnode outgoing nodes */
 static const int MAX_ADDNODE_CONNECTIONS = 8;
+/** Default for -maxconnectattempts, outbound connections being opened at the same time */
+static const int DEFAULT_MAX_CONNECT_ATTEMPTS = 4;
+/** Maximum for -maxconnectattempts */
+static const int MAX_CONNECT_ATTEMPTS = 16;
 /** -listen default */
 static const bool DEFAULT_LISTEN = true;
 /** -upnp default */
@@ -70,6 +82,18 @@ static const unsigned int DEFAULT_MAX_PEER_CONNECTIONS = 125;
 
 // NOTE: When adjusting this, update rpcnet:setban's help ("24h")
 static const unsigned int DEFAULT_MISBEHAVING_BANTIME = 60 * 60 * 24;  // Default 24-hour ban
+/** The default for -maxuploadtarget. 0 = Unlimited */
+static const uint64_t DEFAULT_MAX_UPLOAD_TARGET = 0;
+/** The default timeframe for -maxuploadtarget. 1 day. */
+static const uint64_t MAX_UPLOAD_TIMEFRAME = 60 * 60 * 24;
+/** Bytes reserved per expected new block when deciding whether to keep serving historical blocks. */
+static const uint64_t UPLOAD_TARGET_BLOCK_BUFFER = 1000000;
+/** The reserve for new blocks is at most 1/n of -maxuploadtarget. */
+static const uint64_t UPLOAD_TARGET_BUFFER_DIVISOR = 4;
+/** Blocks older than this are "historical" and stop being served once the upload target is reached. */
+static const int64_t HISTORICAL_BLOCK_AGE = 60 * 60 * 24 * 7;
+/** Seconds without progress on requested blocks before a peer counts as stalling (-blockstallingtimeout). */
+static const int64_t DEFAULT_BLOCK_STALLING_TIMEOUT = 2 * 60;
 
 inline unsigned int ReceiveFloodSize() { return 1000*GetArg("-maxreceivebuffer", 5*1000); }
 inline unsigned int SendBufferSize() { return 1000*GetArg("-maxsendbuffer", 1*1000); }
@@ -83,7 +107,7 @@ CNode* FindNode(const CService& ip);
 void MapPort();
 unsigned short GetListenPort();
 bool BindListenPort(const CService &bindAddr, std::string& strError=REF(std::string()));
-void SocketSendData(CNode *pnode);
+size_t SocketSendData(CNode *pnode);
 
 typedef int NodeId;
 
@@ -194,6 +218,17 @@ public:
         unsigned int nReceiveFloodSize = 0;
         uint64_t nMaxOutboundTimeframe = 0;
         uint64_t nMaxOutboundLimit = 0;
+        int64_t nBlockStallingTimeout = DEFAULT_BLOCK_STALLING_TIMEOUT;
+        int nMaxConnectAttempts = DEFAULT_MAX_CONNECT_ATTEMPTS;
+    };
+
+    struct ConnectStats
+    {
+        uint64_t nAttempts;
+        uint64_t nSucceeded;
+        uint64_t nSucceededMillis;  // total time successful attempts took
+        unsigned int nInFlight;
+        int nWorkers;
     };
 
     CConnman(uint64_t seed0, uint64_t seed1);
@@ -234,7 +269,54 @@ public:
     bool RemoveAddedNode(const std::string& node);
     CNode* ConnectNode(CAddress addrConnect, const char *strDest = NULL, bool darkSendMaster=false); // NTRN TODO - eventually make private
 
+    //!set the max outbound target in bytes
+    void SetMaxOutboundTarget(uint64_t limit);
+    uint64_t GetMaxOutboundTarget();
+
+    //!set the timeframe for the max outbound target
+    void SetMaxOutboundTimeframe(uint64_t timeframe);
+    uint64_t GetMaxOutboundTimeframe();
+
+    //!check if the outbound target is reached
+    // if param historicalBlockServingLimit is set true, the function will
+    // response true if the limit for serving historical blocks has been reached
+    bool OutboundTargetReached(bool historicalBlockServingLimit);
+
+    //!response the bytes left in the current max outbound cycle
+    // in case of no limit, it will always response 0
+    uint64_t GetOutboundTargetBytesLeft();
+
+    //!response the time in second left in the current max outbound cycle
+    // in case of no limit, it will always response 0
+    uint64_t GetMaxOutboundTimeLeftInCycle();
+
+    uint64_t GetTotalBytesRecv();
+    uint64_t GetTotalBytesSent();
+
+    void RecordBytesRecv(uint64_t bytes);
+    void RecordBytesSent(uint64_t bytes);
+
+    int64_t GetBlockStallingTimeout() const { return nBlockStallingTimeout; }
+
+    uint64_t GetInboundEvictedCount() const { return nInboundEvicted; }
+    uint64_t GetInboundRefusedCount() const { return nInboundRefused; }
+
+    ConnectStats GetConnectStats();
+
 private:
+    struct ConnectJob
+    {
+        CAddress addr;
+        std::string strDest;
+        CSemaphoreGrant grantOutbound;
+        CSemaphoreGrant grantAttempt;
+    };
+
+    /** Hand a connection to the connect workers, takes over both grants */
+    void QueueConnection(const CAddress& addrConnect, CSemaphoreGrant& grantOutbound,
+                         CSemaphoreGrant& grantAttempt, const char *strDest = NULL);
+    void ThreadConnectWorker();
+
     void ThreadOpenAddedConnections();
     void ThreadOpenAddedConnections2();
     void ProcessOneShot();
@@ -245,6 +327,8 @@ private:
     void ThreadDNSAddressSeed();
     void ThreadStakeMiner(CWallet *pwallet);
 
+    bool AttemptToEvictConnection();
+
     // Check is the banlist has unwritten changes
     bool BannedSetIsDirty();
     void SetBannedSetDirty(bool dirty=true);
@@ -253,6 +337,24 @@ private:
     void DumpData();
     void DumpBanlist();
 
+    // Network usage totals
+    CCriticalSection cs_totalBytesRecv;
+    CCriticalSection cs_totalBytesSent;
+    uint64_t nTotalBytesRecv;
+    uint64_t nTotalBytesSent;
+
+    // outbound limit & stats
+    uint64_t nMaxOutboundTotalBytesSentInCycle;
+    uint64_t nMaxOutboundCycleStartTime;
+    uint64_t nMaxOutboundLimit;
+    uint64_t nMaxOutboundTimeframe;
+
+    int64_t nBlockStallingTimeout;
+
+    // inbound eviction stats
+    std::atomic<uint64_t> nInboundEvicted;
+    std::atomic<uint64_t> nInboundRefused;
+
     banmap_t setBanned;
     CCriticalSection cs_setBanned;
     bool setBannedIsDirty;
@@ -260,12 +362,24 @@ private:
 
     CSemaphore *semOutbound;
     CSemaphore *semAddnode;
+    CSemaphore *semConnectAttempts;
     int nMaxConnections;
     int nMaxOutbound;
     int nMaxAddnode;
     int nMaxFeeler;
+    int nMaxConnectAttempts;
     CClientUIInterface* clientInterface;
 
+    // Outbound connections being opened by the connect workers
+    std::mutex mutexConnect;
+    std::condition_variable condConnect;
+    std::deque<ConnectJob*> vConnectJobs;
+    std::multiset<std::vector<unsigned char> > setConnectingGroups;
+    unsigned int nConnectingCount;
+    std::atomic<uint64_t> nConnectAttempts;
+    std::atomic<uint64_t> nConnectSucceeded;
+    std::atomic<uint64_t> nConnectSucceededMillis;
+
     // SipHasher seeds for deterministic randomness
     const uint64_t nSeed0, nSeed1;
 
@@ -280,6 +394,7 @@ private:
     std::thread threadOpenAddedConnections;
     std::thread threadOpenConnections;
     std::thread threadStakeMiner;
+    std::vector<std::thread> vConnectThreads;
 };
 
 extern std::unique_ptr<CConnman> g_connman;
@@ -322,6 +437,16 @@ public:
     int readData(const char *pch, unsigned int nBytes);
 };
 
+/** Test-only stand-in for a node's socket, used by the network simulator in src/test */
+class CNodeTransport
+{
+public:
+    virtual ~CNodeTransport() {}
+
+    /** Takes one complete outgoing message, header included */
+    virtual void Send(CNode* pnode, const CSerializeData& data) = 0;
+};
+
 class CNode
 {
     friend class CConnman;
@@ -329,6 +454,7 @@ class CNode
 public:
     uint64_t nServices;
     SOCKET hSocket;
+    CNodeTransport* pTransport; // when set, replaces hSocket for sending
     CDataStream ssSend;
     size_t nSendSize; // total size of all vSendMsg entries
     size_t nSendOffset; // offset inside the first vSendMsg already sent
@@ -336,6 +462,7 @@ public:
     CCriticalSection cs_vSend;
 
     std::deque<CInv> vRecvGetData;
+    std::atomic<bool> fServingBlock; // a block for this node is being read by the block server
     std::deque<CNetMessage> vRecvMsg;
     CCriticalSection cs_vRecvMsg;
     int nRecvVersion;
@@ -344,6 +471,8 @@ public:
     int64_t nLastRecv;
     int64_t nLastSendEmpty;
     int64_t nTimeConnected;
+    std::atomic<uint64_t> nSendBytes;
+    std::atomic<uint64_t> nRecvBytes;
     CAddress addr;
     std::string addrName;
     CService addrLocal;
@@ -359,6 +488,7 @@ public:
     bool fRelayTxes;
     bool fDarkSendMaster;
     bool fMasternode; // TODO: finish implementing this
+    std::atomic<int> nMasternodeListSyncVersion; // announced with mnlistver, 0 for full dseg only
     CSemaphoreGrant grantOutbound;
     CSemaphoreGrant grantMasternodeOutbound; // TODO: finish implementing this
     int nRefCount;
@@ -386,6 +516,27 @@ public:
     CCriticalSection cs_inventory;
     std::multimap<int64_t, CInv> mapAskFor;
 
+    // Block download tracking, used to detect peers that stall block download
+    std::atomic<int> nBlocksInFlight;
+    std::atomic<int64_t> nBlockDownloadProgress; // last time a requested block arrived (or the first was requested)
+    std::atomic<uint64_t> nBlocksRecv;
+    std::atomic<uint64_t> nBlockBytesRecv;
+
+    // Ping time measurement:
+    // The pong reply we're expecting, or 0 if no pong expected.
+    uint64_t nPingNonceSent;
+    // Time (in usec) the last ping was sent, or 0 if no ping was ever sent.
+    int64_t nPingUsecStart;
+    // Last measured round-trip time.
+    int64_t nPingUsecTime;
+    // Best measured round-trip time.
+    int64_t nMinPingUsecTime;
+
+    // Last time this peer gave us a new block / an accepted transaction,
+    // used to protect useful peers from inbound eviction
+    int64_t nLastBlockTime;
+    int64_t nLastTXTime;
+
     CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn = "", bool fInboundIn = false);
     ~CNode();
     CNode(const CNode&);
@@ -403,10 +554,19 @@ public:
         std::string cause;
     };
 
+    typedef std::map<std::string, uint64_t> mapMsgCmdSize; // command, total bytes
+
+    /** Bucket of the per-command byte counts for commands not in getAllNetMessageTypes() */
+    static const std::string MSG_CMD_OTHER;
+
 private:
     CCriticalSection cs_misbehaviors;
     std::vector<Misbehavior> misbehaviors;
 
+    CCriticalSection cs_msgStats;
+    mapMsgCmdSize mapSendBytesPerMsgCmd;
+    mapMsgCmdSize mapRecvBytesPerMsgCmd;
+
 public:
     NodeId GetId() const
     {
@@ -430,6 +590,17 @@ public:
         return total;
     }
 
+    void RecordSendBytesPerMsgCmd(const std::string& strCommand, uint64_t nBytes);
+    void RecordRecvBytesPerMsgCmd(const std::string& strCommand, uint64_t nBytes);
+    void GetBytesPerMsgCmd(mapMsgCmdSize& mapSendRet, mapMsgCmdSize& mapRecvRet);
+
+    void MarkBlockRequested();
+    void MarkBlockReceived(uint64_t nBytes);
+    void MarkBlockNotFound();
+    bool IsStallingBlockDownload(int64_t nNow, int64_t nTimeout) const;
+    // A ping with a nonce has gone unanswered for TIMEOUT_INTERVAL
+    bool IsPingTimedOut(int64_t nNowMicros) const;
+
     // requires LOCK(cs_vRecvMsg)
     bool ReceiveMsgBytes(const char *pch, unsigned int nBytes);
 
@@ -13,6 +13,7 @@
 #include "util.h"
 #include "utilstrencodings.h"
 
+#include <algorithm>
 #include <atomic>
 
 #ifndef WIN32
@@ -32,6 +33,21 @@ static proxyType nameProxy;
 static CCriticalSection cs_proxyInfos;
 int nConnectTimeout = DEFAULT_CONNECT_TIMEOUT;
 bool fNameLookup = DEFAULT_NAME_LOOKUP;
+int64_t nDNSCacheTTL = DEFAULT_DNS_CACHE_TTL;
+
+// getaddrinfo doesn't report record TTLs, resolved names are kept for nDNSCacheTTL
+struct CDNSCacheEntry
+{
+    std::vector<CNetAddr> vIP;
+    int64_t nExpires;
+};
+
+static std::map<std::string, CDNSCacheEntry> mapDNSCache;
+static uint64_t nDNSCacheHits = 0;
+static uint64_t nDNSCacheMisses = 0;
+static CCriticalSection cs_mapDNSCache;
+
+CAsyncResolver asyncResolver;
 
 // Need ample time for negotiation for very slow proxies such as Tor (milliseconds)
 static const int SOCKS5_RECV_TIMEOUT = 20 * 1000;
@@ -87,21 +103,9 @@ void SplitHostPort(std::string in, int &portOut, std::string &hostOut)
         hostOut = in;
 }
 
-bool static LookupIntern(const char *pszName, std::vector<CNetAddr>& vIP,
-                         unsigned int nMaxSolutions, bool fAllowLookup)
+bool static LookupGetAddrInfo(const char *pszName, std::vector<CNetAddr>& vIP,
+                              unsigned int nMaxSolutions, bool fAllowLookup)
 {
-    vIP.clear();
-
-    {
-        CNetAddr addr;
-
-        if (addr.SetSpecial(std::string(pszName)))
-        {
-            vIP.push_back(addr);
-            return true;
-        }
-    }
-
     struct addrinfo aiHint;
     memset(&aiHint, 0, sizeof(struct addrinfo));
 
@@ -145,6 +149,221 @@ bool static LookupIntern(const char *pszName, std::vector<CNetAddr>& vIP,
     return (vIP.size() > 0);
 }
 
+bool static LookupIntern(const char *pszName, std::vector<CNetAddr>& vIP,
+                         unsigned int nMaxSolutions, bool fAllowLookup)
+{
+    vIP.clear();
+
+    {
+        CNetAddr addr;
+
+        if (addr.SetSpecial(std::string(pszName)))
+        {
+            vIP.push_back(addr);
+            return true;
+        }
+    }
+
+    if (!fAllowLookup || nDNSCacheTTL <= 0)
+        return LookupGetAddrInfo(pszName, vIP, nMaxSolutions, fAllowLookup);
+
+    // Numeric addresses don't touch the network, only names are cached
+    if (LookupGetAddrInfo(pszName, vIP, nMaxSolutions, false))
+        return true;
+
+    std::string strName(pszName);
+    boost::to_lower(strName);
+    int64_t nNow = GetTime();
+
+    {
+        LOCK(cs_mapDNSCache);
+        std::map<std::string, CDNSCacheEntry>::iterator it = mapDNSCache.find(strName);
+
+        if (it != mapDNSCache.end() && it->second.nExpires > nNow)
+        {
+            nDNSCacheHits++;
+            vIP = it->second.vIP;
+
+            if (nMaxSolutions > 0 && vIP.size() > nMaxSolutions)
+                vIP.resize(nMaxSolutions);
+
+            return vIP.size() > 0;
+        }
+
+        nDNSCacheMisses++;
+    }
+
+    // The whole answer is cached, callers asking for fewer solutions get a prefix
+    std::vector<CNetAddr> vResolved;
+    bool fResolved = LookupGetAddrInfo(pszName, vResolved, 0, true);
+
+    {
+        LOCK(cs_mapDNSCache);
+        CDNSCacheEntry& entry = mapDNSCache[strName];
+        entry.vIP = vResolved;
+        entry.nExpires = nNow + (fResolved ? nDNSCacheTTL : std::min(nDNSCacheTTL, DNS_NEGATIVE_CACHE_TTL));
+
+        // Drop expired entries once the cache has grown a bit
+        if (mapDNSCache.size() > 256)
+        {
+            for (std::map<std::string, CDNSCacheEntry>::iterator it = mapDNSCache.begin(); it != mapDNSCache.end(); )
+            {
+                if (it->second.nExpires <= nNow)
+                    mapDNSCache.erase(it++);
+                else
+                    it++;
+            }
+        }
+    }
+
+    vIP = vResolved;
+
+    if (nMaxSolutions > 0 && vIP.size() > nMaxSolutions)
+        vIP.resize(nMaxSolutions);
+
+    return fResolved;
+}
+
+CDNSCacheStats GetDNSCacheStats()
+{
+    LOCK(cs_mapDNSCache);
+
+    CDNSCacheStats stats;
+    stats.nHits = nDNSCacheHits;
+    stats.nMisses = nDNSCacheMisses;
+    stats.nEntries = mapDNSCache.size();
+
+    return stats;
+}
+
+void ClearDNSCache()
+{
+    LOCK(cs_mapDNSCache);
+    mapDNSCache.clear();
+}
+
+CAsyncResolver::CAsyncResolver()
+{
+    fStopRequested = false;
+}
+
+CAsyncResolver::~CAsyncResolver()
+{
+    Stop();
+}
+
+void CAsyncResolver::Start(int nThreads)
+{
+    if (IsRunning() || nThreads <= 0)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutexJobs);
+        fStopRequested = false;
+    }
+
+    for (int i = 0; i < nThreads; i++)
+        vThreads.push_back(std::thread(&TraceThread<std::function<void()> >, "dns",
+                                       std::function<void()>(std::bind(&CAsyncResolver::ThreadResolver, this))));
+
+    LogPrintf("%s : resolving names on %d threads\n", __func__, nThreads);
+}
+
+void CAsyncResolver::Stop()
+{
+    if (!IsRunning())
+        return;
+
+    std::deque<Job> vDropped;
+
+    {
+        std::lock_guard<std::mutex> lock(mutexJobs);
+        fStopRequested = true;
+        vDropped.swap(vJobs);
+        mapPending.clear();
+    }
+
+    condJobs.notify_all();
+
+    for (unsigned int i = 0; i < vThreads.size(); i++)
+    {
+        if (vThreads[i].joinable())
+            vThreads[i].join();
+    }
+
+    vThreads.clear();
+
+    // Nobody is left waiting forever on a lookup that will never run
+    for (unsigned int i = 0; i < vDropped.size(); i++)
+        vDropped[i].promise->set_value(std::vector<CNetAddr>());
+}
+
+CAsyncResolver::Result CAsyncResolver::LookupHost(const std::string& strName, bool fAllowLookup)
+{
+    std::shared_ptr<std::promise<std::vector<CNetAddr> > > promise(new std::promise<std::vector<CNetAddr> >());
+    Result result = promise->get_future().share();
+
+    {
+        std::lock_guard<std::mutex> lock(mutexJobs);
+
+        if (!vThreads.empty() && !fStopRequested)
+        {
+            std::pair<std::string, bool> key(strName, fAllowLookup);
+            std::map<std::pair<std::string, bool>, Result>::iterator it = mapPending.find(key);
+
+            if (it != mapPending.end())
+                return it->second;
+
+            Job job;
+            job.strName = strName;
+            job.fAllowLookup = fAllowLookup;
+            job.promise = promise;
+            vJobs.push_back(job);
+            mapPending[key] = result;
+            condJobs.notify_one();
+
+            return result;
+        }
+    }
+
+    std::vector<CNetAddr> vIP;
+    ::LookupHost(strName.c_str(), vIP, 0, fAllowLookup);
+    promise->set_value(vIP);
+
+    return result;
+}
+
+void CAsyncResolver::ThreadResolver()
+{
+    while (true)
+    {
+        Job job;
+
+        {
+            std::unique_lock<std::mutex> lock(mutexJobs);
+
+            while (vJobs.empty() && !fStopRequested)
+                condJobs.wait(lock);
+
+            if (fStopRequested)
+                return;
+
+            job = vJobs.front();
+            vJobs.pop_front();
+        }
+
+        std::vector<CNetAddr> vIP;
+        ::LookupHost(job.strName.c_str(), vIP, 0, job.fAllowLookup);
+
+        {
+            std::lock_guard<std::mutex> lock(mutexJobs);
+            mapPending.erase(std::make_pair(job.strName, job.fAllowLookup));
+        }
+
+        job.promise->set_value(vIP);
+    }
+}
+
 bool LookupHost(const char *pszName, std::vector<CNetAddr>& vIP, unsigned int nMaxSolutions,
                 bool fAllowLookup)
 {
@@ -460,21 +679,22 @@ static bool Socks5(const std::string& strDest, int port,
     return true;
 }
 
-bool static ConnectSocketDirectly(const CService &addrConnect, SOCKET& hSocketRet, int nTimeout)
+// Creates a non-blocking socket and starts connecting it, fConnected is set if that finished right away
+static SOCKET StartConnect(const CService &addrConnect, bool& fConnected)
 {
-    hSocketRet = INVALID_SOCKET;
+    fConnected = false;
     struct sockaddr_storage sockaddr;
     socklen_t len = sizeof(sockaddr);
 
     if (!addrConnect.GetSockAddr((struct sockaddr*)&sockaddr, &len))
     {
         LogPrintf("%s : cannot connect to %s: unsupported network\n", __func__, addrConnect.ToString());
-        return false;
+        return INVALID_SOCKET;
     }
 
     SOCKET hSocket = socket(((struct sockaddr*)&sockaddr)->sa_family, SOCK_STREAM, IPPROTO_TCP);
     if (hSocket == INVALID_SOCKET)
-        return false;
+        return INVALID_SOCKET;
 
     int set = 1;
 #ifdef SO_NOSIGPIPE
@@ -491,75 +711,211 @@ bool static ConnectSocketDirectly(const CService &addrConnect, SOCKET& hSocketRe
 
     // Set to non-blocking
     if (!SetSocketNonBlocking(hSocket, true))
-        return error("ConnectSocketDirectly: Setting socket to non-blocking failed, error %s\n", NetworkErrorString(WSAGetLastError()));
+    {
+        LogPrintf("%s : setting socket to non-blocking failed, error %s\n", __func__, NetworkErrorString(WSAGetLastError()));
+        CloseSocket(hSocket);
+        return INVALID_SOCKET;
+    }
 
     if (connect(hSocket, (struct sockaddr*)&sockaddr, len) == SOCKET_ERROR)
     {
         int nErr = WSAGetLastError();
         // WSAEINVAL is here because some legacy version of winsock uses it
         if (nErr == WSAEINPROGRESS || nErr == WSAEWOULDBLOCK || nErr == WSAEINVAL)
+            return hSocket;
+#ifdef WIN32
+        else if (nErr != WSAEISCONN)
+#else
+        else
+#endif
         {
-            struct timeval timeout = MillisToTimeval(nTimeout);
-            fd_set fdset;
-            FD_ZERO(&fdset);
-            FD_SET(hSocket, &fdset);
-            int nRet = select(hSocket + 1, NULL, &fdset, NULL, &timeout);
-            if (nRet == 0)
-            {
-                LogPrint("net", "connection to %s timeout\n", addrConnect.ToString());
-                CloseSocket(hSocket);
-                return false;
-            }
+            LogPrintf("%s : connect() to %s failed: %s\n", __func__, addrConnect.ToString(),
+                      NetworkErrorString(nErr));
 
-            if (nRet == SOCKET_ERROR)
-            {
-                LogPrintf("%s : select() for %s failed: %s\n", __func__, addrConnect.ToString(),
-                          NetworkErrorString(WSAGetLastError()));
+            CloseSocket(hSocket);
+            return INVALID_SOCKET;
+        }
+    }
 
-                CloseSocket(hSocket);
-                return false;
-            }
+    fConnected = true;
+    return hSocket;
+}
 
-            socklen_t nRetSize = sizeof(nRet);
+// Called once select() reports a connecting socket writable
+static bool FinishConnect(SOCKET hSocket, const CService &addrConnect)
+{
+    int nRet = 0;
+    socklen_t nRetSize = sizeof(nRet);
 
 #ifdef WIN32
-            if (getsockopt(hSocket, SOL_SOCKET, SO_ERROR, (char*)(&nRet), &nRetSize) == SOCKET_ERROR)
+    if (getsockopt(hSocket, SOL_SOCKET, SO_ERROR, (char*)(&nRet), &nRetSize) == SOCKET_ERROR)
 #else
-            if (getsockopt(hSocket, SOL_SOCKET, SO_ERROR, &nRet, &nRetSize) == SOCKET_ERROR)
+    if (getsockopt(hSocket, SOL_SOCKET, SO_ERROR, &nRet, &nRetSize) == SOCKET_ERROR)
 #endif
-            {
-                LogPrintf("%s : getsockopt() for %s failed: %s\n", __func__,
-                          addrConnect.ToString(), NetworkErrorString(WSAGetLastError()));
+    {
+        LogPrintf("%s : getsockopt() for %s failed: %s\n", __func__,
+                  addrConnect.ToString(), NetworkErrorString(WSAGetLastError()));
+        return false;
+    }
 
-                CloseSocket(hSocket);
-                return false;
-            }
+    if (nRet != 0)
+    {
+        LogPrintf("%s : connect() to %s failed after select(): %s\n", __func__,
+                  addrConnect.ToString(), NetworkErrorString(nRet));
+        return false;
+    }
 
-            if (nRet != 0)
-            {
-                LogPrintf("%s : connect() to %s failed after select(): %s\n", __func__,
-                          addrConnect.ToString(), NetworkErrorString(nRet));
+    return true;
+}
 
-                CloseSocket(hSocket);
-                return false;
+std::vector<CService> InterleaveAddressFamilies(const std::vector<CService>& vAddr)
+{
+    std::vector<CService> vFirst, vOther;
+
+    for (unsigned int i = 0; i < vAddr.size(); i++)
+    {
+        if (vAddr[i].IsIPv6() == vAddr[0].IsIPv6())
+            vFirst.push_back(vAddr[i]);
+        else
+            vOther.push_back(vAddr[i]);
+    }
+
+    std::vector<CService> vRet;
+
+    for (unsigned int i = 0; i < std::max(vFirst.size(), vOther.size()); i++)
+    {
+        if (i < vFirst.size())
+            vRet.push_back(vFirst[i]);
+
+        if (i < vOther.size())
+            vRet.push_back(vOther[i]);
+    }
+
+    return vRet;
+}
+
+bool ConnectSocketDirectly(const std::vector<CService>& vAddr, SOCKET& hSocketRet, CService& addrRet, int nTimeout)
+{
+    hSocketRet = INVALID_SOCKET;
+
+    std::vector<CService> vTry = InterleaveAddressFamilies(vAddr);
+    std::vector<std::pair<SOCKET, CService> > vPending;
+    unsigned int nNext = 0;
+    int64_t nStart = GetTimeMillis();
+    int64_t nDeadline = nStart + nTimeout;
+    int64_t nNextAttempt = nStart;
+    bool fRet = false;
+
+    while (true)
+    {
+        int64_t nNow = GetTimeMillis();
+
+        // Start the next attempt once the previous ones had their head start, or all failed
+        if (nNext < vTry.size() && nNow < nDeadline && (nNow >= nNextAttempt || vPending.empty()))
+        {
+            const CService& addrConnect = vTry[nNext++];
+
+            bool fConnected;
+            SOCKET hSocket = StartConnect(addrConnect, fConnected);
+
+            if (hSocket == INVALID_SOCKET)
+                continue;
+
+            if (fConnected)
+            {
+                hSocketRet = hSocket;
+                addrRet = addrConnect;
+                fRet = true;
+                break;
             }
+
+            vPending.push_back(std::make_pair(hSocket, addrConnect));
+            nNextAttempt = nNow + CONNECT_ATTEMPT_DELAY;
+            continue;
         }
-#ifdef WIN32
-        else if (WSAGetLastError() != WSAEISCONN)
-#else
-        else
-#endif
+
+        if (vPending.empty())
+            break;
+
+        if (nNow >= nDeadline)
         {
-            LogPrintf("%s : connect() to %s failed: %s\n", __func__, addrConnect.ToString(),
-                      NetworkErrorString(WSAGetLastError()));
+            for (unsigned int i = 0; i < vPending.size(); i++)
+                LogPrint("net", "connection to %s timeout\n", vPending[i].second.ToString());
+            break;
+        }
 
-            CloseSocket(hSocket);
-            return false;
+        int64_t nWait = nDeadline - nNow;
+        if (nNext < vTry.size())
+            nWait = std::min(nWait, std::max(nNextAttempt - nNow, (int64_t) 0));
+
+        struct timeval timeout = MillisToTimeval(nWait);
+        fd_set fdsetSend;
+        fd_set fdsetError;
+        FD_ZERO(&fdsetSend);
+        FD_ZERO(&fdsetError);
+        SOCKET hSocketMax = 0;
+
+        for (unsigned int i = 0; i < vPending.size(); i++)
+        {
+            FD_SET(vPending[i].first, &fdsetSend);
+            FD_SET(vPending[i].first, &fdsetError);
+            hSocketMax = std::max(hSocketMax, vPending[i].first);
         }
+
+        // Windows reports a failed connect through the except set
+        int nRet = select(hSocketMax + 1, NULL, &fdsetSend, &fdsetError, &timeout);
+
+        if (nRet == SOCKET_ERROR)
+        {
+            LogPrintf("%s : select() failed: %s\n", __func__, NetworkErrorString(WSAGetLastError()));
+            break;
+        }
+
+        for (unsigned int i = 0; i < vPending.size() && !fRet; )
+        {
+            SOCKET hSocket = vPending[i].first;
+
+            if (!FD_ISSET(hSocket, &fdsetSend) && !FD_ISSET(hSocket, &fdsetError))
+            {
+                i++;
+                continue;
+            }
+
+            if (FinishConnect(hSocket, vPending[i].second))
+            {
+                hSocketRet = hSocket;
+                addrRet = vPending[i].second;
+                vPending.erase(vPending.begin() + i);
+                fRet = true;
+            }
+            else
+            {
+                // A refused attempt hands its turn to the next address right away
+                CloseSocket(vPending[i].first);
+                vPending.erase(vPending.begin() + i);
+                nNextAttempt = nNow;
+            }
+        }
+
+        if (fRet)
+            break;
     }
 
-    hSocketRet = hSocket;
-    return true;
+    // The losers of the race
+    for (unsigned int i = 0; i < vPending.size(); i++)
+        CloseSocket(vPending[i].first);
+
+    if (fRet && vTry.size() > 1)
+        LogPrint("net", "connected to %s after %dms, %u of %u addresses tried\n", addrRet.ToString(),
+                 GetTimeMillis() - nStart, nNext, vTry.size());
+
+    return fRet;
+}
+
+bool static ConnectSocketDirectly(const CService &addrConnect, SOCKET& hSocketRet, int nTimeout)
+{
+    CService addrRet;
+    return ConnectSocketDirectly(std::vector<CService>(1, addrConnect), hSocketRet, addrRet, nTimeout);
 }
 
 bool SetProxy(enum Network net, const proxyType &addrProxy)
@@ -665,8 +1021,21 @@ bool ConnectSocketByName(CService &addr, SOCKET& hSocketRet, const char *pszDest
     std::vector<CService> addrResolved;
     if (Lookup(strDest.c_str(), addrResolved, port, fNameLookup && !HaveNameProxy(), 256)) {
         if (addrResolved.size() > 0) {
-            addr = addrResolved[GetRand(addrResolved.size())];
-            return ConnectSocket(addr, hSocketRet, nTimeout);
+            // Still spread the load over all addresses, but race them instead of betting on one
+            std::random_shuffle(addrResolved.begin(), addrResolved.end(), GetRandInt);
+
+            proxyType proxyNet;
+
+            for (unsigned int i = 0; i < addrResolved.size(); i++)
+            {
+                if (GetProxy(addrResolved[i].GetNetwork(), proxyNet))
+                {
+                    addr = addrResolved[0];
+                    return ConnectSocket(addr, hSocketRet, nTimeout);
+                }
+            }
+
+            return ConnectSocketDirectly(addrResolved, hSocketRet, addr, nTimeout);
         }
     }
 
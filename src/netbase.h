@@ -9,18 +9,36 @@
 #include "netaddress.h"
 #include "serialize.h"
 
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <stdint.h>
 #include <string>
+#include <thread>
 #include <vector>
 
 extern int nConnectTimeout;
 extern bool fNameLookup;
+extern int64_t nDNSCacheTTL;
 
 //! -timeout default
 static const int DEFAULT_CONNECT_TIMEOUT = 5000;
 //! -dns default
 static const int DEFAULT_NAME_LOOKUP = true;
 static const bool DEFAULT_ALLOWPRIVATENET = false;
+//! -dnscachettl default, seconds a name lookup result is reused
+static const int64_t DEFAULT_DNS_CACHE_TTL = 5 * 60;
+//! Seconds a failed name lookup is remembered
+static const int64_t DNS_NEGATIVE_CACHE_TTL = 30;
+//! -dnsthreads default
+static const int DEFAULT_DNS_THREADS = 4;
+//! Maximum for -dnsthreads
+static const int MAX_DNS_THREADS = 16;
+//! Milliseconds a connection attempt gets before the next address is tried alongside it (RFC 8305)
+static const int CONNECT_ATTEMPT_DELAY = 250;
 
 class proxyType
 {
@@ -49,6 +67,14 @@ bool Lookup(const char *pszName, std::vector<CService>& vAddr, int portDefault,
 CService LookupNumeric(const char *pszName, int portDefault = 0);
 bool LookupSubNet(const char *pszName, CSubNet& subnet);
 bool ConnectSocket(const CService &addr, SOCKET& hSocketRet, int nTimeout, bool *outProxyConnectionFailed = 0);
+/**
+ * Connect to the first of vAddr that answers. Attempts are started CONNECT_ATTEMPT_DELAY
+ * apart (or as soon as the previous one fails) and raced, nTimeout covers the whole race.
+ * Proxies are not used.
+ */
+bool ConnectSocketDirectly(const std::vector<CService>& vAddr, SOCKET& hSocketRet, CService& addrRet, int nTimeout);
+/** Reorder addresses to alternate between IPv6 and IPv4, starting with the family of the first one */
+std::vector<CService> InterleaveAddressFamilies(const std::vector<CService>& vAddr);
 bool ConnectSocketByName(CService &addr, SOCKET& hSocketRet, const char *pszDest, int portDefault, int nTimeout, bool *outProxyConnectionFailed = 0);
 /** Return readable error string for a network error code */
 std::string NetworkErrorString(int err);
@@ -62,4 +88,54 @@ bool SetSocketNonBlocking(SOCKET& hSocket, bool fNonBlocking);
 struct timeval MillisToTimeval(int64_t nTimeout);
 void InterruptSocks5(bool interrupt);
 
+struct CDNSCacheStats
+{
+    uint64_t nHits;
+    uint64_t nMisses;
+    unsigned int nEntries;
+};
+
+CDNSCacheStats GetDNSCacheStats();
+void ClearDNSCache();
+
+/**
+ * Resolves host names on a small pool of threads so that callers with many
+ * names (DNS seeds, -addnode) can have all lookups in flight at once.
+ * Lookups for a name that is already being resolved share the same result.
+ * When the pool isn't running lookups are done by the caller.
+ */
+class CAsyncResolver
+{
+public:
+    typedef std::shared_future<std::vector<CNetAddr> > Result;
+
+    CAsyncResolver();
+    ~CAsyncResolver();
+
+    void Start(int nThreads);
+    void Stop();
+    bool IsRunning() const { return !vThreads.empty(); }
+
+    Result LookupHost(const std::string& strName, bool fAllowLookup);
+
+private:
+    struct Job
+    {
+        std::string strName;
+        bool fAllowLookup;
+        std::shared_ptr<std::promise<std::vector<CNetAddr> > > promise;
+    };
+
+    void ThreadResolver();
+
+    std::mutex mutexJobs;
+    std::condition_variable condJobs;
+    std::deque<Job> vJobs;
+    std::map<std::pair<std::string, bool>, Result> mapPending;
+    std::vector<std::thread> vThreads;
+    bool fStopRequested;
+};
+
+extern CAsyncResolver asyncResolver;
+
 #endif // BITCOIN_NETBASE_H
@@ -45,6 +45,12 @@ const char *DSTX="dstx";
 const char *DSEG="dseg";
 const char *DSEE="dsee";
 const char *DSEEP="dseep";
+const char *MNLISTVERSION="mnlistver";
+const char *GETMNLISTSUM="getmnlsum";
+const char *MNLISTSUM="mnlsum";
+const char *GETMNLISTBUCKETS="getmnlbkts";
+const char *MNLISTBUCKETS="mnlbkts";
+const char *GETMNENTRIES="getmnents";
 // TODO
 // "checkpoint"
 // TODO
@@ -116,6 +122,12 @@ const static std::string allNetMessageTypes[] = {
     NetMsgType::DSEG,
     NetMsgType::DSEE,
     NetMsgType::DSEEP,
+    NetMsgType::MNLISTVERSION,
+    NetMsgType::GETMNLISTSUM,
+    NetMsgType::MNLISTSUM,
+    NetMsgType::GETMNLISTBUCKETS,
+    NetMsgType::MNLISTBUCKETS,
+    NetMsgType::GETMNENTRIES,
 };
 const static std::vector<std::string> allNetMessageTypesVec(allNetMessageTypes, allNetMessageTypes+ARRAYLEN(allNetMessageTypes));
 
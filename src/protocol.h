@@ -233,6 +233,12 @@ extern const char *DSTX;
 extern const char *DSEG;
 extern const char *DSEE;
 extern const char *DSEEP;
+extern const char *MNLISTVERSION;
+extern const char *GETMNLISTSUM;
+extern const char *MNLISTSUM;
+extern const char *GETMNLISTBUCKETS;
+extern const char *MNLISTBUCKETS;
+extern const char *GETMNENTRIES;
 // TODO: add all commands
 };
 
@@ -323,7 +323,11 @@ bool WalletModel::setWalletLocked(bool locked, const SecureString &passPhrase, b
     else
     {
         // Unlock
-        return wallet->Unlock(passPhrase, anonymizeOnly);
+        if (!wallet->Unlock(passPhrase, anonymizeOnly))
+            return false;
+
+        wallet->CacheSigningKeys();
+        return true;
     }
 }
 
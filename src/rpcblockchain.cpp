@@ -5,6 +5,7 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "blockstats.h"
 #include "checkpoints.h"
 #include "main.h"
 #include "utiltime.h"
@@ -232,6 +233,22 @@ UniValue getrawmempool(const UniValue& params, bool fHelp)
     return a;
 }
 
+UniValue savemempool(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "savemempool\n"
+            "Writes the memory pool to mempool.dat in the data directory.");
+
+    if (!IsMempoolLoaded())
+        throw runtime_error("The mempool was not loaded yet");
+
+    if (!DumpMempool())
+        throw runtime_error("Unable to dump mempool to disk");
+
+    return NullUniValue;
+}
+
 UniValue getblockhash(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -385,6 +402,122 @@ UniValue getblockversionstats(const UniValue& params, bool fHelp) {
     return results;
 }
 
+static UniValue BlockStatsRangeToJSON(const CBlockStatsRange& range)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("from",              range.nFirst));
+    obj.push_back(Pair("to",                range.nLast));
+    obj.push_back(Pair("blocks",            range.GetBlocks()));
+    obj.push_back(Pair("posblocks",         (uint64_t) range.nStakeBlocks));
+    obj.push_back(Pair("powblocks",         (uint64_t) (range.GetBlocks() - range.nStakeBlocks)));
+    obj.push_back(Pair("timespan",          range.nTimeSpan));
+    obj.push_back(Pair("txs",               range.nTx));
+    obj.push_back(Pair("txrate",            range.nTimeSpan > 0 ? (double) range.nTx / range.nTimeSpan : 0.0));
+    obj.push_back(Pair("size",              range.nSize));
+    obj.push_back(Pair("avgsize",           (double) range.nSize / range.GetBlocks()));
+    obj.push_back(Pair("fees",              ValueFromAmount(range.nFees)));
+    obj.push_back(Pair("stakereward",       ValueFromAmount(range.nStakeReward)));
+    obj.push_back(Pair("masternodepaid",    ValueFromAmount(range.nMasternodePaid)));
+    obj.push_back(Pair("developerpaid",     ValueFromAmount(range.nDevPaid)));
+    obj.push_back(Pair("mint",              ValueFromAmount(range.nMint)));
+
+    UniValue versions(UniValue::VOBJ);
+
+    for (map<int32_t, uint32_t>::const_iterator it = range.mapVersions.begin(); it != range.mapVersions.end(); ++it)
+        versions.push_back(Pair(strprintf("%d", it->first), (uint64_t) it->second));
+
+    obj.push_back(Pair("versions", versions));
+    return obj;
+}
+
+UniValue getblockstats(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() < 2 || params.size() > 3)
+        throw runtime_error(
+            "getblockstats <from> <to> [interval]\n"
+            "Returns transaction, fee, size and reward totals of blocks <from> to <to>.\n"
+            "With [interval], returns them for every <interval> blocks of the range.\n"
+            "Needs -blockstatsindex.");
+
+    if (!fBlockStatsIndex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Block statistics index is not enabled, start with -blockstatsindex");
+
+    int nFirst = std::min(params[0].get_int(), params[1].get_int());
+    int nLast = std::max(params[0].get_int(), params[1].get_int());
+    int nInterval = params.size() > 2 ? params[2].get_int() : 0;
+
+    if (nFirst < 0 || nLast > nBestHeight)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+
+    if (nInterval < 0 || (nInterval > 0 && (nLast - nFirst) / nInterval >= MAX_BLOCKSTATS_INTERVALS))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Interval must give at most %d intervals", MAX_BLOCKSTATS_INTERVALS));
+
+    LOCK(cs_main);
+    CBlockStatsRange range;
+
+    if (nInterval == 0)
+    {
+        if (!GetBlockStatsRange(nFirst, nLast, range))
+            throw JSONRPCError(RPC_MISC_ERROR, "Block statistics index is still being built, try again later");
+
+        return BlockStatsRangeToJSON(range);
+    }
+
+    UniValue result(UniValue::VARR);
+
+    for (int nFrom = nFirst; nFrom <= nLast; nFrom += nInterval)
+    {
+        if (!GetBlockStatsRange(nFrom, std::min(nFrom + nInterval - 1, nLast), range))
+            throw JSONRPCError(RPC_MISC_ERROR, "Block statistics index is still being built, try again later");
+
+        result.push_back(BlockStatsRangeToJSON(range));
+    }
+
+    return result;
+}
+
+UniValue getblockstorageinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getblockstorageinfo\n"
+            "Returns block file format and I/O statistics since startup.");
+
+    CBlockStorageStats stats = GetBlockStorageStats();
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("compressblocks",       fCompressBlocks));
+    obj.push_back(Pair("currentfileformat",    fCompressBlocks ? "compressed" : "raw"));
+    obj.push_back(Pair("blockswritten",        stats.nBlocksWritten));
+    obj.push_back(Pair("bytesraw",             stats.nBytesRaw));
+    obj.push_back(Pair("bytesstored",          stats.nBytesStored));
+
+    double dSavings = 0;
+
+    if (stats.nBytesRaw > 0)
+        dSavings = 100.0 * (1.0 - static_cast<double>(stats.nBytesStored) / static_cast<double>(stats.nBytesRaw));
+
+    obj.push_back(Pair("savingspercent",       dSavings));
+    obj.push_back(Pair("compressedblocksread", stats.nBlocksRead));
+    obj.push_back(Pair("headeronlyreads",      stats.nHeadersRead));
+
+    double dThroughput = 0;
+
+    if (stats.nInflateMicros > 0)
+        dThroughput = static_cast<double>(stats.nBytesInflated) / static_cast<double>(stats.nInflateMicros);
+
+    obj.push_back(Pair("inflatemicros",        stats.nInflateMicros));
+    obj.push_back(Pair("inflatembpersec",      dThroughput));
+    obj.push_back(Pair("recordcachehits",      stats.nRecordCacheHits));
+    obj.push_back(Pair("flushes",              stats.nFlushes));
+    obj.push_back(Pair("avgflushms",           stats.nFlushes ? stats.nFlushMicros / 1000.0 / stats.nFlushes : 0.0));
+    obj.push_back(Pair("maxflushms",           stats.nMaxFlushMicros / 1000.0));
+    obj.push_back(Pair("flushwaits",           stats.nFlushWaits));
+    obj.push_back(Pair("avgflushwaitms",       stats.nFlushWaits ? stats.nFlushWaitMicros / 1000.0 / stats.nFlushWaits : 0.0));
+
+    return obj;
+}
+
 UniValue invalidateblock(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -8,6 +8,7 @@
 #include "db.h"
 #include "init.h"
 #include "masternode.h"
+#include "masternodecollateral.h"
 #include "activemasternode.h"
 #include "masternodeconfig.h"
 #include "bitcoinrpc.h"
@@ -80,9 +81,9 @@ UniValue masternode(const UniValue& params, bool fHelp)
                    strCommand != "list" && strCommand != "list-conf" && strCommand != "count" &&
                    strCommand != "enforce" && strCommand != "debug" && strCommand != "current" &&
                    strCommand != "winners" && strCommand != "genkey" && strCommand != "connect" &&
-                   strCommand != "outputs"))
+                   strCommand != "outputs" && strCommand != "stats"))
         throw runtime_error("masternode <start|start-alias|start-many|stop|stop-alias|stop-many|list|list-conf|"
-                            "count|debug|current|winners|genkey|enforce|outputs> [passphrase]\n");
+                            "count|debug|current|winners|genkey|enforce|outputs|stats> [passphrase]\n");
 
     if (strCommand == "stop")
     {
@@ -272,6 +273,46 @@ UniValue masternode(const UniValue& params, bool fHelp)
     if (strCommand == "count")
         return (int) vecMasternodes.size();
 
+    if (strCommand == "stats")
+    {
+        CMasternodeMessageStats stats = mnodeman.GetMessageStats();
+        uint64_t nHits, nMisses, nSize;
+        darkSendSigner.GetVerifyCacheStats(nHits, nMisses, nSize);
+
+        UniValue dsee(UniValue::VOBJ);
+        dsee.push_back(Pair("received", stats.nDseeReceived));
+        dsee.push_back(Pair("duplicate", stats.nDseeDuplicate));
+        dsee.push_back(Pair("rejectedcached", stats.nDseeRejectedCached));
+        dsee.push_back(Pair("verified", stats.nDseeVerified));
+        dsee.push_back(Pair("new", stats.nDseeNew));
+
+        UniValue dseep(UniValue::VOBJ);
+        dseep.push_back(Pair("received", stats.nDseepReceived));
+        dseep.push_back(Pair("duplicate", stats.nDseepDuplicate));
+        dseep.push_back(Pair("verified", stats.nDseepVerified));
+
+        UniValue listsync(UniValue::VOBJ);
+        listsync.push_back(Pair("summariessent", stats.nListSummariesSent));
+        listsync.push_back(Pair("entriessent", stats.nListEntriesSent));
+
+        UniValue sigcache(UniValue::VOBJ);
+        sigcache.push_back(Pair("hits", nHits));
+        sigcache.push_back(Pair("misses", nMisses));
+        sigcache.push_back(Pair("size", nSize));
+
+        UniValue collateral(UniValue::VOBJ);
+        collateral.push_back(Pair("watched", (uint64_t) collateralWatcher.size()));
+        collateral.push_back(Pair("events", collateralWatcher.GetEventCount()));
+
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("dsee", dsee));
+        obj.push_back(Pair("dseep", dseep));
+        obj.push_back(Pair("listsync", listsync));
+        obj.push_back(Pair("sigcache", sigcache));
+        obj.push_back(Pair("collateral", collateral));
+        return obj;
+    }
+
     if (strCommand == "start")
     {
         if (!fMasterNode)
@@ -9,9 +9,25 @@
 #include "init.h"
 #include "miner.h"
 #include "bitcoinrpc.h"
+#include "feeestimator.h"
+#include "stakeportfolio.h"
 
 using namespace std;
 
+static UniValue StakePolicyToJSON(const CStakePolicy& policy)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("targetvalue", ValueFromAmount(policy.nTargetValue)));
+    obj.push_back(Pair("targetoutputs", (uint64_t) policy.nTargetOutputs));
+    obj.push_back(Pair("splitage", policy.nSplitAge));
+    obj.push_back(Pair("splitthreshold", ValueFromAmount(policy.nSplitThreshold)));
+    obj.push_back(Pair("combinethreshold", ValueFromAmount(policy.nCombineThreshold)));
+    obj.push_back(Pair("combineinputs", (uint64_t) policy.nMaxCombineInputs));
+    obj.push_back(Pair("consolidate", policy.fConsolidate));
+
+    return obj;
+}
+
 UniValue getsubsidy(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() > 1)
@@ -82,9 +98,78 @@ UniValue getstakinginfo(const UniValue& params, bool fHelp)
     obj.push_back(Pair("Net Stake Weight", (uint64_t) nNetworkWeight));
     obj.push_back(Pair("Expected Time", nExpectedTime));
 
+    uint64_t nKeyHits, nKeyMisses;
+    unsigned int nKeysCached;
+    pwalletMain->GetSigningKeyCacheStats(nKeyHits, nKeyMisses, nKeysCached);
+
+    UniValue keycache(UniValue::VOBJ);
+    keycache.push_back(Pair("size", (uint64_t) nKeysCached));
+    keycache.push_back(Pair("hits", nKeyHits));
+    keycache.push_back(Pair("misses", nKeyMisses));
+    obj.push_back(Pair("Signing Key Cache", keycache));
+
+    CStakePortfolioStats stats = stakePortfolio.GetStats();
+    UniValue portfolio(UniValue::VOBJ);
+    portfolio.push_back(Pair("outputs", (uint64_t) stats.nOutputs));
+    portfolio.push_back(Pair("kernelsearches", stats.nKernelSearches));
+    portfolio.push_back(Pair("kernelsearchms", (double) stats.nLastKernelSearchMicros / 1000));
+    portfolio.push_back(Pair("meankernelsearchms", stats.nKernelSearches ?
+                             (double) stats.nKernelSearchMicros / stats.nKernelSearches / 1000 : 0.0));
+    portfolio.push_back(Pair("maxkernelsearchms", (double) stats.nMaxKernelSearchMicros / 1000));
+    portfolio.push_back(Pair("consolidations", stats.nConsolidations));
+    portfolio.push_back(Pair("inputsconsolidated", stats.nInputsConsolidated));
+    portfolio.push_back(Pair("lastconsolidation", stats.nLastConsolidation));
+    portfolio.push_back(Pair("policy", StakePolicyToJSON(stakePortfolio.GetPolicy())));
+    obj.push_back(Pair("Stake Portfolio", portfolio));
+
     return obj;
 }
 
+UniValue estimatefee(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+    {
+        throw runtime_error(
+            strprintf("estimatefee <nblocks>\n"
+                      "Returns the fee per kilobyte that recently got transactions confirmed within\n"
+                      "<nblocks> blocks (1-%d), or -1 if there isn't enough data yet.", FEE_ESTIMATOR_MAX_CONFIRMS));
+    }
+
+    int nBlocks = params[0].get_int();
+
+    if (nBlocks < 1 || nBlocks > FEE_ESTIMATOR_MAX_CONFIRMS)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "nblocks out of range");
+
+    int64_t nFee = feeEstimator.EstimateFee(nBlocks);
+
+    if (nFee < 0)
+        return -1.0;
+
+    return ValueFromAmount(nFee);
+}
+
+UniValue setstakepolicy(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 2)
+    {
+        throw runtime_error(
+            "setstakepolicy <option> <value>\n"
+            "Changes how stake outputs are split and combined until the next restart.\n"
+            "<option> is one of targetvalue, targetoutputs, splitage, splitthreshold,\n"
+            "combinethreshold, combineinputs and consolidate, as the -stake<option> settings.\n"
+            "Returns the policy now in effect.");
+    }
+
+    CStakePolicy policy = stakePortfolio.GetPolicy();
+
+    if (!policy.Set(params[0].get_str(), params[1].get_str()))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown option or invalid value");
+
+    stakePortfolio.SetPolicy(policy);
+
+    return StakePolicyToJSON(policy);
+}
+
 UniValue getworkex(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() > 2)
@@ -7,6 +7,7 @@
 #include "netbase.h"
 #include "net.h"
 #include "bitcoinrpc.h"
+#include "blockserver.h"
 #include "alert.h"
 #include "wallet.h"
 #include "db.h"
@@ -14,6 +15,7 @@
 #include "spork.h"
 #include "univalue.h"
 #include "init.h"
+#include "scheduler.h"
 
 UniValue getconnectioncount(const UniValue& params, bool fHelp)
 {
@@ -51,7 +53,21 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
         obj.push_back(Pair("services", strprintf("%016x", pnode->nServices)));
         obj.push_back(Pair("lastsend", (int64_t) pnode->nLastSend));
         obj.push_back(Pair("lastrecv", (int64_t) pnode->nLastRecv));
+        obj.push_back(Pair("bytessent", (uint64_t) pnode->nSendBytes));
+        obj.push_back(Pair("bytesrecv", (uint64_t) pnode->nRecvBytes));
         obj.push_back(Pair("conntime", pnode->nTimeConnected));
+
+        if (pnode->nPingUsecTime > 0)
+            obj.push_back(Pair("pingtime", ((double)pnode->nPingUsecTime) / 1e6));
+
+        if (pnode->nMinPingUsecTime < std::numeric_limits<int64_t>::max())
+            obj.push_back(Pair("minping", ((double)pnode->nMinPingUsecTime) / 1e6));
+
+        if (pnode->nPingNonceSent != 0)
+            obj.push_back(Pair("pingwait", ((double)(GetTimeMicros() - pnode->nPingUsecStart)) / 1e6));
+
+        obj.push_back(Pair("lastblock", pnode->nLastBlockTime));
+        obj.push_back(Pair("lasttransaction", pnode->nLastTXTime));
         obj.push_back(Pair("version", pnode->nVersion));
         obj.push_back(Pair("subver", pnode->strSubVer));
         obj.push_back(Pair("inbound", pnode->fInbound));
@@ -72,12 +88,243 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
         }
 
         obj.push_back(Pair("misbehaviors", marray));
+
+        int64_t nConnected = std::max((int64_t) 1, GetTime() - pnode->nTimeConnected);
+        obj.push_back(Pair("blocksinflight", pnode->nBlocksInFlight.load()));
+        obj.push_back(Pair("blocksrecv", (uint64_t) pnode->nBlocksRecv));
+        obj.push_back(Pair("blockbytesrecv", (uint64_t) pnode->nBlockBytesRecv));
+        obj.push_back(Pair("blockdownloadrate", (uint64_t) pnode->nBlockBytesRecv / nConnected));
+        obj.push_back(Pair("stalling", pnode->IsStallingBlockDownload(GetTime(),
+                g_connman ? g_connman->GetBlockStallingTimeout() : DEFAULT_BLOCK_STALLING_TIMEOUT)));
+
+        CNode::mapMsgCmdSize mapSendBytesPerMsgCmd, mapRecvBytesPerMsgCmd;
+        pnode->GetBytesPerMsgCmd(mapSendBytesPerMsgCmd, mapRecvBytesPerMsgCmd);
+
+        UniValue sendPerMsgCmd(UniValue::VOBJ);
+        BOOST_FOREACH(const CNode::mapMsgCmdSize::value_type &i, mapSendBytesPerMsgCmd)
+        {
+            if (i.second > 0)
+                sendPerMsgCmd.push_back(Pair(i.first, i.second));
+        }
+
+        obj.push_back(Pair("bytessent_per_msg", sendPerMsgCmd));
+
+        UniValue recvPerMsgCmd(UniValue::VOBJ);
+        BOOST_FOREACH(const CNode::mapMsgCmdSize::value_type &i, mapRecvBytesPerMsgCmd)
+        {
+            if (i.second > 0)
+                recvPerMsgCmd.push_back(Pair(i.first, i.second));
+        }
+
+        obj.push_back(Pair("bytesrecv_per_msg", recvPerMsgCmd));
+        ret.push_back(obj);
+    }
+
+    return ret;
+}
+
+UniValue getnettotals(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 0)
+        throw runtime_error(
+            "getnettotals\n"
+            "\nReturns information about network traffic, including bytes in, bytes out,\n"
+            "and current time.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"totalbytesrecv\": n,   (numeric) Total bytes received\n"
+            "  \"totalbytessent\": n,   (numeric) Total bytes sent\n"
+            "  \"timemillis\": t,       (numeric) Current time in milliseconds since the epoch\n"
+            "  \"uploadtarget\":\n"
+            "  {\n"
+            "    \"timeframe\": n,                         (numeric) Length of the measuring timeframe in seconds\n"
+            "    \"target\": n,                            (numeric) Target in bytes\n"
+            "    \"target_reached\": true|false,           (boolean) True if target is reached\n"
+            "    \"serve_historical_blocks\": true|false,  (boolean) True if serving historical blocks\n"
+            "    \"bytes_left_in_cycle\": t,               (numeric) Bytes left in current time cycle\n"
+            "    \"time_left_in_cycle\": t                 (numeric) Seconds left in current time cycle\n"
+            "  },\n"
+            "  \"inboundeviction\":\n"
+            "  {\n"
+            "    \"evicted\": n,   (numeric) Inbound peers evicted to make room for new connections\n"
+            "    \"refused\": n    (numeric) Inbound connections refused because no peer could be evicted\n"
+            "  },\n"
+            "  \"blockserver\":\n"
+            "  {\n"
+            "    \"threads\": n,     (numeric) Threads serving historical blocks\n"
+            "    \"queued\": n,      (numeric) Block reads waiting for a thread\n"
+            "    \"served\": n,      (numeric) Blocks served by the block server\n"
+            "    \"notfound\": n,    (numeric) Blocks that could not be read and were answered with notfound\n"
+            "    \"bytes\": n,       (numeric) Bytes of block data served\n"
+            "    \"avgreadms\": x,   (numeric) Average time to read a block from disk\n"
+            "    \"avgwaitms\": x,   (numeric) Average time a read waited in the queue\n"
+            "    \"maxwaitms\": x    (numeric) Longest time a read waited in the queue\n"
+            "  },\n"
+            "  \"connect\":\n"
+            "  {\n"
+            "    \"workers\": n,     (numeric) Threads opening outbound connections\n"
+            "    \"inflight\": n,    (numeric) Outbound connections being opened right now\n"
+            "    \"attempts\": n,    (numeric) Outbound connection attempts\n"
+            "    \"succeeded\": n,   (numeric) Attempts that ended in a connection\n"
+            "    \"avgms\": x        (numeric) Average time a successful attempt took\n"
+            "  },\n"
+            "  \"dnscache\":\n"
+            "  {\n"
+            "    \"entries\": n,     (numeric) Names held in the resolver cache\n"
+            "    \"hits\": n,        (numeric) Lookups answered from the cache\n"
+            "    \"misses\": n       (numeric) Lookups that went to the system resolver\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getnettotals", "")
+            + HelpExampleRpc("getnettotals", "")
+        );
+
+    if(!g_connman)
+        throw JSONRPCError(RPC_CLIENT_P2P_DISABLED, "Error: Peer-to-peer functionality missing or disabled");
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("totalbytesrecv", g_connman->GetTotalBytesRecv()));
+    obj.push_back(Pair("totalbytessent", g_connman->GetTotalBytesSent()));
+    obj.push_back(Pair("timemillis", GetTimeMillis()));
+
+    UniValue outboundLimit(UniValue::VOBJ);
+    outboundLimit.push_back(Pair("timeframe", g_connman->GetMaxOutboundTimeframe()));
+    outboundLimit.push_back(Pair("target", g_connman->GetMaxOutboundTarget()));
+    outboundLimit.push_back(Pair("target_reached", g_connman->OutboundTargetReached(false)));
+    outboundLimit.push_back(Pair("serve_historical_blocks", !g_connman->OutboundTargetReached(true)));
+    outboundLimit.push_back(Pair("bytes_left_in_cycle", g_connman->GetOutboundTargetBytesLeft()));
+    outboundLimit.push_back(Pair("time_left_in_cycle", g_connman->GetMaxOutboundTimeLeftInCycle()));
+    obj.push_back(Pair("uploadtarget", outboundLimit));
+
+    UniValue inboundEviction(UniValue::VOBJ);
+    inboundEviction.push_back(Pair("evicted", g_connman->GetInboundEvictedCount()));
+    inboundEviction.push_back(Pair("refused", g_connman->GetInboundRefusedCount()));
+    obj.push_back(Pair("inboundeviction", inboundEviction));
+
+    CBlockServerStats stats = blockServer.GetStats();
+    UniValue blockServing(UniValue::VOBJ);
+    blockServing.push_back(Pair("threads", stats.nThreads));
+    blockServing.push_back(Pair("queued", (uint64_t) stats.nQueued));
+    blockServing.push_back(Pair("served", stats.nBlocksServed));
+    blockServing.push_back(Pair("notfound", stats.nBlocksNotFound));
+    blockServing.push_back(Pair("bytes", stats.nBytesServed));
+    blockServing.push_back(Pair("avgreadms", stats.nBlocksServed ? (double) stats.nReadMicros / stats.nBlocksServed / 1000 : 0.0));
+    blockServing.push_back(Pair("avgwaitms", stats.nBlocksServed ? (double) stats.nWaitMicros / stats.nBlocksServed / 1000 : 0.0));
+    blockServing.push_back(Pair("maxwaitms", (double) stats.nMaxWaitMicros / 1000));
+    obj.push_back(Pair("blockserver", blockServing));
+
+    CConnman::ConnectStats connectStats = g_connman->GetConnectStats();
+    UniValue connect(UniValue::VOBJ);
+    connect.push_back(Pair("workers", connectStats.nWorkers));
+    connect.push_back(Pair("inflight", (uint64_t) connectStats.nInFlight));
+    connect.push_back(Pair("attempts", connectStats.nAttempts));
+    connect.push_back(Pair("succeeded", connectStats.nSucceeded));
+    connect.push_back(Pair("avgms", connectStats.nSucceeded ? (double) connectStats.nSucceededMillis / connectStats.nSucceeded : 0.0));
+    obj.push_back(Pair("connect", connect));
+
+    CDNSCacheStats dnsStats = GetDNSCacheStats();
+    UniValue dnsCache(UniValue::VOBJ);
+    dnsCache.push_back(Pair("entries", (uint64_t) dnsStats.nEntries));
+    dnsCache.push_back(Pair("hits", dnsStats.nHits));
+    dnsCache.push_back(Pair("misses", dnsStats.nMisses));
+    obj.push_back(Pair("dnscache", dnsCache));
+
+    return obj;
+}
+
+UniValue getschedulerinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 0)
+        throw runtime_error(
+            "getschedulerinfo\n"
+            "\nReturns the periodic maintenance tasks run by the scheduler.\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"name\": \"name\",        (string) Task name\n"
+            "    \"class\": \"class\",      (string) Lock class, tasks of the same class never run at once\n"
+            "    \"interval\": n,         (numeric) Current interval in milliseconds, jitter included\n"
+            "    \"runs\": n,             (numeric) Number of completed runs\n"
+            "    \"meanms\": n,           (numeric) Mean run time in milliseconds\n"
+            "    \"maxms\": n,            (numeric) Longest run time in milliseconds\n"
+            "    \"maxlatems\": n,        (numeric) Longest delay between a run being due and starting\n"
+            "    \"running\": true|false, (boolean) Whether the task is running right now\n"
+            "    \"nextdue\": ttt         (numeric) Time of the next run in seconds since epoch\n"
+            "  }, ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getschedulerinfo", "")
+            + HelpExampleRpc("getschedulerinfo", "")
+       );
+
+    if (!shared_scheduler)
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Scheduler not running");
+
+    UniValue ret(UniValue::VARR);
+
+    BOOST_FOREACH(const CSchedulerTaskInfo& info, shared_scheduler->getTaskInfo())
+    {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("name", info.strName));
+        obj.push_back(Pair("class", GetSchedulerClassName(info.nClass)));
+        obj.push_back(Pair("interval", info.nIntervalMillis));
+        obj.push_back(Pair("runs", info.nRuns));
+        obj.push_back(Pair("meanms", info.nRuns ? (double) info.nTotalMicros / info.nRuns / 1000 : 0.0));
+        obj.push_back(Pair("maxms", (double) info.nMaxMicros / 1000));
+        obj.push_back(Pair("maxlatems", (double) info.nMaxLateMicros / 1000));
+        obj.push_back(Pair("running", info.fRunning));
+        obj.push_back(Pair("nextdue", (int64_t) boost::chrono::system_clock::to_time_t(info.nextDue)));
         ret.push_back(obj);
     }
 
     return ret;
 }
 
+UniValue getmemoryinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 0)
+        throw runtime_error(
+            "getmemoryinfo\n"
+            "\nReturns usage of the locked memory pool that holds keys and passphrases.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"locked\": {\n"
+            "    \"used\": n,            (numeric) Bytes handed out\n"
+            "    \"free\": n,            (numeric) Bytes available in the arenas\n"
+            "    \"total\": n,           (numeric) Size of all arenas\n"
+            "    \"locked\": n,          (numeric) Bytes the OS agreed to lock, less than total if locking failed\n"
+            "    \"chunks_used\": n,     (numeric) Allocations served\n"
+            "    \"chunks_free\": n,     (numeric) Free chunks\n"
+            "    \"arenas\": n,          (numeric) Number of arenas\n"
+            "    \"fallback_allocs\": n  (numeric) Allocations that had to lock their own pages\n"
+            "  },\n"
+            "  \"lockedpages\": n       (numeric) Pages locked for fallback allocations\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getmemoryinfo", "")
+            + HelpExampleRpc("getmemoryinfo", "")
+       );
+
+    LockedPoolManager::Stats stats = LockedPoolManager::Instance().stats();
+
+    UniValue locked(UniValue::VOBJ);
+    locked.push_back(Pair("used", (uint64_t) stats.used));
+    locked.push_back(Pair("free", (uint64_t) stats.free));
+    locked.push_back(Pair("total", (uint64_t) stats.total));
+    locked.push_back(Pair("locked", (uint64_t) stats.locked));
+    locked.push_back(Pair("chunks_used", (uint64_t) stats.chunks_used));
+    locked.push_back(Pair("chunks_free", (uint64_t) stats.chunks_free));
+    locked.push_back(Pair("arenas", (uint64_t) stats.arenas));
+    locked.push_back(Pair("fallback_allocs", stats.fallback_allocs));
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("locked", locked));
+    obj.push_back(Pair("lockedpages", LockedPageManager::instance.GetLockedPageCount()));
+
+    return obj;
+}
+
 UniValue addnode(const UniValue& params, bool fHelp)
 {
     string strCommand;
@@ -6,6 +6,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "wallet.h"
+#include "walletcheck.h"
 #include "walletdb.h"
 #include "bitcoinrpc.h"
 #include "init.h"
@@ -1468,15 +1469,28 @@ UniValue gettransaction(const UniValue& params, bool fHelp)
 
 UniValue backupwallet(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 1)
+    if (fHelp || params.size() < 1 || params.size() > 2)
     {
         throw runtime_error(
-            "backupwallet <destination>\n"
-            "Safely copies wallet.dat to destination, which can be a directory or a path with filename.");
+            "backupwallet <destination> [base]\n"
+            "Safely copies wallet.dat to destination, which can be a directory or a path with filename.\n"
+            "The wallet stays usable while the copy is made.\n"
+            "With base, the path of an earlier full backup, only the changes since then are written.\n"
+            "Use restorewalletbackup to turn base and the changes back into a wallet file.");
     }
 
     string strDest = params[0].get_str();
 
+    if (params.size() > 1)
+    {
+        CWalletBackupInfo info;
+
+        if (!BackupWalletDifferential(*pwalletMain, params[1].get_str(), strDest, info))
+            throw JSONRPCError(RPC_WALLET_ERROR, "Error: Wallet backup failed!");
+
+        return NullUniValue;
+    }
+
     if (!BackupWallet(*pwalletMain, strDest))
         throw JSONRPCError(RPC_WALLET_ERROR, "Error: Wallet backup failed!");
 
@@ -1484,6 +1498,42 @@ UniValue backupwallet(const UniValue& params, bool fHelp)
 }
 
 
+UniValue restorewalletbackup(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() < 2 || params.size() > 3)
+    {
+        throw runtime_error(
+            "restorewalletbackup <base> <destination> [changes]\n"
+            "Writes the wallet file stored in the full backup base, with the changes from a backup made\n"
+            "with backupwallet <file> <base> applied, to destination. The result is checked against the\n"
+            "backups before it is written. Stop the node and move it in place of wallet.dat to use it.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"records\": n,    (numeric) Number of records in the restored wallet\n"
+            "  \"hash\": \"hex\"    (string) Hash of the restored wallet's records\n"
+            "}\n");
+    }
+
+    string strBase = params[0].get_str();
+    string strDest = params[1].get_str();
+    string strChanges = params.size() > 2 ? params[2].get_str() : "";
+
+    if (boost::filesystem::exists(strDest))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Error: destination already exists");
+
+    CWalletBackupInfo info;
+
+    if (!RestoreWalletBackup(strBase, strChanges, strDest, info))
+        throw JSONRPCError(RPC_WALLET_ERROR, "Error: Wallet restore failed!");
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("records", (uint64_t) info.nRecords));
+    result.push_back(Pair("hash", info.hash.GetHex()));
+
+    return result;
+}
+
+
 UniValue keypoolrefill(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() > 1)
@@ -1613,6 +1663,8 @@ UniValue walletpassphrase(const UniValue& params, bool fHelp)
     else
         fWalletUnlockStakingOnly = false;
 
+    pwalletMain->CacheSigningKeys();
+
     return NullUniValue;
 }
 
@@ -1965,14 +2017,18 @@ UniValue reservebalance(const UniValue& params, bool fHelp)
 // ppcoin: check wallet integrity
 UniValue checkwallet(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() > 0)
+    if (fHelp || params.size() > 1)
         throw runtime_error(
-            "checkwallet\n"
-            "Check wallet for integrity.\n");
+            "checkwallet [full=false]\n"
+            "Check wallet for integrity.\n"
+            "Only transactions that changed since the last clean check are looked at, unless full is true.\n");
+
+    bool fFull = params.size() > 0 && params[0].get_bool();
 
     int nMismatchSpent;
     int64_t nBalanceInQuestion;
-    pwalletMain->FixSpentCoins(nMismatchSpent, nBalanceInQuestion, true);
+    if (!pwalletMain->FixSpentCoins(nMismatchSpent, nBalanceInQuestion, true, fFull))
+        throw JSONRPCError(RPC_MISC_ERROR, "A wallet check is already running, see getwalletcheckinfo");
     UniValue result(UniValue::VOBJ);
     if (nMismatchSpent == 0)
         result.push_back(Pair("wallet check passed", true));
@@ -1988,14 +2044,18 @@ UniValue checkwallet(const UniValue& params, bool fHelp)
 // ppcoin: repair wallet
 UniValue repairwallet(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() > 0)
+    if (fHelp || params.size() > 1)
         throw runtime_error(
-            "repairwallet\n"
-            "Repair wallet if checkwallet reports any problem.\n");
+            "repairwallet [full=false]\n"
+            "Repair wallet if checkwallet reports any problem.\n"
+            "Only transactions that changed since the last clean check are looked at, unless full is true.\n");
+
+    bool fFull = params.size() > 0 && params[0].get_bool();
 
     int nMismatchSpent;
     int64_t nBalanceInQuestion;
-    pwalletMain->FixSpentCoins(nMismatchSpent, nBalanceInQuestion);
+    if (!pwalletMain->FixSpentCoins(nMismatchSpent, nBalanceInQuestion, false, fFull))
+        throw JSONRPCError(RPC_MISC_ERROR, "A wallet check is already running, see getwalletcheckinfo");
     UniValue result(UniValue::VOBJ);
     if (nMismatchSpent == 0)
         result.push_back(Pair("wallet check passed", true));
@@ -2007,6 +2067,42 @@ UniValue repairwallet(const UniValue& params, bool fHelp)
     return result;
 }
 
+UniValue getwalletcheckinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 0)
+        throw runtime_error(
+            "getwalletcheckinfo\n"
+            "Progress of the running checkwallet or repairwallet, or the result of the last one.\n");
+
+    CWalletCheckStatus status = GetWalletCheckStatus();
+    UniValue result(UniValue::VOBJ);
+
+    result.push_back(Pair("running", status.fRunning));
+
+    if (status.nStartTime == 0)
+        return result;
+
+    result.push_back(Pair("mode", status.fIncremental ? "incremental" : "full"));
+    result.push_back(Pair("repair", status.fRepair));
+    result.push_back(Pair("started", status.nStartTime));
+    if (!status.fRunning)
+        result.push_back(Pair("finished", status.nEndTime));
+    result.push_back(Pair("wallettransactions", (int) status.nWalletTx));
+    result.push_back(Pair("tocheck", (int) status.nToCheck));
+    result.push_back(Pair("checked", (int) status.nChecked));
+    result.push_back(Pair("mismatched", (int) status.nMismatch));
+    result.push_back(Pair("amount", ValueFromAmount(status.nBalanceInQuestion)));
+    if (!status.fRunning && status.fRepair)
+        result.push_back(Pair("repaired", (int) status.nRepaired));
+    if (status.fIncremental)
+    {
+        result.push_back(Pair("sinceblock", status.checkpoint.hashBlock.GetHex()));
+        result.push_back(Pair("sinceheight", status.checkpoint.nHeight));
+    }
+
+    return result;
+}
+
 // Neutron: resend unconfirmed wallet transactions
 UniValue resendtx(const UniValue& params, bool fHelp)
 {
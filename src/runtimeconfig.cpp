@@ -0,0 +1,382 @@
+// Copyright (c) 2016-2020 The Neutron Developers
+//
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "runtimeconfig.h"
+#include "main.h"
+#include "net.h"
+#include "scheduler.h"
+#include "sync.h"
+#include "util.h"
+#include "utilstrencodings.h"
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <limits>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/foreach.hpp>
+
+using namespace std;
+
+// Declared before the options, they take it
+static CCriticalSection cs_config;
+
+volatile bool fReloadConfig = false;
+
+static void ApplyDebugCategories(const CConfigOption& option);
+
+CConfigOption configBanScore("banscore", CONFIG_INT, 100, 1, numeric_limits<int>::max(), true);
+CConfigOption configBlockMaxSize("blockmaxsize", CONFIG_INT, MAX_BLOCK_SIZE_GEN / 2, 1000, MAX_BLOCK_SIZE - 1000, true);
+CConfigOption configBlockMinSize("blockminsize", CONFIG_INT, 0, 0, MAX_BLOCK_SIZE, true);
+CConfigOption configBlockPrioritySize("blockprioritysize", CONFIG_INT, 27000, 0, MAX_BLOCK_SIZE, true);
+CConfigOption configDebug("debug", CONFIG_LIST, 0, 0, 0, true, &ApplyDebugCategories);
+CConfigOption configLimitFreeRelay("limitfreerelay", CONFIG_INT, 15, 0, numeric_limits<int>::max() / 10000, true);
+CConfigOption configMaxConnections("maxconnections", CONFIG_INT, DEFAULT_MAX_PEER_CONNECTIONS, 0,
+                                   numeric_limits<int>::max(), true);
+CConfigOption configPrintCoinStake("printcoinstake", CONFIG_BOOL, 0, 0, 1, true);
+CConfigOption configSchedulerThreads("schedulerthreads", CONFIG_INT, DEFAULT_SCHEDULER_THREADS, 1,
+                                     MAX_SCHEDULER_THREADS, false);
+
+vector<CConfigOption*> GetConfigOptions()
+{
+    vector<CConfigOption*> vOptions;
+    vOptions.push_back(&configBanScore);
+    vOptions.push_back(&configBlockMaxSize);
+    vOptions.push_back(&configBlockMinSize);
+    vOptions.push_back(&configBlockPrioritySize);
+    vOptions.push_back(&configDebug);
+    vOptions.push_back(&configLimitFreeRelay);
+    vOptions.push_back(&configMaxConnections);
+    vOptions.push_back(&configPrintCoinStake);
+    vOptions.push_back(&configSchedulerThreads);
+    return vOptions;
+}
+
+CConfigOption* FindConfigOption(const string& strName)
+{
+    // The dash is optional
+    string strFind = strName.size() > 0 && strName[0] == '-' ? strName.substr(1) : strName;
+
+    BOOST_FOREACH(CConfigOption* poption, GetConfigOptions())
+    {
+        if (strFind == poption->GetName())
+            return poption;
+    }
+
+    return NULL;
+}
+
+// Whole string, no trailing garbage and no overflow, unlike atoi64
+static bool ParseConfigInt(const string& str, int64_t& nRet)
+{
+    string strTrimmed = boost::trim_copy(str);
+
+    if (strTrimmed.empty())
+        return false;
+
+    char* pszEnd = NULL;
+    errno = 0;
+    long long n = strtoll(strTrimmed.c_str(), &pszEnd, 10);
+
+    if (errno != 0 || *pszEnd != '\0')
+        return false;
+
+    nRet = n;
+    return true;
+}
+
+static string FormatConfigValue(ConfigOptionType type, int64_t n)
+{
+    if (type == CONFIG_BOOL)
+        return n ? "1" : "0";
+
+    return i64tostr(n);
+}
+
+CConfigOption::CConfigOption(const char* pszName, ConfigOptionType type, int64_t nDefault, int64_t nMin,
+                             int64_t nMax, bool fHotReload, ConfigApplyFn pfnApply) :
+    pszName(pszName), type(type), nDefault(nDefault), nMin(nMin), nMax(nMax), fHotReload(fHotReload),
+    pfnApply(pfnApply), nValue(nDefault), source(CONFIG_SOURCE_DEFAULT)
+{
+}
+
+ConfigSource CConfigOption::GetSource() const
+{
+    LOCK(cs_config);
+    return source;
+}
+
+string CConfigOption::GetString() const
+{
+    if (type == CONFIG_LIST)
+    {
+        LOCK(cs_config);
+        return strValue;
+    }
+
+    return FormatConfigValue(type, GetInt());
+}
+
+bool CConfigOption::Parse(const string& strValueIn, int64_t& nValueRet, string& strValueRet, string& strError) const
+{
+    string strValueLower = boost::to_lower_copy(boost::trim_copy(strValueIn));
+
+    switch (type)
+    {
+    case CONFIG_BOOL:
+        // A bare -foo counts as 1, as for GetBoolArg()
+        if (strValueLower.empty() || strValueLower == "1" || strValueLower == "true")
+            nValueRet = 1;
+        else if (strValueLower == "0" || strValueLower == "false")
+            nValueRet = 0;
+        else
+        {
+            strError = strprintf("%s takes 0/1 or true/false, not '%s'", pszName, strValueIn);
+            return false;
+        }
+
+        break;
+
+    case CONFIG_INT:
+        if (!ParseConfigInt(strValueIn, nValueRet))
+        {
+            strError = strprintf("%s takes an integer, not '%s'", pszName, strValueIn);
+            return false;
+        }
+
+        if (nValueRet < nMin || nValueRet > nMax)
+        {
+            strError = strprintf("%s must be between %d and %d", pszName, nMin, nMax);
+            return false;
+        }
+
+        break;
+
+    case CONFIG_LIST:
+    {
+        vector<string> vWords, vUnique;
+        boost::split(vWords, strValueLower, boost::is_any_of(", \t"), boost::token_compress_on);
+
+        BOOST_FOREACH(const string& strWord, vWords)
+        {
+            if (strWord.empty())
+                continue;
+
+            BOOST_FOREACH(char c, strWord)
+            {
+                if (!isalnum(c) && c != '_')
+                {
+                    strError = strprintf("%s: '%s' isn't a valid word", pszName, strWord);
+                    return false;
+                }
+            }
+
+            if (find(vUnique.begin(), vUnique.end(), strWord) == vUnique.end())
+                vUnique.push_back(strWord);
+        }
+
+        nValueRet = vUnique.size();
+        strValueRet = boost::join(vUnique, ",");
+        return true;
+    }
+    }
+
+    strValueRet = FormatConfigValue(type, nValueRet);
+    return true;
+}
+
+bool CConfigOption::Set(const string& strValueIn, ConfigSource sourceIn, string& strError)
+{
+    bool fRuntime = sourceIn == CONFIG_SOURCE_RELOAD || sourceIn == CONFIG_SOURCE_RPC;
+
+    if (fRuntime && !fHotReload)
+    {
+        strError = strprintf("%s can't be changed without a restart", pszName);
+        return false;
+    }
+
+    int64_t nValueNew;
+    string strValueNew;
+
+    if (!Parse(strValueIn, nValueNew, strValueNew, strError))
+        return false;
+
+    {
+        LOCK(cs_config);
+        nValue.store(nValueNew, std::memory_order_relaxed);
+        strValue = strValueNew;
+        source = sourceIn;
+    }
+
+    if (pfnApply)
+        pfnApply(*this);
+
+    if (fRuntime)
+        LogPrintf("%s : %s set to %s\n", __func__, pszName, strValueNew);
+
+    return true;
+}
+
+void CConfigOption::Reset()
+{
+    LOCK(cs_config);
+    nValue.store(nDefault, std::memory_order_relaxed);
+    strValue.clear();
+    source = CONFIG_SOURCE_DEFAULT;
+}
+
+// -debug turns on fDebug, its words pick the categories, -debug=0 is off
+static void ApplyDebugCategories(const CConfigOption& option)
+{
+    vector<string> vWords, vCategories;
+    string strValue = option.GetString();
+
+    if (!strValue.empty())
+        boost::split(vWords, strValue, boost::is_any_of(","));
+
+    BOOST_FOREACH(const string& strWord, vWords)
+    {
+        if (strWord != "0")
+            vCategories.push_back(strWord);
+    }
+
+    SetLogCategories(vCategories);
+    fDebug = !vCategories.empty();
+}
+
+// The value of option in settings, false if not there
+static bool GetSettingValue(const CConfigOption& option, const map<string, string>& mapSettings,
+                            const map<string, vector<string> >& mapMultiSettings, string& strValueRet)
+{
+    string strArg = string("-") + option.GetName();
+
+    if (option.GetType() == CONFIG_LIST)
+    {
+        map<string, vector<string> >::const_iterator mi = mapMultiSettings.find(strArg);
+
+        if (mi == mapMultiSettings.end())
+            return false;
+
+        // Each -debug adds to the list, a bare one means everything
+        vector<string> vValues;
+
+        BOOST_FOREACH(const string& strValue, mi->second)
+            vValues.push_back(strValue.empty() ? "1" : strValue);
+
+        strValueRet = boost::join(vValues, ",");
+        return true;
+    }
+
+    map<string, string>::const_iterator mi = mapSettings.find(strArg);
+
+    if (mi == mapSettings.end())
+        return false;
+
+    strValueRet = mi->second;
+    return true;
+}
+
+bool LoadConfigOptions(string& strError)
+{
+    BOOST_FOREACH(CConfigOption* poption, GetConfigOptions())
+    {
+        string strValue;
+
+        if (!GetSettingValue(*poption, mapArgs, mapMultiArgs, strValue))
+            continue;
+
+        // These were clamped where they were used before, keep accepting them
+        int64_t n;
+
+        if (poption->GetType() == CONFIG_INT && ParseConfigInt(strValue, n) &&
+            (n < poption->GetMin() || n > poption->GetMax()))
+        {
+            n = max(poption->GetMin(), min(poption->GetMax(), n));
+            LogPrintf("%s : -%s=%s is out of range, using %d\n", __func__, poption->GetName(), strValue, n);
+            strValue = i64tostr(n);
+        }
+
+        if (!poption->Set(strValue, CONFIG_SOURCE_ARGS, strError))
+        {
+            strError = "-" + strError;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool SetConfigOption(const string& strName, const string& strValue, string& strError)
+{
+    CConfigOption* poption = FindConfigOption(strName);
+
+    if (!poption)
+    {
+        strError = strprintf("unknown option %s", strName);
+        return false;
+    }
+
+    return poption->Set(strValue, CONFIG_SOURCE_RPC, strError);
+}
+
+int ReloadConfigFile()
+{
+    map<string, string> mapSettings;
+    map<string, vector<string> > mapMultiSettings;
+    ReadConfigFile(mapSettings, mapMultiSettings);
+
+    int nChanged = 0;
+
+    BOOST_FOREACH(CConfigOption* poption, GetConfigOptions())
+    {
+        if (!poption->IsHotReload() || IsArgSetOnCommandLine(string("-") + poption->GetName()))
+            continue;
+
+        // A value given to setconfig holds until the next restart
+        if (poption->GetSource() == CONFIG_SOURCE_RPC)
+            continue;
+
+        string strValue;
+
+        if (!GetSettingValue(*poption, mapSettings, mapMultiSettings, strValue))
+        {
+            // Removed from the file, or never in it
+            if (poption->GetSource() == CONFIG_SOURCE_DEFAULT)
+                continue;
+
+            strValue = poption->GetType() == CONFIG_LIST ? "" : FormatConfigValue(poption->GetType(),
+                                                                                 poption->GetDefault());
+        }
+
+        int64_t nValue;
+        string strCanonical, strError;
+
+        if (!poption->Parse(strValue, nValue, strCanonical, strError))
+        {
+            LogPrintf("%s : keeping %s at %s, %s\n", __func__, poption->GetName(), poption->GetString(), strError);
+            continue;
+        }
+
+        if (strCanonical == poption->GetString())
+            continue;
+
+        if (poption->Set(strCanonical, CONFIG_SOURCE_RELOAD, strError))
+            nChanged++;
+    }
+
+    LogPrintf("%s : %s read again, %d options changed\n", __func__, GetConfigFile().string(), nChanged);
+    return nChanged;
+}
+
+void ReloadConfigTask()
+{
+    if (!fReloadConfig)
+        return;
+
+    fReloadConfig = false;
+    ReloadConfigFile();
+}
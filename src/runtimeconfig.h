@@ -0,0 +1,125 @@
+// Copyright (c) 2016-2020 The Neutron Developers
+//
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NEUTRON_RUNTIMECONFIG_H
+#define NEUTRON_RUNTIMECONFIG_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+enum ConfigOptionType
+{
+    CONFIG_BOOL,
+    CONFIG_INT,
+    CONFIG_LIST,        // comma separated words, given once or several times as -debug
+};
+
+enum ConfigSource
+{
+    CONFIG_SOURCE_DEFAULT,
+    CONFIG_SOURCE_ARGS,         // command line or config file at startup
+    CONFIG_SOURCE_RELOAD,       // config file read again on SIGHUP
+    CONFIG_SOURCE_RPC,          // setconfig
+};
+
+class CConfigOption;
+typedef void (*ConfigApplyFn)(const CConfigOption& option);
+
+/**
+ * An option parsed once into an atomic, so hot paths don't look up mapArgs
+ * on every call.
+ *
+ * Options with fHotReload can be changed at runtime by setconfig or by a
+ * SIGHUP re-reading the config file, everything else keeps the value it
+ * had at startup. Values are validated before they replace the current one,
+ * a rejected value changes nothing.
+ *
+ * pfnApply, if any, is called after each runtime change, for options whose
+ * value is kept elsewhere as well.
+ */
+class CConfigOption
+{
+public:
+    CConfigOption(const char* pszName, ConfigOptionType type, int64_t nDefault, int64_t nMin, int64_t nMax,
+                  bool fHotReload, ConfigApplyFn pfnApply = NULL);
+
+    const char* GetName() const { return pszName; }
+    ConfigOptionType GetType() const { return type; }
+    int64_t GetDefault() const { return nDefault; }
+    int64_t GetMin() const { return nMin; }
+    int64_t GetMax() const { return nMax; }
+    bool IsHotReload() const { return fHotReload; }
+    ConfigSource GetSource() const;
+
+    int64_t GetInt() const { return nValue.load(std::memory_order_relaxed); }
+    bool GetBool() const { return GetInt() != 0; }
+
+    /** The value as setconfig takes it, the words of a list joined by commas */
+    std::string GetString() const;
+
+    /** Parses and validates strValue, returns the canonical form in strValueRet */
+    bool Parse(const std::string& strValue, int64_t& nValueRet, std::string& strValueRet, std::string& strError) const;
+
+    /** Replaces the value if strValue is valid, requires fHotReload unless at startup */
+    bool Set(const std::string& strValue, ConfigSource sourceIn, std::string& strError);
+
+    /** Back to the default, for tests */
+    void Reset();
+
+private:
+    const char* pszName;        // without the dash
+    ConfigOptionType type;
+    int64_t nDefault;
+    int64_t nMin;
+    int64_t nMax;
+    bool fHotReload;
+    ConfigApplyFn pfnApply;
+
+    std::atomic<int64_t> nValue;
+    std::string strValue;       // CONFIG_LIST only, guarded by cs_config
+    ConfigSource source;        // guarded by cs_config
+};
+
+extern CConfigOption configLimitFreeRelay;
+extern CConfigOption configBanScore;
+extern CConfigOption configMaxConnections;
+extern CConfigOption configBlockMaxSize;
+extern CConfigOption configBlockPrioritySize;
+extern CConfigOption configBlockMinSize;
+extern CConfigOption configPrintCoinStake;
+extern CConfigOption configDebug;
+extern CConfigOption configSchedulerThreads;
+
+/** Set by SIGHUP, the config file is read again by a scheduler task */
+extern volatile bool fReloadConfig;
+
+/** Every registered option, sorted by name */
+std::vector<CConfigOption*> GetConfigOptions();
+
+CConfigOption* FindConfigOption(const std::string& strName);
+
+/**
+ * Takes the options from mapArgs/mapMultiArgs once they are complete.
+ * Unparsable values fail, values out of range are clamped with a warning.
+ */
+bool LoadConfigOptions(std::string& strError);
+
+/** setconfig, fails for unknown options and those that need a restart */
+bool SetConfigOption(const std::string& strName, const std::string& strValue, std::string& strError);
+
+/**
+ * Re-reads the config file into the hot-reloadable options. The command line
+ * and setconfig still override the file, options removed from it go back to
+ * their default. Returns the number of options changed.
+ */
+int ReloadConfigFile();
+
+/** Scheduler task, reloads once fReloadConfig is set */
+void ReloadConfigTask();
+
+#endif // NEUTRON_RUNTIMECONFIG_H
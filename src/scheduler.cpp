@@ -4,6 +4,7 @@
 
 #include "scheduler.h"
 
+#include "random.h"
 #include "reverselock.h"
 
 #include <assert.h>
@@ -12,6 +13,8 @@
 
 CScheduler::CScheduler() : nThreadsServicingQueue(0), stopRequested(false), stopWhenEmpty(false)
 {
+    for (int i = 0; i < SCHEDULER_CLASS_MAX; i++)
+        vClassBusy[i] = false;
 }
 
 CScheduler::~CScheduler()
@@ -19,6 +22,21 @@ CScheduler::~CScheduler()
     assert(nThreadsServicingQueue == 0);
 }
 
+const char* GetSchedulerClassName(int nClass)
+{
+    switch (nClass)
+    {
+        case SCHEDULER_CLASS_MAIN:   return "main";
+        case SCHEDULER_CLASS_NET:    return "net";
+        case SCHEDULER_CLASS_WALLET: return "wallet";
+        default:                     return "none";
+    }
+}
+
+static int64_t MicrosBetween(boost::chrono::system_clock::time_point from, boost::chrono::system_clock::time_point to)
+{
+    return boost::chrono::duration_cast<boost::chrono::microseconds>(to - from).count();
+}
 
 #if BOOST_VERSION < 105000
 static boost::system_time toPosixTime(const boost::chrono::system_clock::time_point& t)
@@ -42,38 +60,85 @@ void CScheduler::serviceQueue()
                 newTaskScheduled.wait(lock);
             }
 
-            // Wait until either there is a new task, or until
-            // the time of the first item on the queue:
+            if (shouldStop())
+                continue;
+
+            // Take the first due task whose lock class is free
+            boost::chrono::system_clock::time_point now = boost::chrono::system_clock::now();
+            TaskQueue::iterator it = taskQueue.begin();
+
+            while (it != taskQueue.end() && it->first <= now && vClassBusy[it->second.nClass])
+                ++it;
+
+            if (it == taskQueue.end() || it->first > now) {
+                // Nothing can run yet. Wait for the next task to become due, or for a
+                // new task or a finished one that frees a lock class.
+                if (it == taskQueue.end()) {
+                    newTaskScheduled.wait(lock);
+                    continue;
+                }
 
 // wait_until needs boost 1.50 or later; older versions have timed_wait:
 #if BOOST_VERSION < 105000
-            while (!shouldStop() && !taskQueue.empty() &&
-                   newTaskScheduled.timed_wait(lock, toPosixTime(taskQueue.begin()->first))) {
-                // Keep waiting until timeout
-            }
+                newTaskScheduled.timed_wait(lock, toPosixTime(it->first));
 #else
-            // Some boost versions have a conflicting overload of wait_until that returns void.
-            // Explicitly use a template here to avoid hitting that overload.
-            while (!shouldStop() && !taskQueue.empty()) {
-                boost::chrono::system_clock::time_point timeToWaitFor = taskQueue.begin()->first;
-                if (newTaskScheduled.wait_until<>(lock, timeToWaitFor) == boost::cv_status::timeout)
-                    break; // Exit loop after timeout, it means we reached the time of the event
-            }
+                // Some boost versions have a conflicting overload of wait_until that returns void.
+                // Explicitly use a template here to avoid hitting that overload.
+                newTaskScheduled.wait_until<>(lock, it->first);
 #endif
-            // If there are multiple threads, the queue can empty while we're waiting (another
-            // thread may service the task we were waiting on).
-            if (shouldStop() || taskQueue.empty())
                 continue;
+            }
 
-            Function f = taskQueue.begin()->second;
-            taskQueue.erase(taskQueue.begin());
+            QueuedTask task = it->second;
+            boost::chrono::system_clock::time_point due = it->first;
+            taskQueue.erase(it);
 
-            {
+            if (task.nClass != SCHEDULER_CLASS_NONE)
+                vClassBusy[task.nClass] = true;
+
+            std::map<std::string, PeriodicTask>::iterator mi = mapPeriodicTasks.end();
+
+            if (!task.strName.empty()) {
+                mi = mapPeriodicTasks.find(task.strName);
+                if (mi != mapPeriodicTasks.end())
+                    mi->second.info.fRunning = true;
+            }
+
+            boost::chrono::system_clock::time_point start = boost::chrono::system_clock::now();
+
+            try {
                 // Unlock before calling f, so it can reschedule itself or another task
                 // without deadlocking:
                 reverse_lock<boost::unique_lock<boost::mutex> > rlock(lock);
-                f();
+                task.f();
+            } catch (...) {
+                if (task.nClass != SCHEDULER_CLASS_NONE)
+                    vClassBusy[task.nClass] = false;
+                if (mi != mapPeriodicTasks.end())
+                    mi->second.info.fRunning = false;
+                throw;
+            }
+
+            boost::chrono::system_clock::time_point end = boost::chrono::system_clock::now();
+
+            if (task.nClass != SCHEDULER_CLASS_NONE)
+                vClassBusy[task.nClass] = false;
+
+            if (mi != mapPeriodicTasks.end()) {
+                CSchedulerTaskInfo& info = mi->second.info;
+                int64_t nMicros = MicrosBetween(start, end);
+
+                info.fRunning = false;
+                info.nRuns++;
+                info.nTotalMicros += nMicros;
+                info.nMaxMicros = std::max(info.nMaxMicros, nMicros);
+                info.nMaxLateMicros = std::max(info.nMaxLateMicros, MicrosBetween(due, start));
+
+                queuePeriodic(task.strName, end);
             }
+
+            // A lock class may have been freed, let other threads look again
+            newTaskScheduled.notify_all();
         } catch (...) {
             --nThreadsServicingQueue;
             throw;
@@ -97,9 +162,13 @@ void CScheduler::stop(bool drain)
 
 void CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t)
 {
+    QueuedTask task;
+    task.f = f;
+    task.nClass = SCHEDULER_CLASS_NONE;
+
     {
         boost::unique_lock<boost::mutex> lock(newTaskMutex);
-        taskQueue.insert(std::make_pair(t, f));
+        taskQueue.insert(std::make_pair(t, task));
     }
     newTaskScheduled.notify_one();
 }
@@ -120,6 +189,77 @@ void CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaSeconds)
     scheduleFromNow(boost::bind(&Repeat, this, f, deltaSeconds), deltaSeconds);
 }
 
+// Queue the next run of a periodic task, newTaskMutex must be held
+void CScheduler::queuePeriodic(const std::string& strName, boost::chrono::system_clock::time_point now)
+{
+    PeriodicTask& periodic = mapPeriodicTasks[strName];
+    int64_t nIntervalMillis = periodic.interval();
+
+    if (nIntervalMillis < 1)
+        nIntervalMillis = 1;
+
+    if (periodic.nJitterMillis > 0)
+        nIntervalMillis += GetRand(periodic.nJitterMillis + 1);
+
+    periodic.info.nIntervalMillis = nIntervalMillis;
+    periodic.info.nextDue = now + boost::chrono::milliseconds(nIntervalMillis);
+
+    QueuedTask task;
+    task.f = periodic.f;
+    task.strName = strName;
+    task.nClass = periodic.info.nClass;
+    taskQueue.insert(std::make_pair(periodic.info.nextDue, task));
+}
+
+static int64_t FixedInterval(int64_t nIntervalMillis)
+{
+    return nIntervalMillis;
+}
+
+void CScheduler::scheduleTask(const std::string& strName, CScheduler::Function f, int64_t nIntervalMillis,
+                              int nClass, int64_t nJitterMillis)
+{
+    scheduleTask(strName, f, boost::bind(&FixedInterval, nIntervalMillis), nClass, nJitterMillis);
+}
+
+void CScheduler::scheduleTask(const std::string& strName, CScheduler::Function f, CScheduler::IntervalFunction interval,
+                              int nClass, int64_t nJitterMillis)
+{
+    assert(!strName.empty() && nClass >= 0 && nClass < SCHEDULER_CLASS_MAX);
+
+    {
+        boost::unique_lock<boost::mutex> lock(newTaskMutex);
+        assert(!mapPeriodicTasks.count(strName));
+
+        PeriodicTask& periodic = mapPeriodicTasks[strName];
+        periodic.f = f;
+        periodic.interval = interval;
+        periodic.nJitterMillis = nJitterMillis;
+        periodic.info.strName = strName;
+        periodic.info.nClass = nClass;
+        periodic.info.nRuns = 0;
+        periodic.info.nTotalMicros = 0;
+        periodic.info.nMaxMicros = 0;
+        periodic.info.nMaxLateMicros = 0;
+        periodic.info.fRunning = false;
+
+        queuePeriodic(strName, boost::chrono::system_clock::now());
+    }
+    newTaskScheduled.notify_one();
+}
+
+std::vector<CSchedulerTaskInfo> CScheduler::getTaskInfo() const
+{
+    boost::unique_lock<boost::mutex> lock(newTaskMutex);
+    std::vector<CSchedulerTaskInfo> vInfo;
+
+    for (std::map<std::string, PeriodicTask>::const_iterator it = mapPeriodicTasks.begin();
+         it != mapPeriodicTasks.end(); ++it)
+        vInfo.push_back(it->second.info);
+
+    return vInfo;
+}
+
 size_t CScheduler::getQueueInfo(boost::chrono::system_clock::time_point &first,
                              boost::chrono::system_clock::time_point &last) const
 {
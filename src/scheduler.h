@@ -14,6 +14,8 @@
 #include <boost/chrono/chrono.hpp>
 #include <boost/thread.hpp>
 #include <map>
+#include <string>
+#include <vector>
 
 //
 // Simple class for background tasks that should be run
@@ -33,6 +35,39 @@
 // delete s; // Must be done after thread is interrupted/joined.
 //
 
+/** Default for -schedulerthreads */
+static const int DEFAULT_SCHEDULER_THREADS = 2;
+/** Maximum for -schedulerthreads */
+static const int MAX_SCHEDULER_THREADS = 8;
+
+// Tasks in the same lock class take the same big lock (cs_main, cs_vNodes, cs_wallet),
+// the scheduler never runs two of them at once so its workers don't queue up on
+// that lock; a due task whose class is busy waits and another class runs instead.
+enum SchedulerLockClass
+{
+    SCHEDULER_CLASS_NONE = 0,
+    SCHEDULER_CLASS_MAIN,
+    SCHEDULER_CLASS_NET,
+    SCHEDULER_CLASS_WALLET,
+    SCHEDULER_CLASS_MAX
+};
+
+const char* GetSchedulerClassName(int nClass);
+
+// Runtime statistics of a named periodic task, see CScheduler::getTaskInfo
+struct CSchedulerTaskInfo
+{
+    std::string strName;
+    int nClass;
+    int64_t nIntervalMillis;
+    uint64_t nRuns;
+    int64_t nTotalMicros;
+    int64_t nMaxMicros;
+    int64_t nMaxLateMicros;   // longest time between a run being due and starting
+    bool fRunning;
+    boost::chrono::system_clock::time_point nextDue;
+};
+
 class CScheduler
 {
 public:
@@ -40,6 +75,7 @@ public:
     ~CScheduler();
 
     typedef boost::function<void(void)> Function;
+    typedef boost::function<int64_t(void)> IntervalFunction;
 
     // Call func at/after time t
     void schedule(Function f, boost::chrono::system_clock::time_point t);
@@ -54,6 +90,18 @@ public:
     // need more accurate scheduling, don't use this method.
     void scheduleEvery(Function f, int64_t deltaSeconds);
 
+    // Named periodic task: f runs about every nIntervalMillis, plus a random delay of up
+    // to nJitterMillis so tasks with equal intervals don't wake up together. Each run is
+    // timed and reported by getTaskInfo.
+    void scheduleTask(const std::string& strName, Function f, int64_t nIntervalMillis,
+                      int nClass = SCHEDULER_CLASS_NONE, int64_t nJitterMillis = 0);
+
+    // Same, with the interval asked again after every run (e.g. when it is set by a spork)
+    void scheduleTask(const std::string& strName, Function f, IntervalFunction interval,
+                      int nClass = SCHEDULER_CLASS_NONE, int64_t nJitterMillis = 0);
+
+    std::vector<CSchedulerTaskInfo> getTaskInfo() const;
+
     // To keep things as simple as possible, there is no unschedule.
 
     // Services the queue 'forever'. Should be run in a thread,
@@ -71,13 +119,34 @@ public:
                         boost::chrono::system_clock::time_point &last) const;
 
 private:
-    std::multimap<boost::chrono::system_clock::time_point, Function> taskQueue;
+    struct QueuedTask
+    {
+        Function f;
+        std::string strName;    // empty for plain schedule() calls
+        int nClass;
+    };
+
+    struct PeriodicTask
+    {
+        Function f;
+        CSchedulerTaskInfo info;
+        IntervalFunction interval;
+        int64_t nJitterMillis;
+    };
+
+    typedef std::multimap<boost::chrono::system_clock::time_point, QueuedTask> TaskQueue;
+
+    TaskQueue taskQueue;
+    std::map<std::string, PeriodicTask> mapPeriodicTasks;
+    bool vClassBusy[SCHEDULER_CLASS_MAX];
     boost::condition_variable newTaskScheduled;
     mutable boost::mutex newTaskMutex;
     int nThreadsServicingQueue;
     bool stopRequested;
     bool stopWhenEmpty;
     bool shouldStop() { return stopRequested || (stopWhenEmpty && taskQueue.empty()); }
+
+    void queuePeriodic(const std::string& strName, boost::chrono::system_clock::time_point now);
 };
 
 #endif
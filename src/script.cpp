@@ -20,7 +20,8 @@ using namespace boost;
 
 
 
-bool CheckSig(vector<unsigned char> vchSig, vector<unsigned char> vchPubKey, CScript scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType);
+bool CheckSig(vector<unsigned char> vchSig, vector<unsigned char> vchPubKey, CScript scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType,
+              const CSignatureHasher* phasher = NULL);
 
 static const valtype vchFalse(0);
 static const valtype vchZero(0);
@@ -308,7 +309,8 @@ static bool IsCanonicalSignature(const valtype &vchSig) {
     return true;
 }
 
-bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, const CTransaction& txTo, unsigned int nIn, int nHashType)
+bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, const CTransaction& txTo, unsigned int nIn, int nHashType,
+                const CSignatureHasher* phasher)
 {
     CAutoBN_CTX pctx;
     CScript::const_iterator pc = script.begin();
@@ -1000,7 +1002,7 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, co
                     scriptCode.FindAndDelete(CScript(vchSig));
 
                     bool fSuccess = IsCanonicalSignature(vchSig) && IsCanonicalPubKey(vchPubKey) &&
-                        CheckSig(vchSig, vchPubKey, scriptCode, txTo, nIn, nHashType);
+                        CheckSig(vchSig, vchPubKey, scriptCode, txTo, nIn, nHashType, phasher);
 
                     popstack(stack);
                     popstack(stack);
@@ -1061,7 +1063,7 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, co
 
                         // Check signature
                         bool fOk = IsCanonicalSignature(vchSig) && IsCanonicalPubKey(vchPubKey) &&
-                            CheckSig(vchSig, vchPubKey, scriptCode, txTo, nIn, nHashType);
+                            CheckSig(vchSig, vchPubKey, scriptCode, txTo, nIn, nHashType, phasher);
 
                         if (fOk)
                         {
@@ -1182,6 +1184,68 @@ uint256 SignatureHash(CScript scriptCode, const CTransaction& txTo, unsigned int
     return Hash(ss.begin(), ss.end());
 }
 
+CSignatureHasher::CSignatureHasher(const CTransaction& txToIn) : txTo(txToIn)
+{
+    CDataStream ss(SER_GETHASH, 0);
+    ss << txTo.nVersion << txTo.nTime;
+    WriteCompactSize(ss, txTo.vin.size());
+
+    SHA256_CTX ctx;
+    SHA256_Init(&ctx);
+    SHA256_Update(&ctx, &ss[0], ss.size());
+
+    // The state before each input, and the inputs as every other input sees them
+    vMidstate.reserve(txTo.vin.size());
+    vInputEnd.reserve(txTo.vin.size());
+    ss.clear();
+
+    BOOST_FOREACH(const CTxIn& txin, txTo.vin)
+    {
+        vMidstate.push_back(ctx);
+
+        unsigned int nBegin = ss.size();
+        ss << txin.prevout << CScript() << txin.nSequence;
+        SHA256_Update(&ctx, &ss[nBegin], ss.size() - nBegin);
+        vInputEnd.push_back(ss.size());
+    }
+
+    vchInputs.assign(ss.begin(), ss.end());
+
+    ss.clear();
+    ss << txTo.vout << txTo.nLockTime;
+    vchOutputs.assign(ss.begin(), ss.end());
+}
+
+uint256 CSignatureHasher::SignatureHash(CScript scriptCode, unsigned int nIn, int nHashType) const
+{
+    // Only SIGHASH_ALL hashes every input and output as they are
+    if (nIn >= txTo.vin.size() || (nHashType & 0x1f) == SIGHASH_NONE || (nHashType & 0x1f) == SIGHASH_SINGLE ||
+        (nHashType & SIGHASH_ANYONECANPAY))
+        return ::SignatureHash(scriptCode, txTo, nIn, nHashType);
+
+    scriptCode.FindAndDelete(CScript(OP_CODESEPARATOR));
+
+    CDataStream ss(SER_GETHASH, 0);
+    ss << txTo.vin[nIn].prevout << scriptCode << txTo.vin[nIn].nSequence;
+
+    SHA256_CTX ctx = vMidstate[nIn];
+    SHA256_Update(&ctx, &ss[0], ss.size());
+
+    if (vInputEnd[nIn] < vchInputs.size())
+        SHA256_Update(&ctx, &vchInputs[vInputEnd[nIn]], vchInputs.size() - vInputEnd[nIn]);
+
+    ss.clear();
+    ss << nHashType;
+    SHA256_Update(&ctx, &vchOutputs[0], vchOutputs.size());
+    SHA256_Update(&ctx, &ss[0], ss.size());
+
+    uint256 hash1;
+    SHA256_Final((unsigned char*)&hash1, &ctx);
+    uint256 hash2;
+    SHA256((unsigned char*)&hash1, sizeof(hash1), (unsigned char*)&hash2);
+    return hash2;
+}
+
 
 // Valid signature cache, to avoid doing expensive ECDSA signature checking
 // twice for every transaction (once when accepted into memory pool, and
@@ -1240,7 +1304,7 @@ public:
 };
 
 bool CheckSig(vector<unsigned char> vchSig, vector<unsigned char> vchPubKey, CScript scriptCode,
-              const CTransaction& txTo, unsigned int nIn, int nHashType)
+              const CTransaction& txTo, unsigned int nIn, int nHashType, const CSignatureHasher* phasher)
 {
     static CSignatureCache signatureCache;
 
@@ -1253,7 +1317,9 @@ bool CheckSig(vector<unsigned char> vchSig, vector<unsigned char> vchPubKey, CSc
         return false;
     vchSig.pop_back();
 
-    uint256 sighash = SignatureHash(scriptCode, txTo, nIn, nHashType);
+    // A hasher of another transaction is of no use here
+    uint256 sighash = phasher && &phasher->GetTransaction() == &txTo ?
+        phasher->SignatureHash(scriptCode, nIn, nHashType) : SignatureHash(scriptCode, txTo, nIn, nHashType);
 
     if (signatureCache.Get(sighash, vchSig, vchPubKey))
         return true;
@@ -1608,15 +1674,15 @@ bool ExtractDestinations(const CScript& scriptPubKey, txnouttype& typeRet, vecto
 }
 
 bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, const CTransaction& txTo, unsigned int nIn,
-                  int nHashType)
+                  int nHashType, const CSignatureHasher* phasher)
 {
     vector<vector<unsigned char> > stack, stackCopy;
-    if (!EvalScript(stack, scriptSig, txTo, nIn, nHashType))
+    if (!EvalScript(stack, scriptSig, txTo, nIn, nHashType, phasher))
         return false;
 
     stackCopy = stack;
 
-    if (!EvalScript(stack, scriptPubKey, txTo, nIn, nHashType))
+    if (!EvalScript(stack, scriptPubKey, txTo, nIn, nHashType, phasher))
         return false;
     if (stack.empty())
         return false;
@@ -1634,7 +1700,7 @@ bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, const C
         CScript pubKey2(pubKeySerialized.begin(), pubKeySerialized.end());
         popstack(stackCopy);
 
-        if (!EvalScript(stackCopy, pubKey2, txTo, nIn, nHashType))
+        if (!EvalScript(stackCopy, pubKey2, txTo, nIn, nHashType, phasher))
             return false;
         if (stackCopy.empty())
             return false;
@@ -1645,17 +1711,17 @@ bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, const C
 }
 
 
-bool SignSignature(const CKeyStore &keystore, const CScript& fromPubKey, CTransaction& txTo, unsigned int nIn, int nHashType)
+bool ProduceSignature(const CKeyStore& keystore, const CScript& fromPubKey, const CSignatureHasher& hasher, unsigned int nIn,
+                      int nHashType, CScript& scriptSigRet)
 {
-    assert(nIn < txTo.vin.size());
-    CTxIn& txin = txTo.vin[nIn];
+    assert(nIn < hasher.GetTransaction().vin.size());
 
     // Leave out the signature from the hash, since a signature can't sign itself.
     // The checksig op will also drop the signatures from its hash.
-    uint256 hash = SignatureHash(fromPubKey, txTo, nIn, nHashType);
+    uint256 hash = hasher.SignatureHash(fromPubKey, nIn, nHashType);
 
     txnouttype whichType;
-    if (!Solver(keystore, fromPubKey, hash, nHashType, txin.scriptSig, whichType))
+    if (!Solver(keystore, fromPubKey, hash, nHashType, scriptSigRet, whichType))
         return false;
 
     if (whichType == TX_SCRIPTHASH)
@@ -1663,21 +1729,37 @@ bool SignSignature(const CKeyStore &keystore, const CScript& fromPubKey, CTransa
         // Solver returns the subscript that need to be evaluated;
         // the final scriptSig is the signatures from that
         // and then the serialized subscript:
-        CScript subscript = txin.scriptSig;
+        CScript subscript = scriptSigRet;
 
         // Recompute txn hash using subscript in place of scriptPubKey:
-        uint256 hash2 = SignatureHash(subscript, txTo, nIn, nHashType);
+        uint256 hash2 = hasher.SignatureHash(subscript, nIn, nHashType);
 
         txnouttype subType;
         bool fSolved =
-            Solver(keystore, subscript, hash2, nHashType, txin.scriptSig, subType) && subType != TX_SCRIPTHASH;
+            Solver(keystore, subscript, hash2, nHashType, scriptSigRet, subType) && subType != TX_SCRIPTHASH;
         // Append serialized subscript whether or not it is completely signed:
-        txin.scriptSig << static_cast<valtype>(subscript);
+        scriptSigRet << static_cast<valtype>(subscript);
         if (!fSolved) return false;
     }
 
+    return true;
+}
+
+bool SignSignature(const CKeyStore &keystore, const CScript& fromPubKey, CTransaction& txTo, unsigned int nIn, int nHashType)
+{
+    assert(nIn < txTo.vin.size());
+    CTxIn& txin = txTo.vin[nIn];
+
+    CSignatureHasher hasher(txTo);
+    CScript scriptSig;
+    bool fSolved = ProduceSignature(keystore, fromPubKey, hasher, nIn, nHashType, scriptSig);
+    txin.scriptSig = scriptSig;
+
+    if (!fSolved)
+        return false;
+
     // Test solution
-    return VerifyScript(txin.scriptSig, fromPubKey, txTo, nIn, 0);
+    return VerifyScript(txin.scriptSig, fromPubKey, txTo, nIn, 0, &hasher);
 }
 
 bool SignSignature(const CKeyStore &keystore, const CTransaction& txFrom, CTransaction& txTo, unsigned int nIn, int nHashType)
@@ -1718,7 +1800,7 @@ static CScript PushAll(const vector<valtype>& values)
 
 static CScript CombineMultisig(CScript scriptPubKey, const CTransaction& txTo, unsigned int nIn,
                                const vector<valtype>& vSolutions,
-                               vector<valtype>& sigs1, vector<valtype>& sigs2)
+                               vector<valtype>& sigs1, vector<valtype>& sigs2, const CSignatureHasher* phasher)
 {
     // Combine all the signatures we've got:
     set<valtype> allsigs;
@@ -1746,7 +1828,7 @@ static CScript CombineMultisig(CScript scriptPubKey, const CTransaction& txTo, u
             if (sigs.count(pubkey))
                 continue; // Already got a sig for this pubkey
 
-            if (CheckSig(sig, pubkey, scriptPubKey, txTo, nIn, 0))
+            if (CheckSig(sig, pubkey, scriptPubKey, txTo, nIn, 0, phasher))
             {
                 sigs[pubkey] = sig;
                 break;
@@ -1773,7 +1855,7 @@ static CScript CombineMultisig(CScript scriptPubKey, const CTransaction& txTo, u
 
 static CScript CombineSignatures(CScript scriptPubKey, const CTransaction& txTo, unsigned int nIn,
                                  const txnouttype txType, const vector<valtype>& vSolutions,
-                                 vector<valtype>& sigs1, vector<valtype>& sigs2)
+                                 vector<valtype>& sigs1, vector<valtype>& sigs2, const CSignatureHasher* phasher)
 {
     switch (txType)
     {
@@ -1805,19 +1887,19 @@ static CScript CombineSignatures(CScript scriptPubKey, const CTransaction& txTo,
             Solver(pubKey2, txType2, vSolutions2);
             sigs1.pop_back();
             sigs2.pop_back();
-            CScript result = CombineSignatures(pubKey2, txTo, nIn, txType2, vSolutions2, sigs1, sigs2);
+            CScript result = CombineSignatures(pubKey2, txTo, nIn, txType2, vSolutions2, sigs1, sigs2, phasher);
             result << spk;
             return result;
         }
     case TX_MULTISIG:
-        return CombineMultisig(scriptPubKey, txTo, nIn, vSolutions, sigs1, sigs2);
+        return CombineMultisig(scriptPubKey, txTo, nIn, vSolutions, sigs1, sigs2, phasher);
     }
 
     return CScript();
 }
 
 CScript CombineSignatures(CScript scriptPubKey, const CTransaction& txTo, unsigned int nIn,
-                          const CScript& scriptSig1, const CScript& scriptSig2)
+                          const CScript& scriptSig1, const CScript& scriptSig2, const CSignatureHasher* phasher)
 {
     txnouttype txType;
     vector<vector<unsigned char> > vSolutions;
@@ -1828,7 +1910,7 @@ CScript CombineSignatures(CScript scriptPubKey, const CTransaction& txTo, unsign
     vector<valtype> stack2;
     EvalScript(stack2, scriptSig2, CTransaction(), 0, 0);
 
-    return CombineSignatures(scriptPubKey, txTo, nIn, txType, vSolutions, stack1, stack2);
+    return CombineSignatures(scriptPubKey, txTo, nIn, txType, vSolutions, stack1, stack2, phasher);
 }
 
 unsigned int CScript::GetSigOpCount(bool fAccurate) const
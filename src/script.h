@@ -14,6 +14,8 @@
 #include <boost/foreach.hpp>
 #include <boost/variant.hpp>
 
+#include <openssl/sha.h>
+
 #include "script/standard.h"
 
 #include "keystore.h"
@@ -571,7 +573,35 @@ public:
 
 
 
-bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript& script, const CTransaction& txTo, unsigned int nIn, int nHashType);
+/**
+ * Signature hashes of every input of one transaction. The header, the inputs
+ * with blanked scriptSigs and the outputs are serialized once, and SIGHASH_ALL
+ * hashes resume from the SHA256 state just before the input being signed
+ * instead of copying and serializing the whole transaction per input. Other
+ * hash types go through SignatureHash.
+ *
+ * Only the scriptSigs of txTo may change while the hasher is in use.
+ */
+class CSignatureHasher
+{
+public:
+    CSignatureHasher(const CTransaction& txToIn);
+
+    uint256 SignatureHash(CScript scriptCode, unsigned int nIn, int nHashType) const;
+
+    const CTransaction& GetTransaction() const { return txTo; }
+
+private:
+    const CTransaction& txTo;
+    std::vector<SHA256_CTX> vMidstate;          // after the header and inputs 0..n-1
+    std::vector<unsigned char> vchInputs;       // every input with an empty scriptSig
+    std::vector<unsigned int> vInputEnd;        // end of input n in vchInputs
+    std::vector<unsigned char> vchOutputs;      // outputs and nLockTime
+};
+
+uint256 SignatureHash(CScript scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType);
+bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript& script, const CTransaction& txTo, unsigned int nIn, int nHashType,
+                const CSignatureHasher* phasher = NULL);
 bool Solver(const CScript& scriptPubKey, txnouttype& typeRet, std::vector<std::vector<unsigned char> >& vSolutionsRet);
 int ScriptSigArgsExpected(txnouttype t, const std::vector<std::vector<unsigned char> >& vSolutions);
 bool IsStandard(const CScript& scriptPubKey, txnouttype& whichType);
@@ -580,12 +610,17 @@ bool ExtractDestination(const CScript& scriptPubKey, CTxDestination& addressRet)
 bool ExtractDestinations(const CScript& scriptPubKey, txnouttype& typeRet, std::vector<CTxDestination>& addressRet, int& nRequiredRet);
 bool SignSignature(const CKeyStore& keystore, const CScript& fromPubKey, CTransaction& txTo, unsigned int nIn, int nHashType=SIGHASH_ALL);
 bool SignSignature(const CKeyStore& keystore, const CTransaction& txFrom, CTransaction& txTo, unsigned int nIn, int nHashType=SIGHASH_ALL);
+// Signs input nIn of the hasher's transaction without changing it, the new scriptSig goes to scriptSigRet.
+// False if the keystore can't sign it completely.
+bool ProduceSignature(const CKeyStore& keystore, const CScript& fromPubKey, const CSignatureHasher& hasher, unsigned int nIn,
+                      int nHashType, CScript& scriptSigRet);
 bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, const CTransaction& txTo, unsigned int nIn,
-                  int nHashType);
+                  int nHashType, const CSignatureHasher* phasher = NULL);
 bool VerifySignature(const CTransaction& txFrom, const CTransaction& txTo, unsigned int nIn, int nHashType);
 
 // Given two sets of signatures for scriptPubKey, possibly with OP_0 placeholders,
 // combine them intelligently and return the result.
-CScript CombineSignatures(CScript scriptPubKey, const CTransaction& txTo, unsigned int nIn, const CScript& scriptSig1, const CScript& scriptSig2);
+CScript CombineSignatures(CScript scriptPubKey, const CTransaction& txTo, unsigned int nIn, const CScript& scriptSig1, const CScript& scriptSig2,
+                          const CSignatureHasher* phasher = NULL);
 
 #endif
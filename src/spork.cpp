@@ -4,9 +4,12 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "clientversion.h"
 #include "darksend.h"
+#include "random.h"
 #include "spork.h"
 #include "main.h"
+#include "streams.h"
 
 #include <sstream>
 #include <boost/format.hpp>
@@ -18,6 +21,47 @@ class CSporkManager;
 CSporkManager sporkManager;
 std::map<uint256, CSporkMessage> mapSporks;
 
+struct CSporkDefinition
+{
+    int nSporkID;
+    const char* pszName;
+    int64_t nDefault;
+};
+
+// Indexed by nSporkID - SPORK_START
+static const CSporkDefinition sporkDefinitions[SPORK_COUNT] =
+{
+    { SPORK_1_MASTERNODE_PAYMENTS_ENFORCEMENT,   "SPORK_1_MASTERNODE_PAYMENTS_ENFORCEMENT",   SPORK_1_MASTERNODE_PAYMENTS_ENFORCEMENT_DEFAULT },
+    { SPORK_2_MASTERNODE_WINNER_ENFORCEMENT,     "SPORK_2_MASTERNODE_WINNER_ENFORCEMENT",     SPORK_2_MASTERNODE_WINNER_ENFORCEMENT_DEFAULT },
+    { SPORK_3_DEVELOPER_PAYMENTS_ENFORCEMENT,    "SPORK_3_DEVELOPER_PAYMENTS_ENFORCEMENT",    SPORK_3_DEVELOPER_PAYMENTS_ENFORCEMENT_DEFAULT },
+    { SPORK_4_PAYMENT_ENFORCEMENT_DOS_VALUE,     "SPORK_4_PAYMENT_ENFORCEMENT_DOS_VALUE",     SPORK_4_PAYMENT_ENFORCEMENT_DOS_VALUE_DEFAULT },
+    { SPORK_5_ENFORCE_NEW_PROTOCOL_V200,         "SPORK_5_ENFORCE_NEW_PROTOCOL_V200",         SPORK_5_ENFORCE_NEW_PROTOCOL_V200_DEFAULT },
+    { SPORK_6_UPDATED_DEV_PAYMENTS_ENFORCEMENT,  "SPORK_6_UPDATED_DEV_PAYMENTS_ENFORCEMENT",  SPORK_6_UPDATED_DEV_PAYMENTS_ENFORCEMENT_DEFAULT },
+    { SPORK_7_PROTOCOL_V201_ENFORCEMENT,         "SPORK_7_PROTOCOL_V201_ENFORCEMENT",         SPORK_7_PROTOCOL_V201_ENFORCEMENT_DEFAULT },
+    { SPORK_8_PROTOCOL_V210_ENFORCEMENT,         "SPORK_8_PROTOCOL_V210_ENFORCEMENT",         SPORK_8_PROTOCOL_V210_ENFORCEMENT_DEFAULT },
+    { SPORK_9_PROTOCOL_V3_ENFORCEMENT,           "SPORK_9_PROTOCOL_V3_ENFORCEMENT",           SPORK_9_PROTOCOL_V3_ENFORCEMENT_DEFAULT },
+    { SPORK_10_V3_DEV_PAYMENTS_ENFORCEMENT,      "SPORK_10_V3_DEV_PAYMENTS_ENFORCEMENT",      SPORK_10_V3_DEV_PAYMENTS_ENFORCEMENT_DEFAULT },
+    { SPORK_11_PROTOCOL_V301_ENFORCEMENT,        "SPORK_11_PROTOCOL_V301_ENFORCEMENT",        SPORK_11_PROTOCOL_V301_ENFORCEMENT_DEFAULT },
+    { SPORK_12_PAYMENT_ENFORCEMENT_THRESHOLD,    "SPORK_12_PAYMENT_ENFORCEMENT_THRESHOLD",    SPORK_12_PAYMENT_ENFORCEMENT_THRESHOLD_DEFAULT },
+    { SPORK_13_PROTOCOL_V4_ENFORCEMENT,          "SPORK_13_PROTOCOL_V4_ENFORCEMENT",          SPORK_13_PROTOCOL_V4_ENFORCEMENT_DEFAULT },
+    { SPORK_14_MASTERNODE_DISTRIBUTION_TICK,     "SPORK_14_MASTERNODE_DISTRIBUTION_TICK",     SPORK_14_MASTERNODE_DISTRIBUTION_TICK_DEFAULT }
+};
+
+static bool IsKnownSpork(int nSporkID)
+{
+    return nSporkID >= SPORK_START && nSporkID <= SPORK_END;
+}
+
+CSporkMessage* CSporkManager::GetActiveSpork(int nSporkID)
+{
+    AssertLockHeld(cs);
+
+    if (!IsKnownSpork(nSporkID) || sporksActive[nSporkID - SPORK_START].nTimeSigned == 0)
+        return NULL;
+
+    return &sporksActive[nSporkID - SPORK_START];
+}
+
 void CSporkManager::ProcessSpork(CNode* pfrom, std::string& strCommand, CDataStream& vRecv)
 {
     if (strCommand == NetMsgType::SPORK)
@@ -30,24 +74,28 @@ void CSporkManager::ProcessSpork(CNode* pfrom, std::string& strCommand, CDataStr
             return;
 
         // Ignore spork messages about unknown/deleted sporks
-        std::string strSpork = sporkManager.GetSporkNameByID(spork.nSporkID);
-
-        if (strSpork == "Unknown")
+        if (!IsKnownSpork(spork.nSporkID))
             return;
 
         uint256 hash = spork.GetHash();
 
-        if (mapSporksActive.count(spork.nSporkID))
         {
-            if (mapSporksActive[spork.nSporkID].nTimeSigned >= spork.nTimeSigned)
-            {
-                if (fDebug)
-                    LogPrintf("%s : seen %s block %d \n", __func__, hash.ToString(), pindexBest->nHeight);
+            LOCK(cs);
+            CSporkMessage* pspork = GetActiveSpork(spork.nSporkID);
 
-                return;
+            // Sporks we already have were verified when they arrived or were loaded
+            if (pspork != NULL)
+            {
+                if (pspork->nTimeSigned >= spork.nTimeSigned)
+                {
+                    if (fDebug)
+                        LogPrintf("%s : seen %s block %d \n", __func__, hash.ToString(), pindexBest->nHeight);
+
+                    return;
+                }
+                else if (fDebug)
+                    LogPrintf("%s : got updated spork %s block %d \n", __func__, hash.ToString(), pindexBest->nHeight);
             }
-            else if (fDebug)
-                LogPrintf("%s : got updated spork %s block %d \n", __func__, hash.ToString(), pindexBest->nHeight);
         }
 
         if (!spork.CheckSignature())
@@ -60,8 +108,12 @@ void CSporkManager::ProcessSpork(CNode* pfrom, std::string& strCommand, CDataStr
             return;
         }
 
-        mapSporks[hash] = spork;
-        mapSporksActive[spork.nSporkID] = spork;
+        {
+            LOCK(cs);
+            mapSporks[hash] = spork;
+            sporksActive[spork.nSporkID - SPORK_START] = spork;
+        }
+
         spork.Relay();
 
         // Does a task if needed
@@ -69,12 +121,12 @@ void CSporkManager::ProcessSpork(CNode* pfrom, std::string& strCommand, CDataStr
     }
     else if (strCommand == NetMsgType::GETSPORKS)
     {
-        std::map<int, CSporkMessage>::iterator it = mapSporksActive.begin();
+        LOCK(cs);
 
-        while(it != mapSporksActive.end())
+        for (int i = 0; i < SPORK_COUNT; i++)
         {
-            pfrom->PushMessage(NetMsgType::SPORK, it->second);
-            it++;
+            if (sporksActive[i].nTimeSigned != 0)
+                pfrom->PushMessage(NetMsgType::SPORK, sporksActive[i]);
         }
     }
 }
@@ -86,14 +138,18 @@ void CSporkManager::ExecuteSpork(int nSporkID, int nValue)
 
 bool CSporkManager::UpdateSpork(int nSporkID, int64_t nValue)
 {
+    if (!IsKnownSpork(nSporkID))
+        return false;
 
     CSporkMessage spork = CSporkMessage(nSporkID, nValue, GetTime());
 
     if(spork.Sign(strMasterPrivKey))
     {
         spork.Relay();
+
+        LOCK(cs);
         mapSporks[spork.GetHash()] = spork;
-        mapSporksActive[nSporkID] = spork;
+        sporksActive[nSporkID - SPORK_START] = spork;
 
         return true;
     }
@@ -103,33 +159,12 @@ bool CSporkManager::UpdateSpork(int nSporkID, int64_t nValue)
 
 bool CSporkManager::IsSporkActive(int nSporkID)
 {
-    int64_t r = -1;
+    int64_t r = GetSporkValue(nSporkID);
 
-    if(mapSporksActive.count(nSporkID))
-        r = mapSporksActive[nSporkID].nValue;
-    else
+    if (r == -1)
     {
-        switch (nSporkID)
-        {
-            case SPORK_1_MASTERNODE_PAYMENTS_ENFORCEMENT:  r = SPORK_1_MASTERNODE_PAYMENTS_ENFORCEMENT_DEFAULT; break;
-            case SPORK_2_MASTERNODE_WINNER_ENFORCEMENT:    r = SPORK_2_MASTERNODE_WINNER_ENFORCEMENT_DEFAULT; break;
-            case SPORK_3_DEVELOPER_PAYMENTS_ENFORCEMENT:   r = SPORK_3_DEVELOPER_PAYMENTS_ENFORCEMENT_DEFAULT; break;
-            case SPORK_4_PAYMENT_ENFORCEMENT_DOS_VALUE:    r = SPORK_4_PAYMENT_ENFORCEMENT_DOS_VALUE_DEFAULT; break;
-            case SPORK_5_ENFORCE_NEW_PROTOCOL_V200:        r = SPORK_5_ENFORCE_NEW_PROTOCOL_V200_DEFAULT; break;
-            case SPORK_6_UPDATED_DEV_PAYMENTS_ENFORCEMENT: r = SPORK_6_UPDATED_DEV_PAYMENTS_ENFORCEMENT_DEFAULT; break;
-            case SPORK_7_PROTOCOL_V201_ENFORCEMENT:        r = SPORK_7_PROTOCOL_V201_ENFORCEMENT_DEFAULT; break;
-            case SPORK_8_PROTOCOL_V210_ENFORCEMENT:        r = SPORK_8_PROTOCOL_V210_ENFORCEMENT_DEFAULT; break;
-            case SPORK_9_PROTOCOL_V3_ENFORCEMENT:          r = SPORK_9_PROTOCOL_V3_ENFORCEMENT_DEFAULT; break;
-            case SPORK_10_V3_DEV_PAYMENTS_ENFORCEMENT:     r = SPORK_10_V3_DEV_PAYMENTS_ENFORCEMENT_DEFAULT; break;
-            case SPORK_11_PROTOCOL_V301_ENFORCEMENT:       r = SPORK_11_PROTOCOL_V301_ENFORCEMENT_DEFAULT; break;
-            case SPORK_12_PAYMENT_ENFORCEMENT_THRESHOLD:   r = SPORK_12_PAYMENT_ENFORCEMENT_THRESHOLD_DEFAULT; break;
-            case SPORK_13_PROTOCOL_V4_ENFORCEMENT:         r = SPORK_13_PROTOCOL_V4_ENFORCEMENT_DEFAULT; break;
-            case SPORK_14_MASTERNODE_DISTRIBUTION_TICK:    r = SPORK_14_MASTERNODE_DISTRIBUTION_TICK_DEFAULT; break;
-            default:
-                LogPrintf("%s : unknown spork ID %d\n", __func__, nSporkID);
-                r = 4070908800ULL; // off by default
-                break;
-        }
+        LogPrintf("%s : unknown spork ID %d\n", __func__, nSporkID);
+        r = 4070908800ULL; // off by default
     }
 
     return r < GetTime();
@@ -137,50 +172,30 @@ bool CSporkManager::IsSporkActive(int nSporkID)
 
 int64_t CSporkManager::GetSporkValue(int nSporkID)
 {
-    int64_t r = -1;
-
-    if (mapSporksActive.count(nSporkID))
-        r = mapSporksActive[nSporkID].nValue;
-    else
+    if (!IsKnownSpork(nSporkID))
     {
-        if (nSporkID == SPORK_1_MASTERNODE_PAYMENTS_ENFORCEMENT)       r = SPORK_1_MASTERNODE_PAYMENTS_ENFORCEMENT_DEFAULT;
-        else if (nSporkID == SPORK_2_MASTERNODE_WINNER_ENFORCEMENT)    r = SPORK_2_MASTERNODE_WINNER_ENFORCEMENT_DEFAULT;
-        else if (nSporkID == SPORK_3_DEVELOPER_PAYMENTS_ENFORCEMENT)   r = SPORK_3_DEVELOPER_PAYMENTS_ENFORCEMENT_DEFAULT;
-        else if (nSporkID == SPORK_4_PAYMENT_ENFORCEMENT_DOS_VALUE)    r = SPORK_4_PAYMENT_ENFORCEMENT_DOS_VALUE_DEFAULT;
-        else if (nSporkID == SPORK_5_ENFORCE_NEW_PROTOCOL_V200)        r = SPORK_5_ENFORCE_NEW_PROTOCOL_V200_DEFAULT;
-        else if (nSporkID == SPORK_6_UPDATED_DEV_PAYMENTS_ENFORCEMENT) r = SPORK_6_UPDATED_DEV_PAYMENTS_ENFORCEMENT_DEFAULT;
-        else if (nSporkID == SPORK_7_PROTOCOL_V201_ENFORCEMENT)        r = SPORK_7_PROTOCOL_V201_ENFORCEMENT_DEFAULT;
-        else if (nSporkID == SPORK_8_PROTOCOL_V210_ENFORCEMENT)        r = SPORK_8_PROTOCOL_V210_ENFORCEMENT_DEFAULT;
-        else if (nSporkID == SPORK_9_PROTOCOL_V3_ENFORCEMENT)          r = SPORK_9_PROTOCOL_V3_ENFORCEMENT_DEFAULT;
-        else if (nSporkID == SPORK_10_V3_DEV_PAYMENTS_ENFORCEMENT)     r = SPORK_10_V3_DEV_PAYMENTS_ENFORCEMENT_DEFAULT;
-        else if (nSporkID == SPORK_11_PROTOCOL_V301_ENFORCEMENT)       r = SPORK_11_PROTOCOL_V301_ENFORCEMENT_DEFAULT;
-        else if (nSporkID == SPORK_12_PAYMENT_ENFORCEMENT_THRESHOLD)   r = SPORK_12_PAYMENT_ENFORCEMENT_THRESHOLD_DEFAULT;
-        else if (nSporkID == SPORK_13_PROTOCOL_V4_ENFORCEMENT)         r = SPORK_13_PROTOCOL_V4_ENFORCEMENT_DEFAULT;
-        else if (nSporkID == SPORK_14_MASTERNODE_DISTRIBUTION_TICK)    r = SPORK_14_MASTERNODE_DISTRIBUTION_TICK_DEFAULT;
-
-        if (r == -1 && fDebug)
+        if (fDebug)
             LogPrintf("%s : unknown spork %d\n", __func__, nSporkID);
+
+        return -1;
     }
 
-    return r;
+    LOCK(cs);
+    CSporkMessage* pspork = GetActiveSpork(nSporkID);
+
+    if (pspork != NULL)
+        return pspork->nValue;
+
+    return sporkDefinitions[nSporkID - SPORK_START].nDefault;
 }
 
 int CSporkManager::GetSporkIDByName(std::string strName)
 {
-    if (strName == "SPORK_1_MASTERNODE_PAYMENTS_ENFORCEMENT")       return SPORK_1_MASTERNODE_PAYMENTS_ENFORCEMENT;
-    else if (strName == "SPORK_2_MASTERNODE_WINNER_ENFORCEMENT")    return SPORK_2_MASTERNODE_WINNER_ENFORCEMENT;
-    else if (strName == "SPORK_3_DEVELOPER_PAYMENTS_ENFORCEMENT")   return SPORK_3_DEVELOPER_PAYMENTS_ENFORCEMENT;
-    else if (strName == "SPORK_4_PAYMENT_ENFORCEMENT_DOS_VALUE")    return SPORK_4_PAYMENT_ENFORCEMENT_DOS_VALUE;
-    else if (strName == "SPORK_5_ENFORCE_NEW_PROTOCOL_V200")        return SPORK_5_ENFORCE_NEW_PROTOCOL_V200;
-    else if (strName == "SPORK_6_UPDATED_DEV_PAYMENTS_ENFORCEMENT") return SPORK_6_UPDATED_DEV_PAYMENTS_ENFORCEMENT;
-    else if (strName == "SPORK_7_PROTOCOL_V201_ENFORCEMENT")        return SPORK_7_PROTOCOL_V201_ENFORCEMENT;
-    else if (strName == "SPORK_8_PROTOCOL_V210_ENFORCEMENT")        return SPORK_8_PROTOCOL_V210_ENFORCEMENT;
-    else if (strName == "SPORK_9_PROTOCOL_V3_ENFORCEMENT")          return SPORK_9_PROTOCOL_V3_ENFORCEMENT;
-    else if (strName == "SPORK_10_V3_DEV_PAYMENTS_ENFORCEMENT")     return SPORK_10_V3_DEV_PAYMENTS_ENFORCEMENT;
-    else if (strName == "SPORK_11_PROTOCOL_V301_ENFORCEMENT")       return SPORK_11_PROTOCOL_V301_ENFORCEMENT;
-    else if (strName == "SPORK_12_PAYMENT_ENFORCEMENT_THRESHOLD")   return SPORK_12_PAYMENT_ENFORCEMENT_THRESHOLD;
-    else if (strName == "SPORK_13_PROTOCOL_V4_ENFORCEMENT")         return SPORK_13_PROTOCOL_V4_ENFORCEMENT;
-    else if (strName == "SPORK_14_MASTERNODE_DISTRIBUTION_TICK")    return SPORK_14_MASTERNODE_DISTRIBUTION_TICK;
+    for (int i = 0; i < SPORK_COUNT; i++)
+    {
+        if (strName == sporkDefinitions[i].pszName)
+            return sporkDefinitions[i].nSporkID;
+    }
 
     LogPrintf("%s : unknown spork name '%s'\n", __func__, strName);
     return -1;
@@ -188,25 +203,208 @@ int CSporkManager::GetSporkIDByName(std::string strName)
 
 std::string CSporkManager::GetSporkNameByID(int id)
 {
-    if (id == SPORK_1_MASTERNODE_PAYMENTS_ENFORCEMENT)       return "SPORK_1_MASTERNODE_PAYMENTS_ENFORCEMENT";
-    else if (id == SPORK_2_MASTERNODE_WINNER_ENFORCEMENT)    return "SPORK_2_MASTERNODE_WINNER_ENFORCEMENT";
-    else if (id == SPORK_3_DEVELOPER_PAYMENTS_ENFORCEMENT)   return "SPORK_3_DEVELOPER_PAYMENTS_ENFORCEMENT";
-    else if (id == SPORK_4_PAYMENT_ENFORCEMENT_DOS_VALUE)    return "SPORK_4_PAYMENT_ENFORCEMENT_DOS_VALUE";
-    else if (id == SPORK_5_ENFORCE_NEW_PROTOCOL_V200)        return "SPORK_5_ENFORCE_NEW_PROTOCOL_V200";
-    else if (id == SPORK_6_UPDATED_DEV_PAYMENTS_ENFORCEMENT) return "SPORK_6_UPDATED_DEV_PAYMENTS_ENFORCEMENT";
-    else if (id == SPORK_7_PROTOCOL_V201_ENFORCEMENT)        return "SPORK_7_PROTOCOL_V201_ENFORCEMENT";
-    else if (id == SPORK_8_PROTOCOL_V210_ENFORCEMENT)        return "SPORK_8_PROTOCOL_V210_ENFORCEMENT";
-    else if (id == SPORK_9_PROTOCOL_V3_ENFORCEMENT)          return "SPORK_9_PROTOCOL_V3_ENFORCEMENT";
-    else if (id == SPORK_10_V3_DEV_PAYMENTS_ENFORCEMENT)     return "SPORK_10_V3_DEV_PAYMENTS_ENFORCEMENT";
-    else if (id == SPORK_11_PROTOCOL_V301_ENFORCEMENT)       return "SPORK_11_PROTOCOL_V301_ENFORCEMENT";
-    else if (id == SPORK_12_PAYMENT_ENFORCEMENT_THRESHOLD)   return "SPORK_12_PAYMENT_ENFORCEMENT_THRESHOLD";
-    else if (id == SPORK_13_PROTOCOL_V4_ENFORCEMENT)         return "SPORK_13_PROTOCOL_V4_ENFORCEMENT";
-    else if (id == SPORK_14_MASTERNODE_DISTRIBUTION_TICK)    return "SPORK_14_MASTERNODE_DISTRIBUTION_TICK";
+    if (IsKnownSpork(id))
+        return sporkDefinitions[id - SPORK_START].pszName;
 
     LogPrintf("%s : unknown spork id '%s'\n", __func__, id);
     return "Unknown";
 }
 
+bool CSporkManager::Load()
+{
+    std::vector<CSporkMessage> vSporks;
+    std::vector<CAlert> vAlerts;
+
+    if (!CSporkDB().Read(vSporks, vAlerts))
+        return false;
+
+    int nSporks = 0;
+    int nAlerts = 0;
+
+    BOOST_FOREACH(CSporkMessage& spork, vSporks)
+    {
+        if (!IsKnownSpork(spork.nSporkID))
+            continue;
+
+        // The only signature check a stored spork gets, later copies from peers are
+        // only verified if they are newer
+        if (!spork.CheckSignature())
+        {
+            LogPrintf("%s : dropping spork %d with invalid signature\n", __func__, spork.nSporkID);
+            continue;
+        }
+
+        LOCK(cs);
+        CSporkMessage* pspork = GetActiveSpork(spork.nSporkID);
+
+        if (pspork == NULL || pspork->nTimeSigned < spork.nTimeSigned)
+        {
+            mapSporks[spork.GetHash()] = spork;
+            sporksActive[spork.nSporkID - SPORK_START] = spork;
+            nSporks++;
+        }
+    }
+
+    BOOST_FOREACH(CAlert& alert, vAlerts)
+    {
+        if (alert.ProcessStoredAlert())
+            nAlerts++;
+    }
+
+    LogPrintf("%s : loaded %d sporks and %d alerts\n", __func__, nSporks, nAlerts);
+
+    return true;
+}
+
+bool CSporkManager::Dump()
+{
+    std::vector<CSporkMessage> vSporks;
+    std::vector<CAlert> vAlerts = CAlert::getActiveAlerts();
+    uint256 hash;
+
+    {
+        LOCK(cs);
+
+        for (int i = 0; i < SPORK_COUNT; i++)
+        {
+            if (sporksActive[i].nTimeSigned != 0)
+                vSporks.push_back(sporksActive[i]);
+        }
+
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << vSporks << vAlerts;
+        hash = Hash(ss.begin(), ss.end());
+
+        if (hash == hashLastDump)
+            return true;
+    }
+
+    if (!CSporkDB().Write(vSporks, vAlerts))
+        return false;
+
+    LOCK(cs);
+    hashLastDump = hash;
+
+    return true;
+}
+
+CSporkDB::CSporkDB()
+{
+    pathSporks = GetDataDir() / "sporks.dat";
+}
+
+bool CSporkDB::Write(const std::vector<CSporkMessage>& vSporks, const std::vector<CAlert>& vAlerts)
+{
+    // Generate random temporary filename
+    unsigned short randv = 0;
+    GetRandBytes((unsigned char*)&randv, sizeof(randv));
+    std::string tmpfn = strprintf("sporks.dat.%04x", randv);
+
+    // Serialize sporks and alerts, checksum data up to that point, then append csum
+    CDataStream ssSporks(SER_DISK, CLIENT_VERSION);
+    ssSporks << FLATDATA(pchMessageStart);
+    ssSporks << SPORK_FILE_VERSION;
+    ssSporks << vSporks << vAlerts;
+    uint256 hash = Hash(ssSporks.begin(), ssSporks.end());
+    ssSporks << hash;
+
+    // Open temp output file, and associate with CAutoFile
+    boost::filesystem::path pathTmp = GetDataDir() / tmpfn;
+    FILE *file = fopen(pathTmp.string().c_str(), "wb");
+    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+
+    if (fileout.IsNull())
+        return error("%s : failed to open file %s", __func__, pathTmp.string());
+
+    try
+    {
+        fileout << ssSporks;
+    }
+    catch (const std::exception& e)
+    {
+        return error("%s : serialize or I/O error - %s", __func__, e.what());
+    }
+
+    FileCommit(fileout.Get());
+    fileout.fclose();
+
+    // Replace existing sporks.dat, if any, with new sporks.dat.XXXX
+    if (!RenameOver(pathTmp, pathSporks))
+        return error("%s : rename-into-place failed", __func__);
+
+    return true;
+}
+
+bool CSporkDB::Read(std::vector<CSporkMessage>& vSporks, std::vector<CAlert>& vAlerts)
+{
+    if (!boost::filesystem::exists(pathSporks))
+        return false;
+
+    // Open input file, and associate with CAutoFile
+    FILE *file = fopen(pathSporks.string().c_str(), "rb");
+    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+
+    if (filein.IsNull())
+        return error("%s : failed to open file %s", __func__, pathSporks.string());
+
+    // Use file size to size memory buffer
+    uint64_t fileSize = boost::filesystem::file_size(pathSporks);
+    uint64_t dataSize = 0;
+
+    // Don't try to resize to a negative number if file is small
+    if (fileSize >= sizeof(uint256))
+        dataSize = fileSize - sizeof(uint256);
+
+    std::vector<unsigned char> vchData;
+    vchData.resize(dataSize);
+    uint256 hashIn;
+
+    try
+    {
+        if (dataSize > 0)
+            filein.read((char *)&vchData[0], dataSize);
+
+        filein >> hashIn;
+    }
+    catch (const std::exception& e)
+    {
+        return error("%s : deserialize or I/O error - %s", __func__, e.what());
+    }
+
+    filein.fclose();
+    CDataStream ssSporks(vchData, SER_DISK, CLIENT_VERSION);
+
+    // Verify stored checksum matches input data
+    uint256 hashTmp = Hash(ssSporks.begin(), ssSporks.end());
+
+    if (hashIn != hashTmp)
+        return error("%s : checksum mismatch, data corrupted", __func__);
+
+    unsigned char pchMsgTmp[4];
+    int nVersion;
+
+    try
+    {
+        ssSporks >> FLATDATA(pchMsgTmp);
+
+        if (memcmp(pchMsgTmp, pchMessageStart, sizeof(pchMsgTmp)))
+            return error("%s : invalid network magic number", __func__);
+
+        ssSporks >> nVersion;
+
+        if (nVersion > SPORK_FILE_VERSION)
+            return error("%s : unsupported file version %d", __func__, nVersion);
+
+        ssSporks >> vSporks >> vAlerts;
+    }
+    catch (const std::exception& e)
+    {
+        return error("%s : deserialize or I/O error - %s", __func__, e.what());
+    }
+
+    return true;
+}
+
 bool CSporkManager::SetPrivKey(std::string strPrivKey)
 {
     CSporkMessage spork;
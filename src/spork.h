@@ -7,6 +7,7 @@
 #ifndef SPORK_H
 #define SPORK_H
 
+#include "alert.h"
 #include "base58.h"
 #include "key.h"
 #include "main.h"
@@ -58,6 +59,13 @@ using namespace boost;
 
 #define REJECT_OLD_SPORKKEY_TIME                              1567330017 // 2019-09-01 00:00 GMT
 
+static const int SPORK_COUNT = SPORK_END - SPORK_START + 1;
+
+/** Version of sporks.dat, bump when its layout changes */
+static const int SPORK_FILE_VERSION = 1;
+/** How often (seconds) sporks.dat is rewritten if sporks or alerts changed */
+static const int SPORK_DUMP_INTERVAL = 15 * 60;
+
 class CSporkMessage;
 class CSporkManager;
 
@@ -103,12 +111,29 @@ public:
 };
 
 
+/** Access to the spork and alert cache file (sporks.dat) */
+class CSporkDB
+{
+private:
+    boost::filesystem::path pathSporks;
+public:
+    CSporkDB();
+    bool Write(const std::vector<CSporkMessage>& vSporks, const std::vector<CAlert>& vAlerts);
+    bool Read(std::vector<CSporkMessage>& vSporks, std::vector<CAlert>& vAlerts);
+};
+
 class CSporkManager
 {
 private:
     std::vector<unsigned char> vchSig;
     std::string strMasterPrivKey;
-    std::map<int, CSporkMessage> mapSporksActive;
+
+    // Latest spork per ID, indexed by nSporkID - SPORK_START; nTimeSigned is 0 for unset entries
+    CCriticalSection cs;
+    CSporkMessage sporksActive[SPORK_COUNT];
+    uint256 hashLastDump;
+
+    CSporkMessage* GetActiveSpork(int nSporkID);
 
 public:
     std::string strTestPubKeyNew;
@@ -135,6 +160,11 @@ public:
     int GetSporkIDByName(std::string strName);
     std::string GetSporkNameByID(int id);
     bool SetPrivKey(std::string strPrivKey);
+
+    /** Restore sporks and alerts from sporks.dat, checking every signature */
+    bool Load();
+    /** Write sporks and active alerts to sporks.dat if anything changed since the last dump */
+    bool Dump();
 };
 
 #endif
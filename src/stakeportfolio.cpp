@@ -0,0 +1,307 @@
+// Copyright (c) 2016-2020 The Neutron Developers
+//
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "stakeportfolio.h"
+#include "main.h"
+#include "txdb.h"
+#include "util.h"
+#include "utilmoneystr.h"
+#include "wallet.h"
+
+#include <algorithm>
+#include <map>
+
+#include <boost/foreach.hpp>
+
+using namespace std;
+
+CStakePortfolio stakePortfolio;
+
+static const char* const pszPolicyNames[] = {
+    "targetvalue", "targetoutputs", "splitage", "splitthreshold", "combinethreshold", "combineinputs", "consolidate"
+};
+
+CStakePolicy::CStakePolicy()
+{
+    nTargetValue = DEFAULT_STAKE_TARGET_VALUE;
+    nTargetOutputs = DEFAULT_STAKE_TARGET_OUTPUTS;
+    nSplitAge = DEFAULT_STAKE_SPLIT_AGE;
+    nSplitThreshold = DEFAULT_STAKE_SPLIT_THRESHOLD;
+    nCombineThreshold = DEFAULT_STAKE_COMBINE_THRESHOLD;
+    nMaxCombineInputs = DEFAULT_STAKE_COMBINE_INPUTS;
+    fConsolidate = DEFAULT_STAKE_CONSOLIDATE;
+}
+
+bool CStakePolicy::ShouldSplit(int64_t nValue, int64_t nKernelAge) const
+{
+    return (nSplitAge > 0 && nKernelAge < nSplitAge) || (nSplitThreshold > 0 && nValue >= nSplitThreshold);
+}
+
+bool CStakePolicy::ShouldCombine(int64_t nCredit, unsigned int nInputs, int64_t nValue) const
+{
+    return nInputs < nMaxCombineInputs && nCredit < nCombineThreshold && nValue < nCombineThreshold;
+}
+
+static bool CompareValue(const pair<int64_t, unsigned int>& a, const pair<int64_t, unsigned int>& b)
+{
+    return a.first < b.first;
+}
+
+vector<unsigned int> CStakePolicy::PlanConsolidation(const vector<int64_t>& vValues, unsigned int nOutputs) const
+{
+    vector<unsigned int> vPlan;
+
+    if (nOutputs <= nTargetOutputs)
+        return vPlan;
+
+    vector<pair<int64_t, unsigned int> > vSmall;
+
+    for (unsigned int i = 0; i < vValues.size(); i++)
+    {
+        if (vValues[i] < nCombineThreshold)
+            vSmall.push_back(make_pair(vValues[i], i));
+    }
+
+    std::sort(vSmall.begin(), vSmall.end(), CompareValue);
+
+    // Merging n outputs into one removes n - 1 of them
+    unsigned int nMaxInputs = std::min(MAX_CONSOLIDATE_INPUTS, nOutputs - nTargetOutputs + 1);
+    int64_t nTotal = 0;
+
+    for (unsigned int i = 0; i < vSmall.size() && vPlan.size() < nMaxInputs && nTotal < nTargetValue; i++)
+    {
+        vPlan.push_back(vSmall[i].second);
+        nTotal += vSmall[i].first;
+    }
+
+    if (vPlan.size() < 2)
+        vPlan.clear();
+
+    return vPlan;
+}
+
+bool CStakePolicy::Set(const string& strName, const string& strValue)
+{
+    if (strName == "targetvalue" || strName == "splitthreshold" || strName == "combinethreshold")
+    {
+        int64_t nValue;
+
+        if (!ParseMoney(strValue, nValue) || nValue < 0)
+            return false;
+
+        if (strName == "targetvalue")
+        {
+            if (nValue == 0)
+                return false;
+
+            nTargetValue = nValue;
+        }
+        else if (strName == "splitthreshold")
+            nSplitThreshold = nValue;
+        else
+            nCombineThreshold = nValue;
+
+        return true;
+    }
+
+    if (strName == "targetoutputs" || strName == "splitage" || strName == "combineinputs")
+    {
+        int64_t n = atoi64(strValue);
+
+        if (n < 0 || n > (strName == "splitage" ? 365 * 24 * 60 * 60 : 1000000) || (n == 0 && strValue != "0"))
+            return false;
+
+        if (strName == "targetoutputs")
+            nTargetOutputs = n;
+        else if (strName == "splitage")
+            nSplitAge = n;
+        else
+            nMaxCombineInputs = n;
+
+        return true;
+    }
+
+    if (strName == "consolidate")
+    {
+        // Empty as for a bare -stakeconsolidate
+        if (strValue.empty() || strValue == "1" || strValue == "true")
+            fConsolidate = true;
+        else if (strValue == "0" || strValue == "false")
+            fConsolidate = false;
+        else
+            return false;
+
+        return true;
+    }
+
+    return false;
+}
+
+bool ReadStakePolicyOptions(CStakePolicy& policy, string& strError)
+{
+    for (unsigned int i = 0; i < sizeof(pszPolicyNames) / sizeof(pszPolicyNames[0]); i++)
+    {
+        string strArg = string("-stake") + pszPolicyNames[i];
+
+        if (mapArgs.count(strArg) && !policy.Set(pszPolicyNames[i], mapArgs[strArg]))
+        {
+            strError = strprintf(_("Invalid value for %s=<value>: '%s'"), strArg, mapArgs[strArg]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+CStakePortfolio::CStakePortfolio()
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+CStakePolicy CStakePortfolio::GetPolicy() const
+{
+    LOCK(cs);
+    return policy;
+}
+
+void CStakePortfolio::SetPolicy(const CStakePolicy& policyIn)
+{
+    LOCK(cs);
+    policy = policyIn;
+}
+
+CStakePortfolioStats CStakePortfolio::GetStats() const
+{
+    LOCK(cs);
+    return stats;
+}
+
+void CStakePortfolio::KernelSearched(unsigned int nOutputs, int64_t nMicros)
+{
+    LOCK(cs);
+    stats.nOutputs = nOutputs;
+    stats.nKernelSearches++;
+    stats.nKernelSearchMicros += nMicros;
+    stats.nMaxKernelSearchMicros = std::max(stats.nMaxKernelSearchMicros, (uint64_t) nMicros);
+    stats.nLastKernelSearchMicros = nMicros;
+}
+
+bool CStakePortfolio::Consolidate(CWallet* pwallet)
+{
+    CStakePolicy policyNow = GetPolicy();
+
+    // Unlocked for staking only means no fee-paying transfers, as for SendMoney
+    if (!policyNow.fConsolidate || pwallet == NULL || pwallet->IsLocked() || fWalletUnlockStakingOnly)
+        return false;
+
+    CWalletTx wtxNew(pwallet);
+    vector<unsigned int> vPlan;
+    int64_t nValueIn = 0;
+    int64_t nFee = 0;
+
+    {
+        // Selected under the same locks the staker holds, so both don't take the same outputs
+        LOCK2(cs_main, pwallet->cs_wallet);
+
+        // The same outputs CreateCoinStake picks from
+        vector<COutput> vCoins;
+        pwallet->AvailableCoinsMinConf(vCoins, nCoinbaseMaturity + 10);
+
+        map<CScript, vector<const COutput*> > mapByScript;
+        unsigned int nOutputs = 0;
+
+        BOOST_FOREACH(const COutput& out, vCoins)
+        {
+            if (out.tx->nTime > wtxNew.nTime || pwallet->IsLockedCoin(out.tx->GetHash(), out.i))
+                continue;
+
+            mapByScript[out.tx->vout[out.i].scriptPubKey].push_back(&out);
+            nOutputs++;
+        }
+
+        // Only outputs of one script go together, like the inputs a coinstake combines,
+        // so consolidating doesn't link addresses. Start with the most fragmented one.
+        const vector<const COutput*>* pvBest = NULL;
+
+        for (map<CScript, vector<const COutput*> >::const_iterator it = mapByScript.begin(); it != mapByScript.end(); ++it)
+        {
+            vector<int64_t> vValues;
+
+            BOOST_FOREACH(const COutput* pout, it->second)
+                vValues.push_back(pout->tx->vout[pout->i].nValue);
+
+            vector<unsigned int> vCandidate = policyNow.PlanConsolidation(vValues, nOutputs);
+
+            if (vCandidate.size() > vPlan.size())
+            {
+                vPlan = vCandidate;
+                pvBest = &it->second;
+            }
+        }
+
+        if (vPlan.empty())
+            return false;
+
+        vector<const CWalletTx*> vwtxPrev;
+
+        BOOST_FOREACH(unsigned int n, vPlan)
+        {
+            const COutput* pout = (*pvBest)[n];
+            wtxNew.vin.push_back(CTxIn(pout->tx->GetHash(), pout->i));
+            vwtxPrev.push_back(pout->tx);
+            nValueIn += pout->tx->vout[pout->i].nValue;
+        }
+
+        CScript scriptPubKey = (*pvBest)[vPlan[0]]->tx->vout[(*pvBest)[vPlan[0]]->i].scriptPubKey;
+        CTxDB txdb("r");
+
+        // Pay no more than the minimum, these can wait for a block with room
+        while (true)
+        {
+            wtxNew.vout.clear();
+
+            if (nValueIn - nFee <= 0)
+                return false;
+
+            wtxNew.vout.push_back(CTxOut(nValueIn - nFee, scriptPubKey));
+
+            for (unsigned int i = 0; i < vwtxPrev.size(); i++)
+            {
+                if (!SignSignature(*pwallet, *vwtxPrev[i], wtxNew, i))
+                    return error("%s : failed to sign consolidation", __func__);
+            }
+
+            unsigned int nBytes = ::GetSerializeSize(*(CTransaction*)&wtxNew, SER_NETWORK, PROTOCOL_VERSION);
+            int64_t nPayFee = nTransactionFee * (1 + (int64_t)nBytes / 1000);
+            int64_t nMinFee = wtxNew.GetMinFee(1, GMF_SEND, nBytes);
+
+            if (nFee < max(nPayFee, nMinFee))
+            {
+                nFee = max(nPayFee, nMinFee);
+                continue;
+            }
+
+            break;
+        }
+
+        wtxNew.AddSupportingTransactions(txdb);
+        wtxNew.fTimeReceivedIsTxTime = true;
+
+        CReserveKey reservekey(pwallet);
+
+        if (!pwallet->CommitTransaction(wtxNew, reservekey))
+            return error("%s : consolidation %s rejected", __func__, wtxNew.GetHash().ToString());
+    }
+
+    LogPrintf("%s : combined %u outputs worth %s into %s, fee %s\n", __func__, vPlan.size(),
+              FormatMoney(nValueIn), wtxNew.GetHash().ToString(), FormatMoney(nFee));
+
+    LOCK(cs);
+    stats.nConsolidations++;
+    stats.nInputsConsolidated += vPlan.size();
+    stats.nLastConsolidation = GetTime();
+
+    return true;
+}
@@ -0,0 +1,115 @@
+// Copyright (c) 2016-2020 The Neutron Developers
+//
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NEUTRON_STAKEPORTFOLIO_H
+#define NEUTRON_STAKEPORTFOLIO_H
+
+#include "amount.h"
+#include "sync.h"
+
+#include <string>
+#include <vector>
+
+class CWallet;
+
+/** Default for -staketargetvalue, the size stake outputs are kept around */
+static const int64_t DEFAULT_STAKE_TARGET_VALUE = 1000 * COIN;
+/** Default for -staketargetoutputs, more stakeable outputs than this get consolidated */
+static const unsigned int DEFAULT_STAKE_TARGET_OUTPUTS = 100;
+/** Default for -stakesplitage, stakes with a kernel younger than this (seconds) are split in two */
+static const int64_t DEFAULT_STAKE_SPLIT_AGE = 24 * 60 * 60;
+/** Default for -stakesplitthreshold, off: stakes split by kernel age only */
+static const int64_t DEFAULT_STAKE_SPLIT_THRESHOLD = 0;
+/** Default for -stakecombinethreshold, outputs below this are combined */
+static const int64_t DEFAULT_STAKE_COMBINE_THRESHOLD = 1000 * COIN;
+/** Default for -stakecombineinputs, the most inputs a coinstake combines */
+static const unsigned int DEFAULT_STAKE_COMBINE_INPUTS = 100;
+/** Default for -stakeconsolidate, off: it spends fees without being asked */
+static const bool DEFAULT_STAKE_CONSOLIDATE = false;
+/** How often (seconds) the consolidation task looks at the wallet */
+static const int STAKE_CONSOLIDATE_INTERVAL = 10 * 60;
+/** Most inputs of one consolidating self-transfer, keeps it well under the size limit */
+static const unsigned int MAX_CONSOLIDATE_INPUTS = 50;
+
+/** How the wallet shapes its stake outputs */
+class CStakePolicy
+{
+public:
+    int64_t nTargetValue;
+    unsigned int nTargetOutputs;
+    int64_t nSplitAge;                  // 0 = never split by age
+    int64_t nSplitThreshold;            // 0 = never split by value
+    int64_t nCombineThreshold;
+    unsigned int nMaxCombineInputs;     // 0 = only combine in the background
+    bool fConsolidate;
+
+    CStakePolicy();
+
+    /** Whether a coinstake paying nValue back to the staker, from a kernel nKernelAge
+     *  seconds old, splits it over two outputs */
+    bool ShouldSplit(int64_t nValue, int64_t nKernelAge) const;
+
+    /** Whether an output of nValue may be added to a coinstake that has nInputs inputs
+     *  worth nCredit so far */
+    bool ShouldCombine(int64_t nCredit, unsigned int nInputs, int64_t nValue) const;
+
+    /**
+     * Picks the inputs of a consolidating self-transfer from vValues, the stakeable
+     * outputs of one script, when the wallet holds nOutputs of them in total. Takes the
+     * smallest ones below nCombineThreshold until they reach nTargetValue, and no more
+     * than needed to get back to nTargetOutputs. Returns indexes into vValues, empty if
+     * there is nothing worth doing.
+     */
+    std::vector<unsigned int> PlanConsolidation(const std::vector<int64_t>& vValues, unsigned int nOutputs) const;
+
+    /** Sets one field by its RPC/option name, returns false for an unknown name or bad value */
+    bool Set(const std::string& strName, const std::string& strValue);
+};
+
+struct CStakePortfolioStats
+{
+    unsigned int nOutputs;          // stakeable outputs seen by the last kernel search
+    uint64_t nKernelSearches;
+    uint64_t nKernelSearchMicros;   // total time spent looking for kernels
+    uint64_t nMaxKernelSearchMicros;
+    int64_t nLastKernelSearchMicros;
+    uint64_t nConsolidations;
+    uint64_t nInputsConsolidated;
+    int64_t nLastConsolidation;
+};
+
+/**
+ * Keeps the wallet's stake outputs near the policy targets. Coinstakes split
+ * and combine as CStakePolicy says; the outputs they leave behind are
+ * consolidated by a scheduler task that sends low fee self-transfers, so the
+ * staking thread doesn't spend its time on extra inputs.
+ */
+class CStakePortfolio
+{
+private:
+    mutable CCriticalSection cs;
+    CStakePolicy policy;
+    CStakePortfolioStats stats;
+
+public:
+    CStakePortfolio();
+
+    CStakePolicy GetPolicy() const;
+    void SetPolicy(const CStakePolicy& policyIn);
+    CStakePortfolioStats GetStats() const;
+
+    /** Called by CreateCoinStake after looking through nOutputs outputs for a kernel */
+    void KernelSearched(unsigned int nOutputs, int64_t nMicros);
+
+    /** Sends at most one consolidating self-transfer from pwallet, returns whether it did */
+    bool Consolidate(CWallet* pwallet);
+};
+
+extern CStakePortfolio stakePortfolio;
+
+/** Reads the -stake* options, returns false with strError set if one is invalid */
+bool ReadStakePolicyOptions(CStakePolicy& policy, std::string& strError);
+
+#endif // NEUTRON_STAKEPORTFOLIO_H
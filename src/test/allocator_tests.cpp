@@ -1,9 +1,14 @@
 #include <boost/test/unit_test.hpp>
 
 #include "init.h"
+#include "key.h"
+#include "keystore.h"
+#include "lockedpool.h"
 #include "main.h"
 #include "util.h"
 
+using namespace std;
+
 BOOST_AUTO_TEST_SUITE(allocator_tests)
 
 // Dummy memory page locker for platform independent tests
@@ -112,4 +117,197 @@ BOOST_AUTO_TEST_CASE(test_LockedPageManagerBase)
     BOOST_CHECK((last_unlock_len & (test_page_size-1)) == 0); // always unlock entire pages
 }
 
+BOOST_AUTO_TEST_CASE(arena_tests)
+{
+    vector<char> vBuffer(4096, 0x55);
+    Arena arena(&vBuffer[0], vBuffer.size(), 16);
+
+    BOOST_CHECK(arena.alloc(0) == NULL);
+
+    // Sizes are rounded up to the alignment
+    void* a = arena.alloc(1);
+    void* b = arena.alloc(17);
+    BOOST_REQUIRE(a && b);
+    BOOST_CHECK_EQUAL(arena.stats().used, 16U + 32U);
+    BOOST_CHECK(arena.addressInArena(a) && arena.addressInArena(b));
+    BOOST_CHECK(!arena.addressInArena(&vBuffer[0] + vBuffer.size()));
+
+    // Freed memory is wiped
+    memset(b, 0xaa, 17);
+    arena.free(b);
+    BOOST_CHECK_EQUAL(((unsigned char*) b)[0], 0);
+    arena.free(a);
+
+    // Fill the arena up, then one byte more doesn't fit
+    vector<void*> vChunks;
+
+    for (int i = 0; i < 4096 / 64; i++)
+    {
+        void* p = arena.alloc(64);
+        BOOST_REQUIRE(p != NULL);
+        vChunks.push_back(p);
+    }
+
+    BOOST_CHECK(arena.alloc(1) == NULL);
+    BOOST_CHECK_EQUAL(arena.stats().free, 0U);
+    BOOST_CHECK_EQUAL(arena.stats().chunks_used, 4096U / 64);
+
+    // Every other chunk back: lots of room but nothing in one piece
+    for (unsigned int i = 0; i < vChunks.size(); i += 2)
+        arena.free(vChunks[i]);
+
+    BOOST_CHECK_EQUAL(arena.stats().free, 2048U);
+    BOOST_CHECK(arena.alloc(128) == NULL);
+    BOOST_CHECK(arena.alloc(64) != NULL);
+
+    // Freeing the rest merges everything back into one chunk
+    for (unsigned int i = 1; i < vChunks.size(); i += 2)
+        arena.free(vChunks[i]);
+
+    arena.free(vChunks[0]);
+    BOOST_CHECK_EQUAL(arena.stats().chunks_free, 1U);
+    BOOST_CHECK_EQUAL(arena.stats().used, 0U);
+    BOOST_CHECK(arena.alloc(4096) != NULL);
+}
+
+class FailingLocker
+{
+public:
+    bool Lock(const void *addr, size_t len) { return false; }
+    bool Unlock(const void *addr, size_t len) { return false; }
+};
+
+BOOST_AUTO_TEST_CASE(lockedpool_exhaustion)
+{
+    const size_t arena_size = 4096;
+    LockedPoolBase<TestLocker> pool(arena_size, 2, 1);
+
+    // One arena locked up front
+    BOOST_CHECK_EQUAL(pool.stats().arenas, 1U);
+    BOOST_CHECK_EQUAL(pool.stats().locked, arena_size);
+    BOOST_CHECK_EQUAL(last_lock_len, arena_size);
+
+    void* a = pool.alloc(arena_size);
+    BOOST_REQUIRE(a != NULL);
+
+    // The first arena is full, a second one is added
+    void* b = pool.alloc(100);
+    BOOST_REQUIRE(b != NULL);
+    BOOST_CHECK_EQUAL(pool.stats().arenas, 2U);
+    BOOST_CHECK_EQUAL(pool.stats().locked, 2 * arena_size);
+
+    // No more arenas: callers lock their own pages
+    void* c = pool.alloc(arena_size);
+    BOOST_CHECK(c == NULL);
+    BOOST_CHECK(pool.alloc(arena_size + 1) == NULL);
+    BOOST_CHECK(pool.alloc(0) == NULL);
+    BOOST_CHECK_EQUAL(pool.stats().fallback_allocs, 3U);
+
+    int nForeign;
+    BOOST_CHECK(!pool.free(&nForeign));
+
+    BOOST_CHECK(pool.free(a));
+    BOOST_CHECK(pool.free(b));
+    BOOST_CHECK_EQUAL(pool.stats().used, 0U);
+    BOOST_CHECK_EQUAL(pool.stats().free, 2 * arena_size);
+
+    // Room again
+    c = pool.alloc(arena_size);
+    BOOST_CHECK(c != NULL);
+    BOOST_CHECK(pool.free(c));
+}
+
+BOOST_AUTO_TEST_CASE(lockedpool_lock_failure)
+{
+    // Over RLIMIT_MEMLOCK the arenas still serve, they just aren't locked
+    LockedPoolBase<FailingLocker> pool(4096, 2, 2);
+
+    BOOST_CHECK_EQUAL(pool.stats().arenas, 2U);
+    BOOST_CHECK_EQUAL(pool.stats().locked, 0U);
+
+    void* p = pool.alloc(32);
+    BOOST_CHECK(p != NULL);
+    BOOST_CHECK(pool.free(p));
+    BOOST_CHECK_EQUAL(pool.stats().fallback_allocs, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(secure_allocator_uses_pool)
+{
+    LockedPoolManager::Stats before = LockedPoolManager::Instance().stats();
+
+    {
+        CKeyingMaterial vKey(32, 0x11);
+        SecureString strPassphrase("correct horse battery staple, long enough to be on the heap");
+        LockedPoolManager::Stats during = LockedPoolManager::Instance().stats();
+        BOOST_CHECK(during.used > before.used);
+        BOOST_CHECK_EQUAL(during.fallback_allocs, before.fallback_allocs);
+    }
+
+    // Larger than an arena falls back to locking its own pages
+    {
+        CKeyingMaterial vLarge(LOCKEDPOOL_ARENA_SIZE + 1);
+        BOOST_CHECK_EQUAL(LockedPoolManager::Instance().stats().fallback_allocs, before.fallback_allocs + 1);
+        BOOST_CHECK(LockedPageManager::instance.GetLockedPageCount() > 0);
+    }
+
+    BOOST_CHECK_EQUAL(LockedPoolManager::Instance().stats().used, before.used);
+}
+
+// Exposes the protected calls CWallet uses to unlock
+class CBenchCryptoKeyStore : public CCryptoKeyStore
+{
+public:
+    bool EncryptKeys(CKeyingMaterial& vMasterKeyIn) { return CCryptoKeyStore::EncryptKeys(vMasterKeyIn); }
+    bool Unlock(const CKeyingMaterial& vMasterKeyIn) { return CCryptoKeyStore::Unlock(vMasterKeyIn); }
+};
+
+BOOST_AUTO_TEST_CASE(lockedpool_unlock_sign_lock_benchmark)
+{
+    CBenchCryptoKeyStore keystore;
+    CKeyingMaterial vMasterKey(WALLET_CRYPTO_KEY_SIZE, 0x3c);
+    vector<CKeyID> vKeyIDs;
+
+    for (int i = 0; i < 20; i++)
+    {
+        CKey key;
+        key.MakeNewKey(true);
+        BOOST_REQUIRE(keystore.AddKey(key));
+        vKeyIDs.push_back(key.GetPubKey().GetID());
+    }
+
+    BOOST_REQUIRE(keystore.EncryptKeys(vMasterKey));
+    BOOST_REQUIRE(keystore.Lock());
+
+    LockedPoolManager::Stats before = LockedPoolManager::Instance().stats();
+    uint256 hash = GetRandHash();
+    const int nCycles = 50;
+    int64_t nStart = GetTimeMicros();
+
+    // What staking and sendtoaddress do on an encrypted wallet
+    for (int n = 0; n < nCycles; n++)
+    {
+        BOOST_REQUIRE(keystore.Unlock(vMasterKey));
+
+        BOOST_FOREACH(const CKeyID& keyID, vKeyIDs)
+        {
+            CKey key;
+            vector<unsigned char> vchSig;
+            BOOST_REQUIRE(keystore.GetKey(keyID, key));
+            BOOST_REQUIRE(key.Sign(hash, vchSig));
+        }
+
+        BOOST_REQUIRE(keystore.Lock());
+    }
+
+    int64_t nMicros = GetTimeMicros() - nStart;
+    LockedPoolManager::Stats after = LockedPoolManager::Instance().stats();
+
+    BOOST_TEST_MESSAGE(strprintf("unlock-sign-lock: %d cycles of %u keys, %.1f us per cycle, pool %u bytes in %u arenas",
+                                 nCycles, vKeyIDs.size(), (double) nMicros / nCycles, after.total, after.arenas));
+
+    // Everything was served by the pool and given back
+    BOOST_CHECK_EQUAL(after.fallback_allocs, before.fallback_allocs);
+    BOOST_CHECK_EQUAL(after.used, before.used);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
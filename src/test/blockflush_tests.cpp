@@ -0,0 +1,132 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include "main.h"
+#include "util.h"
+#include "validation.h"
+
+using namespace std;
+
+// High file number so the test never touches the node's real block files
+static const unsigned int TEST_BLOCK_FILE = 9000;
+
+static unsigned int AppendTestData(unsigned int nBytes)
+{
+    FILE* file = OpenBlockFile(TEST_BLOCK_FILE, 0, "ab");
+    BOOST_REQUIRE(file != NULL);
+
+    std::vector<char> vData(nBytes, 'x');
+    BOOST_REQUIRE(fwrite(&vData[0], 1, vData.size(), file) == vData.size());
+    fflush(file);
+
+    long nEndPos = ftell(file);
+    fclose(file);
+
+    return nEndPos;
+}
+
+static void RemoveTestFile()
+{
+    boost::filesystem::remove(GetDataDir() / strprintf("blk%04u.dat", TEST_BLOCK_FILE));
+    ClearBlockFileFormatCache();
+}
+
+BOOST_AUTO_TEST_SUITE(blockflush_tests)
+
+BOOST_AUTO_TEST_CASE(blockflush_inline_without_thread)
+{
+    RemoveTestFile();
+
+    // Without the flush thread a scheduled flush is durable on return
+    unsigned int nEndPos = AppendTestData(1000);
+    ScheduleBlockFileFlush(TEST_BLOCK_FILE, nEndPos);
+    BOOST_CHECK_EQUAL(GetBlockFileDurablePos(TEST_BLOCK_FILE), nEndPos);
+
+    RemoveTestFile();
+}
+
+BOOST_AUTO_TEST_CASE(blockflush_wait_orders_chain_after_data)
+{
+    RemoveTestFile();
+    StartBlockFileFlusher();
+
+    unsigned int nBlockPos = AppendTestData(100);
+    unsigned int nEndPos = AppendTestData(5000);
+    ScheduleBlockFileFlush(TEST_BLOCK_FILE, nEndPos);
+
+    // What SetBestChain does before committing the chain pointer
+    WaitForBlockFileFlush(TEST_BLOCK_FILE, nBlockPos);
+    BOOST_CHECK(GetBlockFileDurablePos(TEST_BLOCK_FILE) >= nEndPos);
+
+    // Positions no flush was scheduled for don't block
+    unsigned int nUnscheduled = AppendTestData(100);
+    WaitForBlockFileFlush(TEST_BLOCK_FILE, nUnscheduled);
+    BOOST_CHECK(GetBlockFileDurablePos(TEST_BLOCK_FILE) < nUnscheduled);
+
+    StopBlockFileFlusher();
+    RemoveTestFile();
+}
+
+BOOST_AUTO_TEST_CASE(blockflush_shutdown_drains_requests)
+{
+    RemoveTestFile();
+    StartBlockFileFlusher();
+
+    // Queue several flushes and stop right away, as on shutdown: nothing
+    // requested may be left unsynced
+    unsigned int nEndPos = 0;
+
+    for (int i = 0; i < 10; i++)
+    {
+        nEndPos = AppendTestData(2000);
+        ScheduleBlockFileFlush(TEST_BLOCK_FILE, nEndPos);
+    }
+
+    StopBlockFileFlusher();
+    BOOST_CHECK_EQUAL(GetBlockFileDurablePos(TEST_BLOCK_FILE), nEndPos);
+
+    // After stopping, flushes are done inline again
+    nEndPos = AppendTestData(10);
+    ScheduleBlockFileFlush(TEST_BLOCK_FILE, nEndPos);
+    BOOST_CHECK_EQUAL(GetBlockFileDurablePos(TEST_BLOCK_FILE), nEndPos);
+
+    CBlockStorageStats stats = GetBlockStorageStats();
+    BOOST_CHECK(stats.nFlushes > 0);
+    BOOST_CHECK(stats.nMaxFlushMicros >= 0);
+
+    RemoveTestFile();
+}
+
+BOOST_AUTO_TEST_CASE(blockfile_stats_count_whole_records)
+{
+    RemoveTestFile();
+
+    CDataStream ssBlock(SER_DISK, CLIENT_VERSION);
+    ssBlock << string(5000, 'b');
+
+    // Bytes stored are what the file grew by, magic and size included, in both formats
+    CBlockStorageStats before = GetBlockStorageStats();
+    unsigned int nBlockPos;
+    long nEndPos;
+
+    {
+        CAutoFile fileout(OpenBlockFile(TEST_BLOCK_FILE, 0, "ab"), SER_DISK, CLIENT_VERSION);
+        BOOST_REQUIRE((FILE*) fileout != NULL);
+        BOOST_REQUIRE(WriteCompressedBlock(fileout, ssBlock, 80, nBlockPos));
+        fflush(fileout);
+        nEndPos = ftell(fileout);
+    }
+
+    CBlockStorageStats after = GetBlockStorageStats();
+    BOOST_CHECK_EQUAL(after.nBytesStored - before.nBytesStored, (uint64_t) nEndPos);
+    BOOST_CHECK_EQUAL(after.nBytesRaw - before.nBytesRaw, ssBlock.size());
+
+    RecordRawBlockWrite(ssBlock.size());
+    before = after;
+    after = GetBlockStorageStats();
+    BOOST_CHECK_EQUAL(after.nBytesStored - before.nBytesStored, ssBlock.size() + 8);
+
+    RemoveTestFile();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
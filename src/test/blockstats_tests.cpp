@@ -0,0 +1,188 @@
+#include <boost/test/unit_test.hpp>
+
+#include "blockstats.h"
+#include "main.h"
+#include "random.h"
+#include "txdb.h"
+
+using namespace std;
+
+// A proof-of-work block: a coinbase and nTx - 1 transactions
+static CBlock MakeBlock(int nVersion, unsigned int nTx, int64_t nTime)
+{
+    CBlock block;
+    block.nVersion = nVersion;
+    block.nTime = nTime;
+
+    for (unsigned int i = 0; i < nTx; i++)
+    {
+        CTransaction tx;
+        tx.vin.push_back(CTxIn(i == 0 ? COutPoint() : COutPoint(GetRandHash(), 0)));
+        tx.vout.push_back(CTxOut(COIN, CScript() << OP_TRUE));
+        block.vtx.push_back(tx);
+    }
+
+    return block;
+}
+
+BOOST_AUTO_TEST_SUITE(blockstats_tests)
+
+BOOST_AUTO_TEST_CASE(blockstats_ranges_match_sums)
+{
+    vector<CBlockStats> vStats;
+
+    for (int n = 0; n < 300; n++)
+    {
+        CBlockStats stats;
+        stats.nTime = 1000 + n * 60;
+        stats.fProofOfStake = n % 3 != 0;
+        stats.nTx = 1 + n % 7;
+        stats.nSize = 200 + n * 10;
+        stats.nFees = n * CENT;
+        stats.nStakeReward = stats.fProofOfStake ? COIN + n : 0;
+        stats.nMasternodePaid = stats.fProofOfStake ? COIN / 2 : 0;
+        stats.nDevPaid = stats.fProofOfStake ? COIN / 10 : 0;
+        stats.nMint = 2 * COIN;
+        stats.nBlockVersion = n < 100 ? 6 : 7 + n % 2;
+        stats.SetChainTotals(vStats.empty() ? NULL : &vStats.back());
+        vStats.push_back(stats);
+    }
+
+    int vRanges[][2] = { {0, 0}, {0, 299}, {1, 1}, {10, 20}, {150, 299}, {299, 299} };
+
+    for (unsigned int r = 0; r < sizeof(vRanges) / sizeof(vRanges[0]); r++)
+    {
+        int nFirst = vRanges[r][0], nLast = vRanges[r][1];
+
+        CBlockStatsRange range;
+        range.Set(nFirst, nFirst > 0 ? &vStats[nFirst - 1] : NULL, vStats[nFirst], nLast, vStats[nLast]);
+
+        CBlockStatsRange sum;
+
+        for (int n = nFirst; n <= nLast; n++)
+        {
+            sum.nStakeBlocks += vStats[n].fProofOfStake ? 1 : 0;
+            sum.nTx += vStats[n].nTx;
+            sum.nSize += vStats[n].nSize;
+            sum.nFees += vStats[n].nFees;
+            sum.nStakeReward += vStats[n].nStakeReward;
+            sum.nMasternodePaid += vStats[n].nMasternodePaid;
+            sum.nDevPaid += vStats[n].nDevPaid;
+            sum.nMint += vStats[n].nMint;
+            sum.mapVersions[vStats[n].nBlockVersion]++;
+        }
+
+        BOOST_CHECK_EQUAL(range.GetBlocks(), nLast - nFirst + 1);
+        BOOST_CHECK_EQUAL(range.nStakeBlocks, sum.nStakeBlocks);
+        BOOST_CHECK_EQUAL(range.nTx, sum.nTx);
+        BOOST_CHECK_EQUAL(range.nSize, sum.nSize);
+        BOOST_CHECK_EQUAL(range.nFees, sum.nFees);
+        BOOST_CHECK_EQUAL(range.nStakeReward, sum.nStakeReward);
+        BOOST_CHECK_EQUAL(range.nMasternodePaid, sum.nMasternodePaid);
+        BOOST_CHECK_EQUAL(range.nDevPaid, sum.nDevPaid);
+        BOOST_CHECK_EQUAL(range.nMint, sum.nMint);
+        BOOST_CHECK(range.mapVersions == sum.mapVersions);
+        BOOST_CHECK_EQUAL(range.nTimeSpan, nFirst > 0 ? (nLast - nFirst + 1) * 60 : nLast * 60);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(blockstats_coinstake_payouts)
+{
+    CBlock block = MakeBlock(7, 1, 1000);
+    CScript scriptStaker = CScript() << OP_TRUE;
+    CScript scriptMasternode = CScript() << OP_FALSE;
+
+    // Staker split over two outputs, then masternode and developer
+    CTransaction txStake;
+    txStake.vin.push_back(CTxIn(COutPoint(GetRandHash(), 1)));
+    txStake.vout.push_back(CTxOut(0, CScript()));
+    txStake.vout.push_back(CTxOut(500 * COIN, scriptStaker));
+    txStake.vout.push_back(CTxOut(501 * COIN, scriptStaker));
+    txStake.vout.push_back(CTxOut(3 * COIN, scriptMasternode));
+    txStake.vout.push_back(CTxOut(COIN, GetDeveloperScript()));
+    block.vtx.push_back(txStake);
+    BOOST_REQUIRE(block.IsProofOfStake());
+
+    uint256 hash = block.GetHash();
+    CBlockIndex index;
+    index.phashBlock = &hash;
+    index.nMint = 5 * COIN;
+
+    CBlockStats stats;
+    stats.SetBlock(block, &index, 0, 5 * COIN);
+    BOOST_CHECK(stats.hashBlock == hash);
+    BOOST_CHECK(stats.fProofOfStake);
+    BOOST_CHECK_EQUAL(stats.nBlockVersion, 7);
+    BOOST_CHECK_EQUAL(stats.nTx, 2);
+    BOOST_CHECK_EQUAL(stats.nMasternodePaid, 3 * COIN);
+    BOOST_CHECK_EQUAL(stats.nDevPaid, COIN);
+    BOOST_CHECK_EQUAL(stats.nMint, 5 * COIN);
+}
+
+BOOST_AUTO_TEST_CASE(blockstats_connect_disconnect)
+{
+    CTxDB txdb("cr+");
+
+    // Everything goes into a batch that is thrown away at the end
+    BOOST_REQUIRE(txdb.TxnBegin());
+    BOOST_REQUIRE(txdb.WriteBlockStatsHeight(-1));
+
+    vector<CBlock> vBlocks;
+    vector<uint256> vHashes;
+
+    for (int n = 0; n < 4; n++)
+    {
+        vBlocks.push_back(MakeBlock(7, 1 + n, 1000 + n * 60));
+        vHashes.push_back(vBlocks.back().GetHash());
+    }
+
+    vector<CBlockIndex> vIndex(4);
+
+    for (int n = 0; n < 4; n++)
+    {
+        vIndex[n].phashBlock = &vHashes[n];
+        vIndex[n].nHeight = n;
+        vIndex[n].pprev = n > 0 ? &vIndex[n - 1] : NULL;
+    }
+
+    // Out of order blocks are left to the builder
+    BOOST_CHECK(ConnectBlockStats(txdb, vBlocks[1], &vIndex[1], 0, 0));
+    BOOST_CHECK_EQUAL(GetBlockStatsHeight(txdb), -1);
+
+    for (int n = 0; n < 3; n++)
+        BOOST_CHECK(ConnectBlockStats(txdb, vBlocks[n], &vIndex[n], n * CENT, 0));
+
+    BOOST_CHECK_EQUAL(GetBlockStatsHeight(txdb), 2);
+
+    CBlockStats stats;
+    BOOST_REQUIRE(txdb.ReadBlockStats(2, stats));
+    BOOST_CHECK(stats.hashBlock == vHashes[2]);
+    BOOST_CHECK_EQUAL(stats.nChainTx, 1 + 2 + 3);
+    BOOST_CHECK_EQUAL(stats.nChainFees, 3 * CENT);
+
+    // A reorganization takes the tip off and puts another block in its place
+    BOOST_CHECK(DisconnectBlockStats(txdb, &vIndex[2]));
+    BOOST_CHECK_EQUAL(GetBlockStatsHeight(txdb), 1);
+    BOOST_CHECK(!txdb.ReadBlockStats(2, stats));
+
+    vIndex[3].nHeight = 2;
+    vIndex[3].pprev = &vIndex[1];
+    BOOST_CHECK(ConnectBlockStats(txdb, vBlocks[3], &vIndex[3], 0, 0));
+    BOOST_REQUIRE(txdb.ReadBlockStats(2, stats));
+    BOOST_CHECK(stats.hashBlock == vHashes[3]);
+    BOOST_CHECK_EQUAL(stats.nChainTx, 1 + 2 + 4);
+    BOOST_CHECK_EQUAL(stats.nChainFees, CENT);
+
+    // A record of another chain under the previous height is not built on, the block
+    // still connects and the index drops back to be rebuilt from there
+    vIndex[0].phashBlock = &vHashes[2];
+    vIndex[0].nHeight = 3;
+    vIndex[0].pprev = &vIndex[2];
+    BOOST_CHECK(ConnectBlockStats(txdb, vBlocks[0], &vIndex[0], 0, 0));
+    BOOST_CHECK_EQUAL(GetBlockStatsHeight(txdb), 1);
+    BOOST_CHECK(!txdb.ReadBlockStats(3, stats));
+
+    txdb.TxnAbort();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
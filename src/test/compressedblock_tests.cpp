@@ -0,0 +1,172 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include "main.h"
+#include "util.h"
+#include "validation.h"
+
+using namespace std;
+
+static boost::filesystem::path BlockFile(unsigned int nFile)
+{
+    return GetDataDir() / strprintf("blk%04u.dat", nFile);
+}
+
+// A proof-of-stake block, so ReadFromDisk does not check its work
+static CBlock MakeTestBlock()
+{
+    CBlock block;
+    block.nTime = 1500000000;
+    block.nBits = 0x1e0fffff;
+    block.nNonce = 7;
+
+    CTransaction txCoinBase;
+    txCoinBase.vin.resize(1);
+    txCoinBase.vin[0].prevout.SetNull();
+    txCoinBase.vin[0].scriptSig = CScript() << 42 << OP_0;
+    txCoinBase.vout.resize(1);
+    txCoinBase.vout[0].SetEmpty();
+    block.vtx.push_back(txCoinBase);
+
+    CTransaction txCoinStake;
+    txCoinStake.vin.resize(1);
+    txCoinStake.vin[0].prevout = COutPoint(uint256(1), 0);
+    txCoinStake.vout.resize(2);
+    txCoinStake.vout[0].SetEmpty();
+    txCoinStake.vout[1].nValue = 100 * COIN;
+    txCoinStake.vout[1].scriptPubKey = CScript() << OP_TRUE;
+    block.vtx.push_back(txCoinStake);
+
+    for (int i = 0; i < 20; i++)
+    {
+        CTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(uint256(100 + i), i);
+        tx.vout.resize(1);
+        tx.vout[0].nValue = i * CENT;
+        tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+        block.vtx.push_back(tx);
+    }
+
+    block.hashMerkleRoot = block.BuildMerkleTree();
+    block.vchBlockSig.assign(72, 0x30);
+    return block;
+}
+
+struct CompressedBlockSetup
+{
+    bool fCompressBlocksSaved;
+    unsigned int nTestFile;
+
+    CompressedBlockSetup() : fCompressBlocksSaved(fCompressBlocks), nTestFile(0)
+    {
+        ClearBlockFileFormatCache();
+        fCompressBlocks = true;
+    }
+
+    ~CompressedBlockSetup()
+    {
+        if (nTestFile != 0)
+            boost::filesystem::remove(BlockFile(nTestFile));
+
+        ClearBlockFileFormatCache();
+        fCompressBlocks = fCompressBlocksSaved;
+    }
+
+    // WriteToDisk appends to the first file that takes compressed blocks. Only run
+    // when that is a new file, the test must never append to the node's real data.
+    unsigned int ExpectedFile()
+    {
+        unsigned int nFile = 1;
+
+        for (; boost::filesystem::exists(BlockFile(nFile)); nFile++)
+            BOOST_REQUIRE_MESSAGE(GetBlockFileFormat(nFile) == BLOCKFILE_RAW,
+                                  strprintf("%s is compressed, refusing to append to it", BlockFile(nFile).string()));
+
+        return nFile;
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(compressedblock_tests, CompressedBlockSetup)
+
+BOOST_AUTO_TEST_CASE(compressedblock_round_trip)
+{
+    CBlock block = MakeTestBlock();
+    unsigned int nExpectedFile = ExpectedFile();
+    unsigned int nFile, nBlockPos;
+
+    BOOST_REQUIRE(block.WriteToDisk(nFile, nBlockPos));
+    nTestFile = nFile;
+    BOOST_REQUIRE_EQUAL(nFile, nExpectedFile);
+    BOOST_CHECK_EQUAL(GetBlockFileFormat(nFile), BLOCKFILE_COMPRESSED);
+
+    CBlock blockRead;
+    BOOST_REQUIRE(blockRead.ReadFromDisk(nFile, nBlockPos));
+    BOOST_CHECK(blockRead.GetHash() == block.GetHash());
+    BOOST_CHECK(blockRead.hashMerkleRoot == blockRead.BuildMerkleTree());
+    BOOST_CHECK(blockRead.vchBlockSig == block.vchBlockSig);
+    BOOST_REQUIRE_EQUAL(blockRead.vtx.size(), block.vtx.size());
+
+    for (unsigned int i = 0; i < block.vtx.size(); i++)
+        BOOST_CHECK(blockRead.vtx[i].GetHash() == block.vtx[i].GetHash());
+}
+
+BOOST_AUTO_TEST_CASE(compressedblock_header_only)
+{
+    CBlock block = MakeTestBlock();
+    ExpectedFile();
+    unsigned int nFile, nBlockPos;
+
+    BOOST_REQUIRE(block.WriteToDisk(nFile, nBlockPos));
+    nTestFile = nFile;
+
+    // The header is stored uncompressed in front of the body and is read without inflating it
+    CBlockStorageStats statsBefore = GetBlockStorageStats();
+    CBlock blockRead;
+    BOOST_REQUIRE(blockRead.ReadFromDisk(nFile, nBlockPos, false));
+    CBlockStorageStats statsAfter = GetBlockStorageStats();
+
+    BOOST_CHECK(blockRead.GetHash() == block.GetHash());
+    BOOST_CHECK(blockRead.vtx.empty());
+    BOOST_CHECK_EQUAL(statsAfter.nHeadersRead, statsBefore.nHeadersRead + 1);
+    BOOST_CHECK_EQUAL(statsAfter.nBlocksRead, statsBefore.nBlocksRead);
+    BOOST_CHECK_EQUAL(statsAfter.nBytesInflated, statsBefore.nBytesInflated);
+}
+
+BOOST_AUTO_TEST_CASE(compressedblock_tx_virtual_offsets)
+{
+    CBlock block = MakeTestBlock();
+    ExpectedFile();
+    unsigned int nFile, nBlockPos;
+
+    BOOST_REQUIRE(block.WriteToDisk(nFile, nBlockPos));
+    nTestFile = nFile;
+
+    // Same offsets ConnectBlock records, positions inside the inflated block
+    unsigned int nTxPos = nBlockPos + ::GetSerializeSize(CBlock(), SER_DISK, CLIENT_VERSION) -
+                          (2 * GetSizeOfCompactSize(0)) + GetSizeOfCompactSize(block.vtx.size());
+
+    CBlockStorageStats statsBefore = GetBlockStorageStats();
+
+    BOOST_FOREACH(const CTransaction& tx, block.vtx)
+    {
+        CTransaction txRead;
+        BOOST_REQUIRE(txRead.ReadFromDisk(CDiskTxPos(nFile, nBlockPos, nTxPos)));
+        BOOST_CHECK(txRead.GetHash() == tx.GetHash());
+        nTxPos += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
+    }
+
+    // The block was inflated once, every other transaction came from the cached record
+    CBlockStorageStats statsAfter = GetBlockStorageStats();
+    BOOST_CHECK_EQUAL(statsAfter.nBlocksRead, statsBefore.nBlocksRead + 1);
+    BOOST_CHECK_EQUAL(statsAfter.nRecordCacheHits, statsBefore.nRecordCacheHits + block.vtx.size() - 1);
+
+    // Offsets outside the record are rejected, a file handle cannot be handed out
+    CTransaction txRead;
+    FILE* file = NULL;
+    BOOST_CHECK(!txRead.ReadFromDisk(CDiskTxPos(nFile, nBlockPos, nBlockPos + 1000000)));
+    BOOST_CHECK(!txRead.ReadFromDisk(CDiskTxPos(nFile, nBlockPos, nBlockPos - 1)));
+    BOOST_CHECK(!txRead.ReadFromDisk(CDiskTxPos(nFile, nBlockPos, nBlockPos + 100), &file));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,50 @@
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+
+#include "darksend.h"
+#include "key.h"
+
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(darksend_tests)
+
+BOOST_AUTO_TEST_CASE(darksend_verify_message_cache)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CPubKey pubkey = key.GetPubKey();
+
+    string strMessage = "masternode broadcast";
+    string errorMessage;
+    vector<unsigned char> vchSig;
+    BOOST_REQUIRE(darkSendSigner.SignMessage(strMessage, errorMessage, vchSig, key));
+
+    uint64_t nHits, nMisses, nSize;
+    darkSendSigner.GetVerifyCacheStats(nHits, nMisses, nSize);
+
+    // First check verifies the signature, the second one is answered from the cache
+    BOOST_CHECK(darkSendSigner.VerifyMessage(pubkey, vchSig, strMessage, errorMessage));
+    BOOST_CHECK(darkSendSigner.VerifyMessage(pubkey, vchSig, strMessage, errorMessage));
+
+    uint64_t nHits2, nMisses2, nSize2;
+    darkSendSigner.GetVerifyCacheStats(nHits2, nMisses2, nSize2);
+    BOOST_CHECK_EQUAL(nHits2, nHits + 1);
+    BOOST_CHECK_EQUAL(nMisses2, nMisses + 1);
+    BOOST_CHECK_EQUAL(nSize2, nSize + 1);
+
+    // A cached signature must not validate a different message or key
+    BOOST_CHECK(!darkSendSigner.VerifyMessage(pubkey, vchSig, strMessage + "x", errorMessage));
+
+    CKey key2;
+    key2.MakeNewKey(true);
+    BOOST_CHECK(!darkSendSigner.VerifyMessage(key2.GetPubKey(), vchSig, strMessage, errorMessage));
+
+    // Failures are never cached
+    darkSendSigner.GetVerifyCacheStats(nHits, nMisses, nSize);
+    BOOST_CHECK_EQUAL(nSize, nSize2);
+    BOOST_CHECK_EQUAL(nHits, nHits2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,50 @@
+// Copyright (c) 2016-2020 The Neutron Developers
+//
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NEUTRON_TEST_DATFILE_H
+#define NEUTRON_TEST_DATFILE_H
+
+#include "util.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <stdio.h>
+#include <string>
+
+/**
+ * Base of the fixtures of tests that persist to a .dat file in the data
+ * directory: the file is removed before and after each test, so a test
+ * never reads what another one left behind.
+ */
+struct DatFileSetup
+{
+    boost::filesystem::path path;
+
+    explicit DatFileSetup(const std::string& strFile) : path(GetDataDir() / strFile)
+    {
+        boost::filesystem::remove(path);
+    }
+
+    ~DatFileSetup()
+    {
+        boost::filesystem::remove(path);
+    }
+
+    /** Flips the byte at nOffset, the file then has to fail its checksum */
+    void CorruptByte(long nOffset) const
+    {
+        FILE* file = fopen(path.string().c_str(), "r+b");
+        BOOST_REQUIRE(file != NULL);
+        fseek(file, nOffset, SEEK_SET);
+        int c = fgetc(file);
+        BOOST_REQUIRE(c != EOF);
+        fseek(file, nOffset, SEEK_SET);
+        fputc(c ^ 0xff, file);
+        fclose(file);
+    }
+};
+
+#endif // NEUTRON_TEST_DATFILE_H
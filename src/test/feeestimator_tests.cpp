@@ -0,0 +1,136 @@
+#include <boost/test/unit_test.hpp>
+
+#include "datfile.h"
+#include "feeestimator.h"
+#include "main.h"
+
+using namespace std;
+
+static const int64_t HIGH_FEE_RATE = 10 * MIN_TX_FEE;
+static const int64_t LOW_FEE_RATE = MIN_TX_FEE;
+
+// Feeds blocks to an estimator: every block brings nPerBlock high and low fee
+// transactions, the high ones confirm in the next block and the low ones after
+// nLowDelay blocks, or never if nLowDelay is 0
+class FeeHistory
+{
+public:
+    CFeeEstimator& estimator;
+    int nHeight;
+    unsigned int nNextLockTime;
+    map<int, vector<CTransaction> > mapDue;
+
+    FeeHistory(CFeeEstimator& estimatorIn) : estimator(estimatorIn), nHeight(1), nNextLockTime(1) {}
+
+    CTransaction Add(int64_t nFeeRate)
+    {
+        CTransaction tx;
+        tx.vin.push_back(CTxIn(COutPoint(uint256(nNextLockTime), 0)));
+        tx.vout.push_back(CTxOut(COIN, CScript()));
+        tx.nLockTime = nNextLockTime++;
+
+        estimator.TransactionAdded(tx.GetHash(), nFeeRate, 1000, nHeight);
+
+        return tx;
+    }
+
+    void Run(int nBlocks, int nPerBlock, int nLowDelay)
+    {
+        for (int i = 0; i < nBlocks; i++)
+        {
+            for (int n = 0; n < nPerBlock; n++)
+            {
+                mapDue[nHeight + 1].push_back(Add(HIGH_FEE_RATE));
+                CTransaction txLow = Add(LOW_FEE_RATE);
+
+                if (nLowDelay > 0)
+                    mapDue[nHeight + nLowDelay].push_back(txLow);
+            }
+
+            nHeight++;
+            estimator.BlockConnected(nHeight, mapDue[nHeight]);
+            mapDue.erase(nHeight);
+        }
+    }
+};
+
+BOOST_AUTO_TEST_SUITE(feeestimator_tests)
+
+BOOST_AUTO_TEST_CASE(feeestimator_targets)
+{
+    CFeeEstimator estimator;
+
+    // Nothing known yet
+    for (int nBlocks = 1; nBlocks <= FEE_ESTIMATOR_MAX_CONFIRMS; nBlocks++)
+        BOOST_CHECK_EQUAL(estimator.EstimateFee(nBlocks), -1);
+
+    FeeHistory history(estimator);
+    history.Run(200, 10, 5);
+
+    // Only the high fee got in within 1..4 blocks, from 5 the low fee is enough
+    for (int nBlocks = 1; nBlocks < 5; nBlocks++)
+        BOOST_CHECK_EQUAL(estimator.EstimateFee(nBlocks), HIGH_FEE_RATE);
+
+    for (int nBlocks = 5; nBlocks <= FEE_ESTIMATOR_MAX_CONFIRMS; nBlocks++)
+        BOOST_CHECK_EQUAL(estimator.EstimateFee(nBlocks), LOW_FEE_RATE);
+
+    BOOST_CHECK_EQUAL(estimator.EstimateFee(0), -1);
+    BOOST_CHECK_EQUAL(estimator.EstimateFee(FEE_ESTIMATOR_MAX_CONFIRMS + 1), -1);
+
+    // Blocks stop taking the low fee: waiting and given up transactions push the estimate up
+    history.Run(100, 10, 0);
+    BOOST_CHECK_EQUAL(estimator.EstimateFee(5), HIGH_FEE_RATE);
+    BOOST_CHECK_EQUAL(estimator.EstimateFee(FEE_ESTIMATOR_MAX_CONFIRMS), HIGH_FEE_RATE);
+
+    // Given up transactions are no longer tracked
+    BOOST_CHECK(estimator.GetTrackedCount() <= 10 * 2 * FEE_ESTIMATOR_MAX_CONFIRMS);
+}
+
+BOOST_AUTO_TEST_CASE(feeestimator_removed_and_old_blocks)
+{
+    CFeeEstimator estimator;
+    FeeHistory history(estimator);
+
+    // Transactions leaving the pool unconfirmed say nothing about their fee
+    CTransaction tx = history.Add(HIGH_FEE_RATE);
+    BOOST_CHECK_EQUAL(estimator.GetTrackedCount(), 1);
+    estimator.TransactionRemoved(tx.GetHash());
+    BOOST_CHECK_EQUAL(estimator.GetTrackedCount(), 0);
+
+    history.Run(50, 10, 2);
+    int64_t nEstimate = estimator.EstimateFee(2);
+    BOOST_CHECK_EQUAL(nEstimate, LOW_FEE_RATE);
+
+    // A block at a height already seen (reorg) is ignored
+    unsigned int nTracked = estimator.GetTrackedCount();
+    estimator.BlockConnected(history.nHeight, history.mapDue[history.nHeight + 1]);
+    BOOST_CHECK_EQUAL(estimator.GetTrackedCount(), nTracked);
+    BOOST_CHECK_EQUAL(estimator.EstimateFee(2), nEstimate);
+}
+
+BOOST_AUTO_TEST_CASE(feeestimator_file_roundtrip)
+{
+    DatFileSetup datfile("fee_estimates.dat");
+
+    CFeeEstimator estimator;
+    FeeHistory history(estimator);
+    history.Run(200, 10, 5);
+
+    CFeeEstimator estimatorRead;
+    BOOST_CHECK(!CFeeEstimatesDB().Read(estimatorRead));
+
+    BOOST_REQUIRE(CFeeEstimatesDB().Write(estimator));
+    BOOST_REQUIRE(CFeeEstimatesDB().Read(estimatorRead));
+
+    for (int nBlocks = 1; nBlocks <= FEE_ESTIMATOR_MAX_CONFIRMS; nBlocks++)
+        BOOST_CHECK_EQUAL(estimatorRead.EstimateFee(nBlocks), estimator.EstimateFee(nBlocks));
+
+    // A corrupted file fails its checksum
+    datfile.CorruptByte(20);
+
+    CFeeEstimator estimatorCorrupt;
+    BOOST_CHECK(!CFeeEstimatesDB().Read(estimatorCorrupt));
+    BOOST_CHECK_EQUAL(estimatorCorrupt.EstimateFee(1), -1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,109 @@
+#include <boost/test/unit_test.hpp>
+
+#include "key.h"
+#include "keystore.h"
+#include "script.h"
+
+using namespace std;
+
+// Exposes the protected encryption calls CWallet normally drives
+class CTestCryptoKeyStore : public CCryptoKeyStore
+{
+public:
+    bool EncryptKeys(CKeyingMaterial& vMasterKeyIn) { return CCryptoKeyStore::EncryptKeys(vMasterKeyIn); }
+    bool Unlock(const CKeyingMaterial& vMasterKeyIn) { return CCryptoKeyStore::Unlock(vMasterKeyIn); }
+    bool CheckMasterKey(const CKeyingMaterial& vMasterKeyIn) const { return CCryptoKeyStore::CheckMasterKey(vMasterKeyIn); }
+};
+
+BOOST_AUTO_TEST_SUITE(keystore_tests)
+
+BOOST_AUTO_TEST_CASE(keystore_signing_key_cache)
+{
+    CTestCryptoKeyStore keystore;
+    CKeyingMaterial vMasterKey(WALLET_CRYPTO_KEY_SIZE, 0x5a);
+
+    CKey key;
+    key.MakeNewKey(true);
+    CKeyID keyID = key.GetPubKey().GetID();
+
+    BOOST_REQUIRE(keystore.AddKey(key));
+    BOOST_REQUIRE(keystore.EncryptKeys(vMasterKey));
+    BOOST_REQUIRE(keystore.Unlock(vMasterKey));
+
+    uint64_t nHits, nMisses;
+    unsigned int nSize;
+
+    // The first signing lookup decrypts and caches, the next ones are copies
+    CKey keyOut;
+    BOOST_CHECK(keystore.GetSigningKey(keyID, keyOut));
+    BOOST_CHECK(keyOut.GetPubKey() == key.GetPubKey());
+    BOOST_CHECK(keyOut.IsCompressed());
+
+    CKey keyCached;
+    BOOST_CHECK(keystore.GetSigningKey(keyID, keyCached));
+    BOOST_CHECK(keystore.GetKey(keyID, keyCached));
+    BOOST_CHECK(keyCached.GetPubKey() == key.GetPubKey());
+    BOOST_CHECK(keyCached.IsCompressed());
+
+    keystore.GetSigningKeyCacheStats(nHits, nMisses, nSize);
+    BOOST_CHECK_EQUAL(nSize, 1U);
+    BOOST_CHECK_EQUAL(nMisses, 1U);
+    BOOST_CHECK_EQUAL(nHits, 2U);
+
+    // A key from the cache signs like the original
+    uint256 hash = key.GetPubKey().GetHash();
+    vector<unsigned char> vchSig;
+    BOOST_CHECK(keyCached.Sign(hash, vchSig));
+    BOOST_CHECK(key.Verify(hash, vchSig));
+
+    // Locking purges the cache, nothing can be signed afterwards
+    BOOST_CHECK(keystore.Lock());
+    keystore.GetSigningKeyCacheStats(nHits, nMisses, nSize);
+    BOOST_CHECK_EQUAL(nSize, 0U);
+    BOOST_CHECK(!keystore.GetSigningKey(keyID, keyOut));
+    BOOST_CHECK(!keystore.GetKey(keyID, keyOut));
+
+    // Unlocking again doesn't bring old entries back until they're used
+    BOOST_REQUIRE(keystore.Unlock(vMasterKey));
+    keystore.GetSigningKeyCacheStats(nHits, nMisses, nSize);
+    BOOST_CHECK_EQUAL(nSize, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(keystore_encrypt_keys_threads)
+{
+    CTestCryptoKeyStore keystore;
+    CKeyingMaterial vMasterKey(WALLET_CRYPTO_KEY_SIZE, 0xa5);
+
+    // Enough keys for EncryptKeys to split the work, mixing compressed and uncompressed
+    vector<CKey> vKeys(ENCRYPT_KEYS_PER_THREAD * 2 + 17);
+
+    for (unsigned int i = 0; i < vKeys.size(); i++)
+    {
+        vKeys[i].MakeNewKey(i % 3 != 0);
+        BOOST_REQUIRE(keystore.AddKey(vKeys[i]));
+    }
+
+    BOOST_REQUIRE(keystore.EncryptKeys(vMasterKey));
+    BOOST_CHECK_EQUAL(keystore.size(), (int) vKeys.size());
+    BOOST_REQUIRE(keystore.Unlock(vMasterKey));
+
+    BOOST_FOREACH(const CKey& key, vKeys)
+    {
+        CKey keyOut;
+        BOOST_REQUIRE(keystore.GetKey(key.GetPubKey().GetID(), keyOut));
+        BOOST_CHECK(keyOut.GetPubKey() == key.GetPubKey());
+        BOOST_CHECK_EQUAL(keyOut.IsCompressed(), key.IsCompressed());
+    }
+
+    // A wrong master key must not unlock the store
+    BOOST_CHECK(keystore.Lock());
+    CKeyingMaterial vWrongKey(WALLET_CRYPTO_KEY_SIZE, 0x11);
+    BOOST_CHECK(!keystore.Unlock(vWrongKey));
+
+    // Checking a master key, as a passphrase change does, leaves the store locked
+    BOOST_CHECK(keystore.CheckMasterKey(vMasterKey));
+    BOOST_CHECK(!keystore.CheckMasterKey(vWrongKey));
+    BOOST_CHECK(keystore.IsLocked());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
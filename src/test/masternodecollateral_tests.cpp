@@ -0,0 +1,102 @@
+#include <boost/test/unit_test.hpp>
+
+#include "main.h"
+#include "masternode.h"
+#include "masternodecollateral.h"
+#include "random.h"
+#include "version.h"
+
+using namespace std;
+
+struct CollateralSetup
+{
+    CTransaction txFund;
+    CTransaction txSpend;
+    COutPoint collateral;
+
+    CollateralSetup()
+    {
+        txFund.vin.push_back(CTxIn(COutPoint(GetRandHash(), 0)));
+        txFund.vout.push_back(CTxOut(25000 * COIN, CScript()));
+        collateral = COutPoint(txFund.GetHash(), 0);
+
+        txSpend.vin.push_back(CTxIn(collateral));
+        txSpend.vout.push_back(CTxOut(24999 * COIN, CScript()));
+    }
+
+    ~CollateralSetup()
+    {
+        collateralWatcher.Clear();
+    }
+};
+
+static bool IsSpent(const COutPoint& outpoint)
+{
+    bool fSpent = false;
+    BOOST_REQUIRE(collateralWatcher.GetSpent(outpoint, fSpent));
+
+    return fSpent;
+}
+
+BOOST_FIXTURE_TEST_SUITE(masternodecollateral_tests, CollateralSetup)
+
+BOOST_AUTO_TEST_CASE(collateral_spend_and_reorg)
+{
+    // Not in the tx index yet, so it counts as spent until its block connects
+    BOOST_CHECK(collateralWatcher.Watch(collateral));
+    collateralWatcher.TransactionsConnected(vector<CTransaction>(1, txFund));
+    BOOST_CHECK(!IsSpent(collateral));
+
+    // A spend waiting in the mempool
+    collateralWatcher.TransactionAddedToMempool(txSpend);
+    BOOST_CHECK(IsSpent(collateral));
+    collateralWatcher.TransactionRemovedFromMempool(txSpend);
+    BOOST_CHECK(!IsSpent(collateral));
+
+    // The spend confirms, then is reorganized away
+    collateralWatcher.TransactionsConnected(vector<CTransaction>(1, txSpend));
+    BOOST_CHECK(IsSpent(collateral));
+    collateralWatcher.TransactionsDisconnected(vector<CTransaction>(1, txSpend));
+    BOOST_CHECK(!IsSpent(collateral));
+
+    // Funding and spend in one block: undoing it leaves no collateral at all
+    vector<CTransaction> vtx;
+    vtx.push_back(txFund);
+    vtx.push_back(txSpend);
+    collateralWatcher.TransactionsConnected(vtx);
+    BOOST_CHECK(IsSpent(collateral));
+    collateralWatcher.TransactionsDisconnected(vector<CTransaction>(1, txSpend));
+    BOOST_CHECK(!IsSpent(collateral));
+    collateralWatcher.TransactionsDisconnected(vector<CTransaction>(1, txFund));
+    BOOST_CHECK(IsSpent(collateral));
+
+    BOOST_CHECK(collateralWatcher.GetEventCount() > 0);
+
+    collateralWatcher.Unwatch(collateral);
+    bool fSpent;
+    BOOST_CHECK(!collateralWatcher.GetSpent(collateral, fSpent));
+}
+
+BOOST_AUTO_TEST_CASE(collateral_masternode_state)
+{
+    CMasternode mn(CService(), CTxIn(collateral), CPubKey(), vector<unsigned char>(), GetTime(), CPubKey(), PROTOCOL_VERSION);
+    mn.UpdateLastSeen();
+
+    collateralWatcher.Watch(collateral);
+    collateralWatcher.TransactionsConnected(vector<CTransaction>(1, txFund));
+
+    mn.Check();
+    BOOST_CHECK(mn.IsEnabled());
+
+    // Picked up right away, without waiting for MASTERNODE_CHECK_SECONDS
+    collateralWatcher.TransactionsConnected(vector<CTransaction>(1, txSpend));
+    mn.Check();
+    BOOST_CHECK_EQUAL(mn.nActiveState, CMasternode::MASTERNODE_VIN_SPENT);
+
+    // A reorg that undoes the spend brings the masternode back
+    collateralWatcher.TransactionsDisconnected(vector<CTransaction>(1, txSpend));
+    mn.Check();
+    BOOST_CHECK(mn.IsEnabled());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
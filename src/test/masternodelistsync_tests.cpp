@@ -0,0 +1,254 @@
+#include <boost/test/unit_test.hpp>
+
+#include "key.h"
+#include "masternode.h"
+#include "masternodelistsync.h"
+#include "random.h"
+#include "simnet.h"
+#include "version.h"
+
+using namespace std;
+
+static const int64_t SIM_START_TIME = 1500000000;
+
+static CMasternode MakeMasternode(int n, const CPubKey& pubkey)
+{
+    CService addr(strprintf("8.%d.%d.%d", n / 65536 % 256, n / 256 % 256, n % 256), 9999);
+    uint256 hashSig = GetRandHash();
+    vector<unsigned char> vchSig(hashSig.begin(), hashSig.end());
+    vchSig.resize(71, n & 0xff);
+
+    return CMasternode(addr, CTxIn(COutPoint(GetRandHash(), n % 3)), pubkey, vchSig, SIM_START_TIME - n,
+                       pubkey, PROTOCOL_VERSION);
+}
+
+// The same masternode with a newer broadcast
+static void Rebroadcast(CMasternode& mn)
+{
+    mn.now += 600;
+    mn.sig[0] ^= 0xff;
+}
+
+// Bytes the node sends for dseg: one dsee per entry
+static uint64_t GetLegacyListBytes(const vector<CMasternode>& vMasternodes)
+{
+    uint64_t nBytes = 0;
+    int i = 0;
+
+    BOOST_FOREACH(const CMasternode& mn, vMasternodes)
+    {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << mn.vin << mn.addr << mn.sig << mn.now << mn.pubkey << mn.pubkey2 << (int) vMasternodes.size() << i++
+           << mn.lastTimeSeen << mn.protocolVersion;
+        nBytes += CMessageHeader::HEADER_SIZE + ss.size();
+    }
+
+    return nBytes;
+}
+
+// A peer that syncs its own copy of the list from the node
+struct CListSyncClient
+{
+    CMasternodeListSummary summary;
+    uint64_t nBytesReceived;
+    int nEntriesReceived;
+    bool fMatched;
+
+    void Handle(CSimNetwork& simnet, CSimNetwork::CSimPeer& peer, const string& strCommand, CDataStream& vRecv)
+    {
+        nBytesReceived += CMessageHeader::HEADER_SIZE + vRecv.size();
+
+        if (strCommand == NetMsgType::MNLISTSUM)
+        {
+            uint256 hashRoot;
+            unsigned int nCount;
+            vector<uint256> vBucketHashes;
+            vRecv >> hashRoot >> nCount >> vBucketHashes;
+
+            fMatched = hashRoot == summary.hashRoot;
+
+            if (!fMatched)
+                simnet.SendToNode(peer.nId, NetMsgType::GETMNLISTBUCKETS, summary.GetDifferentBuckets(vBucketHashes));
+        }
+        else if (strCommand == NetMsgType::MNLISTBUCKETS)
+        {
+            vector<CMasternodeListEntryRef> vEntries;
+            vRecv >> vEntries;
+
+            simnet.SendToNode(peer.nId, NetMsgType::GETMNENTRIES, summary.GetNeeded(vEntries));
+        }
+        else if (strCommand == NetMsgType::DSEE)
+            nEntriesReceived++;
+    }
+};
+
+struct ListSyncSetup
+{
+    CPubKey pubkey;
+
+    ListSyncSetup()
+    {
+        CKey key;
+        key.MakeNewKey(true);
+        pubkey = key.GetPubKey();
+    }
+
+    ~ListSyncSetup()
+    {
+        mnodeman.Clear();
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(masternodelistsync_tests, ListSyncSetup)
+
+BOOST_AUTO_TEST_CASE(listsync_summary)
+{
+    vector<CMasternode> vMasternodes;
+
+    for (int i = 0; i < 100; i++)
+        vMasternodes.push_back(MakeMasternode(i, pubkey));
+
+    // The order of the list doesn't matter, nor do the last seen times
+    vector<CMasternode> vOther(vMasternodes.rbegin(), vMasternodes.rend());
+    vOther[0].lastTimeSeen = SIM_START_TIME;
+
+    CMasternodeListSummary summary, summaryOther;
+    summary.Build(vMasternodes);
+    summaryOther.Build(vOther);
+    BOOST_CHECK_EQUAL(summary.nCount, 100U);
+    BOOST_CHECK(summary.hashRoot == summaryOther.hashRoot);
+    BOOST_CHECK(summary.GetDifferentBuckets(summaryOther.vBucketHashes).empty());
+
+    // One rebroadcast changes one bucket
+    Rebroadcast(vOther[10]);
+    summaryOther.Build(vOther);
+    BOOST_CHECK(summary.hashRoot != summaryOther.hashRoot);
+
+    vector<int> vBuckets = summary.GetDifferentBuckets(summaryOther.vBucketHashes);
+    BOOST_REQUIRE_EQUAL(vBuckets.size(), 1U);
+    BOOST_CHECK_EQUAL(vBuckets[0], CMasternodeListSummary::GetBucket(vOther[10].vin.prevout));
+
+    // Newer there: we need it. Newer here: they need ours, we don't need theirs.
+    vector<CMasternodeListEntryRef> vEntries = summaryOther.GetEntries(vBuckets);
+    vector<COutPoint> vNeeded = summary.GetNeeded(vEntries);
+    BOOST_REQUIRE_EQUAL(vNeeded.size(), 1U);
+    BOOST_CHECK(vNeeded[0] == vOther[10].vin.prevout);
+    BOOST_CHECK(summaryOther.GetNeeded(summary.GetEntries(vBuckets)).empty());
+
+    // Missing entries are needed, disabled and private ones aren't listed
+    CMasternode mnNew = MakeMasternode(100, pubkey);
+    CMasternode mnDisabled = MakeMasternode(101, pubkey);
+    mnDisabled.nActiveState = CMasternode::MASTERNODE_EXPIRED;
+    CMasternode mnPrivate = MakeMasternode(102, pubkey);
+    mnPrivate.addr = CService("10.0.0.1", 9999);
+    vOther.push_back(mnNew);
+    vOther.push_back(mnDisabled);
+    vOther.push_back(mnPrivate);
+    summaryOther.Build(vOther);
+    BOOST_CHECK_EQUAL(summaryOther.nCount, 101U);
+
+    vEntries = summaryOther.GetEntries(summary.GetDifferentBuckets(summaryOther.vBucketHashes));
+    vNeeded = summary.GetNeeded(vEntries);
+    BOOST_CHECK_EQUAL(vNeeded.size(), 2U);
+    BOOST_CHECK(find(vNeeded.begin(), vNeeded.end(), mnNew.vin.prevout) != vNeeded.end());
+}
+
+BOOST_AUTO_TEST_CASE(listsync_simnet_delta)
+{
+    // A network of a few thousand masternodes, the peer is a little behind
+    const int nMasternodes = 3000;
+    vector<CMasternode> vNode, vClient;
+
+    for (int i = 0; i < nMasternodes; i++)
+        vNode.push_back(MakeMasternode(i, pubkey));
+
+    vClient = vNode;
+    vClient.erase(vClient.end() - 20, vClient.end());
+
+    for (int i = 0; i < 10; i++)
+        Rebroadcast(vNode[i * 97]);
+
+    {
+        LOCK(cs_masternodes);
+        vecMasternodes = vNode;
+    }
+
+    CListSyncClient client;
+    client.summary.Build(vClient);
+    client.nBytesReceived = 0;
+    client.nEntriesReceived = 0;
+    client.fMatched = false;
+
+    CSimNetwork simnet(SIM_START_TIME);
+    int nPeer = simnet.AddPeer(50000, [&client](CSimNetwork& simnet, CSimNetwork::CSimPeer& peer,
+                                                const string& strCommand, CDataStream& vRecv) {
+        client.Handle(simnet, peer, strCommand, vRecv);
+    });
+
+    uint64_t nEntriesSentBefore = mnodeman.GetMessageStats().nListEntriesSent;
+    int64_t nStart = GetTimeMicros();
+    simnet.SendToNode(nPeer, NetMsgType::MNLISTVERSION, MNLIST_SYNC_VERSION);
+    simnet.SendToNode(nPeer, NetMsgType::GETMNLISTSUM, client.summary.hashRoot);
+    simnet.RunUntilIdle(60 * 1000000);
+    int64_t nMicros = GetTimeMicros() - nStart;
+
+    BOOST_CHECK_EQUAL(simnet.GetPeer(nPeer).pnode->nMasternodeListSyncVersion, MNLIST_SYNC_VERSION);
+    BOOST_CHECK(!client.fMatched);
+    BOOST_CHECK_EQUAL(client.nEntriesReceived, 30);
+    BOOST_CHECK_EQUAL(mnodeman.GetMessageStats().nListEntriesSent - nEntriesSentBefore, 30U);
+
+    uint64_t nLegacyBytes = GetLegacyListBytes(vNode);
+    BOOST_CHECK(client.nBytesReceived * 4 < nLegacyBytes);
+
+    BOOST_TEST_MESSAGE(strprintf("list sync: %d masternodes, %d entries behind, %u bytes received against %u for dseg,"
+                                 " %.1f ms", nMasternodes, client.nEntriesReceived, client.nBytesReceived,
+                                 nLegacyBytes, nMicros / 1000.0));
+
+    // In sync now: the roots match and nothing else is sent
+    client.summary.Build(vNode);
+    client.nBytesReceived = 0;
+    simnet.SendToNode(nPeer, NetMsgType::GETMNLISTSUM, client.summary.hashRoot);
+    simnet.RunUntilIdle(60 * 1000000);
+
+    BOOST_CHECK(client.fMatched);
+    BOOST_CHECK_EQUAL(client.nEntriesReceived, 30);
+    BOOST_CHECK(client.nBytesReceived < 100U);
+}
+
+BOOST_AUTO_TEST_CASE(listsync_request_fallback)
+{
+    {
+        LOCK(cs_masternodes);
+        vecMasternodes.push_back(MakeMasternode(0, pubkey));
+    }
+
+    CMasternodeListSummary summary = GetMasternodeListSummary();
+
+    CSimNetwork simnet(SIM_START_TIME);
+    int nOld = simnet.AddPeer(50000);
+    int nNew = simnet.AddPeer(50000);
+    simnet.SendToNode(nNew, NetMsgType::MNLISTVERSION, MNLIST_SYNC_VERSION + 1);
+    simnet.RunUntilIdle(1000000);
+
+    // A newer version is spoken at ours
+    BOOST_CHECK_EQUAL(simnet.GetPeer(nNew).pnode->nMasternodeListSyncVersion, MNLIST_SYNC_VERSION);
+    BOOST_CHECK_EQUAL(simnet.GetPeer(nOld).pnode->nMasternodeListSyncVersion, 0);
+
+    // Peers that never announced list sync get the full dseg
+    RequestMasternodeList(simnet.GetPeer(nOld).pnode, summary);
+    RequestMasternodeList(simnet.GetPeer(nNew).pnode, summary);
+    simnet.RunUntilIdle(1000000);
+
+    const vector<string>& vOld = simnet.GetPeer(nOld).vReceived;
+    const vector<string>& vNew = simnet.GetPeer(nNew).vReceived;
+    BOOST_CHECK(find(vOld.begin(), vOld.end(), string(NetMsgType::DSEG)) != vOld.end());
+    BOOST_CHECK(find(vNew.begin(), vNew.end(), string(NetMsgType::GETMNLISTSUM)) != vNew.end());
+    BOOST_CHECK(find(vNew.begin(), vNew.end(), string(NetMsgType::DSEG)) == vNew.end());
+
+    // With an empty list there's nothing to compare
+    RequestMasternodeList(simnet.GetPeer(nNew).pnode, CMasternodeListSummary());
+    simnet.RunUntilIdle(1000000);
+    BOOST_CHECK(find(vNew.begin(), vNew.end(), string(NetMsgType::DSEG)) != vNew.end());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
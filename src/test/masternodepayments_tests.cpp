@@ -0,0 +1,143 @@
+#include <boost/test/unit_test.hpp>
+
+#include "key.h"
+#include "masternode.h"
+#include "random.h"
+
+using namespace std;
+
+static CScript MakePayee()
+{
+    CKey key;
+    key.MakeNewKey(true);
+
+    return GetScriptForDestination(key.GetPubKey().GetID());
+}
+
+static CMasternodePaymentWinner MakeWinner(int nBlockHeight, const CScript& payee, uint64_t score)
+{
+    CMasternodePaymentWinner winner(CTxIn(COutPoint(GetRandHash(), 0)));
+    winner.nBlockHeight = nBlockHeight;
+    winner.payee = payee;
+    winner.score = score;
+    winner.vchSig.resize(71, nBlockHeight & 0xff);
+
+    return winner;
+}
+
+// A coinstake paying amount to payee, as the block at a payment height has
+static vector<CTransaction> MakeBlockTransactions(const CScript& payee, int64_t amount)
+{
+    vector<CTransaction> vtx(2);
+    vtx[1].vout.push_back(CTxOut(0, CScript()));
+    vtx[1].vout.push_back(CTxOut(amount, payee));
+
+    return vtx;
+}
+
+BOOST_AUTO_TEST_SUITE(masternodepayments_tests)
+
+BOOST_AUTO_TEST_CASE(payments_memory_bound)
+{
+    CMasternodePayments payments;
+    CScript payee = MakePayee();
+    CScript payeeRet;
+
+    // Three times around the ring: it never holds more than its size
+    for (int nHeight = 1; nHeight <= 3 * MASTERNODE_PAYMENTS_CACHE_BLOCKS; nHeight++)
+    {
+        CMasternodePaymentWinner winner = MakeWinner(nHeight, payee, 1);
+        BOOST_CHECK(payments.AddWinningMasternode(winner));
+    }
+
+    BOOST_CHECK_EQUAL(payments.GetRecordCount(), (unsigned int) MASTERNODE_PAYMENTS_CACHE_BLOCKS);
+    BOOST_CHECK(payments.GetBlockPayee(3 * MASTERNODE_PAYMENTS_CACHE_BLOCKS, payeeRet) && payeeRet == payee);
+    BOOST_CHECK(payments.GetBlockPayee(2 * MASTERNODE_PAYMENTS_CACHE_BLOCKS + 1, payeeRet));
+    BOOST_CHECK(!payments.GetBlockPayee(2 * MASTERNODE_PAYMENTS_CACHE_BLOCKS, payeeRet));
+
+    // A block older than the ring doesn't evict a newer one
+    CMasternodePaymentWinner winnerOld = MakeWinner(MASTERNODE_PAYMENTS_CACHE_BLOCKS, MakePayee(), 1000);
+    BOOST_CHECK(!payments.AddWinningMasternode(winnerOld));
+    BOOST_CHECK(payments.GetBlockPayee(3 * MASTERNODE_PAYMENTS_CACHE_BLOCKS, payeeRet) && payeeRet == payee);
+
+    // Seen votes are forgotten once their block is out of the ring
+    BOOST_CHECK_EQUAL(payments.GetSeenVoteCount(), 3U * MASTERNODE_PAYMENTS_CACHE_BLOCKS);
+    payments.CleanPaymentList(3 * MASTERNODE_PAYMENTS_CACHE_BLOCKS);
+    BOOST_CHECK_EQUAL(payments.GetSeenVoteCount(), MASTERNODE_PAYMENTS_CACHE_BLOCKS + 1U);
+}
+
+BOOST_AUTO_TEST_CASE(payments_winner_votes)
+{
+    CMasternodePayments payments;
+    CScript payee = MakePayee();
+    CScript payeeRet;
+    CTxIn vinRet;
+
+    CMasternodePaymentWinner winner = MakeWinner(100, payee, 50);
+    BOOST_CHECK(payments.AddWinningMasternode(winner));
+    BOOST_CHECK(payments.GetWinningMasternode(100, vinRet) && vinRet == winner.vin);
+
+    // The kept vote is served as it was received
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK(payments.HaveSeenVote(winner.GetHash()));
+    BOOST_REQUIRE(payments.GetVoteMessage(winner.GetHash(), ss));
+
+    CMasternodePaymentWinner winnerRet;
+    ss >> winnerRet;
+    BOOST_CHECK(winnerRet.vin == winner.vin && winnerRet.payee == winner.payee);
+    BOOST_CHECK(winnerRet.vchSig == winner.vchSig && winnerRet.score == winner.score);
+
+    // Lower scores are ignored, a higher one replaces the winner
+    CMasternodePaymentWinner winnerLower = MakeWinner(100, MakePayee(), 40);
+    BOOST_CHECK(!payments.AddWinningMasternode(winnerLower));
+    BOOST_CHECK(payments.GetBlockPayee(100, payeeRet) && payeeRet == payee);
+
+    CMasternodePaymentWinner winnerHigher = MakeWinner(100, MakePayee(), 60);
+    BOOST_CHECK(payments.AddWinningMasternode(winnerHigher));
+    BOOST_CHECK(payments.GetBlockPayee(100, payeeRet) && payeeRet == winnerHigher.payee);
+
+    // The vote that lost isn't served anymore
+    BOOST_CHECK(!payments.GetVoteMessage(winner.GetHash(), ss));
+
+    // Only payees that fit a compact record
+    CMasternodePaymentWinner winnerOdd = MakeWinner(101, CScript() << OP_TRUE, 1);
+    BOOST_CHECK(!payments.AddWinningMasternode(winnerOdd));
+    BOOST_CHECK(!payments.GetBlockPayee(101, payeeRet));
+}
+
+BOOST_AUTO_TEST_CASE(payments_reorg)
+{
+    CMasternodePayments payments;
+    CScript payeeA = MakePayee();
+    CScript payeeB = MakePayee();
+    CScript payeeRet;
+    int64_t amount = 5 * COIN;
+
+    // The block at a payment height, then the block replacing it in a reorg
+    vector<CTransaction> vtxA = MakeBlockTransactions(payeeA, amount);
+    vector<CTransaction> vtxB = MakeBlockTransactions(payeeB, amount);
+    BOOST_CHECK(payments.AddPastWinningMasternode(vtxA, amount, 500));
+    BOOST_CHECK(payments.GetBlockPayee(500, payeeRet) && payeeRet == payeeA);
+    BOOST_CHECK(payments.AddPastWinningMasternode(vtxB, amount, 500));
+    BOOST_CHECK(payments.GetBlockPayee(500, payeeRet) && payeeRet == payeeB);
+
+    // No output of the masternode amount, nothing changes
+    BOOST_CHECK(!payments.AddPastWinningMasternode(vtxA, amount + 1, 500));
+    BOOST_CHECK(payments.GetBlockPayee(500, payeeRet) && payeeRet == payeeB);
+
+    // Past winners have the highest score, only a reorganize recalculation replaces them
+    CMasternodePaymentWinner winner = MakeWinner(500, payeeA, 100);
+    BOOST_CHECK(!payments.AddWinningMasternode(winner));
+    BOOST_CHECK(payments.AddWinningMasternode(winner, true));
+    BOOST_CHECK(payments.GetBlockPayee(500, payeeRet) && payeeRet == payeeA);
+
+    // A reorg to a lower height leaves the blocks above it to be replaced
+    CMasternodePaymentWinner winnerNext = MakeWinner(501, payeeA, 100);
+    BOOST_CHECK(payments.AddWinningMasternode(winnerNext));
+    CMasternodePaymentWinner winnerNextReorg = MakeWinner(501, payeeB, 10);
+    BOOST_CHECK(payments.AddWinningMasternode(winnerNextReorg, true));
+    BOOST_CHECK(payments.GetBlockPayee(501, payeeRet) && payeeRet == payeeB);
+    BOOST_CHECK_EQUAL(payments.GetRecordCount(), 2U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,231 @@
+#include <boost/test/unit_test.hpp>
+
+#include "datfile.h"
+#include "key.h"
+#include "keystore.h"
+#include "main.h"
+#include "random.h"
+#include "txdb.h"
+#include "txmempool.h"
+
+using namespace std;
+
+// Starts each test with an empty pool and no mempool.dat
+struct MempoolPersistSetup : public DatFileSetup
+{
+    MempoolPersistSetup() : DatFileSetup("mempool.dat")
+    {
+        mempool.clear();
+    }
+
+    ~MempoolPersistSetup()
+    {
+        mempool.clear();
+    }
+};
+
+// A standard transaction spending an output we don't have, only fit for fCheckInputs=false
+static CTransaction MakeTransaction(const uint256& hashPrev, int64_t nValue)
+{
+    CKey key;
+    key.MakeNewKey(true);
+
+    CTransaction tx;
+    tx.vin.push_back(CTxIn(COutPoint(hashPrev, 0)));
+    tx.vout.push_back(CTxOut(nValue, GetScriptForDestination(key.GetPubKey().GetID())));
+
+    return tx;
+}
+
+// A parent paying to a key we hold and a child spending it with a valid signature
+static void MakeSignedPair(CTransaction& txParent, CTransaction& txChild)
+{
+    CBasicKeyStore keystore;
+    CKey key;
+    key.MakeNewKey(true);
+    keystore.AddKey(key);
+
+    txParent = CTransaction();
+    txParent.vin.push_back(CTxIn(COutPoint(GetRandHash(), 0)));
+    txParent.vout.push_back(CTxOut(10 * COIN, GetScriptForDestination(key.GetPubKey().GetID())));
+
+    txChild = MakeTransaction(txParent.GetHash(), 9 * COIN);
+    BOOST_REQUIRE(SignSignature(keystore, txParent, txChild, 0));
+}
+
+// The pool as hash -> entry time
+static map<uint256, int64_t> PoolEntries()
+{
+    map<uint256, int64_t> mapEntries;
+    vector<uint256> vtxid;
+    mempool.queryHashes(vtxid);
+
+    BOOST_FOREACH(const uint256& hash, vtxid)
+    {
+        CTxMemPoolEntryInfo info;
+        BOOST_REQUIRE(mempool.lookupInfo(hash, info));
+        mapEntries[hash] = info.nTime;
+    }
+
+    return mapEntries;
+}
+
+BOOST_FIXTURE_TEST_SUITE(mempool_persist_tests, MempoolPersistSetup)
+
+BOOST_AUTO_TEST_CASE(mempool_file_roundtrip)
+{
+    vector<CMempoolFileEntry> vEntries;
+
+    for (int i = 0; i < 3; i++)
+        vEntries.push_back(CMempoolFileEntry(MakeTransaction(GetRandHash(), COIN), CTxMemPoolEntryInfo(GetTime() - i, 1000 * i)));
+
+    BOOST_REQUIRE(CMempoolDB().Write(vEntries));
+
+    vector<CMempoolFileEntry> vRead;
+    BOOST_REQUIRE(CMempoolDB().Read(vRead));
+    BOOST_REQUIRE_EQUAL(vRead.size(), vEntries.size());
+
+    for (unsigned int i = 0; i < vEntries.size(); i++)
+    {
+        BOOST_CHECK(vRead[i].tx.GetHash() == vEntries[i].tx.GetHash());
+        BOOST_CHECK_EQUAL(vRead[i].nTime, vEntries[i].nTime);
+        BOOST_CHECK_EQUAL(vRead[i].nFee, vEntries[i].nFee);
+    }
+
+    // A corrupted file fails its checksum
+    CorruptByte(10);
+
+    BOOST_CHECK(!CMempoolDB().Read(vRead));
+    BOOST_CHECK(!LoadMempool(false));
+    BOOST_CHECK_EQUAL(mempool.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(mempool_restart_restores_pool)
+{
+    CTxDB txdb("r");
+    int64_t nNow = GetTime();
+
+    // A chain of three, each spending the one before, and an unrelated one
+    CTransaction tx = MakeTransaction(GetRandHash(), 10 * COIN);
+    BOOST_REQUIRE(mempool.accept(txdb, tx, false, NULL, nNow - 30));
+
+    for (int i = 0; i < 2; i++)
+    {
+        tx = MakeTransaction(tx.GetHash(), (9 - i) * COIN);
+        BOOST_REQUIRE(mempool.accept(txdb, tx, false, NULL, nNow - 20 + i));
+    }
+
+    tx = MakeTransaction(GetRandHash(), COIN);
+    BOOST_REQUIRE(mempool.accept(txdb, tx, false, NULL, nNow - 40));
+
+    // Too old to come back
+    CTransaction txExpired = MakeTransaction(GetRandHash(), COIN);
+    BOOST_REQUIRE(mempool.accept(txdb, txExpired, false, NULL, nNow - MEMPOOL_EXPIRY - 60));
+
+    map<uint256, int64_t> mapBefore = PoolEntries();
+    BOOST_REQUIRE_EQUAL(mapBefore.size(), 5);
+    BOOST_REQUIRE(DumpMempool());
+
+    // A restarted node starts with an empty pool until it reads mempool.dat
+    mempool.clear();
+    BOOST_CHECK_EQUAL(mempool.size(), 0);
+    BOOST_REQUIRE(LoadMempool(false));
+
+    mapBefore.erase(txExpired.GetHash());
+    map<uint256, int64_t> mapAfter = PoolEntries();
+    BOOST_CHECK(mapAfter == mapBefore);
+    BOOST_CHECK(!mempool.exists(txExpired.GetHash()));
+}
+
+BOOST_AUTO_TEST_CASE(mempool_same_second_parents_first)
+{
+    CTxDB txdb("r");
+    int64_t nNow = GetTime();
+    map<uint256, uint256> mapParent;
+
+    // Entry times are whole seconds: chains accepted within one share theirs, so only
+    // the inputs tell a parent from its child
+    for (int i = 0; i < 20; i++)
+    {
+        CTransaction tx = MakeTransaction(GetRandHash(), 10 * COIN);
+        BOOST_REQUIRE(mempool.accept(txdb, tx, false, NULL, nNow));
+
+        for (int j = 0; j < 2; j++)
+        {
+            CTransaction txChild = MakeTransaction(tx.GetHash(), (9 - j) * COIN);
+            BOOST_REQUIRE(mempool.accept(txdb, txChild, false, NULL, nNow));
+            mapParent[txChild.GetHash()] = tx.GetHash();
+            tx = txChild;
+        }
+    }
+
+    BOOST_REQUIRE(DumpMempool());
+
+    vector<CMempoolFileEntry> vEntries;
+    BOOST_REQUIRE(CMempoolDB().Read(vEntries));
+    BOOST_REQUIRE_EQUAL(vEntries.size(), 60U);
+
+    set<uint256> setSeen;
+
+    BOOST_FOREACH(const CMempoolFileEntry& entry, vEntries)
+    {
+        map<uint256, uint256>::const_iterator it = mapParent.find(entry.tx.GetHash());
+        BOOST_CHECK(it == mapParent.end() || setSeen.count(it->second));
+        setSeen.insert(entry.tx.GetHash());
+    }
+
+    // A file written children first, as the time sort alone could, loads parents first
+    reverse(vEntries.begin(), vEntries.end());
+    SortMempoolEntries(vEntries);
+    setSeen.clear();
+
+    BOOST_FOREACH(const CMempoolFileEntry& entry, vEntries)
+    {
+        map<uint256, uint256>::const_iterator it = mapParent.find(entry.tx.GetHash());
+        BOOST_CHECK(it == mapParent.end() || setSeen.count(it->second));
+        setSeen.insert(entry.tx.GetHash());
+    }
+
+    mempool.clear();
+    BOOST_REQUIRE(LoadMempool(false));
+    BOOST_CHECK_EQUAL(mempool.size(), 60);
+}
+
+BOOST_AUTO_TEST_CASE(mempool_load_checks_signatures)
+{
+    CTxDB txdb("r");
+    CTransaction txParent, txChild;
+    MakeSignedPair(txParent, txChild);
+
+    map<uint256, CTransaction> mapBatch;
+    mapBatch[txParent.GetHash()] = txParent;
+
+    // The parent is found in the batch, the child's signature is checked against it
+    BOOST_CHECK(PreVerifyMempoolSignatures(txdb, txChild, mapBatch));
+
+    CTransaction txBad = txChild;
+    txBad.vout[0].nValue = 8 * COIN;
+    BOOST_CHECK(!PreVerifyMempoolSignatures(txdb, txBad, mapBatch));
+
+    // Inputs it can't find are left to accept
+    BOOST_CHECK(PreVerifyMempoolSignatures(txdb, txBad, map<uint256, CTransaction>()));
+
+    // With inputs checked nothing here can be accepted: the parent spends an output
+    // that isn't in the chain and the child's signature is bad. The load still finishes.
+    vector<CMempoolFileEntry> vEntries;
+    int64_t nNow = GetTime();
+    vEntries.push_back(CMempoolFileEntry(txBad, CTxMemPoolEntryInfo(nNow, 1000)));
+    vEntries.push_back(CMempoolFileEntry(txParent, CTxMemPoolEntryInfo(nNow, 1000)));
+    BOOST_REQUIRE(CMempoolDB().Write(vEntries));
+
+    BOOST_CHECK(LoadMempool(true));
+    BOOST_CHECK_EQUAL(mempool.size(), 0);
+    BOOST_CHECK(!mempool.exists(txBad.GetHash()));
+
+    // The same file without input checks restores both, parent first
+    BOOST_CHECK(LoadMempool(false));
+    BOOST_CHECK(mempool.exists(txParent.GetHash()));
+    BOOST_CHECK(mempool.exists(txBad.GetHash()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,32 @@
+#include <boost/test/unit_test.hpp>
+
+#include "net.h"
+#include "protocol.h"
+
+BOOST_AUTO_TEST_SUITE(net_tests)
+
+BOOST_AUTO_TEST_CASE(net_bytes_per_msg_cmd_bounded)
+{
+    CNode node(INVALID_SOCKET, CAddress(CService("10.0.0.1", 7)), "", true);
+    CNode::mapMsgCmdSize mapSend, mapRecv;
+    node.GetBytesPerMsgCmd(mapSend, mapRecv);
+
+    const size_t nKnown = getAllNetMessageTypes().size() + 1;
+    BOOST_CHECK_EQUAL(mapRecv.size(), nKnown);
+
+    // Made up commands all land in one bucket
+    for (int i = 0; i < 1000; i++)
+        node.RecordRecvBytesPerMsgCmd(strprintf("junk%d", i), 10);
+
+    node.RecordRecvBytesPerMsgCmd(NetMsgType::PING, 32);
+    node.RecordSendBytesPerMsgCmd("junk", 5);
+    node.GetBytesPerMsgCmd(mapSend, mapRecv);
+
+    BOOST_CHECK_EQUAL(mapRecv.size(), nKnown);
+    BOOST_CHECK_EQUAL(mapSend.size(), nKnown);
+    BOOST_CHECK_EQUAL(mapRecv[CNode::MSG_CMD_OTHER], 10000U);
+    BOOST_CHECK_EQUAL(mapRecv[NetMsgType::PING], 32U);
+    BOOST_CHECK_EQUAL(mapSend[CNode::MSG_CMD_OTHER], 5U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
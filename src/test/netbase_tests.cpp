@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "netbase.h"
+#include "utiltime.h"
 
 using namespace std;
 
@@ -99,4 +100,138 @@ BOOST_AUTO_TEST_CASE(onioncat_test)
     BOOST_CHECK(addr1.IsRoutable());
 }
 
+BOOST_AUTO_TEST_CASE(netbase_interleave_families)
+{
+    vector<CService> vAddr;
+    vAddr.push_back(CService("2001::1", 1));
+    vAddr.push_back(CService("2001::2", 1));
+    vAddr.push_back(CService("2001::3", 1));
+    vAddr.push_back(CService("1.2.3.4", 1));
+
+    vector<CService> vOrdered = InterleaveAddressFamilies(vAddr);
+    BOOST_REQUIRE_EQUAL(vOrdered.size(), 4U);
+    BOOST_CHECK(vOrdered[0] == CService("2001::1", 1));
+    BOOST_CHECK(vOrdered[1] == CService("1.2.3.4", 1));
+    BOOST_CHECK(vOrdered[2] == CService("2001::2", 1));
+    BOOST_CHECK(vOrdered[3] == CService("2001::3", 1));
+}
+
+// Listens on an ephemeral loopback port
+static SOCKET ListenLoopback(CService& addrRet)
+{
+    SOCKET hSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    BOOST_REQUIRE(hSocket != INVALID_SOCKET);
+
+    struct sockaddr_in sockaddr;
+    memset(&sockaddr, 0, sizeof(sockaddr));
+    sockaddr.sin_family = AF_INET;
+    sockaddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sockaddr.sin_port = 0;
+
+    BOOST_REQUIRE(::bind(hSocket, (struct sockaddr*)&sockaddr, sizeof(sockaddr)) != SOCKET_ERROR);
+    BOOST_REQUIRE(listen(hSocket, SOMAXCONN) != SOCKET_ERROR);
+
+    socklen_t len = sizeof(sockaddr);
+    BOOST_REQUIRE(getsockname(hSocket, (struct sockaddr*)&sockaddr, &len) != SOCKET_ERROR);
+    BOOST_REQUIRE(addrRet.SetSockAddr((struct sockaddr*)&sockaddr));
+
+    return hSocket;
+}
+
+BOOST_AUTO_TEST_CASE(netbase_connect_race)
+{
+    CService addrListen;
+    SOCKET hListen = ListenLoopback(addrListen);
+
+    // A port nobody listens on refuses right away
+    CService addrClosed;
+    SOCKET hClosed = ListenLoopback(addrClosed);
+    CloseSocket(hClosed);
+
+    // TEST-NET-1 never answers, it gets its head start and then loses the race
+    vector<CService> vAddr;
+    vAddr.push_back(CService("192.0.2.1", addrListen.GetPort()));
+    vAddr.push_back(addrClosed);
+    vAddr.push_back(addrListen);
+
+    SOCKET hSocket;
+    CService addrConnected;
+    int64_t nStart = GetTimeMillis();
+
+    BOOST_REQUIRE(ConnectSocketDirectly(vAddr, hSocket, addrConnected, 5000));
+    int64_t nElapsed = GetTimeMillis() - nStart;
+
+    BOOST_CHECK(addrConnected == addrListen);
+    BOOST_CHECK_MESSAGE(nElapsed < 2 * CONNECT_ATTEMPT_DELAY + 500, "connect took " << nElapsed << "ms");
+    CloseSocket(hSocket);
+
+    // An address that answers returns as soon as it connects, it never waits out the
+    // attempt delay: eight connects one after the other take less than two delays
+    nStart = GetTimeMillis();
+
+    for (int i = 0; i < 8; i++)
+    {
+        BOOST_REQUIRE(ConnectSocketDirectly(vector<CService>(1, addrListen), hSocket, addrConnected, 5000));
+        CloseSocket(hSocket);
+    }
+
+    BOOST_CHECK_MESSAGE(GetTimeMillis() - nStart < 2 * CONNECT_ATTEMPT_DELAY,
+                        "8 loopback connects took " << GetTimeMillis() - nStart << "ms");
+
+    // Nothing left that could answer
+    BOOST_CHECK(!ConnectSocketDirectly(vector<CService>(1, addrClosed), hSocket, addrConnected, 1000));
+    BOOST_CHECK(hSocket == INVALID_SOCKET);
+
+    CloseSocket(hListen);
+}
+
+BOOST_AUTO_TEST_CASE(netbase_dns_cache)
+{
+    ClearDNSCache();
+    CDNSCacheStats before = GetDNSCacheStats();
+
+    // Numeric addresses never reach the cache
+    vector<CNetAddr> vIP;
+    BOOST_CHECK(LookupHost("127.0.0.1", vIP, 0, true));
+    BOOST_CHECK_EQUAL(GetDNSCacheStats().nMisses, before.nMisses);
+
+    // The second lookup of a name is answered from the cache, positive or negative
+    LookupHost("localhost", vIP, 0, true);
+    vector<CNetAddr> vCached;
+    LookupHost("localhost", vCached, 0, true);
+
+    CDNSCacheStats after = GetDNSCacheStats();
+    BOOST_CHECK_EQUAL(after.nMisses, before.nMisses + 1);
+    BOOST_CHECK_EQUAL(after.nHits, before.nHits + 1);
+    BOOST_CHECK_EQUAL(after.nEntries, 1U);
+    BOOST_CHECK(vIP == vCached);
+
+    ClearDNSCache();
+}
+
+BOOST_AUTO_TEST_CASE(netbase_async_resolver)
+{
+    CAsyncResolver resolver;
+
+    // Without threads the caller resolves
+    vector<CNetAddr> vIP = resolver.LookupHost("127.0.0.1", false).get();
+    BOOST_REQUIRE_EQUAL(vIP.size(), 1U);
+    BOOST_CHECK(vIP[0] == CNetAddr("127.0.0.1"));
+
+    resolver.Start(2);
+    BOOST_CHECK(resolver.IsRunning());
+
+    vector<CAsyncResolver::Result> vResults;
+    vResults.push_back(resolver.LookupHost("127.0.0.1", false));
+    vResults.push_back(resolver.LookupHost("::1", false));
+    vResults.push_back(resolver.LookupHost("not an address", false));
+
+    BOOST_CHECK(vResults[0].get()[0] == CNetAddr("127.0.0.1"));
+    BOOST_CHECK(vResults[1].get()[0] == CNetAddr("::1"));
+    BOOST_CHECK(vResults[2].get().empty());
+
+    resolver.Stop();
+    BOOST_CHECK(!resolver.IsRunning());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
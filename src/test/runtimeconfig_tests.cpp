@@ -0,0 +1,156 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include "runtimeconfig.h"
+#include "util.h"
+
+using namespace std;
+
+static bool ParseOk(const CConfigOption& option, const string& strValue, string& strCanonical)
+{
+    int64_t n;
+    string strError;
+    return option.Parse(strValue, n, strCanonical, strError);
+}
+
+static bool ParseOk(const CConfigOption& option, const string& strValue)
+{
+    string strCanonical;
+    return ParseOk(option, strValue, strCanonical);
+}
+
+static void WriteConfigFile(const boost::filesystem::path& path, const string& strContent)
+{
+    boost::filesystem::ofstream stream(path);
+    stream << strContent;
+}
+
+BOOST_AUTO_TEST_SUITE(runtimeconfig_tests)
+
+BOOST_AUTO_TEST_CASE(runtimeconfig_parse)
+{
+    CConfigOption optionInt("testint", CONFIG_INT, 10, -5, 1000, true);
+    CConfigOption optionBool("testbool", CONFIG_BOOL, 0, 0, 1, true);
+    CConfigOption optionList("testlist", CONFIG_LIST, 0, 0, 0, true);
+    string str;
+
+    // Whole integers within the range only, unlike atoi
+    BOOST_CHECK(ParseOk(optionInt, " 42 ", str) && str == "42");
+    BOOST_CHECK(ParseOk(optionInt, "-5") && ParseOk(optionInt, "1000"));
+    BOOST_CHECK(!ParseOk(optionInt, "-6") && !ParseOk(optionInt, "1001"));
+    BOOST_CHECK(!ParseOk(optionInt, ""));
+    BOOST_CHECK(!ParseOk(optionInt, "12x"));
+    BOOST_CHECK(!ParseOk(optionInt, "1.5"));
+    BOOST_CHECK(!ParseOk(optionInt, "99999999999999999999"));
+
+    BOOST_CHECK(ParseOk(optionBool, "true", str) && str == "1");
+    BOOST_CHECK(ParseOk(optionBool, "FALSE", str) && str == "0");
+    BOOST_CHECK(ParseOk(optionBool, "", str) && str == "1");
+    BOOST_CHECK(!ParseOk(optionBool, "yes"));
+    BOOST_CHECK(!ParseOk(optionBool, "2"));
+
+    BOOST_CHECK(ParseOk(optionList, "Net, masternode,net", str) && str == "net,masternode");
+    BOOST_CHECK(ParseOk(optionList, "", str) && str.empty());
+    BOOST_CHECK(!ParseOk(optionList, "net;masternode"));
+}
+
+BOOST_AUTO_TEST_CASE(runtimeconfig_set)
+{
+    CConfigOption optionHot("testhot", CONFIG_INT, 10, 0, 100, true);
+    CConfigOption optionCold("testcold", CONFIG_INT, 10, 0, 100, false);
+    string strError;
+
+    BOOST_CHECK(optionHot.Set("20", CONFIG_SOURCE_RPC, strError));
+    BOOST_CHECK_EQUAL(optionHot.GetInt(), 20);
+    BOOST_CHECK_EQUAL(optionHot.GetSource(), CONFIG_SOURCE_RPC);
+
+    // A rejected value changes nothing
+    BOOST_CHECK(!optionHot.Set("200", CONFIG_SOURCE_RPC, strError));
+    BOOST_CHECK(!strError.empty());
+    BOOST_CHECK_EQUAL(optionHot.GetInt(), 20);
+
+    // Needs a restart: only taken at startup
+    BOOST_CHECK(!optionCold.Set("20", CONFIG_SOURCE_RPC, strError));
+    BOOST_CHECK(!optionCold.Set("20", CONFIG_SOURCE_RELOAD, strError));
+    BOOST_CHECK_EQUAL(optionCold.GetInt(), 10);
+    BOOST_CHECK(optionCold.Set("20", CONFIG_SOURCE_ARGS, strError));
+    BOOST_CHECK_EQUAL(optionCold.GetInt(), 20);
+
+    optionHot.Reset();
+    BOOST_CHECK_EQUAL(optionHot.GetInt(), 10);
+    BOOST_CHECK_EQUAL(optionHot.GetSource(), CONFIG_SOURCE_DEFAULT);
+
+    // The registry
+    BOOST_CHECK(FindConfigOption("banscore") == &configBanScore);
+    BOOST_CHECK(FindConfigOption("-banscore") == &configBanScore);
+    BOOST_CHECK(!FindConfigOption("nosuchoption"));
+    BOOST_CHECK(!SetConfigOption("nosuchoption", "1", strError));
+    BOOST_CHECK(!SetConfigOption("schedulerthreads", "4", strError));
+    BOOST_CHECK(!SetConfigOption("blockmaxsize", "10", strError));
+
+    BOOST_CHECK(SetConfigOption("banscore", "50", strError));
+    BOOST_CHECK_EQUAL(configBanScore.GetInt(), 50);
+    configBanScore.Reset();
+}
+
+BOOST_AUTO_TEST_CASE(runtimeconfig_debug_categories)
+{
+    bool fDebugBefore = fDebug;
+    string strError;
+
+    BOOST_CHECK(SetConfigOption("debug", "net", strError));
+    BOOST_CHECK(fDebug);
+    BOOST_CHECK(LogAcceptCategory("net"));
+    BOOST_CHECK(!LogAcceptCategory("masternode"));
+
+    BOOST_CHECK(SetConfigOption("debug", "1", strError));
+    BOOST_CHECK(LogAcceptCategory("masternode"));
+
+    BOOST_CHECK(SetConfigOption("debug", "", strError));
+    BOOST_CHECK(!fDebug);
+    BOOST_CHECK(!LogAcceptCategory("net"));
+
+    configDebug.Reset();
+    fDebug = fDebugBefore;
+}
+
+BOOST_AUTO_TEST_CASE(runtimeconfig_reload)
+{
+    boost::filesystem::path path = boost::filesystem::temp_directory_path() /
+        boost::filesystem::unique_path("neutron-config-%%%%%%%%.conf");
+    mapArgs["-conf"] = path.string();
+
+    // Bad values are skipped, the rest is taken
+    WriteConfigFile(path, "banscore=42\nlimitfreerelay=abc\nschedulerthreads=4\n");
+    BOOST_CHECK_EQUAL(ReloadConfigFile(), 1);
+    BOOST_CHECK_EQUAL(configBanScore.GetInt(), 42);
+    BOOST_CHECK_EQUAL(configBanScore.GetSource(), CONFIG_SOURCE_RELOAD);
+    BOOST_CHECK_EQUAL(configLimitFreeRelay.GetInt(), configLimitFreeRelay.GetDefault());
+    BOOST_CHECK_EQUAL(configSchedulerThreads.GetInt(), configSchedulerThreads.GetDefault());
+
+    // Unchanged, nothing to do
+    BOOST_CHECK_EQUAL(ReloadConfigFile(), 0);
+
+    // Removed from the file, back to the default
+    WriteConfigFile(path, "printcoinstake=1\n");
+    BOOST_CHECK_EQUAL(ReloadConfigFile(), 2);
+    BOOST_CHECK_EQUAL(configBanScore.GetInt(), configBanScore.GetDefault());
+    BOOST_CHECK(configPrintCoinStake.GetBool());
+
+    // setconfig wins over the file, whether the file has the option or not
+    string strError;
+    BOOST_REQUIRE(SetConfigOption("banscore", "77", strError));
+    BOOST_CHECK_EQUAL(ReloadConfigFile(), 0);
+    WriteConfigFile(path, "printcoinstake=1\nbanscore=42\n");
+    BOOST_CHECK_EQUAL(ReloadConfigFile(), 0);
+    BOOST_CHECK_EQUAL(configBanScore.GetInt(), 77);
+    BOOST_CHECK_EQUAL(configBanScore.GetSource(), CONFIG_SOURCE_RPC);
+
+    configBanScore.Reset();
+    configPrintCoinStake.Reset();
+    mapArgs.erase("-conf");
+    boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
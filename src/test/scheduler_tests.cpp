@@ -0,0 +1,64 @@
+#include <boost/test/unit_test.hpp>
+
+#include "scheduler.h"
+#include "util.h"
+
+#include <atomic>
+#include <boost/foreach.hpp>
+
+using namespace std;
+
+static std::atomic<int> nMainRunning(0);
+static std::atomic<int> nMainOverlaps(0);
+static std::atomic<int> nRuns(0);
+
+static void MainClassTask()
+{
+    if (++nMainRunning > 1)
+        nMainOverlaps++;
+
+    MilliSleep(5);
+    nMainRunning--;
+    nRuns++;
+}
+
+BOOST_AUTO_TEST_SUITE(scheduler_tests)
+
+BOOST_AUTO_TEST_CASE(scheduler_lock_class_and_stats)
+{
+    CScheduler scheduler;
+
+    // Two tasks of the same lock class must never run at the same time,
+    // even with a free worker for each
+    scheduler.scheduleTask("first", &MainClassTask, 1, SCHEDULER_CLASS_MAIN);
+    scheduler.scheduleTask("second", &MainClassTask, 1, SCHEDULER_CLASS_MAIN, 2);
+
+    boost::thread_group workers;
+    for (int i = 0; i < 3; i++)
+        workers.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+
+    for (int i = 0; i < 200 && nRuns < 20; i++)
+        MilliSleep(10);
+
+    workers.interrupt_all();
+    workers.join_all();
+
+    BOOST_CHECK(nRuns >= 20);
+    BOOST_CHECK_EQUAL(nMainOverlaps, 0);
+
+    vector<CSchedulerTaskInfo> vInfo = scheduler.getTaskInfo();
+    BOOST_REQUIRE_EQUAL(vInfo.size(), 2U);
+
+    BOOST_FOREACH(const CSchedulerTaskInfo& info, vInfo)
+    {
+        BOOST_CHECK(info.nRuns > 0);
+        BOOST_CHECK(info.nMaxMicros >= 5000);
+        BOOST_CHECK(info.nTotalMicros >= (int64_t) info.nRuns * 5000);
+        BOOST_CHECK(info.nClass == SCHEDULER_CLASS_MAIN);
+    }
+
+    BOOST_CHECK(vInfo[0].nIntervalMillis == 1);
+    BOOST_CHECK(vInfo[1].nIntervalMillis >= 1 && vInfo[1].nIntervalMillis <= 3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
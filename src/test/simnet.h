@@ -0,0 +1,283 @@
+// Copyright (c) 2016-2020 The Neutron Developers
+//
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NEUTRON_TEST_SIMNET_H
+#define NEUTRON_TEST_SIMNET_H
+
+#include "main.h"
+#include "net.h"
+#include "streams.h"
+#include "util.h"
+#include "utiltime.h"
+#include "version.h"
+
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * Deterministic in-process network for tests and benchmarks.
+ *
+ * The node under test talks to a number of simulated peers through
+ * CNodeTransport instead of sockets. Every message becomes an event on a
+ * virtual clock (driving SetMockTime, so GetTime and GetAdjustedTime follow
+ * it) and is delivered after the link latency, in (time, send order) order.
+ * Partitioned links drop messages in both directions. Nothing depends on
+ * wall time or thread scheduling, so a scenario replays identically.
+ *
+ * Chain, mempool and masternode state are process globals, so there is one
+ * full node per process; the peers are scripted through their handlers.
+ */
+class CSimNetwork : public CNodeTransport
+{
+public:
+    struct CSimPeer;
+
+    /** Called for every message the node sends to a peer */
+    typedef std::function<void(CSimNetwork&, CSimPeer&, const std::string&, CDataStream&)> MessageHandler;
+
+    struct CSimPeer
+    {
+        int nId;
+        CNode* pnode; // the node's side of the connection
+        int64_t nLatencyMicros;
+        bool fPartitioned;
+        MessageHandler handler;
+        std::vector<std::string> vReceived; // commands the peer got, in delivery order
+    };
+
+    explicit CSimNetwork(int64_t nStartTime)
+    {
+        nNowMicros = nStartTime * 1000000;
+        nSequence = 0;
+        nDelivered = 0;
+        nDropped = 0;
+        SetMockTime(nStartTime);
+    }
+
+    ~CSimNetwork()
+    {
+        for (std::map<int, CSimPeer>::iterator it = mapPeers.begin(); it != mapPeers.end(); it++)
+            delete it->second.pnode;
+
+        SetMockTime(0);
+    }
+
+    /** Adds an inbound peer; with fHandshake the version exchange is taken as done */
+    int AddPeer(int64_t nLatencyMicros, MessageHandler handler = MessageHandler(), bool fHandshake = true)
+    {
+        int nId = mapPeers.size();
+        CAddress addr(CService(strprintf("10.0.%d.%d", nId / 250, nId % 250 + 1), 7), NODE_NETWORK);
+
+        CSimPeer& peer = mapPeers[nId];
+        peer.nId = nId;
+        peer.pnode = new CNode(INVALID_SOCKET, addr, strprintf("sim%d", nId), true);
+        peer.pnode->pTransport = this;
+        peer.nLatencyMicros = nLatencyMicros;
+        peer.fPartitioned = false;
+        peer.handler = handler;
+
+        if (fHandshake)
+        {
+            peer.pnode->nVersion = PROTOCOL_VERSION;
+            peer.pnode->SetRecvVersion(PROTOCOL_VERSION);
+            peer.pnode->fSuccessfullyConnected = true;
+        }
+
+        mapNodePeer[peer.pnode] = nId;
+
+        return nId;
+    }
+
+    CSimPeer& GetPeer(int nId) { return mapPeers.at(nId); }
+
+    void SetLatency(int nId, int64_t nLatencyMicros) { GetPeer(nId).nLatencyMicros = nLatencyMicros; }
+    void SetPartitioned(int nId, bool fPartitioned) { GetPeer(nId).fPartitioned = fPartitioned; }
+
+    /** Queues a message from a peer to the node */
+    template <typename... Args>
+    void SendToNode(int nId, const char* pszCommand, const Args&... args)
+    {
+        CDataStream ssPayload(SER_NETWORK, PROTOCOL_VERSION);
+        Serialize(ssPayload, args...);
+
+        CSimPeer& peer = GetPeer(nId);
+        Schedule(peer, true, pszCommand, ssPayload);
+    }
+
+    /** CNodeTransport: the node sent a message to one of the peers */
+    void Send(CNode* pnode, const CSerializeData& data)
+    {
+        CDataStream ssMsg(&data[0], &data[0] + data.size(), SER_NETWORK, PROTOCOL_VERSION);
+        CMessageHeader hdr;
+        ssMsg >> hdr;
+
+        Schedule(GetPeer(mapNodePeer.at(pnode)), false, hdr.GetCommand(), ssMsg);
+    }
+
+    /** Delivers everything due within the next nMicros of virtual time */
+    void RunFor(int64_t nMicros)
+    {
+        int64_t nEnd = nNowMicros + nMicros;
+
+        while (!setEvents.empty() && setEvents.begin()->nTime <= nEnd)
+        {
+            CEvent event = *setEvents.begin();
+            setEvents.erase(setEvents.begin());
+
+            SetNow(event.nTime);
+            Deliver(event);
+        }
+
+        SetNow(nEnd);
+        SendAll();
+    }
+
+    /** Runs until no messages are in flight, at most nMaxMicros of virtual time */
+    void RunUntilIdle(int64_t nMaxMicros)
+    {
+        int64_t nEnd = nNowMicros + nMaxMicros;
+
+        while (!setEvents.empty() && setEvents.begin()->nTime <= nEnd)
+            RunFor(setEvents.begin()->nTime - nNowMicros);
+    }
+
+    int64_t GetNowMicros() const { return nNowMicros; }
+    unsigned int GetInFlight() const { return setEvents.size(); }
+    uint64_t GetDelivered() const { return nDelivered; }
+    uint64_t GetDropped() const { return nDropped; }
+
+private:
+    struct CEvent
+    {
+        int64_t nTime;
+        uint64_t nSequence;
+        int nPeer;
+        bool fToNode;
+        std::string strCommand;
+        std::vector<char> vPayload;
+
+        bool operator<(const CEvent& other) const
+        {
+            if (nTime != other.nTime)
+                return nTime < other.nTime;
+
+            return nSequence < other.nSequence;
+        }
+    };
+
+    static void Serialize(CDataStream& ss) {}
+
+    template <typename T, typename... Args>
+    static void Serialize(CDataStream& ss, const T& arg, const Args&... args)
+    {
+        ss << arg;
+        Serialize(ss, args...);
+    }
+
+    void SetNow(int64_t nMicros)
+    {
+        nNowMicros = nMicros;
+        SetMockTime(nNowMicros / 1000000);
+    }
+
+    void Schedule(const CSimPeer& peer, bool fToNode, const std::string& strCommand, const CDataStream& ssPayload)
+    {
+        if (peer.fPartitioned)
+        {
+            nDropped++;
+            return;
+        }
+
+        CEvent event;
+        event.nTime = nNowMicros + peer.nLatencyMicros;
+        event.nSequence = nSequence++;
+        event.nPeer = peer.nId;
+        event.fToNode = fToNode;
+        event.strCommand = strCommand;
+        event.vPayload.assign(ssPayload.begin(), ssPayload.end());
+
+        setEvents.insert(event);
+    }
+
+    void Deliver(const CEvent& event)
+    {
+        CSimPeer& peer = GetPeer(event.nPeer);
+
+        // A partition also cuts messages that were already on the wire
+        if (peer.fPartitioned)
+        {
+            nDropped++;
+            return;
+        }
+
+        nDelivered++;
+
+        if (!event.fToNode)
+        {
+            peer.vReceived.push_back(event.strCommand);
+
+            if (peer.handler)
+            {
+                CDataStream ssPayload(event.vPayload, SER_NETWORK, PROTOCOL_VERSION);
+                peer.handler(*this, peer, event.strCommand, ssPayload);
+            }
+
+            return;
+        }
+
+        CMessageHeader hdr(event.strCommand.c_str(), event.vPayload.size());
+        const char* pch = event.vPayload.empty() ? NULL : &event.vPayload[0];
+        uint256 hash = Hash(pch, pch + event.vPayload.size());
+        memcpy(&hdr.nChecksum, &hash, sizeof(hdr.nChecksum));
+
+        CDataStream ssMsg(SER_NETWORK, PROTOCOL_VERSION);
+        ssMsg << hdr;
+        ssMsg.write(pch, event.vPayload.size());
+
+        CNode* pnode = peer.pnode;
+        LOCK(pnode->cs_vRecvMsg);
+        pnode->ReceiveMsgBytes(&ssMsg[0], ssMsg.size());
+
+        // ProcessMessages handles one message per call, like the handler thread loop
+        while (!pnode->fDisconnect && !pnode->vRecvMsg.empty() && pnode->vRecvMsg.front().complete())
+        {
+            size_t nBefore = pnode->vRecvMsg.size();
+            size_t nGetDataBefore = pnode->vRecvGetData.size();
+            ProcessMessages(pnode);
+
+            if (pnode->vRecvMsg.size() == nBefore && pnode->vRecvGetData.size() == nGetDataBefore)
+                break;
+        }
+    }
+
+    void SendAll()
+    {
+        for (std::map<int, CSimPeer>::iterator it = mapPeers.begin(); it != mapPeers.end(); it++)
+        {
+            CNode* pnode = it->second.pnode;
+
+            if (!pnode->fDisconnect)
+                SendMessages(pnode, false);
+
+            LOCK(pnode->cs_vSend);
+
+            if (!pnode->vSendMsg.empty())
+                SocketSendData(pnode);
+        }
+    }
+
+    int64_t nNowMicros;
+    uint64_t nSequence;
+    uint64_t nDelivered;
+    uint64_t nDropped;
+    std::map<int, CSimPeer> mapPeers;
+    std::map<CNode*, int> mapNodePeer;
+    std::set<CEvent> setEvents;
+};
+
+#endif // NEUTRON_TEST_SIMNET_H
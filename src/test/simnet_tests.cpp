@@ -0,0 +1,176 @@
+#include <boost/test/unit_test.hpp>
+
+#include "key.h"
+#include "random.h"
+#include "simnet.h"
+#include "txmempool.h"
+
+using namespace std;
+
+extern map<uint256, CTransaction> mapOrphanTransactions;
+extern map<uint256, set<uint256> > mapOrphanTransactionsByPrev;
+extern unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans);
+
+static const int64_t SIM_START_TIME = 1500000000;
+
+static vector<pair<int, int64_t> > vPongs;
+
+// Records when each peer's pong arrived and checks it echoes the ping nonce
+static void RecordPong(CSimNetwork& simnet, CSimNetwork::CSimPeer& peer, const string& strCommand, CDataStream& vRecv)
+{
+    if (strCommand != NetMsgType::PONG)
+        return;
+
+    uint64_t nonce;
+    vRecv >> nonce;
+    BOOST_CHECK_EQUAL(nonce, (uint64_t) peer.nId + 1000);
+
+    vPongs.push_back(make_pair(peer.nId, simnet.GetNowMicros()));
+}
+
+BOOST_AUTO_TEST_SUITE(simnet_tests)
+
+BOOST_AUTO_TEST_CASE(simnet_latency_and_ordering)
+{
+    vPongs.clear();
+    CSimNetwork simnet(SIM_START_TIME);
+
+    int nSlow = simnet.AddPeer(300000, RecordPong);
+    int nFast = simnet.AddPeer(100000, RecordPong);
+
+    simnet.SendToNode(nSlow, NetMsgType::PING, (uint64_t) nSlow + 1000);
+    simnet.SendToNode(nFast, NetMsgType::PING, (uint64_t) nFast + 1000);
+
+    // One way takes 100ms for the fast peer, the round trip 200ms
+    simnet.RunFor(150000);
+    BOOST_CHECK(vPongs.empty());
+
+    simnet.RunUntilIdle(10000000);
+    BOOST_REQUIRE_EQUAL(vPongs.size(), 2U);
+    BOOST_CHECK_EQUAL(vPongs[0].first, nFast);
+    BOOST_CHECK_EQUAL(vPongs[0].second, SIM_START_TIME * 1000000 + 200000);
+    BOOST_CHECK_EQUAL(vPongs[1].first, nSlow);
+    BOOST_CHECK_EQUAL(vPongs[1].second, SIM_START_TIME * 1000000 + 600000);
+
+    // The node sees the virtual clock
+    simnet.RunFor(2000000);
+    BOOST_CHECK_EQUAL(GetTime(), SIM_START_TIME + 2);
+}
+
+BOOST_AUTO_TEST_CASE(simnet_partition)
+{
+    vPongs.clear();
+    CSimNetwork simnet(SIM_START_TIME);
+
+    int nPeer = simnet.AddPeer(50000, RecordPong);
+
+    // Cut the link while the ping is on the wire
+    simnet.SendToNode(nPeer, NetMsgType::PING, (uint64_t) nPeer + 1000);
+    simnet.SetPartitioned(nPeer, true);
+    simnet.RunUntilIdle(1000000);
+
+    BOOST_CHECK(vPongs.empty());
+    BOOST_CHECK(simnet.GetDropped() >= 1);
+
+    // Once healed the same exchange goes through
+    simnet.SetPartitioned(nPeer, false);
+    simnet.SendToNode(nPeer, NetMsgType::PING, (uint64_t) nPeer + 1000);
+    simnet.RunUntilIdle(1000000);
+
+    BOOST_CHECK_EQUAL(vPongs.size(), 1U);
+    BOOST_CHECK(simnet.GetDelivered() >= 2);
+}
+
+BOOST_AUTO_TEST_CASE(simnet_ping_timeout)
+{
+    CSimNetwork simnet(SIM_START_TIME);
+    uint64_t nPingNonce = 0;
+
+    // The peer notes the node's ping and doesn't answer it
+    int nPeer = simnet.AddPeer(50000, [&nPingNonce](CSimNetwork& simnet, CSimNetwork::CSimPeer& peer,
+                                                    const string& strCommand, CDataStream& vRecv) {
+        if (strCommand == NetMsgType::PING)
+            vRecv >> nPingNonce;
+    });
+
+    simnet.RunFor(1000);
+    simnet.RunUntilIdle(1000000);
+    CNode* pnode = simnet.GetPeer(nPeer).pnode;
+    BOOST_REQUIRE(nPingNonce != 0);
+    BOOST_CHECK_EQUAL(pnode->nPingNonceSent, nPingNonce);
+
+    // Unanswered, the node pings no more and drops the peer after TIMEOUT_INTERVAL
+    int64_t nStart = pnode->nPingUsecStart;
+    BOOST_CHECK(!pnode->IsPingTimedOut(nStart + TIMEOUT_INTERVAL * 1000000LL));
+    BOOST_CHECK(pnode->IsPingTimedOut(nStart + TIMEOUT_INTERVAL * 1000000LL + 1));
+
+    // A pong with another nonce doesn't count, the right one does
+    simnet.SendToNode(nPeer, NetMsgType::PONG, nPingNonce + 1);
+    simnet.RunUntilIdle(1000000);
+    BOOST_CHECK(pnode->IsPingTimedOut(nStart + TIMEOUT_INTERVAL * 1000000LL + 1));
+
+    simnet.SendToNode(nPeer, NetMsgType::PONG, nPingNonce);
+    simnet.RunUntilIdle(1000000);
+    BOOST_CHECK_EQUAL(pnode->nPingNonceSent, 0U);
+    BOOST_CHECK(!pnode->IsPingTimedOut(nStart + TIMEOUT_INTERVAL * 1000000LL + 1));
+}
+
+BOOST_AUTO_TEST_CASE(simnet_orphan_flood)
+{
+    vPongs.clear();
+    mapOrphanTransactions.clear();
+    mapOrphanTransactionsByPrev.clear();
+    CSimNetwork simnet(SIM_START_TIME);
+
+    int nFlooder = simnet.AddPeer(20000);
+    int nHonest = simnet.AddPeer(100000, RecordPong);
+
+    CKey key;
+    key.MakeNewKey(true);
+    CScript script = GetScriptForDestination(key.GetPubKey().GetID());
+
+    // Standard transactions spending outputs nobody has, every one sent twice
+    const int nOrphans = 2000;
+    vector<CTransaction> vOrphans;
+
+    for (int i = 0; i < nOrphans; i++)
+    {
+        CTransaction tx;
+        tx.vin.push_back(CTxIn(COutPoint(GetRandHash(), 0)));
+        tx.vout.push_back(CTxOut(COIN, script));
+        vOrphans.push_back(tx);
+    }
+
+    unsigned long nPoolBefore = mempool.size();
+    int64_t nStart = GetTimeMicros();
+
+    for (int i = 0; i < 2 * nOrphans; i++)
+    {
+        simnet.SendToNode(nFlooder, NetMsgType::TX, vOrphans[i % nOrphans]);
+
+        if (i == nOrphans)
+            simnet.SendToNode(nHonest, NetMsgType::PING, (uint64_t) nHonest + 1000);
+    }
+
+    simnet.RunUntilIdle(60 * 1000000);
+    int64_t nMicros = GetTimeMicros() - nStart;
+
+    // Held once each, none in the pool, and the other peer is still answered
+    BOOST_CHECK_EQUAL(mapOrphanTransactions.size(), (unsigned int) nOrphans);
+    BOOST_CHECK_EQUAL(mapOrphanTransactionsByPrev.size(), (unsigned int) nOrphans);
+    BOOST_CHECK_EQUAL(mempool.size(), nPoolBefore);
+    BOOST_CHECK_EQUAL(vPongs.size(), 1U);
+    BOOST_CHECK(!simnet.GetPeer(nFlooder).pnode->fDisconnect);
+
+    BOOST_TEST_MESSAGE(strprintf("orphan flood: %d transactions twice, %.1f ms", nOrphans, nMicros / 1000.0));
+
+    // Past the limit orphans are evicted, the index by input goes with them
+    BOOST_CHECK_EQUAL(LimitOrphanTxSize(nOrphans / 4), (unsigned int) (nOrphans - nOrphans / 4));
+    BOOST_CHECK_EQUAL(mapOrphanTransactions.size(), (unsigned int) nOrphans / 4);
+    BOOST_CHECK_EQUAL(mapOrphanTransactionsByPrev.size(), (unsigned int) nOrphans / 4);
+
+    mapOrphanTransactions.clear();
+    mapOrphanTransactionsByPrev.clear();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
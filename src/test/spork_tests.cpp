@@ -0,0 +1,101 @@
+#include <boost/test/unit_test.hpp>
+
+#include "base58.h"
+#include "datfile.h"
+#include "key.h"
+#include "spork.h"
+
+using namespace std;
+
+static string SecretString(const CKey& key)
+{
+    bool fCompressed;
+    CSecret vchSecret = key.GetSecret(fCompressed);
+
+    return CBitcoinSecret(vchSecret, fCompressed).ToString();
+}
+
+// Makes key the spork key for the duration of a test
+struct SporkKeySetup : public DatFileSetup
+{
+    string strMainPubKey, strTestPubKey;
+    CKey key;
+
+    SporkKeySetup() : DatFileSetup("sporks.dat")
+    {
+        strMainPubKey = sporkManager.strMainPubKeyNew;
+        strTestPubKey = sporkManager.strTestPubKeyNew;
+
+        key.MakeNewKey(false);
+        sporkManager.strMainPubKeyNew = sporkManager.strTestPubKeyNew = HexStr(key.GetPubKey().Raw());
+    }
+
+    ~SporkKeySetup()
+    {
+        sporkManager.strMainPubKeyNew = strMainPubKey;
+        sporkManager.strTestPubKeyNew = strTestPubKey;
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(spork_tests, SporkKeySetup)
+
+BOOST_AUTO_TEST_CASE(spork_lookup_by_id_and_name)
+{
+    CSporkManager manager;
+
+    BOOST_CHECK_EQUAL(manager.GetSporkValue(SPORK_12_PAYMENT_ENFORCEMENT_THRESHOLD), SPORK_12_PAYMENT_ENFORCEMENT_THRESHOLD_DEFAULT);
+    BOOST_CHECK_EQUAL(manager.GetSporkValue(SPORK_START - 1), -1);
+    BOOST_CHECK_EQUAL(manager.GetSporkValue(SPORK_END + 1), -1);
+    BOOST_CHECK(!manager.IsSporkActive(SPORK_END + 1));
+
+    BOOST_CHECK_EQUAL(manager.GetSporkNameByID(SPORK_14_MASTERNODE_DISTRIBUTION_TICK), "SPORK_14_MASTERNODE_DISTRIBUTION_TICK");
+    BOOST_CHECK_EQUAL(manager.GetSporkIDByName("SPORK_1_MASTERNODE_PAYMENTS_ENFORCEMENT"), SPORK_1_MASTERNODE_PAYMENTS_ENFORCEMENT);
+    BOOST_CHECK_EQUAL(manager.GetSporkIDByName("SPORK_99"), -1);
+    BOOST_CHECK_EQUAL(manager.GetSporkNameByID(SPORK_END + 1), "Unknown");
+}
+
+BOOST_AUTO_TEST_CASE(spork_restart_restores_sporks)
+{
+    CSporkManager manager;
+    BOOST_REQUIRE(manager.SetPrivKey(SecretString(key)));
+    BOOST_REQUIRE(manager.UpdateSpork(SPORK_12_PAYMENT_ENFORCEMENT_THRESHOLD, 7));
+    BOOST_REQUIRE(manager.Dump());
+
+    // A restarted node has only the compiled defaults until it reads sporks.dat
+    CSporkManager restarted;
+    BOOST_CHECK_EQUAL(restarted.GetSporkValue(SPORK_12_PAYMENT_ENFORCEMENT_THRESHOLD), SPORK_12_PAYMENT_ENFORCEMENT_THRESHOLD_DEFAULT);
+
+    BOOST_REQUIRE(restarted.Load());
+    BOOST_CHECK_EQUAL(restarted.GetSporkValue(SPORK_12_PAYMENT_ENFORCEMENT_THRESHOLD), 7);
+    BOOST_CHECK_EQUAL(restarted.GetSporkValue(SPORK_4_PAYMENT_ENFORCEMENT_DOS_VALUE), SPORK_4_PAYMENT_ENFORCEMENT_DOS_VALUE_DEFAULT);
+}
+
+BOOST_AUTO_TEST_CASE(spork_restart_rejects_bad_data)
+{
+    // A spork signed with some other key is dropped on load
+    CKey keyOther;
+    keyOther.MakeNewKey(false);
+
+    CSporkMessage spork(SPORK_12_PAYMENT_ENFORCEMENT_THRESHOLD, 99, GetTime());
+    spork.Sign(SecretString(keyOther));
+
+    BOOST_REQUIRE(CSporkDB().Write(vector<CSporkMessage>(1, spork), vector<CAlert>()));
+
+    CSporkManager restarted;
+    BOOST_CHECK(restarted.Load());
+    BOOST_CHECK_EQUAL(restarted.GetSporkValue(SPORK_12_PAYMENT_ENFORCEMENT_THRESHOLD), SPORK_12_PAYMENT_ENFORCEMENT_THRESHOLD_DEFAULT);
+
+    // A corrupted file fails its checksum and leaves the defaults in place
+    CSporkManager manager;
+    BOOST_REQUIRE(manager.SetPrivKey(SecretString(key)));
+    BOOST_REQUIRE(manager.UpdateSpork(SPORK_12_PAYMENT_ENFORCEMENT_THRESHOLD, 3));
+    BOOST_REQUIRE(manager.Dump());
+
+    CorruptByte(10);
+
+    CSporkManager corrupted;
+    BOOST_CHECK(!corrupted.Load());
+    BOOST_CHECK_EQUAL(corrupted.GetSporkValue(SPORK_12_PAYMENT_ENFORCEMENT_THRESHOLD), SPORK_12_PAYMENT_ENFORCEMENT_THRESHOLD_DEFAULT);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
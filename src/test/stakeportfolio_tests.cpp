@@ -0,0 +1,157 @@
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <numeric>
+
+#include "stakeportfolio.h"
+
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(stakeportfolio_tests)
+
+BOOST_AUTO_TEST_CASE(stakepolicy_split_and_combine)
+{
+    CStakePolicy policy;
+
+    // By default only young kernels split, whatever they pay back
+    BOOST_CHECK(policy.ShouldSplit(10 * COIN, DEFAULT_STAKE_SPLIT_AGE - 1));
+    BOOST_CHECK(!policy.ShouldSplit(1000000 * COIN, DEFAULT_STAKE_SPLIT_AGE));
+
+    // A value threshold splits large paybacks of old kernels too
+    policy.nSplitThreshold = 2000 * COIN;
+    BOOST_CHECK(!policy.ShouldSplit(2000 * COIN - 1, DEFAULT_STAKE_SPLIT_AGE));
+    BOOST_CHECK(policy.ShouldSplit(2000 * COIN, DEFAULT_STAKE_SPLIT_AGE));
+    policy.nSplitThreshold = 0;
+    policy.nSplitAge = 0;
+    BOOST_CHECK(!policy.ShouldSplit(1000000 * COIN, 0));
+
+    // Small outputs join a small stake, up to the input limit
+    BOOST_CHECK(policy.ShouldCombine(10 * COIN, 1, 10 * COIN));
+    BOOST_CHECK(!policy.ShouldCombine(10 * COIN, 1, DEFAULT_STAKE_COMBINE_THRESHOLD));
+    BOOST_CHECK(!policy.ShouldCombine(DEFAULT_STAKE_COMBINE_THRESHOLD, 1, 10 * COIN));
+    BOOST_CHECK(!policy.ShouldCombine(10 * COIN, DEFAULT_STAKE_COMBINE_INPUTS, 10 * COIN));
+
+    // 0 inputs leaves all combining to the background task
+    policy.nMaxCombineInputs = 0;
+    BOOST_CHECK(!policy.ShouldCombine(10 * COIN, 1, 10 * COIN));
+}
+
+BOOST_AUTO_TEST_CASE(stakepolicy_plan_consolidation)
+{
+    CStakePolicy policy;
+    policy.nTargetOutputs = 10;
+    policy.nTargetValue = 100 * COIN;
+
+    vector<int64_t> vValues;
+    vValues.push_back(5000 * COIN);
+    vValues.push_back(40 * COIN);
+    vValues.push_back(10 * COIN);
+    vValues.push_back(30 * COIN);
+    vValues.push_back(70 * COIN);
+
+    // At or under the target count nothing happens
+    BOOST_CHECK(policy.PlanConsolidation(vValues, 10).empty());
+
+    // Smallest first until the target value is reached, large outputs are left alone
+    vector<unsigned int> vPlan = policy.PlanConsolidation(vValues, 20);
+    BOOST_REQUIRE_EQUAL(vPlan.size(), 4);
+    BOOST_CHECK_EQUAL(vPlan[0], 2);
+    BOOST_CHECK_EQUAL(vPlan[1], 3);
+    BOOST_CHECK_EQUAL(vPlan[2], 1);
+    BOOST_CHECK_EQUAL(vPlan[3], 4);
+
+    // One over the target only needs two merged
+    vPlan = policy.PlanConsolidation(vValues, 11);
+    BOOST_CHECK_EQUAL(vPlan.size(), 2);
+
+    // A single small output can't be consolidated
+    BOOST_CHECK(policy.PlanConsolidation(vector<int64_t>(1, COIN), 20).empty());
+}
+
+BOOST_AUTO_TEST_CASE(stakepolicy_portfolio_converges)
+{
+    CStakePolicy policy;
+    policy.nTargetOutputs = 50;
+    policy.nSplitAge = 0;
+    policy.nSplitThreshold = 2000 * COIN;
+
+    // A wallet that drifted into lots of small outputs
+    vector<int64_t> vOutputs(2000, 5 * COIN);
+    vOutputs.push_back(20000 * COIN);
+    int64_t nTotal = accumulate(vOutputs.begin(), vOutputs.end(), (int64_t) 0);
+
+    int nTransfers = 0;
+
+    while (nTransfers < 1000)
+    {
+        vector<unsigned int> vPlan = policy.PlanConsolidation(vOutputs, vOutputs.size());
+
+        if (vPlan.empty())
+            break;
+
+        BOOST_REQUIRE(vPlan.size() <= MAX_CONSOLIDATE_INPUTS);
+
+        int64_t nValue = 0;
+        sort(vPlan.rbegin(), vPlan.rend());
+
+        for (unsigned int i = 0; i < vPlan.size(); i++)
+        {
+            nValue += vOutputs[vPlan[i]];
+            vOutputs.erase(vOutputs.begin() + vPlan[i]);
+        }
+
+        vOutputs.push_back(nValue);
+        nTransfers++;
+    }
+
+    BOOST_CHECK(nTransfers < 1000);
+    BOOST_CHECK(vOutputs.size() <= policy.nTargetOutputs);
+    BOOST_CHECK_EQUAL(accumulate(vOutputs.begin(), vOutputs.end(), (int64_t) 0), nTotal);
+
+    // Staking the large output keeps splitting it until the pieces are under the threshold
+    for (int nStake = 0; nStake < 100; nStake++)
+    {
+        vector<int64_t>::iterator it = max_element(vOutputs.begin(), vOutputs.end());
+        int64_t nCredit = *it + COIN;
+        vOutputs.erase(it);
+
+        if (policy.ShouldSplit(nCredit, DEFAULT_STAKE_SPLIT_AGE))
+        {
+            vOutputs.push_back(nCredit / 2);
+            vOutputs.push_back(nCredit - nCredit / 2);
+        }
+        else
+            vOutputs.push_back(nCredit);
+    }
+
+    BOOST_CHECK(*max_element(vOutputs.begin(), vOutputs.end()) < policy.nSplitThreshold + 100 * COIN);
+}
+
+BOOST_AUTO_TEST_CASE(stakepolicy_set)
+{
+    CStakePolicy policy;
+
+    // Consolidating spends fees, it has to be asked for
+    BOOST_CHECK(!policy.fConsolidate);
+
+    BOOST_CHECK(policy.Set("targetvalue", "250"));
+    BOOST_CHECK_EQUAL(policy.nTargetValue, 250 * COIN);
+    BOOST_CHECK(policy.Set("splitage", "3600"));
+    BOOST_CHECK_EQUAL(policy.nSplitAge, 3600);
+    BOOST_CHECK(policy.Set("splitthreshold", "2000"));
+    BOOST_CHECK_EQUAL(policy.nSplitThreshold, 2000 * COIN);
+    BOOST_CHECK(policy.Set("combineinputs", "0"));
+    BOOST_CHECK_EQUAL(policy.nMaxCombineInputs, 0);
+    BOOST_CHECK(policy.Set("consolidate", "false"));
+    BOOST_CHECK(!policy.fConsolidate);
+    BOOST_CHECK(policy.Set("consolidate", ""));
+    BOOST_CHECK(policy.fConsolidate);
+
+    BOOST_CHECK(!policy.Set("targetvalue", "0"));
+    BOOST_CHECK(!policy.Set("targetoutputs", "many"));
+    BOOST_CHECK(!policy.Set("combinethreshold", "-1"));
+    BOOST_CHECK(!policy.Set("splitage", "-1"));
+    BOOST_CHECK(!policy.Set("splitcount", "1"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
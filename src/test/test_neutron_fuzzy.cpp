@@ -0,0 +1,412 @@
+// Copyright (c) 2016-2020 The Neutron Developers
+//
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// In-process fuzz targets for the deserialization and P2P message layer.
+//
+// Built as a standalone binary next to test_bitcoin. Without arguments an
+// input is read from stdin, which is what AFL expects; when built with
+// -DLIBFUZZER the libFuzzer entry point is compiled in instead of main().
+// The first four bytes of an input select the target (see FuzzTarget).
+//
+// "test_neutron_fuzzy replay <file> [iterations]" feeds a captured stream of
+// wire messages (magic, command, size, checksum, payload) through
+// ProcessMessages and reports throughput, for measuring the message handler.
+
+#include "alert.h"
+#include "db.h"
+#include "darksend.h"
+#include "main.h"
+#include "masternode.h"
+#include "net.h"
+#include "runtimeconfig.h"
+#include "spork.h"
+#include "streams.h"
+#include "util.h"
+#include "version.h"
+#include "wallet.h"
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+using namespace std;
+
+CWallet* pwalletMain;
+CClientUIInterface uiInterface;
+std::unique_ptr<CConnman> g_connman;
+CConnman* shared_connman;
+CScheduler* shared_scheduler;
+
+extern void noui_connect();
+
+enum FuzzTarget
+{
+    FUZZ_BLOCK_DESERIALIZE = 0,
+    FUZZ_TRANSACTION_DESERIALIZE,
+    FUZZ_ADDRESS_DESERIALIZE,
+    FUZZ_MASTERNODE_DESERIALIZE,
+    FUZZ_SPORK_DESERIALIZE,
+    FUZZ_ALERT_DESERIALIZE,
+    FUZZ_DARKSEND_QUEUE_DESERIALIZE,
+    FUZZ_INV_DESERIALIZE,
+    FUZZ_PROCESS_MESSAGE,
+    FUZZ_TARGET_MAX
+};
+
+void Shutdown(void* parg)
+{
+    exit(0);
+}
+
+void StartShutdown()
+{
+    exit(0);
+}
+
+static void InitFuzzEnvironment()
+{
+    static bool fInitialized = false;
+
+    if (fInitialized)
+        return;
+
+    fInitialized = true;
+
+    fPrintToDebugger = true; // don't want to write to debug.log file
+    noui_connect();
+
+    // Misbehaving peers are scored but never banned, so one bad message
+    // doesn't hide the rest of an input from the message handler. Misbehaving
+    // reads configBanScore, which only LoadConfigOptions takes from mapArgs.
+    SoftSetArg("-banscore", "2000000000");
+
+    std::string strError;
+
+    if (!LoadConfigOptions(strError) || configBanScore.GetInt() != 2000000000)
+    {
+        fprintf(stderr, "test_neutron_fuzzy: can't set -banscore: %s\n", strError.c_str());
+        exit(1);
+    }
+
+    bitdb.MakeMock();
+    LoadBlockIndex(true);
+
+    bool fFirstRun;
+    pwalletMain = new CWallet("wallet.dat");
+    pwalletMain->LoadWallet(fFirstRun);
+    RegisterWallet(pwalletMain);
+
+    g_connman = std::unique_ptr<CConnman>(new CConnman(0, 0));
+    shared_connman = g_connman.get();
+}
+
+static CNode* NewFuzzNode(bool fHandshake)
+{
+    CAddress addr(CService("127.0.0.1", 7), NODE_NETWORK);
+    CNode* pnode = new CNode(INVALID_SOCKET, addr, "fuzz", true);
+
+    if (fHandshake)
+    {
+        pnode->nVersion = PROTOCOL_VERSION;
+        pnode->fSuccessfullyConnected = true;
+    }
+
+    return pnode;
+}
+
+// Runs everything queued on pnode through the message handler, the way
+// ThreadMessageHandler does, and drops whatever it wanted to send back.
+// Returns the number of messages taken off the receive queue.
+static unsigned int DrainNode(CNode* pnode)
+{
+    unsigned int nProcessed = 0;
+
+    while (true)
+    {
+        {
+            LOCK(pnode->cs_vRecvMsg);
+
+            if (pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete())
+                break;
+
+            size_t nBefore = pnode->vRecvMsg.size();
+            ProcessMessages(pnode);
+
+            if (pnode->fDisconnect)
+            {
+                nProcessed += nBefore;
+                pnode->vRecvMsg.clear();
+                pnode->fDisconnect = false;
+            }
+            else if (pnode->vRecvMsg.size() < nBefore)
+                nProcessed += nBefore - pnode->vRecvMsg.size();
+            else if (!pnode->vRecvGetData.empty())
+                pnode->vRecvGetData.clear();
+            else
+                break;
+        }
+
+        {
+            LOCK(pnode->cs_vSend);
+            pnode->vSendMsg.clear();
+            pnode->nSendSize = 0;
+            pnode->nSendOffset = 0;
+        }
+    }
+
+    return nProcessed;
+}
+
+// Frames a payload as it would arrive from the network
+static void PushWireMessage(CNode* pnode, const string& strCommand, const char* pch, unsigned int nSize)
+{
+    CMessageHeader hdr(strCommand.c_str(), nSize);
+    uint256 hash = Hash(pch, pch + nSize);
+    memcpy(&hdr.nChecksum, &hash, sizeof(hdr.nChecksum));
+
+    CDataStream ssMsg(SER_NETWORK, PROTOCOL_VERSION);
+    ssMsg << hdr;
+    ssMsg.write(pch, nSize);
+
+    LOCK(pnode->cs_vRecvMsg);
+    pnode->ReceiveMsgBytes(&ssMsg[0], ssMsg.size());
+}
+
+// Whatever was accepted has to serialize again
+template <typename T>
+static void FuzzDeserialize(CDataStream& ds, T& obj)
+{
+    ds >> obj;
+
+    CDataStream ssCheck(SER_NETWORK, ds.GetVersion());
+    ssCheck << obj;
+}
+
+static int TestOneInput(const vector<unsigned char>& vch)
+{
+    if (vch.size() < sizeof(uint32_t))
+        return 0;
+
+    uint32_t nTarget;
+    memcpy(&nTarget, &vch[0], sizeof(nTarget));
+
+    CDataStream ds(vector<unsigned char>(vch.begin() + sizeof(nTarget), vch.end()), SER_NETWORK, PROTOCOL_VERSION);
+
+    try
+    {
+        switch (nTarget % FUZZ_TARGET_MAX)
+        {
+            case FUZZ_BLOCK_DESERIALIZE:
+            {
+                CBlock block;
+                ds >> block;
+                block.GetHash();
+                block.BuildMerkleTree();
+                break;
+            }
+            case FUZZ_TRANSACTION_DESERIALIZE:
+            {
+                CTransaction tx;
+                ds >> tx;
+                tx.GetHash();
+                tx.CheckTransaction();
+                break;
+            }
+            case FUZZ_ADDRESS_DESERIALIZE:
+            {
+                // addr serialization depends on the stream version
+                int nVersion;
+                ds >> nVersion;
+                ds.SetVersion(nVersion);
+
+                CAddress addr;
+                FuzzDeserialize(ds, addr);
+                break;
+            }
+            case FUZZ_MASTERNODE_DESERIALIZE:
+            {
+                // CMasternode has no serialization of its own, entries travel as the fields of a dsee
+                CTxIn vin;
+                CService addr;
+                CPubKey pubkey, pubkey2;
+                vector<unsigned char> vchSig;
+                int64_t sigTime, lastUpdated;
+                int count, current, protocolVersion;
+
+                ds >> vin >> addr >> vchSig >> sigTime >> pubkey >> pubkey2 >> count >> current >>
+                      lastUpdated >> protocolVersion;
+
+                CMasternode mn(addr, vin, pubkey, vchSig, sigTime, pubkey2, protocolVersion);
+                mn.addr.ToString();
+                break;
+            }
+            case FUZZ_SPORK_DESERIALIZE:
+            {
+                CSporkMessage spork;
+                ds >> spork;
+                spork.GetHash();
+                break;
+            }
+            case FUZZ_ALERT_DESERIALIZE:
+            {
+                CAlert alert;
+                ds >> alert;
+                alert.GetHash();
+                alert.CheckSignature();
+                break;
+            }
+            case FUZZ_DARKSEND_QUEUE_DESERIALIZE:
+            {
+                CDarksendQueue dsq;
+                ds >> dsq;
+
+                CService addr;
+                dsq.GetAddress(addr);
+                break;
+            }
+            case FUZZ_INV_DESERIALIZE:
+            {
+                CInv inv;
+                ds >> inv;
+                inv.ToString();
+                break;
+            }
+            case FUZZ_PROCESS_MESSAGE:
+            {
+                // Input is a 12 byte command followed by the payload; framing,
+                // magic and checksum are filled in so the fuzzer reaches the handlers
+                if (ds.size() < CMessageHeader::COMMAND_SIZE)
+                    return 0;
+
+                string strCommand(&ds[0], CMessageHeader::COMMAND_SIZE);
+                strCommand = strCommand.c_str();
+                ds.ignore(CMessageHeader::COMMAND_SIZE);
+
+                InitFuzzEnvironment();
+
+                std::unique_ptr<CNode> pnode(NewFuzzNode(strCommand != NetMsgType::VERSION));
+                PushWireMessage(pnode.get(), strCommand, ds.empty() ? NULL : &ds[0], ds.size());
+                DrainNode(pnode.get());
+                break;
+            }
+        }
+    }
+    catch (const std::ios_base::failure&)
+    {
+        // Malformed input is expected, only crashes and sanitizer reports count
+    }
+
+    return 0;
+}
+
+// Splits a raw capture into its messages; stops at the first truncated one
+static bool ReadCapture(const string& strFile, vector<pair<string, vector<char> > >& vMessages)
+{
+    std::ifstream file(strFile.c_str(), std::ios::binary);
+
+    if (!file)
+        return error("%s : can't open %s", __func__, strFile);
+
+    vector<char> vData((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    unsigned int nPos = 0;
+
+    while (nPos + CMessageHeader::HEADER_SIZE <= vData.size())
+    {
+        CDataStream ssHeader(&vData[nPos], &vData[nPos] + CMessageHeader::HEADER_SIZE, SER_NETWORK, PROTOCOL_VERSION);
+        CMessageHeader hdr;
+        ssHeader >> hdr;
+
+        if (memcmp(hdr.pchMessageStart, pchMessageStart, sizeof(pchMessageStart)) != 0)
+            return error("%s : bad message start at offset %u", __func__, nPos);
+
+        nPos += CMessageHeader::HEADER_SIZE;
+
+        if (hdr.nMessageSize > vData.size() - nPos)
+            break;
+
+        vMessages.push_back(make_pair(hdr.GetCommand(),
+                                      vector<char>(vData.begin() + nPos, vData.begin() + nPos + hdr.nMessageSize)));
+        nPos += hdr.nMessageSize;
+    }
+
+    return true;
+}
+
+static int Replay(const string& strFile, int nIterations)
+{
+    vector<pair<string, vector<char> > > vMessages;
+
+    if (!ReadCapture(strFile, vMessages) || vMessages.empty())
+    {
+        fprintf(stderr, "no messages in %s\n", strFile.c_str());
+        return 1;
+    }
+
+    InitFuzzEnvironment();
+
+    // A capture taken from the start of a connection carries its own handshake
+    bool fHandshake = vMessages[0].first != NetMsgType::VERSION;
+    uint64_t nBytes = 0;
+    uint64_t nProcessed = 0;
+    int64_t nStart = GetTimeMicros();
+
+    for (int i = 0; i < nIterations; i++)
+    {
+        std::unique_ptr<CNode> pnode(NewFuzzNode(fHandshake));
+
+        for (unsigned int j = 0; j < vMessages.size(); j++)
+        {
+            const vector<char>& vPayload = vMessages[j].second;
+            PushWireMessage(pnode.get(), vMessages[j].first, vPayload.empty() ? NULL : &vPayload[0], vPayload.size());
+            nProcessed += DrainNode(pnode.get());
+            nBytes += vPayload.size() + CMessageHeader::HEADER_SIZE;
+        }
+    }
+
+    int64_t nMicros = std::max(GetTimeMicros() - nStart, (int64_t) 1);
+
+    printf("%u messages x %d iterations: %llu processed, %.3f s, %.0f msg/s, %.2f MB/s\n",
+           (unsigned int) vMessages.size(), nIterations, (unsigned long long) nProcessed,
+           nMicros / 1000000.0, nProcessed * 1000000.0 / nMicros, nBytes / (double) nMicros);
+
+    return 0;
+}
+
+#ifdef LIBFUZZER
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    return TestOneInput(vector<unsigned char>(data, data + size));
+}
+#else
+int main(int argc, char** argv)
+{
+    if (argc >= 3 && string(argv[1]) == "replay")
+        return Replay(argv[2], argc >= 4 ? std::max(atoi(argv[3]), 1) : 1);
+
+    InitFuzzEnvironment();
+
+#ifdef __AFL_INIT
+    // Enable AFL deferred forkserver mode, the fork happens after the setup above
+    __AFL_INIT();
+#endif
+
+#ifdef __AFL_LOOP
+    // Enable AFL persistent mode, requires afl-clang-fast
+    while (__AFL_LOOP(1000))
+#endif
+    {
+        vector<unsigned char> vch;
+
+        char buffer[1024];
+        while (std::cin.read(buffer, sizeof(buffer)) || std::cin.gcount() > 0)
+            vch.insert(vch.end(), buffer, buffer + std::cin.gcount());
+
+        std::cin.clear();
+        TestOneInput(vch);
+    }
+
+    return 0;
+}
+#endif
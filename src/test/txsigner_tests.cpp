@@ -0,0 +1,159 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
+
+#include "keystore.h"
+#include "main.h"
+#include "random.h"
+#include "script.h"
+#include "txsigner.h"
+#include "util.h"
+
+using namespace std;
+
+// Spends nInputs outputs of keystore's keys, every third to P2PK, every
+// fifth to a 1-of-2 multisig behind P2SH and the rest to P2PKH
+static CTransaction MakeSpend(CBasicKeyStore& keystore, unsigned int nInputs, vector<CScript>& vPrevPubKeys)
+{
+    CTransaction tx;
+    vPrevPubKeys.clear();
+
+    for (unsigned int i = 0; i < nInputs; i++)
+    {
+        CKey key, key2;
+        key.MakeNewKey(true);
+        key2.MakeNewKey(true);
+        keystore.AddKey(key);
+
+        CScript scriptPubKey;
+
+        if (i % 5 == 4)
+        {
+            CScript redeemScript;
+            redeemScript << OP_1 << key.GetPubKey() << key2.GetPubKey() << OP_2 << OP_CHECKMULTISIG;
+            keystore.AddCScript(redeemScript);
+            scriptPubKey.SetDestination(redeemScript.GetID());
+        }
+        else if (i % 3 == 2)
+            scriptPubKey << key.GetPubKey() << OP_CHECKSIG;
+        else
+            scriptPubKey.SetDestination(key.GetPubKey().GetID());
+
+        tx.vin.push_back(CTxIn(COutPoint(GetRandHash(), i % 4)));
+        vPrevPubKeys.push_back(scriptPubKey);
+    }
+
+    CKey keyTo;
+    keyTo.MakeNewKey(true);
+    tx.vout.push_back(CTxOut(nInputs * COIN, CScript() << OP_DUP << OP_HASH160 << keyTo.GetPubKey().GetID() << OP_EQUALVERIFY << OP_CHECKSIG));
+    tx.vout.push_back(CTxOut(CENT, CScript() << OP_TRUE));
+    return tx;
+}
+
+BOOST_AUTO_TEST_SUITE(txsigner_tests)
+
+BOOST_AUTO_TEST_CASE(signaturehasher_matches_signaturehash)
+{
+    CTransaction tx;
+    tx.nLockTime = 12345;
+
+    for (int i = 0; i < 6; i++)
+    {
+        CTxIn txin(COutPoint(GetRandHash(), i), CScript() << i << OP_DROP, i == 3 ? 7 : numeric_limits<unsigned int>::max());
+        tx.vin.push_back(txin);
+    }
+
+    for (int i = 0; i < 4; i++)
+        tx.vout.push_back(CTxOut(i * COIN, CScript() << i));
+
+    CScript scriptCode = CScript() << OP_DUP << OP_CODESEPARATOR << OP_HASH160 << OP_EQUALVERIFY << OP_CHECKSIG;
+    int vHashTypes[] = { SIGHASH_ALL, SIGHASH_NONE, SIGHASH_SINGLE, SIGHASH_ALL | SIGHASH_ANYONECANPAY,
+                         SIGHASH_NONE | SIGHASH_ANYONECANPAY, SIGHASH_SINGLE | SIGHASH_ANYONECANPAY, 0, 0x42 };
+
+    CSignatureHasher hasher(tx);
+
+    BOOST_FOREACH(int nHashType, vHashTypes)
+    {
+        for (unsigned int nIn = 0; nIn <= tx.vin.size(); nIn++)
+            BOOST_CHECK(hasher.SignatureHash(scriptCode, nIn, nHashType) == SignatureHash(scriptCode, tx, nIn, nHashType));
+    }
+
+    // Signing changes the scriptSigs only, which every hash leaves out
+    tx.vin[2].scriptSig = CScript() << OP_1 << OP_2;
+    BOOST_CHECK(hasher.SignatureHash(scriptCode, 0, SIGHASH_ALL) == SignatureHash(scriptCode, tx, 0, SIGHASH_ALL));
+}
+
+BOOST_AUTO_TEST_CASE(signtransaction_complete)
+{
+    CBasicKeyStore keystore;
+    vector<CScript> vPrevPubKeys;
+
+    // Enough inputs for several threads
+    CTransaction tx = MakeSpend(keystore, 4 * SIGN_INPUTS_PER_THREAD + 3, vPrevPubKeys);
+    CTransaction txNoVerify(tx);
+
+    BOOST_CHECK(SignTransaction(keystore, tx, vPrevPubKeys));
+
+    for (unsigned int i = 0; i < tx.vin.size(); i++)
+        BOOST_CHECK(VerifyScript(tx.vin[i].scriptSig, vPrevPubKeys[i], tx, i, 0));
+
+    BOOST_CHECK(SignTransaction(keystore, txNoVerify, vPrevPubKeys, SIGHASH_ALL, false));
+
+    for (unsigned int i = 0; i < txNoVerify.vin.size(); i++)
+        BOOST_CHECK(VerifyScript(txNoVerify.vin[i].scriptSig, vPrevPubKeys[i], txNoVerify, i, 0));
+}
+
+BOOST_AUTO_TEST_CASE(signtransaction_incomplete)
+{
+    CBasicKeyStore keystore, keystoreEmpty;
+    vector<CScript> vPrevPubKeys;
+    CTransaction tx = MakeSpend(keystore, 5, vPrevPubKeys);
+
+    // Nothing to sign with
+    BOOST_CHECK(!SignTransaction(keystoreEmpty, tx, vPrevPubKeys));
+    BOOST_CHECK(!SignTransaction(keystoreEmpty, tx, vPrevPubKeys, SIGHASH_ALL, false));
+
+    // An input with an unknown previous output keeps its scriptSig
+    CScript scriptSigKept = CScript() << OP_2;
+    tx.vin[1].scriptSig = scriptSigKept;
+    vector<CScript> vPartial(vPrevPubKeys);
+    vPartial[1] = CScript();
+
+    BOOST_CHECK(!SignTransaction(keystore, tx, vPartial));
+    BOOST_CHECK(tx.vin[1].scriptSig == scriptSigKept);
+    BOOST_CHECK(VerifyScript(tx.vin[0].scriptSig, vPrevPubKeys[0], tx, 0, 0));
+
+    // The signatures of another copy are merged in
+    CTransaction txOther(tx);
+    BOOST_CHECK(SignTransaction(keystore, txOther, vPrevPubKeys));
+
+    vector<CTransaction> vVariants(1, txOther);
+    BOOST_CHECK(SignTransaction(keystoreEmpty, tx, vPrevPubKeys, SIGHASH_ALL, true, &vVariants));
+}
+
+BOOST_AUTO_TEST_CASE(signtransaction_benchmark)
+{
+    CBasicKeyStore keystore;
+    unsigned int vInputs[] = { 1, 100, 1000 };
+
+    BOOST_FOREACH(unsigned int nInputs, vInputs)
+    {
+        vector<CScript> vPrevPubKeys;
+        CTransaction tx = MakeSpend(keystore, nInputs, vPrevPubKeys);
+        CTransaction txSerial(tx);
+
+        int64_t nStart = GetTimeMicros();
+
+        for (unsigned int i = 0; i < txSerial.vin.size(); i++)
+            BOOST_REQUIRE(SignSignature(keystore, vPrevPubKeys[i], txSerial, i));
+
+        int64_t nSerial = GetTimeMicros() - nStart;
+        nStart = GetTimeMicros();
+        BOOST_REQUIRE(SignTransaction(keystore, tx, vPrevPubKeys));
+        int64_t nEngine = GetTimeMicros() - nStart;
+
+        BOOST_TEST_MESSAGE(strprintf("sign %u inputs: one at a time %.1f ms, SignTransaction %.1f ms",
+                                     nInputs, nSerial / 1000.0, nEngine / 1000.0));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
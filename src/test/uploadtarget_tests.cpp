@@ -0,0 +1,35 @@
+#include <boost/test/unit_test.hpp>
+
+#include "main.h"
+#include "net.h"
+
+BOOST_AUTO_TEST_SUITE(uploadtarget_tests)
+
+BOOST_AUTO_TEST_CASE(uploadtarget_small_target)
+{
+    CConnman connman(0, 0);
+    const uint64_t nTarget = 100 * 1024 * 1024;
+
+    BOOST_CHECK(!connman.OutboundTargetReached(true));
+    connman.SetMaxOutboundTarget(nTarget);
+
+    // A day of new blocks at UPLOAD_TARGET_BLOCK_BUFFER each is far more than the
+    // target, only a quarter of it is kept back
+    BOOST_REQUIRE(MAX_UPLOAD_TIMEFRAME / nTargetSpacing * UPLOAD_TARGET_BLOCK_BUFFER > nTarget);
+    BOOST_CHECK(!connman.OutboundTargetReached(true));
+
+    connman.RecordBytesSent(nTarget / 2);
+    BOOST_CHECK(!connman.OutboundTargetReached(true));
+    BOOST_CHECK_EQUAL(connman.GetOutboundTargetBytesLeft(), nTarget / 2);
+
+    // Into the reserve: historical blocks stop, new ones are still served
+    connman.RecordBytesSent(nTarget / 4 + 1);
+    BOOST_CHECK(connman.OutboundTargetReached(true));
+    BOOST_CHECK(!connman.OutboundTargetReached(false));
+
+    connman.RecordBytesSent(nTarget / 4);
+    BOOST_CHECK(connman.OutboundTargetReached(false));
+    BOOST_CHECK_EQUAL(connman.GetOutboundTargetBytesLeft(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,141 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+
+#include <atomic>
+
+#include "db.h"
+#include "init.h"
+#include "util.h"
+#include "utiltime.h"
+#include "wallet.h"
+#include "walletdb.h"
+
+using namespace std;
+
+// A scratch directory for the backups of one test
+struct BackupDirSetup
+{
+    boost::filesystem::path dir;
+
+    BackupDirSetup()
+    {
+        dir = GetDataDir() / "backup_tests";
+        boost::filesystem::remove_all(dir);
+        boost::filesystem::create_directories(dir);
+    }
+
+    ~BackupDirSetup()
+    {
+        boost::filesystem::remove_all(dir);
+    }
+
+    string Path(const string& strName)
+    {
+        return (dir / strName).string();
+    }
+};
+
+// Keeps writing address book entries, like a wallet busy sending, and records the slowest write
+static void WriteNames(std::atomic<bool>* pfStop, std::atomic<int>* pnWrites, int64_t* pnMaxMicros)
+{
+    CWalletDB walletdb(pwalletMain->strWalletFile);
+
+    while (!*pfStop)
+    {
+        int64_t nStart = GetTimeMicros();
+        walletdb.WriteName(strprintf("load%d", (int) *pnWrites), "load");
+        *pnMaxMicros = max(*pnMaxMicros, GetTimeMicros() - nStart);
+        (*pnWrites)++;
+    }
+}
+
+BOOST_FIXTURE_TEST_SUITE(walletbackup_tests, BackupDirSetup)
+
+BOOST_AUTO_TEST_CASE(walletbackup_full_and_differential)
+{
+    {
+        CWalletDB walletdb(pwalletMain->strWalletFile);
+        walletdb.WriteName("backup1", "one");
+        walletdb.WriteName("backup2", "two");
+    }
+
+    CWalletBackupInfo infoFull;
+    BOOST_REQUIRE(BackupWallet(*pwalletMain, Path("full.dat"), infoFull));
+    BOOST_CHECK(infoFull.nRecords >= 3);
+
+    CWalletBackupInfo infoRead;
+    BOOST_REQUIRE(VerifyWalletBackup(Path("full.dat"), infoRead));
+    BOOST_CHECK_EQUAL(infoRead.nRecords, infoFull.nRecords);
+    BOOST_CHECK(infoRead.hash == infoFull.hash);
+
+    // Change, erase and add records after the full backup
+    {
+        CWalletDB walletdb(pwalletMain->strWalletFile);
+        walletdb.WriteName("backup2", "changed");
+        walletdb.EraseName("backup1");
+        walletdb.WriteName("backup3", "three");
+    }
+
+    CWalletBackupInfo infoDiff, infoNow;
+    BOOST_REQUIRE(BackupWalletDifferential(*pwalletMain, Path("full.dat"), Path("changes.dat"), infoDiff));
+    BOOST_REQUIRE(BackupWallet(*pwalletMain, Path("now.dat"), infoNow));
+    BOOST_CHECK(infoDiff.hash == infoNow.hash);
+    BOOST_CHECK(boost::filesystem::file_size(Path("changes.dat")) < boost::filesystem::file_size(Path("now.dat")));
+
+    // Base plus changes restores to the wallet as it is now
+    CWalletBackupInfo infoRestored;
+    BOOST_REQUIRE(RestoreWalletBackup(Path("full.dat"), Path("changes.dat"), Path("restored.dat"), infoRestored));
+    BOOST_CHECK_EQUAL(infoRestored.nRecords, infoNow.nRecords);
+    BOOST_CHECK(infoRestored.hash == infoNow.hash);
+
+    BOOST_REQUIRE(VerifyWalletBackup(Path("restored.dat"), infoRead));
+    BOOST_CHECK(infoRead.hash == infoNow.hash);
+
+    // The base alone restores to the full backup
+    BOOST_REQUIRE(RestoreWalletBackup(Path("full.dat"), "", Path("base.dat"), infoRestored));
+    BOOST_CHECK(infoRestored.hash == infoFull.hash);
+
+    // Changes only apply to the backup they were taken against
+    BOOST_CHECK(!RestoreWalletBackup(Path("now.dat"), Path("changes.dat"), Path("wrong.dat"), infoRestored));
+    BOOST_CHECK(!boost::filesystem::exists(Path("wrong.dat")));
+}
+
+BOOST_AUTO_TEST_CASE(walletbackup_during_writes)
+{
+    std::atomic<bool> fStop(false);
+    std::atomic<int> nWrites(0);
+    int64_t nMaxMicros = 0;
+
+    boost::thread writer(WriteNames, &fStop, &nWrites, &nMaxMicros);
+    MilliSleep(50);
+
+    int nWritesBefore = nWrites;
+    int64_t nStart = GetTimeMillis();
+    CWalletBackupInfo info;
+    bool fBackup = true;
+
+    for (int i = 0; i < 5 && fBackup; i++)
+        fBackup = BackupWallet(*pwalletMain, Path("busy.dat"), info);
+
+    int64_t nBackupMillis = GetTimeMillis() - nStart;
+    int nWritesDuring = nWrites - nWritesBefore;
+
+    fStop = true;
+    writer.join();
+
+    BOOST_REQUIRE(fBackup);
+    BOOST_TEST_MESSAGE("5 backups took " << nBackupMillis << "ms, " << nWritesDuring << " writes meanwhile, slowest "
+                       << nMaxMicros / 1000 << "ms");
+
+    // The wallet kept taking writes and each backup is a consistent copy
+    BOOST_CHECK(nWritesDuring > 0);
+    BOOST_CHECK(nMaxMicros < 1000000);
+
+    CWalletBackupInfo infoRead;
+    BOOST_REQUIRE(VerifyWalletBackup(Path("busy.dat"), infoRead));
+    BOOST_CHECK_EQUAL(infoRead.nRecords, info.nRecords);
+    BOOST_CHECK(infoRead.hash == info.hash);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
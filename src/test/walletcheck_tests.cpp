@@ -0,0 +1,237 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
+
+#include "init.h"
+#include "main.h"
+#include "random.h"
+#include "txdb.h"
+#include "wallet.h"
+#include "walletcheck.h"
+#include "walletdb.h"
+
+using namespace std;
+
+// Pays nOutputs coins to a new key of the wallet and indexes the transaction as
+// if it were in the chain, nothing spent on either side
+static CWalletTx AddWalletTx(unsigned int nOutputs, unsigned int nTimeReceived, const uint256& hashBlock)
+{
+    CWalletTx wtx;
+    wtx.vin.push_back(CTxIn(COutPoint(GetRandHash(), 0)));
+
+    CScript scriptPubKey;
+    scriptPubKey.SetDestination(pwalletMain->GenerateNewKey().GetID());
+
+    for (unsigned int n = 0; n < nOutputs; n++)
+        wtx.vout.push_back(CTxOut((n + 1) * COIN, scriptPubKey));
+
+    wtx.nTimeReceived = nTimeReceived;
+    wtx.hashBlock = hashBlock;
+    wtx.BindWallet(pwalletMain);
+
+    {
+        LOCK(pwalletMain->cs_wallet);
+        pwalletMain->mapWallet[wtx.GetHash()] = wtx;
+    }
+
+    CTxDB txdb;
+    BOOST_REQUIRE(txdb.UpdateTxIndex(wtx.GetHash(), CTxIndex(CDiskTxPos(1, 1, 1), nOutputs)));
+
+    return wtx;
+}
+
+static void SetSpentInWallet(const uint256& hash, unsigned int n)
+{
+    LOCK(pwalletMain->cs_wallet);
+    pwalletMain->mapWallet[hash].MarkSpent(n);
+}
+
+static void SetSpentInIndex(const uint256& hash, unsigned int n)
+{
+    CTxDB txdb;
+    CTxIndex txindex;
+    BOOST_REQUIRE(txdb.ReadTxIndex(hash, txindex));
+    txindex.vSpent[n] = CDiskTxPos(1, 2, 3);
+    BOOST_REQUIRE(txdb.UpdateTxIndex(hash, txindex));
+}
+
+static bool IsSpentInWallet(const uint256& hash, unsigned int n)
+{
+    LOCK(pwalletMain->cs_wallet);
+    return pwalletMain->mapWallet[hash].IsSpent(n);
+}
+
+// The mismatches among the given transactions, other tests leave theirs in the wallet
+static vector<CSpentMismatch> Filter(const vector<CSpentMismatch>& vMismatch, const vector<CWalletTx>& vTx)
+{
+    vector<CSpentMismatch> vFiltered;
+
+    BOOST_FOREACH(const CSpentMismatch& mismatch, vMismatch)
+    {
+        BOOST_FOREACH(const CWalletTx& wtx, vTx)
+        {
+            if (wtx.GetHash() == mismatch.hash)
+                vFiltered.push_back(mismatch);
+        }
+    }
+
+    return vFiltered;
+}
+
+static void RemoveWalletTxs(const vector<CWalletTx>& vTx)
+{
+    CTxDB txdb;
+    LOCK(pwalletMain->cs_wallet);
+
+    BOOST_FOREACH(const CWalletTx& wtx, vTx)
+    {
+        txdb.EraseTxIndex(wtx);
+        pwalletMain->mapWallet.erase(wtx.GetHash());
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(walletcheck_tests)
+
+BOOST_AUTO_TEST_CASE(walletcheck_full_and_repair)
+{
+    BOOST_REQUIRE(pindexBest);
+    uint256 hashGenesis = pindexGenesisBlock->GetBlockHash();
+
+    vector<CWalletTx> vTx;
+    vTx.push_back(AddWalletTx(2, 1, hashGenesis));
+    vTx.push_back(AddWalletTx(2, 1, hashGenesis));
+    vTx.push_back(AddWalletTx(1, 1, hashGenesis));
+
+    // Lost coin: spent in the wallet only. Spent coin: spent in the index only.
+    SetSpentInWallet(vTx[0].GetHash(), 0);
+    SetSpentInIndex(vTx[1].GetHash(), 1);
+    SetSpentInWallet(vTx[2].GetHash(), 0);
+    SetSpentInIndex(vTx[2].GetHash(), 0);
+
+    CWalletCheckpoint checkpointBefore, checkpoint;
+    CWalletDB(pwalletMain->strWalletFile).ReadWalletCheckpoint(checkpointBefore);
+
+    vector<CSpentMismatch> vMismatch;
+    BOOST_REQUIRE(CheckWalletSpent(pwalletMain, false, true, vMismatch));
+    vector<CSpentMismatch> vOurs = Filter(vMismatch, vTx);
+
+    BOOST_REQUIRE_EQUAL(vOurs.size(), 2U);
+    BOOST_CHECK(vOurs[0].hash == vTx[0].GetHash() || vOurs[1].hash == vTx[0].GetHash());
+
+    BOOST_FOREACH(const CSpentMismatch& mismatch, vOurs)
+    {
+        bool fLost = mismatch.hash == vTx[0].GetHash();
+        BOOST_CHECK_EQUAL(mismatch.n, fLost ? 0U : 1U);
+        BOOST_CHECK_EQUAL(mismatch.fSpentInWallet, fLost);
+        BOOST_CHECK_EQUAL(mismatch.nValue, fLost ? COIN : 2 * COIN);
+    }
+
+    // Only checked, nothing changed and the checkpoint stays where it was
+    BOOST_CHECK(IsSpentInWallet(vTx[0].GetHash(), 0));
+    BOOST_CHECK(!IsSpentInWallet(vTx[1].GetHash(), 1));
+    CWalletDB(pwalletMain->strWalletFile).ReadWalletCheckpoint(checkpoint);
+    BOOST_CHECK(checkpoint.hashBlock == checkpointBefore.hashBlock && checkpoint.nTime == checkpointBefore.nTime);
+
+    // Repaired in one go, and the checkpoint moves to the best block
+    BOOST_REQUIRE(CheckWalletSpent(pwalletMain, true, true, vMismatch));
+    BOOST_CHECK_EQUAL(Filter(vMismatch, vTx).size(), 2U);
+    BOOST_CHECK(!IsSpentInWallet(vTx[0].GetHash(), 0));
+    BOOST_CHECK(IsSpentInWallet(vTx[1].GetHash(), 1));
+    BOOST_CHECK(IsSpentInWallet(vTx[2].GetHash(), 0));
+
+    CWalletCheckStatus status = GetWalletCheckStatus();
+    BOOST_CHECK(!status.fRunning);
+    BOOST_CHECK(!status.fIncremental);
+    BOOST_CHECK_EQUAL(status.nRepaired, vMismatch.size());
+
+    BOOST_REQUIRE(CWalletDB(pwalletMain->strWalletFile).ReadWalletCheckpoint(checkpoint));
+    BOOST_CHECK(checkpoint.hashBlock == pindexBest->GetBlockHash());
+    BOOST_CHECK_EQUAL(checkpoint.nHeight, nBestHeight);
+
+    BOOST_REQUIRE(CheckWalletSpent(pwalletMain, false, true, vMismatch));
+    BOOST_CHECK(vMismatch.empty());
+
+    RemoveWalletTxs(vTx);
+}
+
+BOOST_AUTO_TEST_CASE(walletcheck_incremental)
+{
+    BOOST_REQUIRE(pindexBest);
+    uint256 hashGenesis = pindexGenesisBlock->GetBlockHash();
+
+    // Start from a clean checkpoint
+    vector<CSpentMismatch> vMismatch;
+    BOOST_REQUIRE(CheckWalletSpent(pwalletMain, true, true, vMismatch));
+    BOOST_REQUIRE(CheckWalletSpent(pwalletMain, false, false, vMismatch));
+    BOOST_REQUIRE(vMismatch.empty());
+
+    // An old confirmed transaction whose flag went wrong behind the checker's back, and
+    // one received since the checkpoint
+    vector<CWalletTx> vTx;
+    vTx.push_back(AddWalletTx(1, 1, hashGenesis));
+    vTx.push_back(AddWalletTx(1, GetAdjustedTime(), 0));
+    SetSpentInWallet(vTx[0].GetHash(), 0);
+    SetSpentInIndex(vTx[1].GetHash(), 0);
+
+    BOOST_REQUIRE(CheckWalletSpent(pwalletMain, false, false, vMismatch));
+    vector<CSpentMismatch> vOurs = Filter(vMismatch, vTx);
+    BOOST_REQUIRE_EQUAL(vOurs.size(), 1U);
+    BOOST_CHECK(vOurs[0].hash == vTx[1].GetHash());
+
+    CWalletCheckStatus status = GetWalletCheckStatus();
+    BOOST_CHECK(status.fIncremental);
+    BOOST_CHECK(status.nToCheck < status.nWalletTx);
+    BOOST_CHECK_EQUAL(status.nChecked, status.nToCheck);
+    BOOST_CHECK(status.checkpoint.hashBlock == pindexBest->GetBlockHash());
+
+    // A full check still finds everything
+    BOOST_REQUIRE(CheckWalletSpent(pwalletMain, true, true, vMismatch));
+    BOOST_CHECK_EQUAL(Filter(vMismatch, vTx).size(), 2U);
+    BOOST_CHECK(!IsSpentInWallet(vTx[0].GetHash(), 0));
+    BOOST_CHECK(IsSpentInWallet(vTx[1].GetHash(), 0));
+
+    BOOST_REQUIRE(CheckWalletSpent(pwalletMain, false, false, vMismatch));
+    BOOST_CHECK(vMismatch.empty());
+
+    RemoveWalletTxs(vTx);
+}
+
+BOOST_AUTO_TEST_CASE(walletcheck_batched_index_reads)
+{
+    vector<CWalletTx> vTx;
+    vector<uint256> vHashes;
+
+    for (int i = 0; i < 50; i++)
+    {
+        vTx.push_back(AddWalletTx(3, 1, 0));
+        vHashes.push_back(vTx.back().GetHash());
+
+        if (i % 7 == 0)
+            SetSpentInIndex(vHashes.back(), i % 3);
+    }
+
+    // Not indexed, left out
+    vHashes.push_back(GetRandHash());
+
+    CTxDB txdb("r");
+    map<uint256, CTxIndex> mapTxIndex;
+    BOOST_REQUIRE(txdb.ReadTxIndexes(vHashes, mapTxIndex));
+    BOOST_CHECK_EQUAL(mapTxIndex.size(), vTx.size());
+
+    BOOST_FOREACH(const uint256& hash, vHashes)
+    {
+        CTxIndex txindex;
+
+        if (!txdb.ReadTxIndex(hash, txindex))
+        {
+            BOOST_CHECK(!mapTxIndex.count(hash));
+            continue;
+        }
+
+        BOOST_REQUIRE(mapTxIndex.count(hash));
+        BOOST_CHECK(mapTxIndex[hash] == txindex);
+    }
+
+    RemoveWalletTxs(vTx);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -66,6 +66,8 @@ void init_blockindex(leveldb::Options& options, bool fRemoveOld = false) {
 
             nFile++;
         }
+
+        ClearBlockFileFormatCache();
     }
 
     filesystem::create_directory(directory);
@@ -240,6 +242,57 @@ bool CTxDB::ReadTxIndex(uint256 hash, CTxIndex& txindex)
     return Read(make_pair(string("tx"), hash), txindex);
 }
 
+bool CTxDB::ReadTxIndexes(const vector<uint256>& vHashes, map<uint256, CTxIndex>& mapTxIndex)
+{
+    assert(!fClient);
+
+    // Seeking in key order walks the table files front to back once
+    vector<pair<string, uint256> > vKeys;
+    vKeys.reserve(vHashes.size());
+
+    BOOST_FOREACH(const uint256& hash, vHashes)
+    {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey << make_pair(string("tx"), hash);
+        vKeys.push_back(make_pair(ssKey.str(), hash));
+    }
+
+    sort(vKeys.begin(), vKeys.end());
+
+    const leveldb::Snapshot* snapshot = pdb->GetSnapshot();
+    leveldb::ReadOptions options;
+    options.snapshot = snapshot;
+    options.fill_cache = false;
+    leveldb::Iterator* iterator = pdb->NewIterator(options);
+    bool fOk = true;
+
+    for (vector<pair<string, uint256> >::const_iterator it = vKeys.begin(); it != vKeys.end(); ++it)
+    {
+        iterator->Seek(it->first);
+
+        if (!iterator->Valid() || iterator->key().ToString() != it->first)
+            continue;
+
+        try {
+            CDataStream ssValue(iterator->value().data(), iterator->value().data() + iterator->value().size(),
+                                SER_DISK, CLIENT_VERSION);
+            ssValue >> mapTxIndex[it->second];
+        }
+        catch (std::exception &e) {
+            fOk = error("%s : can't read the index of %s", __func__, it->second.ToString());
+            mapTxIndex.erase(it->second);
+        }
+    }
+
+    if (!iterator->status().ok())
+        fOk = error("%s : %s", __func__, iterator->status().ToString());
+
+    delete iterator;
+    pdb->ReleaseSnapshot(snapshot);
+
+    return fOk;
+}
+
 bool CTxDB::UpdateTxIndex(uint256 hash, const CTxIndex& txindex)
 {
     assert(!fClient);
@@ -344,6 +397,31 @@ bool CTxDB::WriteCheckpointPubKey(const string& strPubKey)
     return Write(string("strCheckpointPubKey"), strPubKey);
 }
 
+bool CTxDB::ReadBlockStats(int nHeight, CBlockStats& stats)
+{
+    return Read(make_pair(string("blockstats"), nHeight), stats);
+}
+
+bool CTxDB::WriteBlockStats(int nHeight, const CBlockStats& stats)
+{
+    return Write(make_pair(string("blockstats"), nHeight), stats);
+}
+
+bool CTxDB::EraseBlockStats(int nHeight)
+{
+    return Erase(make_pair(string("blockstats"), nHeight));
+}
+
+bool CTxDB::ReadBlockStatsHeight(int& nHeight)
+{
+    return Read(string("nBlockStatsHeight"), nHeight);
+}
+
+bool CTxDB::WriteBlockStatsHeight(int nHeight)
+{
+    return Write(string("nBlockStatsHeight"), nHeight);
+}
+
 static CBlockIndex *InsertBlockIndex(uint256 hash)
 {
     if (hash == 0)
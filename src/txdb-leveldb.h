@@ -6,6 +6,7 @@
 #ifndef BITCOIN_LEVELDB_H
 #define BITCOIN_LEVELDB_H
 
+#include "blockstats.h"
 #include "main.h"
 #include "streams.h"
 
@@ -185,6 +186,9 @@ public:
     }
 
     bool ReadTxIndex(uint256 hash, CTxIndex& txindex);
+    // Reads many indexes from one snapshot, in key order rather than one lookup each.
+    // Transactions without an index are left out. Doesn't see writes in an open batch.
+    bool ReadTxIndexes(const std::vector<uint256>& vHashes, std::map<uint256, CTxIndex>& mapTxIndex);
     bool UpdateTxIndex(uint256 hash, const CTxIndex& txindex);
     bool AddTxIndex(const CTransaction& tx, const CDiskTxPos& pos, int nHeight);
     bool EraseTxIndex(const CTransaction& tx);
@@ -202,6 +206,11 @@ public:
     bool WriteSyncCheckpoint(uint256 hashCheckpoint);
     bool ReadCheckpointPubKey(std::string& strPubKey);
     bool WriteCheckpointPubKey(const std::string& strPubKey);
+    bool ReadBlockStats(int nHeight, CBlockStats& stats);
+    bool WriteBlockStats(int nHeight, const CBlockStats& stats);
+    bool EraseBlockStats(int nHeight);
+    bool ReadBlockStatsHeight(int& nHeight);
+    bool WriteBlockStatsHeight(int nHeight);
     bool LoadBlockIndex();
 private:
     bool LoadBlockIndexGuts();
@@ -3,11 +3,19 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "clientversion.h"
+#include "feeestimator.h"
 #include "main.h"
+#include "masternodecollateral.h"
+#include "random.h"
+#include "runtimeconfig.h"
+#include "streams.h"
 #include "txmempool.h"
 // #include "txdb-leveldb.h"
 #include "wallet.h"
 
+#include <atomic>
+
 // which to use? can maybe remove txdb-leveldb.h....????
 #include "txdb.h"
 // class CTxDB;
@@ -29,7 +37,7 @@ bool static IsFromMe(CTransaction& tx)
 }
 
 bool CTxMemPool::accept(CTxDB& txdb, CTransaction &tx, bool fCheckInputs,
-                        bool* pfMissingInputs)
+                        bool* pfMissingInputs, int64_t nTime)
 {
     if (pfMissingInputs)
         *pfMissingInputs = false;
@@ -92,6 +100,9 @@ bool CTxMemPool::accept(CTxDB& txdb, CTransaction &tx, bool fCheckInputs,
         }
     }
 
+    int64_t nFees = 0;
+    unsigned int nSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+
     if (fCheckInputs)
     {
         MapPrevTx mapInputs;
@@ -114,8 +125,7 @@ bool CTxMemPool::accept(CTxDB& txdb, CTransaction &tx, bool fCheckInputs,
         // you should add code here to check that the transaction does a
         // reasonable number of ECDSA signature verifications.
 
-        int64_t nFees = tx.GetValueIn(mapInputs)-tx.GetValueOut();
-        unsigned int nSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+        nFees = tx.GetValueIn(mapInputs)-tx.GetValueOut();
 
         // Don't accept it if it can't get into a block
         int64_t txMinFee = tx.GetMinFee(1000, GMF_RELAY, nSize);
@@ -141,7 +151,7 @@ bool CTxMemPool::accept(CTxDB& txdb, CTransaction &tx, bool fCheckInputs,
                 nLastTime = nNow;
                 // -limitfreerelay unit is thousand-bytes-per-minute
                 // At default rate it would take over a month to fill 1GB
-                if (dFreeCount > GetArg("-limitfreerelay", 15)*10*1000 && !IsFromMe(tx))
+                if (dFreeCount > configLimitFreeRelay.GetInt()*10*1000 && !IsFromMe(tx))
                     return error("CTxMemPool::accept() : free transaction rejected by rate limiter");
                 if (fDebug)
                     LogPrintf("Rate limit dFreeCount: %g => %g\n", dFreeCount, dFreeCount+nSize);
@@ -165,7 +175,12 @@ bool CTxMemPool::accept(CTxDB& txdb, CTransaction &tx, bool fCheckInputs,
             LogPrintf("CTxMemPool::accept() : replacing tx %s with new version\n", ptxOld->GetHash().ToString().c_str());
             remove(*ptxOld);
         }
-        addUnchecked(hash, tx);
+        addUnchecked(hash, tx, nFees, nTime ? nTime : GetTime());
+
+        // Only transactions seen arriving tell how long confirmation takes, not ones
+        // reloaded from mempool.dat or resurrected by a reorg
+        if (fCheckInputs && nTime == 0)
+            feeEstimator.TransactionAdded(hash, nFees, nSize, nBestHeight);
     }
 
     ///// are we sure this is ok when loading transactions or restoring block txes
@@ -180,15 +195,17 @@ bool CTxMemPool::accept(CTxDB& txdb, CTransaction &tx, bool fCheckInputs,
 }
 
 
-bool CTxMemPool::addUnchecked(const uint256& hash, CTransaction &tx)
+bool CTxMemPool::addUnchecked(const uint256& hash, CTransaction &tx, int64_t nFee, int64_t nTime)
 {
     // Add to memory pool without checking anything.  Don't call this directly,
     // call CTxMemPool::accept to properly check the transaction first.
     {
         mapTx[hash] = tx;
+        mapInfo[hash] = CTxMemPoolEntryInfo(nTime ? nTime : GetTime(), nFee);
         for (unsigned int i = 0; i < tx.vin.size(); i++)
             mapNextTx[tx.vin[i].prevout] = CInPoint(&mapTx[hash], i);
         nTransactionsUpdated++;
+        collateralWatcher.TransactionAddedToMempool(tx);
     }
     return true;
 }
@@ -212,7 +229,10 @@ bool CTxMemPool::remove(const CTransaction &tx, bool fRecursive)
             BOOST_FOREACH(const CTxIn& txin, tx.vin)
                     mapNextTx.erase(txin.prevout);
             mapTx.erase(hash);
+            mapInfo.erase(hash);
+            feeEstimator.TransactionRemoved(hash);
             nTransactionsUpdated++;
+            collateralWatcher.TransactionRemovedFromMempool(tx);
         }
     }
     return true;
@@ -238,7 +258,9 @@ void CTxMemPool::clear()
     LOCK(cs);
     mapTx.clear();
     mapNextTx.clear();
+    mapInfo.clear();
     ++nTransactionsUpdated;
+    collateralWatcher.MempoolCleared();
 }
 
 void CTxMemPool::queryHashes(std::vector<uint256>& vtxid)
@@ -259,3 +281,312 @@ bool CTxMemPool::lookup(uint256 hash, CTransaction& result) const
     result = i->second;
     return true;
 }
+
+bool CTxMemPool::lookupInfo(uint256 hash, CTxMemPoolEntryInfo& result) const
+{
+    LOCK(cs);
+    std::map<uint256, CTxMemPoolEntryInfo>::const_iterator i = mapInfo.find(hash);
+    if (i == mapInfo.end()) return false;
+    result = i->second;
+    return true;
+}
+
+CMempoolDB::CMempoolDB()
+{
+    pathMempool = GetDataDir() / "mempool.dat";
+}
+
+bool CMempoolDB::Write(const std::vector<CMempoolFileEntry>& vEntries)
+{
+    // Generate random temporary filename
+    unsigned short randv = 0;
+    GetRandBytes((unsigned char*)&randv, sizeof(randv));
+    std::string tmpfn = strprintf("mempool.dat.%04x", randv);
+
+    // Serialize the entries, checksum data up to that point, then append csum
+    CDataStream ssMempool(SER_DISK, CLIENT_VERSION);
+    ssMempool << FLATDATA(pchMessageStart);
+    ssMempool << MEMPOOL_FILE_VERSION;
+    ssMempool << vEntries;
+    uint256 hash = Hash(ssMempool.begin(), ssMempool.end());
+    ssMempool << hash;
+
+    // Open temp output file, and associate with CAutoFile
+    boost::filesystem::path pathTmp = GetDataDir() / tmpfn;
+    FILE *file = fopen(pathTmp.string().c_str(), "wb");
+    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+
+    if (fileout.IsNull())
+        return error("%s : failed to open file %s", __func__, pathTmp.string());
+
+    try
+    {
+        fileout << ssMempool;
+    }
+    catch (const std::exception& e)
+    {
+        return error("%s : serialize or I/O error - %s", __func__, e.what());
+    }
+
+    FileCommit(fileout.Get());
+    fileout.fclose();
+
+    // Replace existing mempool.dat, if any, with new mempool.dat.XXXX
+    if (!RenameOver(pathTmp, pathMempool))
+        return error("%s : rename-into-place failed", __func__);
+
+    return true;
+}
+
+bool CMempoolDB::Read(std::vector<CMempoolFileEntry>& vEntries)
+{
+    if (!boost::filesystem::exists(pathMempool))
+        return false;
+
+    // Open input file, and associate with CAutoFile
+    FILE *file = fopen(pathMempool.string().c_str(), "rb");
+    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+
+    if (filein.IsNull())
+        return error("%s : failed to open file %s", __func__, pathMempool.string());
+
+    // Use file size to size memory buffer
+    uint64_t fileSize = boost::filesystem::file_size(pathMempool);
+    uint64_t dataSize = 0;
+
+    // Don't try to resize to a negative number if file is small
+    if (fileSize >= sizeof(uint256))
+        dataSize = fileSize - sizeof(uint256);
+
+    std::vector<unsigned char> vchData;
+    vchData.resize(dataSize);
+    uint256 hashIn;
+
+    try
+    {
+        if (dataSize > 0)
+            filein.read((char *)&vchData[0], dataSize);
+
+        filein >> hashIn;
+    }
+    catch (const std::exception& e)
+    {
+        return error("%s : deserialize or I/O error - %s", __func__, e.what());
+    }
+
+    filein.fclose();
+    CDataStream ssMempool(vchData, SER_DISK, CLIENT_VERSION);
+
+    // Verify stored checksum matches input data
+    uint256 hashTmp = Hash(ssMempool.begin(), ssMempool.end());
+
+    if (hashIn != hashTmp)
+        return error("%s : checksum mismatch, data corrupted", __func__);
+
+    unsigned char pchMsgTmp[4];
+    int nVersion;
+
+    try
+    {
+        ssMempool >> FLATDATA(pchMsgTmp);
+
+        if (memcmp(pchMsgTmp, pchMessageStart, sizeof(pchMsgTmp)))
+            return error("%s : invalid network magic number", __func__);
+
+        ssMempool >> nVersion;
+
+        if (nVersion > MEMPOOL_FILE_VERSION)
+            return error("%s : unsupported file version %d", __func__, nVersion);
+
+        ssMempool >> vEntries;
+    }
+    catch (const std::exception& e)
+    {
+        return error("%s : deserialize or I/O error - %s", __func__, e.what());
+    }
+
+    return true;
+}
+
+// Set once mempool.dat has been loaded, until then it must not be overwritten
+static std::atomic<bool> fMempoolLoaded(false);
+
+static bool CompareEntryTime(const CMempoolFileEntry& a, const CMempoolFileEntry& b)
+{
+    return a.nTime < b.nTime;
+}
+
+void SortMempoolEntries(std::vector<CMempoolFileEntry>& vEntries)
+{
+    std::stable_sort(vEntries.begin(), vEntries.end(), CompareEntryTime);
+
+    map<uint256, unsigned int> mapIndex;
+
+    for (unsigned int i = 0; i < vEntries.size(); i++)
+        mapIndex[vEntries[i].tx.GetHash()] = i;
+
+    // Depth first over the inputs spent within the file, a transaction is written out
+    // once everything it spends is. Entry times only break the ties, they have one
+    // second resolution and a child often shares its parent's.
+    std::vector<CMempoolFileEntry> vSorted;
+    std::vector<char> vVisited(vEntries.size(), 0);
+    std::vector<pair<unsigned int, unsigned int> > vStack; // entry, next input to look at
+    vSorted.reserve(vEntries.size());
+
+    for (unsigned int i = 0; i < vEntries.size(); i++)
+    {
+        if (vVisited[i])
+            continue;
+
+        vVisited[i] = 1;
+        vStack.push_back(make_pair(i, 0));
+
+        while (!vStack.empty())
+        {
+            unsigned int nEntry = vStack.back().first;
+            unsigned int nInput = vStack.back().second;
+            const CTransaction& tx = vEntries[nEntry].tx;
+
+            if (nInput < tx.vin.size())
+            {
+                vStack.back().second++;
+                map<uint256, unsigned int>::const_iterator it = mapIndex.find(tx.vin[nInput].prevout.hash);
+
+                if (it != mapIndex.end() && !vVisited[it->second])
+                {
+                    vVisited[it->second] = 1;
+                    vStack.push_back(make_pair(it->second, 0));
+                }
+
+                continue;
+            }
+
+            vSorted.push_back(vEntries[nEntry]);
+            vStack.pop_back();
+        }
+    }
+
+    vEntries.swap(vSorted);
+}
+
+bool DumpMempool()
+{
+    std::vector<CMempoolFileEntry> vEntries;
+    int64_t nStart = GetTimeMillis();
+
+    {
+        LOCK(mempool.cs);
+        vEntries.reserve(mempool.mapTx.size());
+
+        for (map<uint256, CTransaction>::const_iterator it = mempool.mapTx.begin(); it != mempool.mapTx.end(); ++it)
+            vEntries.push_back(CMempoolFileEntry(it->second, mempool.mapInfo[it->first]));
+    }
+
+    SortMempoolEntries(vEntries);
+
+    if (!CMempoolDB().Write(vEntries))
+        return false;
+
+    LogPrint("mempool", "%s : wrote %u transactions in %dms\n", __func__, vEntries.size(), GetTimeMillis() - nStart);
+
+    return true;
+}
+
+bool PreVerifyMempoolSignatures(CTxDB& txdb, const CTransaction& tx, const map<uint256, CTransaction>& mapBatch)
+{
+    for (unsigned int i = 0; i < tx.vin.size(); i++)
+    {
+        const COutPoint& prevout = tx.vin[i].prevout;
+        CTransaction txPrev;
+        map<uint256, CTransaction>::const_iterator it = mapBatch.find(prevout.hash);
+
+        if (it != mapBatch.end())
+            txPrev = it->second;
+        else if (!mempool.lookup(prevout.hash, txPrev) && !txdb.ReadDiskTx(prevout.hash, txPrev))
+            continue;
+
+        if (prevout.n >= txPrev.vout.size())
+            continue;
+
+        if (!VerifySignature(txPrev, tx, i, 0))
+            return false;
+    }
+
+    return true;
+}
+
+bool LoadMempool(bool fCheckInputs)
+{
+    std::vector<CMempoolFileEntry> vEntries;
+    int64_t nStart = GetTimeMillis();
+
+    if (!CMempoolDB().Read(vEntries))
+        return false;
+
+    // Files written before the dump sorted parents first
+    SortMempoolEntries(vEntries);
+
+    int64_t nExpiry = GetTime() - MEMPOOL_EXPIRY;
+    int nAccepted = 0;
+    int nFailed = 0;
+    int nExpired = 0;
+
+    for (unsigned int nBatch = 0; nBatch < vEntries.size() && !fShutdown; nBatch += MEMPOOL_LOAD_BATCH_SIZE)
+    {
+        unsigned int nEnd = std::min((unsigned int) vEntries.size(), nBatch + MEMPOOL_LOAD_BATCH_SIZE);
+        map<uint256, CTransaction> mapBatch;
+        std::vector<bool> vValid(nEnd - nBatch, true);
+
+        for (unsigned int i = nBatch; i < nEnd; i++)
+            mapBatch[vEntries[i].tx.GetHash()] = vEntries[i].tx;
+
+        // The expensive part, done before cs_main is taken
+        if (fCheckInputs)
+        {
+            CTxDB txdb("r");
+
+            for (unsigned int i = nBatch; i < nEnd; i++)
+            {
+                if (vEntries[i].nTime < nExpiry)
+                    continue;
+
+                vValid[i - nBatch] = PreVerifyMempoolSignatures(txdb, vEntries[i].tx, mapBatch);
+            }
+        }
+
+        LOCK(cs_main);
+        CTxDB txdb("r");
+
+        for (unsigned int i = nBatch; i < nEnd; i++)
+        {
+            CMempoolFileEntry& entry = vEntries[i];
+
+            if (entry.nTime < nExpiry)
+                nExpired++;
+            else if (vValid[i - nBatch] && mempool.accept(txdb, entry.tx, fCheckInputs, NULL, entry.nTime))
+                nAccepted++;
+            else
+                nFailed++;
+        }
+    }
+
+    LogPrintf("%s : accepted %d of %u transactions (%d expired, %d failed) in %dms\n", __func__,
+              nAccepted, vEntries.size(), nExpired, nFailed, GetTimeMillis() - nStart);
+
+    return true;
+}
+
+bool IsMempoolLoaded()
+{
+    return fMempoolLoaded;
+}
+
+void ThreadLoadMempool(void* parg)
+{
+    RenameThread("neutron-loadmempool");
+    LoadMempool();
+
+    // Interrupted by shutdown, keep mempool.dat as it is
+    if (!fShutdown)
+        fMempoolLoaded = true;
+}
@@ -8,25 +8,51 @@
 
 #include "main.h"
 
+#include <boost/filesystem/path.hpp>
+
 class CInPoint;
 class COutPoint;
 class CTxDB;
 
+/** Version of mempool.dat, bump when its layout changes */
+static const int MEMPOOL_FILE_VERSION = 1;
+/** How often (seconds) mempool.dat is rewritten */
+static const int MEMPOOL_DUMP_INTERVAL = 15 * 60;
+/** Transactions accepted per cs_main lock while mempool.dat is loaded */
+static const int MEMPOOL_LOAD_BATCH_SIZE = 100;
+/** Stored transactions older than this (seconds) aren't loaded again */
+static const int64_t MEMPOOL_EXPIRY = 72 * 60 * 60;
+/** Default for -persistmempool */
+static const bool DEFAULT_PERSIST_MEMPOOL = true;
+
+/** When a transaction entered the pool and the fee it pays (0 if its inputs weren't checked) */
+struct CTxMemPoolEntryInfo
+{
+    int64_t nTime;
+    int64_t nFee;
+
+    CTxMemPoolEntryInfo() : nTime(0), nFee(0) { }
+    CTxMemPoolEntryInfo(int64_t nTimeIn, int64_t nFeeIn) : nTime(nTimeIn), nFee(nFeeIn) { }
+};
+
 class CTxMemPool
 {
 public:
     mutable CCriticalSection cs;
     std::map<uint256, CTransaction> mapTx;
     std::map<COutPoint, CInPoint> mapNextTx;
+    std::map<uint256, CTxMemPoolEntryInfo> mapInfo;
 
+    // nTime is the entry time to record, 0 for now
     bool accept(CTxDB& txdb, CTransaction &tx,
-                bool fCheckInputs, bool* pfMissingInputs);
-    bool addUnchecked(const uint256& hash, CTransaction &tx);
+                bool fCheckInputs, bool* pfMissingInputs, int64_t nTime = 0);
+    bool addUnchecked(const uint256& hash, CTransaction &tx, int64_t nFee = 0, int64_t nTime = 0);
     bool remove(const CTransaction &tx, bool fRecursive = false);
     bool removeConflicts(const CTransaction &tx);
     void clear();
     void queryHashes(std::vector<uint256>& vtxid);
     bool lookup(uint256 hash, CTransaction& result) const;
+    bool lookupInfo(uint256 hash, CTxMemPoolEntryInfo& result) const;
 
     unsigned long size()
     {
@@ -45,4 +71,61 @@ public:
     }
 };
 
+/** A pool transaction as stored in mempool.dat */
+class CMempoolFileEntry
+{
+public:
+    CTransaction tx;
+    int64_t nTime;
+    int64_t nFee;
+
+    CMempoolFileEntry() : nTime(0), nFee(0) { }
+    CMempoolFileEntry(const CTransaction& txIn, const CTxMemPoolEntryInfo& info) :
+        tx(txIn), nTime(info.nTime), nFee(info.nFee) { }
+
+    IMPLEMENT_SERIALIZE
+    (
+        READWRITE(tx);
+        READWRITE(nTime);
+        READWRITE(nFee);
+    )
+};
+
+/** Access to the mempool cache file (mempool.dat) */
+class CMempoolDB
+{
+private:
+    boost::filesystem::path pathMempool;
+public:
+    CMempoolDB();
+    bool Write(const std::vector<CMempoolFileEntry>& vEntries);
+    bool Read(std::vector<CMempoolFileEntry>& vEntries);
+};
+
+/** Entry time order, except that a transaction always comes after the ones it spends */
+void SortMempoolEntries(std::vector<CMempoolFileEntry>& vEntries);
+
+/** Write the pool to mempool.dat, in SortMempoolEntries() order */
+bool DumpMempool();
+
+/**
+ * Checks the signatures of tx whose inputs are in mapBatch, the pool or the tx index,
+ * so they are in the signature cache when accept runs under cs_main. Inputs not found
+ * are left to accept. Returns false only for a bad signature.
+ */
+bool PreVerifyMempoolSignatures(CTxDB& txdb, const CTransaction& tx, const std::map<uint256, CTransaction>& mapBatch);
+
+/**
+ * Accept the transactions of mempool.dat again, in batches of MEMPOOL_LOAD_BATCH_SIZE.
+ * Signatures of a batch are checked before cs_main is taken, accept then finds them in
+ * the signature cache. fCheckInputs is only turned off by tests.
+ */
+bool LoadMempool(bool fCheckInputs = true);
+
+/** Whether ThreadLoadMempool is done, dumps before that would drop what wasn't loaded yet */
+bool IsMempoolLoaded();
+
+/** Runs LoadMempool, started after the block index is loaded */
+void ThreadLoadMempool(void* parg);
+
 #endif // BITCOIN_TXMEMPOOL_H
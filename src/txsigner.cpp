@@ -0,0 +1,115 @@
+// Copyright (c) 2016-2020 The Neutron Developers
+//
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txsigner.h"
+#include "main.h"
+#include "txdb.h"
+#include "txmempool.h"
+#include "util.h"
+
+#include <thread>
+
+#include <boost/foreach.hpp>
+
+using namespace std;
+
+void FetchPrevOuts(const CTransaction& tx, map<COutPoint, CScript>& mapPrevOut)
+{
+    // Consolidations spend many outputs of the same few transactions
+    map<uint256, CTransaction> mapPrevTx;
+    BOOST_FOREACH(const CTxIn& txin, tx.vin)
+        mapPrevTx[txin.prevout.hash];
+
+    CTxDB txdb("r");
+
+    for (map<uint256, CTransaction>::iterator it = mapPrevTx.begin(); it != mapPrevTx.end(); )
+    {
+        if (mempool.lookup(it->first, it->second) || txdb.ReadDiskTx(it->first, it->second))
+            ++it;
+        else
+            mapPrevTx.erase(it++);
+    }
+
+    BOOST_FOREACH(const CTxIn& txin, tx.vin)
+    {
+        map<uint256, CTransaction>::const_iterator mi = mapPrevTx.find(txin.prevout.hash);
+
+        if (mi != mapPrevTx.end() && txin.prevout.n < mi->second.vout.size())
+            mapPrevOut[txin.prevout] = mi->second.vout[txin.prevout.n].scriptPubKey;
+    }
+}
+
+bool SignTransaction(const CKeyStore& keystore, CTransaction& txTo, const vector<CScript>& vPrevPubKeys,
+                     int nHashType, bool fVerify, const vector<CTransaction>* pvVariants)
+{
+    assert(vPrevPubKeys.size() == txTo.vin.size());
+
+    int64_t nStart = GetTimeMillis();
+    bool fHashSingle = ((nHashType & ~SIGHASH_ANYONECANPAY) == SIGHASH_SINGLE);
+    const CSignatureHasher hasher(txTo);
+
+    // txTo is only read until every thread is done, a char per input as
+    // threads can't safely write neighbouring elements of a vector<bool>
+    size_t nInputs = txTo.vin.size();
+    vector<CScript> vScriptSigs(nInputs);
+    vector<char> vComplete(nInputs, false);
+
+    unsigned int nThreads = max(1U, min(thread::hardware_concurrency(),
+                                        (unsigned int) (nInputs / SIGN_INPUTS_PER_THREAD)));
+
+    auto signRange = [&](size_t nBegin, size_t nEnd)
+    {
+        for (size_t i = nBegin; i < nEnd; i++)
+        {
+            const CScript& prevPubKey = vPrevPubKeys[i];
+            CScript& scriptSig = vScriptSigs[i];
+
+            if (prevPubKey.empty())
+            {
+                scriptSig = txTo.vin[i].scriptSig;
+                continue;
+            }
+
+            // Only sign SIGHASH_SINGLE if there's a corresponding output:
+            bool fSigned = false;
+            if (!fHashSingle || i < txTo.vout.size())
+                fSigned = ProduceSignature(keystore, prevPubKey, hasher, i, nHashType, scriptSig);
+
+            // ... and merge in other signatures:
+            if (pvVariants)
+            {
+                BOOST_FOREACH(const CTransaction& txv, *pvVariants)
+                    scriptSig = CombineSignatures(prevPubKey, txTo, i, scriptSig, txv.vin[i].scriptSig, &hasher);
+            }
+
+            vComplete[i] = fVerify ? VerifyScript(scriptSig, prevPubKey, txTo, i, 0, &hasher) : fSigned;
+        }
+    };
+
+    vector<thread> vThreads;
+    size_t nPerThread = (nInputs + nThreads - 1) / nThreads;
+
+    for (unsigned int t = 1; t < nThreads; t++)
+        vThreads.push_back(thread(signRange, t * nPerThread, min(nInputs, (t + 1) * nPerThread)));
+
+    signRange(0, min(nInputs, nPerThread));
+
+    BOOST_FOREACH(thread& t, vThreads)
+        t.join();
+
+    bool fComplete = true;
+
+    for (size_t i = 0; i < nInputs; i++)
+    {
+        txTo.vin[i].scriptSig = vScriptSigs[i];
+        fComplete = fComplete && vComplete[i];
+    }
+
+    if (nInputs >= SIGN_INPUTS_PER_THREAD)
+        LogPrint("sign", "%s : signed %u inputs in %dms using %u threads\n", __func__, nInputs,
+                 GetTimeMillis() - nStart, nThreads);
+
+    return fComplete;
+}
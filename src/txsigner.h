@@ -0,0 +1,44 @@
+// Copyright (c) 2016-2020 The Neutron Developers
+//
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NEUTRON_TXSIGNER_H
+#define NEUTRON_TXSIGNER_H
+
+#include "script.h"
+
+#include <map>
+#include <vector>
+
+class COutPoint;
+class CTransaction;
+
+/** SignTransaction only starts another thread for every this many inputs */
+static const unsigned int SIGN_INPUTS_PER_THREAD = 16;
+
+/**
+ * Looks up the outputs the inputs of tx spend, in the memory pool and then in
+ * the transaction index. Every previous transaction is read once however many
+ * of its outputs are spent; outputs that can't be found are left out of
+ * mapPrevOut, which may already hold outputs given by the caller.
+ */
+void FetchPrevOuts(const CTransaction& tx, std::map<COutPoint, CScript>& mapPrevOut);
+
+/**
+ * Signs the inputs of txTo, vPrevPubKeys holds the script of the output each
+ * one spends (an empty script skips the input, it stays as it is).
+ *
+ * The signature hashes share one CSignatureHasher and the inputs are signed
+ * and verified on all cores, the new scriptSigs are only stored once every
+ * input is done. When pvVariants is given, the signatures in the same input
+ * of those transactions are merged in as well.
+ *
+ * With fVerify the result of every input is run through VerifyScript,
+ * otherwise an input counts as complete when the keystore signed it fully.
+ * Returns true if every input is complete.
+ */
+bool SignTransaction(const CKeyStore& keystore, CTransaction& txTo, const std::vector<CScript>& vPrevPubKeys,
+                     int nHashType = SIGHASH_ALL, bool fVerify = true, const std::vector<CTransaction>* pvVariants = NULL);
+
+#endif // NEUTRON_TXSIGNER_H
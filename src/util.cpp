@@ -39,6 +39,8 @@ namespace boost {
 #include <openssl/err.h>
 #include <stdarg.h>
 
+#include <atomic>
+
 #ifdef WIN32
 #ifdef _MSC_VER
 #pragma warning(disable:4786)
@@ -116,6 +118,13 @@ void locking_callback(int mode, int i, const char* file, int line)
 
 LockedPageManager LockedPageManager::instance;
 
+LockedPoolManager& LockedPoolManager::Instance()
+{
+    // Never destroyed, secure allocations of other statics may outlive it otherwise
+    static LockedPoolManager* instance = new LockedPoolManager();
+    return *instance;
+}
+
 // Init
 class CInit
 {
@@ -191,6 +200,25 @@ void DebugPrintShutdown()
     }
 }
 
+// Categories set at runtime, replace -debug once SetLogCategories was called. Never freed,
+// LogPrint may run from global destructors.
+static boost::mutex* pmutexLogCategories = new boost::mutex();
+static vector<string>* pvLogCategories = new vector<string>();
+static std::atomic<int> nLogCategoriesVersion(0);
+
+struct CThreadLogCategories
+{
+    int nVersion;
+    set<string> setCategories;
+};
+
+void SetLogCategories(const vector<string>& vCategories)
+{
+    boost::mutex::scoped_lock lock(*pmutexLogCategories);
+    *pvLogCategories = vCategories;
+    nLogCategoriesVersion++;
+}
+
 bool LogAcceptCategory(const char* category)
 {
     if (category != NULL) {
@@ -201,24 +229,35 @@ bool LogAcceptCategory(const char* category)
         // This helps prevent issues debugging global destructors,
         // where mapMultiArgs might be deleted before another
         // global destructor calls LogPrint()
-        static boost::thread_specific_ptr<set<string> > ptrCategory;
-        if (ptrCategory.get() == NULL) {
-            const vector<string>& categories = mapMultiArgs["-debug"];
-            ptrCategory.reset(new set<string>(categories.begin(), categories.end()));
+        static boost::thread_specific_ptr<CThreadLogCategories> ptrCategory;
+        int nVersion = nLogCategoriesVersion.load(std::memory_order_relaxed);
+        if (ptrCategory.get() == NULL || ptrCategory->nVersion != nVersion) {
+            vector<string> categories;
+            if (nVersion == 0)
+                categories = mapMultiArgs["-debug"];
+            else {
+                boost::mutex::scoped_lock lock(*pmutexLogCategories);
+                categories = *pvLogCategories;
+                nVersion = nLogCategoriesVersion.load();
+            }
+            ptrCategory.reset(new CThreadLogCategories());
+            ptrCategory->nVersion = nVersion;
+            ptrCategory->setCategories.insert(categories.begin(), categories.end());
             // thread_specific_ptr automatically deletes the set when the thread ends.
             // "neutron" is a composite category enabling all Neutron-related debug output
-            if (ptrCategory->count(string("neutron"))) {
-                ptrCategory->insert(string("obfuscation"));
-                ptrCategory->insert(string("swifttx"));
-                ptrCategory->insert(string("masternode"));
-                ptrCategory->insert(string("mnpayments"));
-                ptrCategory->insert(string("mnbudget"));
+            set<string>& setNew = ptrCategory->setCategories;
+            if (setNew.count(string("neutron"))) {
+                setNew.insert(string("obfuscation"));
+                setNew.insert(string("swifttx"));
+                setNew.insert(string("masternode"));
+                setNew.insert(string("mnpayments"));
+                setNew.insert(string("mnbudget"));
             }
         }
-        const set<string>& setCategories = *ptrCategory.get();
+        const set<string>& setCategories = ptrCategory->setCategories;
 
         // if not debugging everything and not debugging specific category, LogPrint does nothing.
-        if (setCategories.count(string("")) == 0 &&
+        if (setCategories.count(string("")) == 0 && setCategories.count(string("1")) == 0 &&
             setCategories.count(string(category)) == 0)
             return false;
     }
@@ -300,10 +339,19 @@ static void InterpretNegativeSetting(string name, map<string, string>& mapSettin
     }
 }
 
+// Arguments given on the command line, they keep overriding the config file when it is read again
+static set<string> setArgsCommandLine;
+
+bool IsArgSetOnCommandLine(const std::string& strArg)
+{
+    return setArgsCommandLine.count(strArg) > 0;
+}
+
 void ParseParameters(int argc, const char* const argv[])
 {
     mapArgs.clear();
     mapMultiArgs.clear();
+    setArgsCommandLine.clear();
     for (int i = 1; i < argc; i++)
     {
         char psz[10000];
@@ -343,6 +391,9 @@ void ParseParameters(int argc, const char* const argv[])
         // interpret -nofoo as -foo=0 (and -nofoo=0 as -foo=1) as long as -foo not set
         InterpretNegativeSetting(name, mapArgs);
     }
+
+    BOOST_FOREACH(const PAIRTYPE(string,string)& entry, mapArgs)
+        setArgsCommandLine.insert(entry.first);
 }
 
 bool IsArgSet(const std::string& strArg)
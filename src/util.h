@@ -150,6 +150,9 @@ void DebugPrintShutdown();
 /** Return true if log accepts specified category */
 bool LogAcceptCategory(const char* category);
 
+/** Replaces the -debug categories, "" or "1" among them enables all */
+void SetLogCategories(const std::vector<std::string>& vCategories);
+
 /** Send a string to the log output */
 int LogPrintStr(const std::string& str);
 
@@ -248,6 +251,14 @@ inline bool IsSwitchChar(char c)
  */
 bool IsArgSet(const std::string& strArg);
 
+/**
+ * Return true if the given argument was on the command line, not only in the config file
+ *
+ * @param strArg Argument to check (e.g. "-foo")
+ * @return true if the argument has been given on the command line
+ */
+bool IsArgSetOnCommandLine(const std::string& strArg);
+
 /**
  * Return string argument or default value
  *
@@ -14,11 +14,83 @@
 
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <zlib.h>
 
 using namespace std;
 using namespace boost;
 
 int64_t nMaxTipAge = DEFAULT_MAX_TIP_AGE;
+bool fCompressBlocks = false;
+
+// Compressed block files start with this tag followed by a format version
+static const unsigned char pchCompressedFileTag[8] = { 'N', 'T', 'R', 'N', 'B', 'L', 'K', 'Z' };
+static const uint32_t COMPRESSED_FILE_VERSION = 1;
+static const unsigned int COMPRESSED_FILE_HEADER_SIZE = sizeof(pchCompressedFileTag) + sizeof(uint32_t);
+
+/** Framing of a single block inside a compressed block file. The block header
+ *  is kept uncompressed right after this record so header-only reads never have
+ *  to inflate the transactions. The checksum covers header and compressed body.
+ */
+class CBlockRecordHeader
+{
+public:
+    unsigned int nRawSize;
+    unsigned int nHeaderSize;
+    unsigned int nCompressedSize;
+    unsigned int nChecksum;
+
+    CBlockRecordHeader()
+    {
+        nRawSize = nHeaderSize = nCompressedSize = nChecksum = 0;
+    }
+
+    IMPLEMENT_SERIALIZE
+    (
+        READWRITE(nRawSize);
+        READWRITE(nHeaderSize);
+        READWRITE(nCompressedSize);
+        READWRITE(nChecksum);
+    )
+};
+
+static CCriticalSection cs_blockFileFormat;
+static std::map<unsigned int, int> mapBlockFileFormat;
+
+static std::atomic<uint64_t> nStatBlocksWritten{0};
+static std::atomic<uint64_t> nStatBytesRaw{0};
+static std::atomic<uint64_t> nStatBytesStored{0};
+static std::atomic<uint64_t> nStatBlocksRead{0};
+static std::atomic<uint64_t> nStatHeadersRead{0};
+static std::atomic<uint64_t> nStatBytesInflated{0};
+static std::atomic<int64_t> nStatInflateMicros{0};
+static std::atomic<uint64_t> nStatRecordCacheHits{0};
+
+// The last block record inflated in full. Transactions of one block are usually
+// read one after the other (ConnectInputs, the stake kernel, the wallet), and
+// each read would inflate the whole block again.
+static CCriticalSection cs_lastBlockRecord;
+static unsigned int nLastRecordFile = 0;    // 0 is never a block file
+static unsigned int nLastRecordPos = 0;
+static std::vector<char> vLastRecord;
+
+static std::atomic<uint64_t> nStatFlushes{0};
+static std::atomic<int64_t> nStatFlushMicros{0};
+static std::atomic<int64_t> nStatMaxFlushMicros{0};
+static std::atomic<uint64_t> nStatFlushWaits{0};
+static std::atomic<int64_t> nStatFlushWaitMicros{0};
+
+// Block file sync state, see "Block file durability" below
+static std::mutex mutexBlockFlush;
+static std::condition_variable condBlockFlushWork;
+static std::condition_variable condBlockFlushDone;
+static std::map<unsigned int, unsigned int> mapFlushRequested;
+static std::map<unsigned int, unsigned int> mapFlushDurable;
+static std::thread threadBlockFlush;
+static bool fBlockFlushRunning = false;
+static bool fBlockFlushStop = false;
 
 static filesystem::path BlockFilePath(unsigned int nFile)
 {
@@ -53,6 +125,7 @@ static unsigned int nCurrentBlockFile = 1;
 FILE* AppendBlockFile(unsigned int& nFileRet)
 {
     nFileRet = 0;
+    int nFormat = fCompressBlocks ? BLOCKFILE_COMPRESSED : BLOCKFILE_RAW;
 
     while (true)
     {
@@ -62,10 +135,33 @@ FILE* AppendBlockFile(unsigned int& nFileRet)
             return NULL;
 
         if (fseek(file, 0, SEEK_END) != 0)
+        {
+            fclose(file);
             return NULL;
+        }
+
+        long nFileSize = ftell(file);
 
-        // FAT32 file size max 4GB, fseek and ftell max 2GB, so we must stay under 2GB
-        if (ftell(file) < (long) (0x7F000000 - MAX_SIZE))
+        // A fresh file takes the configured format, compressed files announce themselves with a header
+        if (nFileSize == 0 && nFormat == BLOCKFILE_COMPRESSED)
+        {
+            CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+
+            fileout << FLATDATA(pchCompressedFileTag) << COMPRESSED_FILE_VERSION;
+            fflush(fileout);
+            nFileSize = ftell(fileout);
+            file = fileout.release();
+        }
+
+        if (nFileSize == 0)
+        {
+            LOCK(cs_blockFileFormat);
+            mapBlockFileFormat[nCurrentBlockFile] = nFormat;
+        }
+
+        // FAT32 file size max 4GB, fseek and ftell max 2GB, so we must stay under 2GB.
+        // Never mix formats inside one file, switching format starts a new one.
+        if (nFileSize < (long) (0x7F000000 - MAX_SIZE) && GetBlockFileFormat(nCurrentBlockFile) == nFormat)
         {
             nFileRet = nCurrentBlockFile;
             return file;
@@ -76,6 +172,416 @@ FILE* AppendBlockFile(unsigned int& nFileRet)
     }
 }
 
+bool IsCompressedBlockFile(FILE* file)
+{
+    unsigned char pchTag[sizeof(pchCompressedFileTag)];
+
+    if (fseek(file, 0, SEEK_SET) != 0)
+        return false;
+
+    bool fCompressed = fread(pchTag, 1, sizeof(pchTag), file) == sizeof(pchTag) &&
+                       memcmp(pchTag, pchCompressedFileTag, sizeof(pchTag)) == 0;
+
+    fseek(file, fCompressed ? COMPRESSED_FILE_HEADER_SIZE : 0, SEEK_SET);
+    return fCompressed;
+}
+
+int GetBlockFileFormat(unsigned int nFile)
+{
+    {
+        LOCK(cs_blockFileFormat);
+        std::map<unsigned int, int>::const_iterator it = mapBlockFileFormat.find(nFile);
+
+        if (it != mapBlockFileFormat.end())
+            return it->second;
+    }
+
+    FILE* file = OpenBlockFile(nFile, 0, "rb");
+
+    // Missing files are raw, that's what every pre-existing reader expects
+    if (!file)
+        return BLOCKFILE_RAW;
+
+    int nFormat = IsCompressedBlockFile(file) ? BLOCKFILE_COMPRESSED : BLOCKFILE_RAW;
+    bool fEmpty = (fseek(file, 0, SEEK_END) != 0 || ftell(file) <= 0);
+    fclose(file);
+
+    // Only remember the format once the file has content, empty files are claimed by AppendBlockFile
+    if (!fEmpty)
+    {
+        LOCK(cs_blockFileFormat);
+        mapBlockFileFormat[nFile] = nFormat;
+    }
+
+    return nFormat;
+}
+
+void ClearBlockFileFormatCache()
+{
+    {
+        LOCK(cs_blockFileFormat);
+        mapBlockFileFormat.clear();
+        nCurrentBlockFile = 1;
+    }
+
+    {
+        LOCK(cs_lastBlockRecord);
+        nLastRecordFile = 0;
+        vLastRecord.clear();
+    }
+
+    // The files are gone, forget their sync positions too
+    std::lock_guard<std::mutex> lock(mutexBlockFlush);
+    mapFlushRequested.clear();
+    mapFlushDurable.clear();
+}
+
+// nSize is what follows the magic and size that start every record, both formats
+static void RecordBlockWrite(unsigned int nRawSize, unsigned int nSize)
+{
+    nStatBlocksWritten++;
+    nStatBytesRaw += nRawSize;
+    nStatBytesStored += sizeof(pchMessageStart) + sizeof(nSize) + nSize;
+}
+
+bool WriteCompressedBlock(CAutoFile& fileout, const CDataStream& ssBlock, unsigned int nHeaderSize, unsigned int& nBlockPosRet)
+{
+    if (nHeaderSize > ssBlock.size())
+        return error("%s : header size %u exceeds block size %u", __func__, nHeaderSize, ssBlock.size());
+
+    const unsigned char* pchBlock = (const unsigned char*) &ssBlock.begin()[0];
+    uLong nBodySize = ssBlock.size() - nHeaderSize;
+    uLongf nCompressedSize = compressBound(nBodySize);
+    std::vector<unsigned char> vchCompressed(nCompressedSize);
+
+    if (compress2(&vchCompressed[0], &nCompressedSize, pchBlock + nHeaderSize, nBodySize, Z_BEST_SPEED) != Z_OK)
+        return error("%s : compress2 failed", __func__);
+
+    CBlockRecordHeader record;
+    record.nRawSize = ssBlock.size();
+    record.nHeaderSize = nHeaderSize;
+    record.nCompressedSize = nCompressedSize;
+    record.nChecksum = crc32(crc32(0, pchBlock, nHeaderSize), &vchCompressed[0], nCompressedSize);
+
+    unsigned int nSize = ::GetSerializeSize(record, SER_DISK, CLIENT_VERSION) + nHeaderSize + nCompressedSize;
+    fileout << FLATDATA(pchMessageStart) << nSize;
+
+    long fileOutPos = ftell(fileout);
+
+    if (fileOutPos < 0)
+        return error("%s : ftell failed", __func__);
+
+    nBlockPosRet = fileOutPos;
+    fileout << record;
+    fileout.write((const char*) pchBlock, nHeaderSize);
+    fileout.write((const char*) &vchCompressed[0], nCompressedSize);
+
+    RecordBlockWrite(record.nRawSize, nSize);
+    return true;
+}
+
+bool ReadCompressedBlock(CAutoFile& filein, bool fHeaderOnly, CDataStream& ssBlock)
+{
+    CBlockRecordHeader record;
+    std::vector<unsigned char> vchCompressed;
+
+    ssBlock.clear();
+
+    try
+    {
+        filein >> record;
+
+        if (record.nHeaderSize > record.nRawSize || record.nRawSize > MAX_SIZE ||
+            record.nCompressedSize > compressBound(MAX_SIZE))
+        {
+            return error("%s : implausible block record (raw %u, header %u, compressed %u)", __func__,
+                         record.nRawSize, record.nHeaderSize, record.nCompressedSize);
+        }
+
+        ssBlock.resize(fHeaderOnly ? record.nHeaderSize : record.nRawSize);
+
+        if (record.nHeaderSize > 0)
+            filein.read(&ssBlock[0], record.nHeaderSize);
+
+        if (fHeaderOnly)
+        {
+            nStatHeadersRead++;
+            return true;
+        }
+
+        vchCompressed.resize(record.nCompressedSize);
+
+        if (record.nCompressedSize > 0)
+            filein.read((char*) &vchCompressed[0], record.nCompressedSize);
+    }
+    catch (std::exception &e)
+    {
+        return error("%s : deserialize or I/O error", __func__);
+    }
+
+    const unsigned char* pchBlock = (const unsigned char*) &ssBlock[0];
+
+    if (crc32(crc32(0, pchBlock, record.nHeaderSize), vchCompressed.data(), vchCompressed.size()) != record.nChecksum)
+        return error("%s : block record checksum mismatch", __func__);
+
+    int64_t nStart = GetTimeMicros();
+    uLongf nBodySize = record.nRawSize - record.nHeaderSize;
+
+    if (nBodySize > 0 && (uncompress((unsigned char*) &ssBlock[record.nHeaderSize], &nBodySize,
+                                     vchCompressed.data(), vchCompressed.size()) != Z_OK ||
+                          nBodySize != record.nRawSize - record.nHeaderSize))
+    {
+        return error("%s : uncompress failed", __func__);
+    }
+
+    nStatBlocksRead++;
+    nStatBytesInflated += record.nRawSize;
+    nStatInflateMicros += GetTimeMicros() - nStart;
+    return true;
+}
+
+bool ReadCompressedBlock(unsigned int nFile, unsigned int nBlockPos, bool fHeaderOnly, CDataStream& ssBlock)
+{
+    // Records are never rewritten in place, one read at a position stays valid
+    if (!fHeaderOnly)
+    {
+        LOCK(cs_lastBlockRecord);
+
+        if (nLastRecordFile == nFile && nLastRecordPos == nBlockPos)
+        {
+            ssBlock.clear();
+            ssBlock.write(vLastRecord.data(), vLastRecord.size());
+            nStatRecordCacheHits++;
+            return true;
+        }
+    }
+
+    CAutoFile filein = CAutoFile(OpenBlockFile(nFile, nBlockPos, "rb"), SER_DISK, CLIENT_VERSION);
+
+    if (!filein)
+        return error("%s : OpenBlockFile failed", __func__);
+
+    if (!ReadCompressedBlock(filein, fHeaderOnly, ssBlock))
+        return false;
+
+    if (!fHeaderOnly)
+    {
+        LOCK(cs_lastBlockRecord);
+        nLastRecordFile = nFile;
+        nLastRecordPos = nBlockPos;
+        vLastRecord.assign(ssBlock.begin(), ssBlock.end());
+    }
+
+    return true;
+}
+
+void RecordRawBlockWrite(unsigned int nSize)
+{
+    RecordBlockWrite(nSize, nSize);
+}
+
+CBlockStorageStats GetBlockStorageStats()
+{
+    CBlockStorageStats stats;
+
+    stats.nBlocksWritten = nStatBlocksWritten;
+    stats.nBytesRaw = nStatBytesRaw;
+    stats.nBytesStored = nStatBytesStored;
+    stats.nBlocksRead = nStatBlocksRead;
+    stats.nHeadersRead = nStatHeadersRead;
+    stats.nBytesInflated = nStatBytesInflated;
+    stats.nInflateMicros = nStatInflateMicros;
+    stats.nRecordCacheHits = nStatRecordCacheHits;
+    stats.nFlushes = nStatFlushes;
+    stats.nFlushMicros = nStatFlushMicros;
+    stats.nMaxFlushMicros = nStatMaxFlushMicros;
+    stats.nFlushWaits = nStatFlushWaits;
+    stats.nFlushWaitMicros = nStatFlushWaitMicros;
+
+    return stats;
+}
+
+/**
+ * Block file durability. CBlock::WriteToDisk hands the block to the OS right
+ * away (fflush), so readers see it immediately, and schedules the fsync here.
+ * A background thread performs the fsyncs off cs_main. Before a block becomes
+ * the best chain, SetBestChain waits for its data to be durable, so the chain
+ * pointer in the block index database never references block data that a
+ * power failure could lose.
+ *
+ * Positions are tracked per file: mapFlushRequested is the end of the data
+ * that has to be synced, mapFlushDurable the end of the data that is. An fsync
+ * covers everything written to the file before it started.
+ */
+static bool CommitBlockFile(unsigned int nFile)
+{
+    int64_t nStart = GetTimeMicros();
+    FILE* file = OpenBlockFile(nFile, 0, "ab");
+
+    if (!file)
+        return error("%s : unable to open blk%04u.dat", __func__, nFile);
+
+    FileCommit(file);
+    fclose(file);
+
+    int64_t nElapsed = GetTimeMicros() - nStart;
+    int64_t nMax = nStatMaxFlushMicros.load();
+
+    nStatFlushes++;
+    nStatFlushMicros += nElapsed;
+
+    while (nElapsed > nMax && !nStatMaxFlushMicros.compare_exchange_weak(nMax, nElapsed))
+        ;
+
+    return true;
+}
+
+static void ThreadBlockFlush()
+{
+    std::unique_lock<std::mutex> lock(mutexBlockFlush);
+
+    while (true)
+    {
+        // Pick the oldest file with unsynced data, files become durable in order
+        std::map<unsigned int, unsigned int>::iterator it = mapFlushRequested.begin();
+
+        while (it != mapFlushRequested.end() && mapFlushDurable[it->first] >= it->second)
+            ++it;
+
+        if (it == mapFlushRequested.end())
+        {
+            if (fBlockFlushStop)
+                return;
+
+            condBlockFlushWork.wait(lock);
+            continue;
+        }
+
+        unsigned int nFile = it->first;
+        unsigned int nEndPos = it->second;
+
+        // Data written after nEndPos was requested may be included in the sync,
+        // but is only reported durable once its own request is served
+        lock.unlock();
+        bool fOk = CommitBlockFile(nFile);
+        lock.lock();
+
+        // Never stall the chain tip on a file that can't be synced, it is logged above
+        mapFlushDurable[nFile] = std::max(mapFlushDurable[nFile], nEndPos);
+
+        if (!fOk)
+            LogPrintf("%s : [WARNING] blk%04u.dat may not be durable up to %u\n", __func__, nFile, nEndPos);
+
+        condBlockFlushDone.notify_all();
+    }
+}
+
+void StartBlockFileFlusher()
+{
+    std::lock_guard<std::mutex> lock(mutexBlockFlush);
+
+    if (fBlockFlushRunning)
+        return;
+
+    fBlockFlushStop = false;
+    fBlockFlushRunning = true;
+    threadBlockFlush = std::thread(&TraceThread<void (*)()>, "blockflush", &ThreadBlockFlush);
+}
+
+void StopBlockFileFlusher()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutexBlockFlush);
+
+        if (!fBlockFlushRunning)
+            return;
+
+        // The thread drains all outstanding requests before it exits
+        fBlockFlushStop = true;
+    }
+
+    condBlockFlushWork.notify_all();
+    threadBlockFlush.join();
+
+    std::lock_guard<std::mutex> lock(mutexBlockFlush);
+    fBlockFlushRunning = false;
+}
+
+void ScheduleBlockFileFlush(unsigned int nFile, unsigned int nEndPos)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutexBlockFlush);
+
+        if (fBlockFlushRunning && !fBlockFlushStop)
+        {
+            unsigned int& nRequested = mapFlushRequested[nFile];
+            nRequested = std::max(nRequested, nEndPos);
+            condBlockFlushWork.notify_one();
+            return;
+        }
+    }
+
+    // No flush thread (startup, shutdown or -asyncblockflush=0), sync inline
+    CommitBlockFile(nFile);
+
+    std::lock_guard<std::mutex> lock(mutexBlockFlush);
+    unsigned int& nDurable = mapFlushDurable[nFile];
+    nDurable = std::max(nDurable, nEndPos);
+    condBlockFlushDone.notify_all();
+}
+
+// Waits for every flush that was requested for data at or before nBlockPos in
+// nFile, including all pending flushes of older files. Blocks that were never
+// scheduled (initial block download only syncs every 500 blocks) return at once.
+void WaitForBlockFileFlush(unsigned int nFile, unsigned int nBlockPos)
+{
+    std::unique_lock<std::mutex> lock(mutexBlockFlush);
+    int64_t nStart = 0;
+
+    while (true)
+    {
+        bool fPending = false;
+
+        for (std::map<unsigned int, unsigned int>::iterator it = mapFlushRequested.begin();
+             it != mapFlushRequested.end() && it->first <= nFile; ++it)
+        {
+            unsigned int nDurable = mapFlushDurable[it->first];
+
+            if (nDurable >= it->second)
+                continue;
+
+            // Only wait on the block's own file if its position is covered by a request
+            if (it->first < nFile || (it->second > nBlockPos && nDurable <= nBlockPos))
+            {
+                fPending = true;
+                break;
+            }
+        }
+
+        if (!fPending)
+            break;
+
+        if (nStart == 0)
+            nStart = GetTimeMicros();
+
+        condBlockFlushDone.wait(lock);
+    }
+
+    if (nStart != 0)
+    {
+        nStatFlushWaits++;
+        nStatFlushWaitMicros += GetTimeMicros() - nStart;
+    }
+}
+
+unsigned int GetBlockFileDurablePos(unsigned int nFile)
+{
+    std::lock_guard<std::mutex> lock(mutexBlockFlush);
+    std::map<unsigned int, unsigned int>::const_iterator it = mapFlushDurable.find(nFile);
+
+    return it == mapFlushDurable.end() ? 0 : it->second;
+}
+
 // Once this function has returned false it should remain so most of the time
 static std::atomic<bool> latchToFalse{false};
 
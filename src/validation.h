@@ -15,10 +15,54 @@
 static const int MAX_INACTIVITY_IBD = 60 * 5; /* 5 minutes */
 static const int64_t DEFAULT_MAX_TIP_AGE = 60 * 60 * 2;
 extern int64_t nMaxTipAge;
+extern bool fCompressBlocks;
+/** Default for -asyncblockflush */
+static const bool DEFAULT_ASYNC_BLOCK_FLUSH = true;
+class CAutoFile;
 class CBlockIndex;
+class CDataStream;
+
+/** Layout of a blk000?.dat file. A file keeps the format it was created with, so
+ *  raw and compressed files can coexist in the same data directory. */
+enum BlockFileFormat
+{
+    BLOCKFILE_RAW        = 0, // magic, size, serialized block
+    BLOCKFILE_COMPRESSED = 1, // file header, then magic, size, framed zlib record per block
+};
+
+/** Counters describing block file I/O, reported by getblockstorageinfo */
+struct CBlockStorageStats
+{
+    uint64_t nBlocksWritten;
+    uint64_t nBytesRaw;
+    uint64_t nBytesStored;
+    uint64_t nBlocksRead;
+    uint64_t nHeadersRead;
+    uint64_t nBytesInflated;
+    int64_t nInflateMicros;
+    uint64_t nRecordCacheHits;  // full reads served from the last inflated record
+    uint64_t nFlushes;          // fsyncs of block files
+    int64_t nFlushMicros;
+    int64_t nMaxFlushMicros;
+    uint64_t nFlushWaits;       // times the chain tip had to wait for its block to become durable
+    int64_t nFlushWaitMicros;
+};
 
 FILE* OpenBlockFile(unsigned int nFile, unsigned int nBlockPos, const char* pszMode="rb");
 FILE* AppendBlockFile(unsigned int& nFileRet);
+int GetBlockFileFormat(unsigned int nFile);
+void ClearBlockFileFormatCache();
+bool IsCompressedBlockFile(FILE* file);
+bool WriteCompressedBlock(CAutoFile& fileout, const CDataStream& ssBlock, unsigned int nHeaderSize, unsigned int& nBlockPosRet);
+bool ReadCompressedBlock(CAutoFile& filein, bool fHeaderOnly, CDataStream& ssBlock);
+bool ReadCompressedBlock(unsigned int nFile, unsigned int nBlockPos, bool fHeaderOnly, CDataStream& ssBlock);
+void RecordRawBlockWrite(unsigned int nSize);
+CBlockStorageStats GetBlockStorageStats();
+void StartBlockFileFlusher();
+void StopBlockFileFlusher();
+void ScheduleBlockFileFlush(unsigned int nFile, unsigned int nEndPos);
+void WaitForBlockFileFlush(unsigned int nFile, unsigned int nBlockPos);
+unsigned int GetBlockFileDurablePos(unsigned int nFile);
 void DelatchIsInitialBlockDownload();
 bool IsInitialBlockDownload();
 
@@ -18,13 +18,32 @@
 #include "script.h"
 #include "spork.h"
 #include "darksend.h"
+#include "feeestimator.h"
 #include "masternode.h"
+#include "runtimeconfig.h"
+#include "stakeportfolio.h"
+#include "txsigner.h"
+#include "walletcheck.h"
 #include "validation.h"
 
 using namespace std;
 
-unsigned int nStakeSplitAge = 1 * 24 * 60 * 60;
-int64_t nStakeCombineThreshold = 1000 * COIN;
+int nTxConfirmTarget = DEFAULT_TX_CONFIRM_TARGET;
+
+// Fee per 1000 bytes for new transactions: with -txconfirmtarget what recently got
+// confirmed within that many blocks, otherwise (or without enough data) -paytxfee
+static int64_t GetPayTxFeePerK()
+{
+    if (nTxConfirmTarget > 0)
+    {
+        int64_t nEstimate = feeEstimator.EstimateFee(nTxConfirmTarget);
+
+        if (nEstimate > 0)
+            return nEstimate;
+    }
+
+    return nTransactionFee;
+}
 
 struct CompareValueOnly
 {
@@ -152,6 +171,34 @@ bool CWallet::AddCScript(const CScript& redeemScript)
 
 bool fWalletUnlockStakingOnly = false;
 
+int64_t nWalletKdfTargetMillis = DEFAULT_WALLET_KDF_MILLIS;
+
+// Lowest allowed passphrase derivation cost. A scrypt round is a full memory-hard
+// scrypt hash, far more expensive than a round of EVP_BytesToKey with SHA-512.
+static unsigned int GetMinDeriveIterations(unsigned int nDerivationMethod)
+{
+    return nDerivationMethod == 1 ? 100 : 25000;
+}
+
+// Pick the number of derivation rounds that takes about nWalletKdfTargetMillis on this machine
+static unsigned int CalibrateDeriveIterations(const SecureString& strWalletPassphrase, const CMasterKey& kMasterKey)
+{
+    CCrypter crypter;
+    unsigned int nMinIterations = GetMinDeriveIterations(kMasterKey.nDerivationMethod);
+
+    int64_t nStartTime = GetTimeMicros();
+    crypter.SetKeyFromPassphrase(strWalletPassphrase, kMasterKey.vchSalt, nMinIterations, kMasterKey.nDerivationMethod);
+    double nMillis = std::max(1.0, (GetTimeMicros() - nStartTime) / 1000.0);
+    unsigned int nIterations = nMinIterations * (nWalletKdfTargetMillis / nMillis);
+
+    nStartTime = GetTimeMicros();
+    crypter.SetKeyFromPassphrase(strWalletPassphrase, kMasterKey.vchSalt, nIterations, kMasterKey.nDerivationMethod);
+    nMillis = std::max(1.0, (GetTimeMicros() - nStartTime) / 1000.0);
+    nIterations = (nIterations + nIterations * (nWalletKdfTargetMillis / nMillis)) / 2;
+
+    return std::max(nIterations, nMinIterations);
+}
+
 bool CWallet::Unlock(const SecureString& strWalletPassphrase, bool anonymizeOnly)
 {
     if (!IsLocked())
@@ -163,23 +210,31 @@ bool CWallet::Unlock(const SecureString& strWalletPassphrase, bool anonymizeOnly
     CCrypter crypter;
     CKeyingMaterial vMasterKey;
     fWalletUnlockAnonymizeOnly = anonymizeOnly;
+    int64_t nStartTime = GetTimeMillis();
 
+    // The passphrase derivation is deliberately slow, run it on a copy of the
+    // master keys so cs_wallet stays free for the rest of the node
+    MasterKeyMap mapKeys;
     {
         LOCK(cs_wallet);
+        mapKeys = mapMasterKeys;
+    }
 
-        BOOST_FOREACH(const MasterKeyMap::value_type& pMasterKey, mapMasterKeys)
+    BOOST_FOREACH(const MasterKeyMap::value_type& pMasterKey, mapKeys)
+    {
+        if (!crypter.SetKeyFromPassphrase(strWalletPassphrase, pMasterKey.second.vchSalt,
+                                         pMasterKey.second.nDeriveIterations, pMasterKey.second.nDerivationMethod))
         {
-            if (!crypter.SetKeyFromPassphrase(strWalletPassphrase, pMasterKey.second.vchSalt,
-                                             pMasterKey.second.nDeriveIterations, pMasterKey.second.nDerivationMethod))
-            {
-                return false;
-            }
+            return false;
+        }
 
-            if (!crypter.Decrypt(pMasterKey.second.vchCryptedKey, vMasterKey))
-                return false;
+        if (!crypter.Decrypt(pMasterKey.second.vchCryptedKey, vMasterKey))
+            return false;
 
-            if (CCryptoKeyStore::Unlock(vMasterKey))
-                return true;
+        if (CCryptoKeyStore::Unlock(vMasterKey))
+        {
+            LogPrint("wallet", "%s : unlocked in %dms\n", __func__, GetTimeMillis() - nStartTime);
+            return true;
         }
     }
 
@@ -188,71 +243,111 @@ bool CWallet::Unlock(const SecureString& strWalletPassphrase, bool anonymizeOnly
 
 bool CWallet::ChangeWalletPassphrase(const SecureString& strOldWalletPassphrase, const SecureString& strNewWalletPassphrase)
 {
-    bool fWasLocked = IsLocked();
+    int64_t nStartTime = GetTimeMillis();
 
+    // Both derivations and the calibration run on a local crypter without cs_wallet,
+    // the keystore is never unlocked for them; only the new master key is stored under it
+    MasterKeyMap mapKeys;
     {
         LOCK(cs_wallet);
-        Lock();
+        mapKeys = mapMasterKeys;
+    }
 
-        CCrypter crypter;
-        CKeyingMaterial vMasterKey;
+    CCrypter crypter;
+    CKeyingMaterial vMasterKey;
 
-        BOOST_FOREACH(MasterKeyMap::value_type& pMasterKey, mapMasterKeys)
+    BOOST_FOREACH(MasterKeyMap::value_type& pMasterKey, mapKeys)
+    {
+        if(!crypter.SetKeyFromPassphrase(strOldWalletPassphrase, pMasterKey.second.vchSalt,
+                                         pMasterKey.second.nDeriveIterations, pMasterKey.second.nDerivationMethod))
         {
-            if(!crypter.SetKeyFromPassphrase(strOldWalletPassphrase, pMasterKey.second.vchSalt,
-                                             pMasterKey.second.nDeriveIterations, pMasterKey.second.nDerivationMethod))
-            {
-                return false;
-            }
+            return false;
+        }
+
+        if (!crypter.Decrypt(pMasterKey.second.vchCryptedKey, vMasterKey))
+            return false;
 
-            if (!crypter.Decrypt(pMasterKey.second.vchCryptedKey, vMasterKey))
+        if (!CheckMasterKey(vMasterKey))
+            continue;
+
+        CMasterKey kMasterKey = pMasterKey.second;
+        kMasterKey.nDeriveIterations = CalibrateDeriveIterations(strNewWalletPassphrase, kMasterKey);
+
+        LogPrintf("%s: wallet passphrase changed to an nDeriveIterations of %i\n",
+                  __func__, kMasterKey.nDeriveIterations);
+
+        if (!crypter.SetKeyFromPassphrase(strNewWalletPassphrase, kMasterKey.vchSalt,
+                                          kMasterKey.nDeriveIterations, kMasterKey.nDerivationMethod))
+        {
+            return false;
+        }
+
+        if (!crypter.Encrypt(vMasterKey, kMasterKey.vchCryptedKey))
+            return false;
+
+        {
+            LOCK(cs_wallet);
+
+            // Another passphrase change got in first, its result stands
+            MasterKeyMap::iterator mi = mapMasterKeys.find(pMasterKey.first);
+            if (mi == mapMasterKeys.end() || (*mi).second.vchCryptedKey != pMasterKey.second.vchCryptedKey)
                 return false;
 
-            if (CCryptoKeyStore::Unlock(vMasterKey))
-            {
-                int64_t nStartTime = GetTimeMillis();
+            (*mi).second = kMasterKey;
+            CWalletDB(strWalletFile).WriteMasterKey(pMasterKey.first, kMasterKey);
+        }
 
-                crypter.SetKeyFromPassphrase(strNewWalletPassphrase, pMasterKey.second.vchSalt,
-                                             pMasterKey.second.nDeriveIterations, pMasterKey.second.nDerivationMethod);
+        LogPrint("wallet", "%s : passphrase changed in %dms\n", __func__, GetTimeMillis() - nStartTime);
+        return true;
+    }
 
-                pMasterKey.second.nDeriveIterations = pMasterKey.second.nDeriveIterations *
-                                                      (100 / ((double) (GetTimeMillis() - nStartTime)));
-                nStartTime = GetTimeMillis();
+    return false;
+}
 
-                crypter.SetKeyFromPassphrase(strNewWalletPassphrase, pMasterKey.second.vchSalt,
-                                             pMasterKey.second.nDeriveIterations, pMasterKey.second.nDerivationMethod);
+static bool CompareOutputValueDesc(const COutput& a, const COutput& b)
+{
+    return a.tx->vout[a.i].nValue > b.tx->vout[b.i].nValue;
+}
 
-                pMasterKey.second.nDeriveIterations = (pMasterKey.second.nDeriveIterations +
-                                                       pMasterKey.second.nDeriveIterations * 100 /
-                                                       ((double)(GetTimeMillis() - nStartTime))) / 2;
+void CWallet::CacheSigningKeys()
+{
+    if (!IsCrypted() || IsLocked())
+        return;
 
-                if (pMasterKey.second.nDeriveIterations < 25000)
-                    pMasterKey.second.nDeriveIterations = 25000;
+    // keys missed here are cached on first use by CreateCoinStake
+    TRY_LOCK(cs_main, lockMain);
 
-                LogPrintf("%s: wallet passphrase changed to an nDeriveIterations of %i\n",
-                          __func__, pMasterKey.second.nDeriveIterations);
+    if (!lockMain)
+        return;
 
-                if (!crypter.SetKeyFromPassphrase(strNewWalletPassphrase, pMasterKey.second.vchSalt,
-                                                  pMasterKey.second.nDeriveIterations,
-                                                  pMasterKey.second.nDerivationMethod))
-                {
-                    return false;
-                }
+    vector<COutput> vCoins;
+    AvailableCoinsMinConf(vCoins, nCoinbaseMaturity + 10);
+    sort(vCoins.begin(), vCoins.end(), CompareOutputValueDesc);
 
-                if (!crypter.Encrypt(vMasterKey, pMasterKey.second.vchCryptedKey))
-                    return false;
+    unsigned int nCached = 0;
 
-                CWalletDB(strWalletFile).WriteMasterKey(pMasterKey.first, pMasterKey.second);
+    BOOST_FOREACH(const COutput& out, vCoins)
+    {
+        if (nCached >= SIGNING_KEY_CACHE_SIZE)
+            break;
 
-                if (fWasLocked)
-                    Lock();
+        CTxDestination address;
+        CKey key;
 
-                return true;
-            }
-        }
+        if (!ExtractDestination(out.tx->vout[out.i].scriptPubKey, address))
+            continue;
+
+        const CKeyID* pkeyID = boost::get<CKeyID>(&address);
+
+        if (pkeyID && GetSigningKey(*pkeyID, key))
+            nCached++;
     }
 
-    return false;
+    uint64_t nHits, nMisses;
+    unsigned int nSize;
+    GetSigningKeyCacheStats(nHits, nMisses, nSize);
+
+    LogPrint("wallet", "%s : %u signing keys ready\n", __func__, nSize);
 }
 
 void CWallet::SetBestChain(const CBlockLocator& loc)
@@ -319,15 +414,7 @@ bool CWallet::EncryptWallet(const SecureString& strWalletPassphrase)
 
     CCrypter crypter;
     int64_t nStartTime = GetTimeMillis();
-    crypter.SetKeyFromPassphrase(strWalletPassphrase, kMasterKey.vchSalt, 25000, kMasterKey.nDerivationMethod);
-    kMasterKey.nDeriveIterations = 2500000 / ((double)(GetTimeMillis() - nStartTime));
-
-    nStartTime = GetTimeMillis();
-    crypter.SetKeyFromPassphrase(strWalletPassphrase, kMasterKey.vchSalt, kMasterKey.nDeriveIterations, kMasterKey.nDerivationMethod);
-    kMasterKey.nDeriveIterations = (kMasterKey.nDeriveIterations + kMasterKey.nDeriveIterations * 100 / ((double)(GetTimeMillis() - nStartTime))) / 2;
-
-    if (kMasterKey.nDeriveIterations < 25000)
-        kMasterKey.nDeriveIterations = 25000;
+    kMasterKey.nDeriveIterations = CalibrateDeriveIterations(strWalletPassphrase, kMasterKey);
 
     LogPrintf("Encrypting Wallet with an nDeriveIterations of %i\n", kMasterKey.nDeriveIterations);
 
@@ -376,6 +463,7 @@ bool CWallet::EncryptWallet(const SecureString& strWalletPassphrase)
         CDB::Rewrite(strWalletFile);
 
     }
+    LogPrintf("%s : wallet encrypted in %dms\n", __func__, GetTimeMillis() - nStartTime);
     NotifyStatusChanged(this);
 
     return true;
@@ -2347,7 +2435,8 @@ bool CWallet::CreateTransaction(const vector<pair<CScript, int64_t> >& vecSend,
         // txdb must be opened before the mapWallet lock
         CTxDB txdb("r");
         {
-            nFeeRet = nTransactionFee;
+            int64_t nFeePerK = GetPayTxFeePerK();
+            nFeeRet = nFeePerK;
 
             while (true)
             {
@@ -2439,11 +2528,13 @@ bool CWallet::CreateTransaction(const vector<pair<CScript, int64_t> >& vecSend,
                 BOOST_FOREACH(const PAIRTYPE(const CWalletTx*,unsigned int)& coin, setCoins)
                     wtxNew.vin.push_back(CTxIn(coin.first->GetHash(),coin.second));
 
-                // Sign
-                int nIn = 0;
+                // Sign, large sends use all cores
+                vector<CScript> vPrevPubKeys;
                 BOOST_FOREACH(const PAIRTYPE(const CWalletTx*,unsigned int)& coin, setCoins)
-                    if (!SignSignature(*this, *coin.first, wtxNew, nIn++))
-                        return false;
+                    vPrevPubKeys.push_back(coin.first->vout[coin.second].scriptPubKey);
+
+                if (!SignTransaction(*this, wtxNew, vPrevPubKeys))
+                    return false;
 
                 // Limit size
                 unsigned int nBytes = ::GetSerializeSize(*(CTransaction*)&wtxNew, SER_NETWORK, PROTOCOL_VERSION);
@@ -2452,7 +2543,7 @@ bool CWallet::CreateTransaction(const vector<pair<CScript, int64_t> >& vecSend,
                 dPriority /= nBytes;
 
                 // Check that enough fee is included
-                int64_t nPayFee = nTransactionFee * (1 + (int64_t)nBytes / 1000);
+                int64_t nPayFee = nFeePerK * (1 + (int64_t)nBytes / 1000);
                 int64_t nMinFee = wtxNew.GetMinFee(1, GMF_SEND, nBytes);
 
                 if (nFeeRet < max(nPayFee, nMinFee))
@@ -2553,8 +2644,11 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int
         return false;
 
     int64_t nCredit = 0;
+    int64_t nKernelAge = 0;
     CScript scriptPubKeyKernel;
     CTxDB txdb("r");
+    CStakePolicy policy = stakePortfolio.GetPolicy();
+    int64_t nSearchStart = GetTimeMicros();
 
     BOOST_FOREACH(PAIRTYPE(const CWalletTx*, unsigned int) pcoin, setCoins)
     {
@@ -2592,7 +2686,7 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int
                                      prevoutStake, txNew.nTime - n, hashProofOfStake, targetProofOfStake))
             {
                 // Found a kernel
-                if (fDebug && GetBoolArg("-printcoinstake"))
+                if (fDebug && configPrintCoinStake.GetBool())
                     LogPrintf("%s : kernel found\n", __func__);
 
                 vector<valtype> vSolutions;
@@ -2602,18 +2696,18 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int
 
                 if (!Solver(scriptPubKeyKernel, whichType, vSolutions))
                 {
-                    if (fDebug && GetBoolArg("-printcoinstake"))
+                    if (fDebug && configPrintCoinStake.GetBool())
                         LogPrintf("%s : failed to parse kernel\n", __func__);
 
                     break;
                 }
 
-                if (fDebug && GetBoolArg("-printcoinstake"))
+                if (fDebug && configPrintCoinStake.GetBool())
                     LogPrintf("%s : parsed kernel type=%d\n", __func__, whichType);
 
                 if (whichType != TX_PUBKEY && whichType != TX_PUBKEYHASH)
                 {
-                    if (fDebug && GetBoolArg("-printcoinstake"))
+                    if (fDebug && configPrintCoinStake.GetBool())
                         LogPrintf("CreateCoinStake : no support for kernel type=%d\n", whichType);
 
                     break;  // only support pay to public key and pay to address
@@ -2622,9 +2716,9 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int
                 if (whichType == TX_PUBKEYHASH) // pay to address type
                 {
                     // convert to pay to public key type
-                    if (!keystore.GetKey(uint160(vSolutions[0]), key))
+                    if (!keystore.GetSigningKey(uint160(vSolutions[0]), key))
                     {
-                        if (fDebug && GetBoolArg("-printcoinstake"))
+                        if (fDebug && configPrintCoinStake.GetBool())
                             LogPrintf("%s : failed to get key for kernel type=%d\n", __func__, whichType);
 
                         break;  // unable to find corresponding public key
@@ -2637,9 +2731,9 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int
                 {
                     valtype& vchPubKey = vSolutions[0];
 
-                    if (!keystore.GetKey(Hash160(vchPubKey), key))
+                    if (!keystore.GetSigningKey(Hash160(vchPubKey), key))
                     {
-                        if (fDebug && GetBoolArg("-printcoinstake"))
+                        if (fDebug && configPrintCoinStake.GetBool())
                             LogPrintf("%s : failed to get key for kernel type=%d\n", __func__, whichType);
 
                         break;  // unable to find corresponding public key
@@ -2647,7 +2741,7 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int
 
                     if (key.GetPubKey() != vchPubKey)
                     {
-                        if (fDebug && GetBoolArg("-printcoinstake"))
+                        if (fDebug && configPrintCoinStake.GetBool())
                             LogPrintf("%s : invalid key for kernel type=%d\n", __func__, whichType);
 
                         break; // keys mismatch
@@ -2661,11 +2755,9 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int
                 nCredit += pcoin.first->vout[pcoin.second].nValue;
                 vwtxPrev.push_back(pcoin.first);
                 txNew.vout.push_back(CTxOut(0, scriptPubKeyOut));
+                nKernelAge = GetWeight(block.GetBlockTime(), (int64_t)txNew.nTime);
 
-                if (GetWeight(block.GetBlockTime(), (int64_t)txNew.nTime) < nStakeSplitAge)
-                    txNew.vout.push_back(CTxOut(0, scriptPubKeyOut)); //split stake
-
-                if (fDebug && GetBoolArg("-printcoinstake"))
+                if (fDebug && configPrintCoinStake.GetBool())
                     LogPrintf("%s : added kernel type=%d\n", __func__, whichType);
 
                 fKernelFound = true;
@@ -2677,6 +2769,8 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int
             break; // if kernel is found stop searching
     }
 
+    stakePortfolio.KernelSearched(setCoins.size(), GetTimeMicros() - nSearchStart);
+
     if (nCredit == 0 || nCredit > nBalance - nReserveBalance)
         return false;
 
@@ -2689,17 +2783,14 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int
         {
             int64_t nTimeWeight = GetWeight((int64_t)pcoin.first->nTime, (int64_t)txNew.nTime);
 
-            // Stop adding more inputs if already too many inputs
-            if (txNew.vin.size() >= 100)
-                break;
-            // Stop adding more inputs if value is already pretty significant
-            if (nCredit >= nStakeCombineThreshold)
+            // Stop adding more inputs if already too many inputs or value is already pretty significant
+            if (!policy.ShouldCombine(nCredit, txNew.vin.size(), 0))
                 break;
             // Stop adding inputs if reached reserve limit
             if (nCredit + pcoin.first->vout[pcoin.second].nValue > nBalance - nReserveBalance)
                 break;
             // Do not add additional significant input
-            if (pcoin.first->vout[pcoin.second].nValue >= nStakeCombineThreshold)
+            if (!policy.ShouldCombine(nCredit, txNew.vin.size(), pcoin.first->vout[pcoin.second].nValue))
                 continue;
             // Do not add input that is still too young
             if (nTimeWeight < nStakeMinAge)
@@ -2726,6 +2817,10 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int
         nCredit += nReward;
     }
 
+    // Split stake, young kernels as before, large paybacks when -stakesplitthreshold asks for it
+    if (policy.ShouldSplit(nCredit, nKernelAge))
+        txNew.vout.push_back(CTxOut(0, txNew.vout[1].scriptPubKey));
+
     // Masternode Payments
     int payments = 1;
     // start masternode payments
@@ -3420,58 +3515,23 @@ set< set<CTxDestination> > CWallet::GetAddressGroupings()
 
 // ppcoin: check 'spent' consistency between wallet and txindex
 // ppcoin: fix wallet spent state according to txindex
-void CWallet::FixSpentCoins(int& nMismatchFound, int64_t& nBalanceInQuestion, bool fCheckOnly)
+bool CWallet::FixSpentCoins(int& nMismatchFound, int64_t& nBalanceInQuestion, bool fCheckOnly, bool fFull)
 {
     nMismatchFound = 0;
     nBalanceInQuestion = 0;
 
-    LOCK(cs_wallet);
-    vector<CWalletTx*> vCoins;
-    vCoins.reserve(mapWallet.size());
+    vector<CSpentMismatch> vMismatch;
 
-    for (auto it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        vCoins.push_back(&(*it).second);
-
-    CTxDB txdb("r");
+    if (!CheckWalletSpent(this, !fCheckOnly, fFull, vMismatch))
+        return false;
 
-    BOOST_FOREACH(CWalletTx* pcoin, vCoins)
+    BOOST_FOREACH(const CSpentMismatch& mismatch, vMismatch)
     {
-        // Find the corresponding transaction index
-        CTxIndex txindex;
-
-        if (!txdb.ReadTxIndex(pcoin->GetHash(), txindex))
-            continue;
-
-        for (unsigned int n=0; n < pcoin->vout.size(); n++)
-        {
-            if (IsMine(pcoin->vout[n]) && pcoin->IsSpent(n) && (txindex.vSpent.size() <= n || txindex.vSpent[n].IsNull()))
-            {
-                LogPrintf("FixSpentCoins found lost coin %s TC %s[%d], %s\n",
-                    FormatMoney(pcoin->vout[n].nValue).c_str(), pcoin->GetHash().ToString().c_str(), n, fCheckOnly? "repair not attempted" : "repairing");
-                nMismatchFound++;
-                nBalanceInQuestion += pcoin->vout[n].nValue;
-
-                if (!fCheckOnly)
-                {
-                    pcoin->MarkUnspent(n);
-                    pcoin->WriteToDisk();
-                }
-            }
-            else if (IsMine(pcoin->vout[n]) && !pcoin->IsSpent(n) && (txindex.vSpent.size() > n && !txindex.vSpent[n].IsNull()))
-            {
-                LogPrintf("FixSpentCoins found spent coin %s TC %s[%d], %s\n",
-                    FormatMoney(pcoin->vout[n].nValue).c_str(), pcoin->GetHash().ToString().c_str(), n, fCheckOnly? "repair not attempted" : "repairing");
-                nMismatchFound++;
-                nBalanceInQuestion += pcoin->vout[n].nValue;
-
-                if (!fCheckOnly)
-                {
-                    pcoin->MarkSpent(n);
-                    pcoin->WriteToDisk();
-                }
-            }
-        }
+        nMismatchFound++;
+        nBalanceInQuestion += mismatch.nValue;
     }
+
+    return true;
 }
 
 // ppcoin: disable transaction (only for coinstake)
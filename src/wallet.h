@@ -26,7 +26,13 @@
 #include "txmempool.h"
 
 extern bool fWalletUnlockStakingOnly;
+extern int nTxConfirmTarget;
 extern bool fConfChange;
+extern int64_t nWalletKdfTargetMillis;
+
+/** Default for -walletkdftime, the time a passphrase derivation should take */
+static const int64_t DEFAULT_WALLET_KDF_MILLIS = 100;
+
 class CAccountingEntry;
 class CReserveKey;
 class COutput;
@@ -533,6 +539,8 @@ public:
     bool AddCScript(const CScript& redeemScript);
     bool LoadCScript(const CScript& redeemScript) { return CCryptoKeyStore::AddCScript(redeemScript); }
     bool Unlock(const SecureString& strWalletPassphrase, bool anonimizeOnly = false);
+    // Decrypt the keys of the largest stakeable outputs ahead of time, see CCryptoKeyStore::GetSigningKey
+    void CacheSigningKeys();
     bool ChangeWalletPassphrase(const SecureString& strOldWalletPassphrase, const SecureString& strNewWalletPassphrase);
     bool EncryptWallet(const SecureString& strWalletPassphrase);
     void GetKeyBirthTimes(std::map<CKeyID, int64_t> &mapKeyBirth) const;
@@ -653,7 +661,7 @@ public:
     // get the current wallet format (the oldest client version guaranteed to understand this wallet)
     int GetVersion() { return nWalletVersion; }
 
-    void FixSpentCoins(int& nMismatchSpent, int64_t& nBalanceInQuestion, bool fCheckOnly = false);
+    bool FixSpentCoins(int& nMismatchSpent, int64_t& nBalanceInQuestion, bool fCheckOnly = false, bool fFull = true);
     void DisableTransaction(const CTransaction &tx);
 
     // Address book entry changed
@@ -0,0 +1,317 @@
+// Copyright (c) 2016-2020 The Neutron Developers
+//
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "walletcheck.h"
+#include "main.h"
+#include "txdb.h"
+#include "util.h"
+#include "wallet.h"
+
+#include <set>
+
+#include <boost/foreach.hpp>
+
+using namespace std;
+
+static CCriticalSection cs_walletcheck;
+static CWalletCheckStatus statusWalletCheck;
+
+void CWalletCheckStatus::SetNull()
+{
+    fRunning = false;
+    fIncremental = false;
+    fRepair = false;
+    nStartTime = 0;
+    nEndTime = 0;
+    nWalletTx = 0;
+    nToCheck = 0;
+    nChecked = 0;
+    nMismatch = 0;
+    nRepaired = 0;
+    nBalanceInQuestion = 0;
+    checkpoint.SetNull();
+}
+
+CWalletCheckStatus GetWalletCheckStatus()
+{
+    LOCK(cs_walletcheck);
+    return statusWalletCheck;
+}
+
+// An output of ours as it was when the check started
+struct CCheckedOutput
+{
+    unsigned int n;
+    int64_t nValue;
+    bool fSpent;
+
+    CCheckedOutput(unsigned int nIn, int64_t nValueIn, bool fSpentIn) : n(nIn), nValue(nValueIn), fSpent(fSpentIn) {}
+};
+
+struct CCheckedTx
+{
+    uint256 hash;
+    vector<CCheckedOutput> vOutputs;
+};
+
+// Requires cs_main
+static bool IsCheckpointUsable(const CWalletCheckpoint& checkpoint)
+{
+    if (checkpoint.IsNull())
+        return false;
+
+    auto mi = mapBlockIndex.find(checkpoint.hashBlock);
+
+    // Reorganized away, or the block database lost blocks the wallet had seen
+    if (mi == mapBlockIndex.end() || !mi->second->IsInMainChain())
+        return false;
+
+    return nBestHeight - mi->second->nHeight <= WALLETCHECK_MAX_BLOCKS;
+}
+
+// Whether wtx is in the best chain at or below nHeight, requires cs_main
+static bool IsConfirmedBy(const CWalletTx& wtx, int nHeight)
+{
+    if (wtx.hashBlock == 0)
+        return false;
+
+    auto mi = mapBlockIndex.find(wtx.hashBlock);
+
+    return mi != mapBlockIndex.end() && mi->second->IsInMainChain() && mi->second->nHeight <= nHeight;
+}
+
+static void CheckWalletSpentRun(CWallet* pwallet, bool fRepair, bool fFull, vector<CSpentMismatch>& vMismatch)
+{
+    CWalletCheckpoint checkpoint, checkpointNew;
+    vector<const CBlockIndex*> vBlocks;
+    bool fIncremental;
+
+    // Where the chain is now and what it got since the last clean check
+    {
+        LOCK(cs_main);
+
+        fIncremental = !fFull && CWalletDB(pwallet->strWalletFile, "r").ReadWalletCheckpoint(checkpoint) &&
+            IsCheckpointUsable(checkpoint);
+
+        if (pindexBest)
+        {
+            checkpointNew.hashBlock = pindexBest->GetBlockHash();
+            checkpointNew.nHeight = pindexBest->nHeight;
+        }
+
+        checkpointNew.nTime = GetAdjustedTime();
+
+        if (fIncremental)
+        {
+            for (const CBlockIndex* pindex = mapBlockIndex[checkpoint.hashBlock]->pnext; pindex; pindex = pindex->pnext)
+                vBlocks.push_back(pindex);
+        }
+    }
+
+    // Transactions with outputs spent since, the blocks are read without any lock
+    set<uint256> setSpentSince;
+
+    BOOST_FOREACH(const CBlockIndex* pindex, vBlocks)
+    {
+        CBlock block;
+
+        if (!block.ReadFromDisk(pindex))
+        {
+            LogPrintf("%s : can't read block %d, checking every transaction\n", __func__, pindex->nHeight);
+            fIncremental = false;
+            break;
+        }
+
+        BOOST_FOREACH(const CTransaction& tx, block.vtx)
+        {
+            BOOST_FOREACH(const CTxIn& txin, tx.vin)
+                setSpentSince.insert(txin.prevout.hash);
+        }
+    }
+
+    // Copy the outputs of ours to look at
+    vector<CCheckedTx> vTx;
+
+    {
+        LOCK2(cs_main, pwallet->cs_wallet);
+
+        set<uint256> setSelected;
+
+        if (fIncremental)
+        {
+            for (auto it = pwallet->mapWallet.begin(); it != pwallet->mapWallet.end(); ++it)
+            {
+                const CWalletTx& wtx = it->second;
+
+                if (setSpentSince.count(it->first) || wtx.nTimeReceived + WALLETCHECK_TIME_MARGIN >= checkpoint.nTime ||
+                    !IsConfirmedBy(wtx, checkpoint.nHeight))
+                {
+                    setSelected.insert(it->first);
+
+                    // Whatever it spends, in case it got disconnected since
+                    BOOST_FOREACH(const CTxIn& txin, wtx.vin)
+                        setSelected.insert(txin.prevout.hash);
+                }
+            }
+        }
+
+        for (auto it = pwallet->mapWallet.begin(); it != pwallet->mapWallet.end(); ++it)
+        {
+            if (fIncremental && !setSelected.count(it->first))
+                continue;
+
+            const CWalletTx& wtx = it->second;
+            CCheckedTx checked;
+            checked.hash = it->first;
+
+            for (unsigned int n = 0; n < wtx.vout.size(); n++)
+            {
+                if (pwallet->IsMine(wtx.vout[n]))
+                    checked.vOutputs.push_back(CCheckedOutput(n, wtx.vout[n].nValue, wtx.IsSpent(n)));
+            }
+
+            if (!checked.vOutputs.empty())
+                vTx.push_back(checked);
+        }
+
+        LOCK(cs_walletcheck);
+        statusWalletCheck.fIncremental = fIncremental;
+        statusWalletCheck.nWalletTx = pwallet->mapWallet.size();
+        statusWalletCheck.nToCheck = vTx.size();
+        statusWalletCheck.checkpoint = checkpoint;
+    }
+
+    // Compare with the transaction index, a batch at a time
+    CTxDB txdb("r");
+    bool fComplete = true;
+
+    for (size_t nBegin = 0; nBegin < vTx.size(); nBegin += WALLETCHECK_BATCH)
+    {
+        if (fShutdown)
+        {
+            fComplete = false;
+            break;
+        }
+
+        size_t nEnd = min(vTx.size(), nBegin + WALLETCHECK_BATCH);
+        vector<uint256> vHashes;
+
+        for (size_t i = nBegin; i < nEnd; i++)
+            vHashes.push_back(vTx[i].hash);
+
+        map<uint256, CTxIndex> mapTxIndex;
+
+        if (!txdb.ReadTxIndexes(vHashes, mapTxIndex))
+            fComplete = false;
+
+        int64_t nBalanceInQuestion = 0;
+
+        for (size_t i = nBegin; i < nEnd; i++)
+        {
+            // Not in the chain, nothing to compare with
+            map<uint256, CTxIndex>::const_iterator mi = mapTxIndex.find(vTx[i].hash);
+
+            if (mi == mapTxIndex.end())
+                continue;
+
+            const CTxIndex& txindex = mi->second;
+
+            BOOST_FOREACH(const CCheckedOutput& output, vTx[i].vOutputs)
+            {
+                bool fSpentInIndex = txindex.vSpent.size() > output.n && !txindex.vSpent[output.n].IsNull();
+
+                if (output.fSpent == fSpentInIndex)
+                    continue;
+
+                LogPrintf("%s : found %s coin %s TC %s[%d], %s\n", __func__, output.fSpent ? "lost" : "spent",
+                          FormatMoney(output.nValue), vTx[i].hash.ToString(), output.n,
+                          fRepair ? "repairing" : "repair not attempted");
+
+                vMismatch.push_back(CSpentMismatch(vTx[i].hash, output.n, output.nValue, output.fSpent));
+                nBalanceInQuestion += output.nValue;
+            }
+        }
+
+        LOCK(cs_walletcheck);
+        statusWalletCheck.nChecked = nEnd;
+        statusWalletCheck.nMismatch = vMismatch.size();
+        statusWalletCheck.nBalanceInQuestion += nBalanceInQuestion;
+    }
+
+    unsigned int nRepaired = 0;
+
+    if (fRepair && !vMismatch.empty())
+    {
+        LOCK(pwallet->cs_wallet);
+
+        set<uint256> setChanged;
+
+        BOOST_FOREACH(const CSpentMismatch& mismatch, vMismatch)
+        {
+            auto mi = pwallet->mapWallet.find(mismatch.hash);
+
+            // Changed since it was copied, the next check looks at it again
+            if (mi == pwallet->mapWallet.end() || mi->second.IsSpent(mismatch.n) != mismatch.fSpentInWallet)
+                continue;
+
+            if (mismatch.fSpentInWallet)
+                mi->second.MarkUnspent(mismatch.n);
+            else
+                mi->second.MarkSpent(mismatch.n);
+
+            setChanged.insert(mismatch.hash);
+            nRepaired++;
+        }
+
+        // All fixes and the checkpoint in one database transaction
+        CWalletDB walletdb(pwallet->strWalletFile);
+        walletdb.TxnBegin();
+
+        BOOST_FOREACH(const uint256& hash, setChanged)
+            walletdb.WriteTx(hash, pwallet->mapWallet[hash]);
+
+        if (fComplete && nRepaired == vMismatch.size())
+            walletdb.WriteWalletCheckpoint(checkpointNew);
+
+        if (!walletdb.TxnCommit())
+            LogPrintf("%s : failed to write %u repaired transactions\n", __func__, setChanged.size());
+    }
+    else if (fComplete && vMismatch.empty())
+        CWalletDB(pwallet->strWalletFile).WriteWalletCheckpoint(checkpointNew);
+
+    LOCK(cs_walletcheck);
+    statusWalletCheck.nRepaired = nRepaired;
+}
+
+bool CheckWalletSpent(CWallet* pwallet, bool fRepair, bool fFull, vector<CSpentMismatch>& vMismatch)
+{
+    vMismatch.clear();
+
+    {
+        LOCK(cs_walletcheck);
+
+        if (statusWalletCheck.fRunning)
+            return false;
+
+        statusWalletCheck.SetNull();
+        statusWalletCheck.fRunning = true;
+        statusWalletCheck.fRepair = fRepair;
+        statusWalletCheck.nStartTime = GetTime();
+    }
+
+    int64_t nStart = GetTimeMillis();
+    CheckWalletSpentRun(pwallet, fRepair, fFull, vMismatch);
+
+    LOCK(cs_walletcheck);
+    statusWalletCheck.fRunning = false;
+    statusWalletCheck.nEndTime = GetTime();
+
+    LogPrintf("%s : %s check of %u of %u transactions, %u mismatches, %u repaired, %dms\n", __func__,
+              statusWalletCheck.fIncremental ? "incremental" : "full", statusWalletCheck.nChecked,
+              statusWalletCheck.nWalletTx, statusWalletCheck.nMismatch, statusWalletCheck.nRepaired,
+              GetTimeMillis() - nStart);
+
+    return true;
+}
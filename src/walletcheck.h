@@ -0,0 +1,81 @@
+// Copyright (c) 2016-2020 The Neutron Developers
+//
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NEUTRON_WALLETCHECK_H
+#define NEUTRON_WALLETCHECK_H
+
+#include "uint256.h"
+#include "walletdb.h"
+
+#include <stdint.h>
+#include <vector>
+
+class CWallet;
+
+/** Most blocks since the checkpoint an incremental check reads, further behind everything is checked */
+static const int WALLETCHECK_MAX_BLOCKS = 5000;
+/** Transaction indexes read at a time, progress is updated in between */
+static const unsigned int WALLETCHECK_BATCH = 1000;
+/** Transactions received this long (seconds) before the checkpoint are looked at again, for clock adjustments */
+static const int64_t WALLETCHECK_TIME_MARGIN = 2 * 60 * 60;
+
+/** An output of ours the wallet and the transaction index disagree on */
+class CSpentMismatch
+{
+public:
+    uint256 hash;
+    unsigned int n;
+    int64_t nValue;
+    bool fSpentInWallet;
+
+    CSpentMismatch(const uint256& hashIn, unsigned int nIn, int64_t nValueIn, bool fSpentInWalletIn) :
+        hash(hashIn), n(nIn), nValue(nValueIn), fSpentInWallet(fSpentInWalletIn) {}
+};
+
+/** The check running now or the last one, for getwalletcheckinfo */
+class CWalletCheckStatus
+{
+public:
+    bool fRunning;
+    bool fIncremental;
+    bool fRepair;
+    int64_t nStartTime;
+    int64_t nEndTime;
+    unsigned int nWalletTx;         // transactions in the wallet
+    unsigned int nToCheck;          // of those, the ones this check looks at
+    unsigned int nChecked;
+    unsigned int nMismatch;
+    unsigned int nRepaired;
+    int64_t nBalanceInQuestion;
+    CWalletCheckpoint checkpoint;   // the check started from this one
+
+    CWalletCheckStatus()
+    {
+        SetNull();
+    }
+
+    void SetNull();
+};
+
+/**
+ * Compares the spent flags of the wallet's outputs with the transaction index.
+ *
+ * The outputs are copied under cs_wallet, the indexes are then read in
+ * batches without holding it, and with fRepair the wallet is corrected in
+ * one database transaction. Outputs that changed in the meantime are left
+ * for the next check.
+ *
+ * Unless fFull, only transactions that could have changed since the last
+ * clean check are examined: those received since, confirmed after it or not
+ * in the best chain, and those spent by blocks connected since. A check that
+ * leaves no mismatch behind moves the checkpoint to the block it started at.
+ *
+ * Returns false if another check is running.
+ */
+bool CheckWalletSpent(CWallet* pwallet, bool fRepair, bool fFull, std::vector<CSpentMismatch>& vMismatch);
+
+CWalletCheckStatus GetWalletCheckStatus();
+
+#endif // NEUTRON_WALLETCHECK_H
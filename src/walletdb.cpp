@@ -8,6 +8,7 @@
 #include "utiltime.h"
 #include "walletdb.h"
 #include "wallet.h"
+#include <boost/bind.hpp>
 #include <boost/version.hpp>
 #include <boost/filesystem.hpp>
 
@@ -757,51 +758,411 @@ void ThreadFlushWalletDB(void* parg)
     }
 }
 
+typedef map<vector<unsigned char>, vector<unsigned char> > WalletRecordMap;
+
+static const int WALLET_DIFFERENTIAL_VERSION = 1;
+
+// Backups are plain database files outside of the environment, like a wallet.dat
+// that was flushed and detached, so they can be put back in place as they are
+static Db* CreateBackupDb(const filesystem::path& path)
+{
+    Db* pdb = new Db(NULL, DB_CXX_NO_EXCEPTIONS);
+    int ret = pdb->open(NULL, path.string().c_str(), "main", DB_BTREE, DB_CREATE | DB_EXCL, 0);
+
+    if (ret != 0)
+    {
+        LogPrintf("%s : cannot create %s, error %d\n", __func__, path.string(), ret);
+        delete pdb;
+        return NULL;
+    }
+
+    return pdb;
+}
+
+static bool PutBackupRecord(Db* pdb, const vector<unsigned char>& vchKey, const vector<unsigned char>& vchValue)
+{
+    // A record may have an empty value, &vch[0] isn't valid then
+    Dbt datKey(vchKey.empty() ? NULL : (void*)vchKey.data(), vchKey.size());
+    Dbt datValue(vchValue.empty() ? NULL : (void*)vchValue.data(), vchValue.size());
+
+    return pdb->put(NULL, &datKey, &datValue, DB_NOOVERWRITE) == 0;
+}
+
+static bool CopySnapshotRecord(Db* pdb, CHashWriter& hasher, unsigned int& nRecords, CDataStream& ssKey, CDataStream& ssValue)
+{
+    vector<unsigned char> vchKey(ssKey.begin(), ssKey.end());
+    vector<unsigned char> vchValue(ssValue.begin(), ssValue.end());
+
+    hasher << vchKey << vchValue;
+    nRecords++;
+
+    return PutBackupRecord(pdb, vchKey, vchValue);
+}
+
+static bool ReadBackupDb(const filesystem::path& path, CWalletBackupInfo& info, WalletRecordMap* pmapRecords)
+{
+    Db db(NULL, DB_CXX_NO_EXCEPTIONS);
+    int ret = db.open(NULL, path.string().c_str(), "main", DB_BTREE, DB_RDONLY, 0);
+
+    if (ret != 0)
+    {
+        db.close(0);
+        return error("%s : cannot open %s, error %d", __func__, path.string(), ret);
+    }
+
+    Dbc* pcursor = NULL;
+
+    if (db.cursor(NULL, &pcursor, 0) != 0 || !pcursor)
+    {
+        db.close(0);
+        return error("%s : cannot read %s", __func__, path.string());
+    }
+
+    CHashWriter hasher(SER_GETHASH, 0);
+    info.nRecords = 0;
+
+    while (true)
+    {
+        Dbt datKey, datValue;
+        ret = pcursor->get(&datKey, &datValue, DB_NEXT);
+
+        if (ret == DB_NOTFOUND)
+            break;
+
+        if (ret != 0)
+        {
+            pcursor->close();
+            db.close(0);
+            return error("%s : error %d reading %s", __func__, ret, path.string());
+        }
+
+        vector<unsigned char> vchKey((unsigned char*)datKey.get_data(), (unsigned char*)datKey.get_data() + datKey.get_size());
+        vector<unsigned char> vchValue((unsigned char*)datValue.get_data(), (unsigned char*)datValue.get_data() + datValue.get_size());
+
+        hasher << vchKey << vchValue;
+        info.nRecords++;
+
+        if (pmapRecords)
+            (*pmapRecords)[vchKey] = vchValue;
+    }
+
+    pcursor->close();
+    db.close(0);
+    info.hash = hasher.GetHash();
+
+    return true;
+}
+
+static filesystem::path BackupPath(const CWallet& wallet, const string& strDest)
+{
+    filesystem::path pathDest(strDest);
+
+    if (filesystem::is_directory(pathDest))
+        pathDest /= wallet.strWalletFile;
+
+    return pathDest;
+}
+
+static filesystem::path BackupTempPath(const filesystem::path& pathDest)
+{
+    unsigned short randv = 0;
+    GetRandBytes((unsigned char*)&randv, sizeof(randv));
+
+    return pathDest.parent_path() / strprintf("%s.%04x", pathDest.filename().string(), randv);
+}
+
+// Writes the records to a new backup file, reads it back to check it restores to
+// exactly what was copied and only then moves it over pathDest
+static bool WriteBackupDb(const filesystem::path& pathDest, boost::function<bool (Db*, CWalletBackupInfo&)> writer,
+                          CWalletBackupInfo& info)
+{
+    filesystem::path pathTmp = BackupTempPath(pathDest);
+    Db* pdb = CreateBackupDb(pathTmp);
+
+    if (!pdb)
+        return false;
+
+    bool fSuccess = writer(pdb, info);
+
+    if (pdb->close(0) != 0)
+        fSuccess = false;
+
+    delete pdb;
+
+    CWalletBackupInfo infoRead;
+
+    if (fSuccess && (!ReadBackupDb(pathTmp, infoRead, NULL) || infoRead.nRecords != info.nRecords || infoRead.hash != info.hash))
+        fSuccess = error("%s : %s does not read back to what was written", __func__, pathTmp.string());
+
+    if (fSuccess && !RenameOver(pathTmp, pathDest))
+        fSuccess = error("%s : rename-into-place of %s failed", __func__, pathDest.string());
+
+    if (!fSuccess)
+        filesystem::remove(pathTmp);
+
+    return fSuccess;
+}
+
+static bool WriteWalletSnapshot(const string& strWalletFile, Db* pdb, CWalletBackupInfo& info)
+{
+    CHashWriter hasher(SER_GETHASH, 0);
+    info.nRecords = 0;
+
+    if (!CDB::ReadSnapshot(strWalletFile, boost::bind(&CopySnapshotRecord, pdb, boost::ref(hasher), boost::ref(info.nRecords), _1, _2)))
+        return false;
+
+    info.hash = hasher.GetHash();
+
+    return true;
+}
+
+static bool WriteRecordMap(const WalletRecordMap& mapRecords, Db* pdb, CWalletBackupInfo& info)
+{
+    CHashWriter hasher(SER_GETHASH, 0);
+    info.nRecords = 0;
+
+    for (WalletRecordMap::const_iterator it = mapRecords.begin(); it != mapRecords.end(); it++)
+    {
+        if (!PutBackupRecord(pdb, it->first, it->second))
+            return false;
+
+        hasher << it->first << it->second;
+        info.nRecords++;
+    }
+
+    info.hash = hasher.GetHash();
+
+    return true;
+}
+
 bool BackupWallet(const CWallet& wallet, const string& strDest)
+{
+    CWalletBackupInfo info;
+    return BackupWallet(wallet, strDest, info);
+}
+
+bool BackupWallet(const CWallet& wallet, const string& strDest, CWalletBackupInfo& info)
 {
     if (!wallet.fFileBacked)
         return false;
 
-    while (!fShutdown)
+    int64_t nStart = GetTimeMillis();
+    filesystem::path pathDest = BackupPath(wallet, strDest);
+
+    try
+    {
+        if (!WriteBackupDb(pathDest, boost::bind(&WriteWalletSnapshot, wallet.strWalletFile, _1, _2), info))
+            return error("%s : backup of %s to %s failed", __func__, wallet.strWalletFile, pathDest.string());
+    }
+    catch (const filesystem::filesystem_error &e)
+    {
+        return error("%s : error copying %s to %s - %s", __func__, wallet.strWalletFile, pathDest.string(), e.what());
+    }
+
+    LogPrintf("copied %s to %s, %u records in %dms\n", wallet.strWalletFile, pathDest.string(), info.nRecords,
+              GetTimeMillis() - nStart);
+
+    return true;
+}
+
+static bool DiffSnapshotRecord(map<vector<unsigned char>, uint256>& mapBase, CHashWriter& hasher, CWalletBackupInfo& info,
+                               vector<pair<vector<unsigned char>, vector<unsigned char> > >& vPut,
+                               CDataStream& ssKey, CDataStream& ssValue)
+{
+    vector<unsigned char> vchKey(ssKey.begin(), ssKey.end());
+    vector<unsigned char> vchValue(ssValue.begin(), ssValue.end());
+
+    hasher << vchKey << vchValue;
+    info.nRecords++;
+
+    map<vector<unsigned char>, uint256>::iterator it = mapBase.find(vchKey);
+
+    if (it == mapBase.end() || it->second != Hash(vchValue.begin(), vchValue.end()))
+        vPut.push_back(make_pair(vchKey, vchValue));
+
+    // Whatever is left in mapBase at the end was erased since the base backup
+    if (it != mapBase.end())
+        mapBase.erase(it);
+
+    return true;
+}
+
+bool BackupWalletDifferential(const CWallet& wallet, const string& strBase, const string& strDest, CWalletBackupInfo& info)
+{
+    if (!wallet.fFileBacked)
+        return false;
+
+    int64_t nStart = GetTimeMillis();
+    CWalletBackupInfo infoBase;
+    WalletRecordMap mapBaseRecords;
+
+    if (!ReadBackupDb(filesystem::path(strBase), infoBase, &mapBaseRecords))
+        return error("%s : cannot read base backup %s", __func__, strBase);
+
+    // Only a hash per value is kept while the snapshot is compared against the base
+    map<vector<unsigned char>, uint256> mapBase;
+
+    for (WalletRecordMap::const_iterator it = mapBaseRecords.begin(); it != mapBaseRecords.end(); it++)
+        mapBase[it->first] = Hash(it->second.begin(), it->second.end());
+
+    mapBaseRecords.clear();
+
+    CHashWriter hasher(SER_GETHASH, 0);
+    vector<pair<vector<unsigned char>, vector<unsigned char> > > vPut;
+    info.nRecords = 0;
+
+    if (!CDB::ReadSnapshot(wallet.strWalletFile, boost::bind(&DiffSnapshotRecord, boost::ref(mapBase), boost::ref(hasher),
+                                                             boost::ref(info), boost::ref(vPut), _1, _2)))
+        return error("%s : cannot read %s", __func__, wallet.strWalletFile);
+
+    info.hash = hasher.GetHash();
+
+    vector<vector<unsigned char> > vErase;
+
+    for (map<vector<unsigned char>, uint256>::const_iterator it = mapBase.begin(); it != mapBase.end(); it++)
+        vErase.push_back(it->first);
+
+    // Serialize the changes, checksum data up to that point, then append csum
+    CDataStream ssDiff(SER_DISK, CLIENT_VERSION);
+    ssDiff << FLATDATA(pchMessageStart);
+    ssDiff << WALLET_DIFFERENTIAL_VERSION;
+    ssDiff << infoBase.hash << info.hash << info.nRecords;
+    ssDiff << vPut << vErase;
+    uint256 hash = Hash(ssDiff.begin(), ssDiff.end());
+    ssDiff << hash;
+
+    filesystem::path pathDest(strDest);
+    filesystem::path pathTmp = BackupTempPath(pathDest);
+    FILE *file = fopen(pathTmp.string().c_str(), "wb");
+    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+
+    if (fileout.IsNull())
+        return error("%s : failed to open file %s", __func__, pathTmp.string());
+
+    try
+    {
+        fileout << ssDiff;
+    }
+    catch (const std::exception& e)
+    {
+        return error("%s : serialize or I/O error - %s", __func__, e.what());
+    }
+
+    FileCommit(fileout.Get());
+    fileout.fclose();
+
+    if (!RenameOver(pathTmp, pathDest))
+        return error("%s : rename-into-place failed", __func__);
+
+    LogPrintf("wrote differential backup of %s to %s, %u changed and %u erased records in %dms\n", wallet.strWalletFile,
+              pathDest.string(), vPut.size(), vErase.size(), GetTimeMillis() - nStart);
+
+    return true;
+}
+
+bool RestoreWalletBackup(const string& strBase, const string& strDifferential, const string& strDest, CWalletBackupInfo& info)
+{
+    CWalletBackupInfo infoBase;
+    WalletRecordMap mapRecords;
+
+    if (!ReadBackupDb(filesystem::path(strBase), infoBase, &mapRecords))
+        return error("%s : cannot read base backup %s", __func__, strBase);
+
+    info = infoBase;
+
+    if (!strDifferential.empty())
     {
+        filesystem::path pathDiff(strDifferential);
+        FILE *file = fopen(pathDiff.string().c_str(), "rb");
+        CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+
+        if (filein.IsNull())
+            return error("%s : failed to open file %s", __func__, pathDiff.string());
+
+        uint64_t fileSize = filesystem::file_size(pathDiff);
+        uint64_t dataSize = 0;
+
+        if (fileSize >= sizeof(uint256))
+            dataSize = fileSize - sizeof(uint256);
+
+        vector<unsigned char> vchData;
+        vchData.resize(dataSize);
+        uint256 hashIn;
+
+        try
         {
-            LOCK(bitdb.cs_db);
+            filein.read((char *)&vchData[0], dataSize);
+            filein >> hashIn;
+        }
+        catch (const std::exception& e)
+        {
+            return error("%s : deserialize or I/O error - %s", __func__, e.what());
+        }
 
-            if (!bitdb.mapFileUseCount.count(wallet.strWalletFile) || bitdb.mapFileUseCount[wallet.strWalletFile] == 0)
-            {
-                // Flush log data to the dat file
-                bitdb.CloseDb(wallet.strWalletFile);
-                bitdb.CheckpointLSN(wallet.strWalletFile);
-                bitdb.mapFileUseCount.erase(wallet.strWalletFile);
-
-                // Copy wallet.dat
-                filesystem::path pathSrc = GetDataDir() / wallet.strWalletFile;
-                filesystem::path pathDest(strDest);
-
-                if (filesystem::is_directory(pathDest))
-                    pathDest /= wallet.strWalletFile;
-
-                try {
-#if BOOST_VERSION >= 104000
-                    filesystem::copy_file(pathSrc, pathDest, filesystem::copy_option::overwrite_if_exists);
-#else
-                    filesystem::copy_file(pathSrc, pathDest);
-#endif
-                    LogPrintf("copied wallet.dat to %s\n", pathDest.string().c_str());
-                    return true;
-                }
-                catch(const filesystem::filesystem_error &e)
-                {
-                    LogPrintf("error copying wallet.dat to %s - %s\n", pathDest.string().c_str(), e.what());
-                    return false;
-                }
-            }
+        filein.fclose();
+        CDataStream ssDiff(vchData, SER_DISK, CLIENT_VERSION);
+
+        if (hashIn != Hash(ssDiff.begin(), ssDiff.end()))
+            return error("%s : checksum mismatch, data corrupted", __func__);
+
+        unsigned char pchMsgTmp[4];
+        int nVersion;
+        uint256 hashBase;
+        vector<pair<vector<unsigned char>, vector<unsigned char> > > vPut;
+        vector<vector<unsigned char> > vErase;
+
+        try
+        {
+            ssDiff >> FLATDATA(pchMsgTmp) >> nVersion;
+
+            if (memcmp(pchMsgTmp, pchMessageStart, sizeof(pchMsgTmp)))
+                return error("%s : invalid network magic number", __func__);
+
+            if (nVersion > WALLET_DIFFERENTIAL_VERSION)
+                return error("%s : unsupported differential backup version %d", __func__, nVersion);
+
+            ssDiff >> hashBase >> info.hash >> info.nRecords >> vPut >> vErase;
+        }
+        catch (const std::exception& e)
+        {
+            return error("%s : deserialize or I/O error - %s", __func__, e.what());
         }
 
-        MilliSleep(100);
+        if (hashBase != infoBase.hash)
+            return error("%s : %s was not made against %s", __func__, strDifferential, strBase);
+
+        for (unsigned int i = 0; i < vErase.size(); i++)
+            mapRecords.erase(vErase[i]);
+
+        for (unsigned int i = 0; i < vPut.size(); i++)
+            mapRecords[vPut[i].first] = vPut[i].second;
     }
 
-    return false;
+    CWalletBackupInfo infoExpected = info;
+
+    try
+    {
+        if (!WriteBackupDb(filesystem::path(strDest), boost::bind(&WriteRecordMap, boost::cref(mapRecords), _1, _2), info))
+            return error("%s : writing %s failed", __func__, strDest);
+    }
+    catch (const filesystem::filesystem_error &e)
+    {
+        return error("%s : error writing %s - %s", __func__, strDest, e.what());
+    }
+
+    // The rebuilt wallet has to be the one the differential backup was taken from
+    if (info.nRecords != infoExpected.nRecords || info.hash != infoExpected.hash)
+    {
+        filesystem::remove(filesystem::path(strDest));
+        return error("%s : restored wallet does not match the backup", __func__);
+    }
+
+    return true;
+}
+
+bool VerifyWalletBackup(const string& strPath, CWalletBackupInfo& info)
+{
+    return ReadBackupDb(filesystem::path(strPath), info, NULL);
 }
 
 // Try to (very carefully!) recover wallet.dat if there is a problem
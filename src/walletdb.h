@@ -55,6 +55,44 @@ public:
     }
 };
 
+/** Where the last clean check of the spent flags got to, an incremental check
+ *  only looks at transactions that could have changed since */
+class CWalletCheckpoint
+{
+public:
+    static const int CURRENT_VERSION=1;
+    int nVersion;
+    uint256 hashBlock;      // best block when the check started
+    int nHeight;
+    int64_t nTime;          // adjusted time when the check started
+
+    CWalletCheckpoint()
+    {
+        SetNull();
+    }
+
+    IMPLEMENT_SERIALIZE
+    (
+        READWRITE(this->nVersion);
+        READWRITE(hashBlock);
+        READWRITE(nHeight);
+        READWRITE(nTime);
+    )
+
+    void SetNull()
+    {
+        nVersion = CWalletCheckpoint::CURRENT_VERSION;
+        hashBlock = 0;
+        nHeight = -1;
+        nTime = 0;
+    }
+
+    bool IsNull() const
+    {
+        return nHeight < 0;
+    }
+};
+
 class CAdrenalineNodeConfig
 {
 public:
@@ -162,6 +200,17 @@ public:
         return Read(std::string("bestblock"), locator);
     }
 
+    bool WriteWalletCheckpoint(const CWalletCheckpoint& checkpoint)
+    {
+        nWalletDBUpdated++;
+        return Write(std::string("walletcheck"), checkpoint);
+    }
+
+    bool ReadWalletCheckpoint(CWalletCheckpoint& checkpoint)
+    {
+        return Read(std::string("walletcheck"), checkpoint);
+    }
+
     bool WriteOrderPosNext(int64_t nOrderPosNext)
     {
         nWalletDBUpdated++;